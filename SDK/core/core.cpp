@@ -1,3 +1,4 @@
+#include <SDL2/SDL.h>
 #include <core/core.h>
 
 bool testPtInRect(const point_t& pt, const rect_t& rect)
@@ -14,6 +15,7 @@ bool mem_area(memory_t* mem, size_t size)
 {
     mem->allocated = 0;
     mem->size      = size;
+    mem->mapped    = false;
     mem->buffer    = (uint8_t*)malloc(size);
 
     return true;
@@ -23,6 +25,7 @@ bool mem_thread_stack_init(memory_t* mem, size_t size)
 {
     mem->allocated = 0;
     mem->size      = size;
+    mem->mapped    = false;
     mem->buffer    = (uint8_t*)core::thread_stack_alloc(size);
 
     return true;
@@ -39,6 +42,7 @@ bool mem_file(memory_t* mem, const char* name)
 
     mem->size      = (size_t)PHYSFS_fileLength(src);
     mem->allocated = 0;
+    mem->mapped    = false;
     mem->buffer    = (uint8_t*)malloc(mem->size+1);
 
     PHYSFS_read(src, mem->buffer, mem->size, 1);
@@ -48,13 +52,21 @@ bool mem_file(memory_t* mem, const char* name)
     return true;
 }
 
+static void mem_unmap(memory_t* mem);
+static bool mem_native_path(char* path, size_t size, const char* name);
+static bool mem_map_native(memory_t* mem, const char* path, int hints);
+
 void mem_free(memory_t* mem)
 {
-    if (mem->buffer) free(mem->buffer);
+    if (mem->mapped)
+        mem_unmap(mem);
+    else if (mem->buffer)
+        free(mem->buffer);
 
     mem->buffer    = 0;
     mem->size      = 0;
     mem->allocated = 0;
+    mem->mapped    = false;
 }
 
 char* cpToUTF8(int cp, char* str)
@@ -82,6 +94,7 @@ struct stack_mem_data_t
 {
     size_t  size;
     size_t  allocated;
+    size_t  peak;
     uint8_t data[1];
 };
 
@@ -89,8 +102,9 @@ void  stack_mem_init(stack_mem_t* stack, void* mem, size_t size)
 {
     *stack = (stack_mem_t)mem;
 
-    (*stack)->size = size;
+    (*stack)->size = size - offsetof(stack_mem_data_t, data);
     (*stack)->allocated = 0;
+    (*stack)->peak = 0;
 }
 
 void* stack_mem_alloc(stack_mem_t stack, size_t size, size_t align)
@@ -108,6 +122,7 @@ void* stack_mem_alloc(stack_mem_t stack, size_t size, size_t align)
     void* p = stack->data + stack->allocated;
 
     stack->allocated += size;
+    stack->peak = core::max(stack->peak, stack->allocated);
 
     return p;
 }
@@ -120,53 +135,353 @@ void  stack_mem_reset(stack_mem_t stack, void* ptr)
     stack->allocated = (uint8_t*)ptr - stack->data;
 }
 
+size_t stack_mem_marker(stack_mem_t stack)
+{
+    return stack->allocated;
+}
+
+void stack_mem_rewind(stack_mem_t stack, size_t marker)
+{
+    assert(marker<=stack->allocated);
+
+    stack->allocated = marker;
+}
+
+size_t stack_mem_peak(stack_mem_t stack)
+{
+    return stack->peak;
+}
+
 namespace core
 {
     static const size_t THREAD_DATA_STACK_SIZE = 256 * (1<<10);
-
-    static stack_mem_t mainThreadDataStack = 0;
-    static uint8_t* threadDataStackMem;
+    static const size_t MAX_THREAD_DATA_STACKS = 64;
+
+    // Stacks are allocated on first use and owned by core, threads only cache pointer.
+    // Generation invalidates cached pointers after fini.
+    // Stack of SDL thread is returned to free list by TLS destructor when thread exits.
+    static stack_mem_t  threadDataStacks[MAX_THREAD_DATA_STACKS];
+    static size_t       numThreadDataStacks;
+    static stack_mem_t  freeThreadDataStacks[MAX_THREAD_DATA_STACKS];
+    static size_t       numFreeThreadDataStacks;
+    static SDL_SpinLock threadDataStacksLock;
+    static uint32_t     threadDataStacksGen = 1;
+    static SDL_TLSID    threadDataStackTLS;
+
+    static CORE_THREAD_LOCAL stack_mem_t threadDataStack;
+    static CORE_THREAD_LOCAL uint32_t    threadDataStackGen;
 
     static const size_t MSPACE_CORE_SIZE = 1*(1<<20);
     static mspace_t mspace_core;
+    static uint16_t mspace_core_gauge;
+    // Only etlsf arena headers and concurrent state are allocated with tag in core mspace
+    static mem_tag_t etlsf_arenas_tag;
+
+    static const size_t FRAME_MEM_BUFFERS   = 2;
+    static const size_t FRAME_MEM_SIZE      = 8 * (1<<20);
+    static const size_t FRAME_MEM_PAGE_SIZE = 64 * (1<<10);
+    // Larger allocations are taken directly from frame buffer, so pages are not wasted
+    static const size_t FRAME_MEM_MAX_PAGE_ALLOC = FRAME_MEM_PAGE_SIZE / 4;
+    // Heap blocks keep header with link to free them with frame buffer
+    static const size_t FRAME_OVERFLOW_HEADER = 16;
+
+    struct frame_page_t
+    {
+        uint8_t* ptr;
+        uint8_t* end;
+        int      frame;
+    };
+
+    // Frame counter is never reset, so pages cached by threads before fini are not reused
+    static uint8_t*      frameMem;
+    static SDL_atomic_t  frameMemFrame = {1};
+    static SDL_atomic_t  frameMemAllocated;
+    static SDL_atomic_t  frameMemOverflows;
+    static SDL_atomic_t  frameMemFrameOverflows;
+    static SDL_SpinLock  frameOverflowsLock;
+    static void*         frameOverflows[FRAME_MEM_BUFFERS];
+    static uint16_t      frameMemGauge;
+
+    static CORE_THREAD_LOCAL frame_page_t threadFramePage;
+
+    static int64_t sampleSpaceUsed(void* mspace)
+    {
+        return mem_space_used((mspace_t)mspace);
+    }
 
-    void init()
+    static int64_t sampleFrameMemUsed(void*)
     {
-        threadDataStackMem = (uint8_t*)malloc(THREAD_DATA_STACK_SIZE);
-        stack_mem_init(&mainThreadDataStack, threadDataStackMem, THREAD_DATA_STACK_SIZE);
+        return frame_mem_used();
+    }
 
+    static void frame_overflows_free(size_t buffer)
+    {
+        SDL_AtomicLock(&frameOverflowsLock);
+        void* block = frameOverflows[buffer];
+        frameOverflows[buffer] = 0;
+        SDL_AtomicUnlock(&frameOverflowsLock);
+
+        while (block)
+        {
+            void* next = *(void**)block;
+            free(block);
+            block = next;
+        }
+    }
+
+    void init()
+    {
         profilerInit();
-        mt::init(1, 128);
+        mt::init(-1, 2048);
+        io::init(2, 64*1024*1024);
 
         mspace_core = mem_create_space(MSPACE_CORE_SIZE);
+        mspace_core_gauge = profilerAddGaugeSampler("mspace core bytes", sampleSpaceUsed, mspace_core);
+        etlsf_arenas_tag  = mem_register_tag("etlsf arenas");
+
+        frameMem = (uint8_t*)malloc(FRAME_MEM_BUFFERS * FRAME_MEM_SIZE);
+        SDL_AtomicSet(&frameMemAllocated, 0);
+        SDL_AtomicSet(&frameMemOverflows, 0);
+        SDL_AtomicSet(&frameMemFrameOverflows, 0);
+        frameMemGauge = profilerAddGaugeSampler("frame mem bytes", sampleFrameMemUsed, 0);
     }
 
     void fini()
     {
+        io::fini();
+
+        profilerRemoveGaugeSampler(frameMemGauge);
+        for (size_t i = 0; i < FRAME_MEM_BUFFERS; ++i)
+        {
+            frame_overflows_free(i);
+        }
+        free(frameMem);
+        frameMem = 0;
+        SDL_AtomicAdd(&frameMemFrame, 1);
+
+        profilerRemoveGaugeSampler(mspace_core_gauge);
         mem_destroy_space(mspace_core);
         mspace_core = 0;
 
+        mem_tags_report_leaks();
+
         mt::fini();
+        profilerFini();
+
+        SDL_AtomicLock(&threadDataStacksLock);
+        for (size_t i = 0; i < numThreadDataStacks; ++i)
+        {
+            free(threadDataStacks[i]);
+            threadDataStacks[i] = 0;
+        }
+        numThreadDataStacks     = 0;
+        numFreeThreadDataStacks = 0;
+        ++threadDataStacksGen;
+        SDL_AtomicUnlock(&threadDataStacksLock);
+    }
 
-        free(threadDataStackMem);
+    static void release_thread_data_stack(void* stack)
+    {
+        SDL_AtomicLock(&threadDataStacksLock);
+        // Stacks freed by fini are not in the table anymore
+        for (size_t i = 0; i < numThreadDataStacks; ++i)
+        {
+            if (threadDataStacks[i] == (stack_mem_t)stack)
+            {
+                freeThreadDataStacks[numFreeThreadDataStacks++] = (stack_mem_t)stack;
+                break;
+            }
+        }
+        SDL_AtomicUnlock(&threadDataStacksLock);
+    }
+
+    static stack_mem_t create_thread_data_stack()
+    {
+        stack_mem_t stack = 0;
+
+        SDL_AtomicLock(&threadDataStacksLock);
+        bool reuse = numFreeThreadDataStacks > 0;
+        SDL_AtomicUnlock(&threadDataStacksLock);
+
+        // Memory of new stack is allocated outside of spinlock, unused if stack is reused meanwhile
+        void* mem = reuse ? 0 : malloc(THREAD_DATA_STACK_SIZE);
+
+        SDL_AtomicLock(&threadDataStacksLock);
+        if (numFreeThreadDataStacks)
+        {
+            stack = freeThreadDataStacks[--numFreeThreadDataStacks];
+            stack_mem_rewind(stack, 0);
+        }
+        else if (mem && numThreadDataStacks < MAX_THREAD_DATA_STACKS)
+        {
+            stack_mem_init(&stack, mem, THREAD_DATA_STACK_SIZE);
+            threadDataStacks[numThreadDataStacks++] = stack;
+            mem = 0;
+        }
+        if (!threadDataStackTLS)
+        {
+            threadDataStackTLS = SDL_TLSCreate();
+        }
+        threadDataStackGen = threadDataStacksGen;
+        SDL_AtomicUnlock(&threadDataStacksLock);
+
+        free(mem);
+
+        if (stack)
+        {
+            SDL_TLSSet(threadDataStackTLS, stack, release_thread_data_stack);
+        }
+
+        return stack;
     }
 
-    //TODO: make mt!!!!!
     stack_mem_t get_thread_data_stack()
     {
-        assert(mainThreadDataStack);
+        if (!threadDataStack || threadDataStackGen != threadDataStacksGen)
+        {
+            threadDataStack = create_thread_data_stack();
+        }
 
-        return mainThreadDataStack;
+        return threadDataStack;
     }
 
     void* thread_stack_alloc(size_t size, size_t align)
     {
-        return stack_mem_alloc(get_thread_data_stack(), size, align);
+        stack_mem_t stack = get_thread_data_stack();
+
+        return stack ? stack_mem_alloc(stack, size, align) : 0;
     }
 
     void thread_stack_reset(void* ptr)
     {
-        stack_mem_reset(get_thread_data_stack(), ptr);
+        stack_mem_t stack = get_thread_data_stack();
+
+        if (stack) stack_mem_reset(stack, ptr);
+    }
+
+    size_t thread_stack_peak()
+    {
+        stack_mem_t stack = get_thread_data_stack();
+
+        return stack ? stack_mem_peak(stack) : 0;
+    }
+
+    size_t thread_stacks_peak()
+    {
+        size_t peak = 0;
+
+        SDL_AtomicLock(&threadDataStacksLock);
+        for (size_t i = 0; i < numThreadDataStacks; ++i)
+        {
+            peak = core::max(peak, stack_mem_peak(threadDataStacks[i]));
+        }
+        SDL_AtomicUnlock(&threadDataStacksLock);
+
+        return peak;
+    }
+
+    void frame_mem_begin()
+    {
+        int overflows = SDL_AtomicSet(&frameMemFrameOverflows, 0);
+        if (overflows)
+        {
+            core_log(LOG_CAT_SYS, LOG_PRIO_WARN, "Frame memory: %d allocations fell back to heap\n", overflows);
+        }
+
+        int frame = SDL_AtomicGet(&frameMemFrame) + 1;
+
+        // Buffer was used FRAME_MEM_BUFFERS frames ago
+        frame_overflows_free(frame % FRAME_MEM_BUFFERS);
+
+        SDL_AtomicSet(&frameMemAllocated, 0);
+        SDL_AtomicSet(&frameMemFrame, frame);
+    }
+
+    // Takes memory shared by threads from current frame buffer, 0 if buffer is exhausted
+    static uint8_t* frame_mem_take(int frame, size_t size)
+    {
+        if (!frameMem || size > FRAME_MEM_SIZE) return 0;
+
+        int offset;
+        do
+        {
+            offset = SDL_AtomicGet(&frameMemAllocated);
+            if (offset + size > FRAME_MEM_SIZE) return 0;
+        }
+        while (!SDL_AtomicCAS(&frameMemAllocated, offset, offset + (int)size));
+
+        return frameMem + (frame % FRAME_MEM_BUFFERS) * FRAME_MEM_SIZE + offset;
+    }
+
+    static uint8_t* frame_align(uint8_t* ptr, size_t align)
+    {
+        size_t rem = align ? (size_t)ptr % align : 0;
+        return rem ? ptr + align - rem : ptr;
+    }
+
+    static void* frame_mem_overflow(int frame, size_t size, size_t align)
+    {
+        SDL_AtomicAdd(&frameMemOverflows, 1);
+        SDL_AtomicAdd(&frameMemFrameOverflows, 1);
+
+        uint8_t* block = (uint8_t*)malloc(FRAME_OVERFLOW_HEADER + size + align);
+        if (!block) return 0;
+
+        SDL_AtomicLock(&frameOverflowsLock);
+        *(void**)block = frameOverflows[frame % FRAME_MEM_BUFFERS];
+        frameOverflows[frame % FRAME_MEM_BUFFERS] = block;
+        SDL_AtomicUnlock(&frameOverflowsLock);
+
+        return frame_align(block + FRAME_OVERFLOW_HEADER, align);
+    }
+
+    void* frame_alloc(size_t size, size_t align)
+    {
+        frame_page_t& page  = threadFramePage;
+        int           frame = SDL_AtomicGet(&frameMemFrame);
+
+        if (page.frame != frame)
+        {
+            page.ptr   = 0;
+            page.end   = 0;
+            page.frame = frame;
+        }
+
+        uint8_t* ptr = frame_align(page.ptr, align);
+
+        if (!page.ptr || ptr + size > page.end)
+        {
+            if (size + align > FRAME_MEM_MAX_PAGE_ALLOC)
+            {
+                uint8_t* block = frame_mem_take(frame, size + align);
+                return block ? frame_align(block, align) : frame_mem_overflow(frame, size, align);
+            }
+
+            uint8_t* newPage = frame_mem_take(frame, FRAME_MEM_PAGE_SIZE);
+            if (!newPage)
+            {
+                return frame_mem_overflow(frame, size, align);
+            }
+
+            page.ptr = newPage;
+            page.end = newPage + FRAME_MEM_PAGE_SIZE;
+
+            ptr = frame_align(page.ptr, align);
+        }
+
+        page.ptr = ptr + size;
+
+        return ptr;
+    }
+
+    size_t frame_mem_used()
+    {
+        return (size_t)SDL_AtomicGet(&frameMemAllocated);
+    }
+
+    size_t frame_mem_overflows()
+    {
+        return (size_t)SDL_AtomicGet(&frameMemOverflows);
     }
 };
 
@@ -174,11 +489,12 @@ extern "C"
 {
 #define ETLSF_assert assert
 #define ETLSF_memset(ptr, size, value) mem_set(ptr, size, 0)
-#define ETLSF_alloc(size) mem_alloc(core::mspace_core, size, 0)
+#define ETLSF_alloc(size) mem_alloc_tagged(core::mspace_core, size, 0, core::etlsf_arenas_tag)
 #define ETLSF_free(ptr) mem_free(core::mspace_core, ptr)
 #define ETLSF_fls bit_fls
 #define ETLSF_ffs bit_ffs
 #define ETLSF_align2 bit_align_up
+#define ETLSF_thread_local CORE_THREAD_LOCAL
 #include "etlsf.c"
 
 #include "str.c"
@@ -190,8 +506,10 @@ extern "C"
 
 #include "ml.cpp"
 #include "mt.cpp"
+#include "io.cpp"
 #include "timer.cpp"
 #include "profiler.cpp"
+#include "profiler_stats.cpp"
 
 extern "C"
 {
@@ -206,8 +524,370 @@ extern "C"
 
 #ifdef __WIN32__
 #include "windows.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __WIN32__
+typedef struct
+{
+    ULONG_PTR VirtualAddress;
+    SIZE_T    NumberOfBytes;
+} mem_range_entry_t;
+
+typedef BOOL (WINAPI *prefetch_virtual_memory_t)(HANDLE, ULONG_PTR, mem_range_entry_t*, ULONG);
+
+static bool mem_map_native(memory_t* mem, const char* path, int hints)
+{
+    DWORD  flags = hints & MEM_MAP_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+    HANDLE file  = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, flags, 0);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    void*         view    = 0;
+    HANDLE        mapping = 0;
+
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 && (uint64_t)fileSize.QuadPart < SIZE_MAX)
+    {
+        mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    }
+
+    // View keeps mapping alive
+    if (mapping)
+    {
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+
+    if (!view) return false;
+
+    mem->buffer    = (uint8_t*)view;
+    mem->size      = (size_t)fileSize.QuadPart;
+    mem->allocated = 0;
+    mem->mapped    = true;
+
+    // Available since Windows 8
+    static prefetch_virtual_memory_t prefetchVirtualMemory = (prefetch_virtual_memory_t)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+    if ((hints & MEM_MAP_WILLNEED) && prefetchVirtualMemory)
+    {
+        mem_range_entry_t range = {(ULONG_PTR)view, mem->size};
+        prefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+    return true;
+}
+
+static void mem_unmap(memory_t* mem)
+{
+    UnmapViewOfFile(mem->buffer);
+}
+
+// Fails if destination is mapped or opened by another process
+static bool mem_replace_file(const char* src, const char* dst)
+{
+    return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static bool mem_native_is_dir(const char* path)
+{
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+#else
+static bool mem_map_native(memory_t* mem, const char* path, int hints)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat info;
+    void*       view = MAP_FAILED;
+
+    if (fstat(file, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        view = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+
+    close(file);
+
+    if (view == MAP_FAILED) return false;
+
+    mem->buffer    = (uint8_t*)view;
+    mem->size      = (size_t)info.st_size;
+    mem->allocated = 0;
+    mem->mapped    = true;
+
+    if (hints & MEM_MAP_SEQUENTIAL) madvise(view, mem->size, MADV_SEQUENTIAL);
+    if (hints & MEM_MAP_WILLNEED)   madvise(view, mem->size, MADV_WILLNEED);
+
+    return true;
+}
+
+static void mem_unmap(memory_t* mem)
+{
+    munmap(mem->buffer, mem->size);
+}
+
+static bool mem_replace_file(const char* src, const char* dst)
+{
+    return rename(src, dst) == 0;
+}
+
+static bool mem_native_is_dir(const char* path)
+{
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
 #endif
 
+// Native path of file if it is found in directory of search path, archives are not mapped.
+// Mount point of directory is virtual prefix of name, it is not part of native path.
+static bool mem_native_path(char* path, size_t size, const char* name)
+{
+    const char* dir = PHYSFS_getRealDir(name);
+    if (!dir || !mem_native_is_dir(dir)) return false;
+
+    // Mount point is "/" for root or sanitized "prefix/", names have no leading slash
+    const char* mountPoint = PHYSFS_getMountPoint(dir);
+    if (!mountPoint) return false;
+
+    while (*name == '/') ++name;
+
+    if (strcmp(mountPoint, "/") != 0)
+    {
+        size_t prefix = strlen(mountPoint);
+        if (strncmp(name, mountPoint, prefix) != 0) return false;
+
+        name += prefix;
+    }
+
+    int length = SDL_snprintf(path, size, "%s%s%s", dir, PHYSFS_getDirSeparator(), name);
+
+    return length > 0 && (size_t)length < size;
+}
+
+bool mem_map(memory_t* mem, const char* name, int hints)
+{
+    char path[1024];
+
+    if (mem_native_path(path, sizeof(path), name) && mem_map_native(mem, path, hints))
+    {
+        return true;
+    }
+
+    return mem_file(mem, name);
+}
+
+// Cache file is header followed by storage written by mjson_build_index
+struct bjson_cache_header_t
+{
+    uint32_t fourcc;
+    uint32_t version;
+    uint64_t sourceHash;
+    int64_t  sourceTime;
+    uint64_t sourceSize;
+    uint64_t size;          // BJSON bytes after header
+};
+
+static const uint32_t BJSON_CACHE_FOURCC  = 'CJSB';
+static const uint32_t BJSON_CACHE_VERSION = 2;
+
+// FNV-1a
+static uint64_t mem_hash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static bool mem_bjson_cache_top(memory_t* mem, mjson_element_t* root)
+{
+    if (mem->size < sizeof(bjson_cache_header_t)) return false;
+
+    bjson_cache_header_t* header = (bjson_cache_header_t*)mem->buffer;
+
+    if (header->fourcc  != BJSON_CACHE_FOURCC  ||
+        header->version != BJSON_CACHE_VERSION ||
+        header->size    != mem->size - sizeof(bjson_cache_header_t))
+    {
+        return false;
+    }
+
+    uint8_t* storage = mem->buffer + sizeof(bjson_cache_header_t);
+
+    // Truncated or corrupted cache is parsed again, nested reads stay inside of buffer
+    if (!mjson_validate(storage, (size_t)header->size)) return false;
+
+    *root = mjson_get_top_element(storage, (size_t)header->size);
+
+    return *root != 0;
+}
+
+// Cache is written next to source, sources in archives are not cached.
+// File is written under temporary name and replaces cache when complete, so concurrent
+// loaders never see partial cache. Cache should not be mapped by caller.
+static void mem_bjson_cache_write(const char* name, const void* data, size_t size)
+{
+    char path[1024];
+    char temp[1024];
+
+    if (!mem_native_path(path, sizeof(path), name)) return;
+
+    SDL_strlcat(path, ".bjson", sizeof(path));
+    SDL_snprintf(temp, sizeof(temp), "%s.%lx.%llx.tmp", path, SDL_ThreadID(), (unsigned long long)SDL_GetPerformanceCounter());
+
+    SDL_RWops* dst = SDL_RWFromFile(temp, "wb");
+    if (!dst) return;
+
+    bool written = SDL_RWwrite(dst, data, size, 1) == 1;
+
+    written = SDL_RWclose(dst) == 0 && written;
+
+    if (!written || !mem_replace_file(temp, path))
+    {
+        core_log(LOG_CAT_SYS, LOG_PRIO_WARN, "Failed to write BJSON cache %s\n", path);
+        remove(temp);
+    }
+}
+
+bool mem_mjson(memory_t* mem, const char* name, mjson_element_t* root)
+{
+    PROFILER_CPU_TIMESLICE("mem_mjson");
+
+    char cacheName[1024];
+    SDL_snprintf(cacheName, sizeof(cacheName), "%s.bjson", name);
+
+    *root = 0;
+
+    PHYSFS_sint64 sourceTime = PHYSFS_getLastModTime(name);
+    PHYSFS_sint64 cacheTime  = PHYSFS_getLastModTime(cacheName);
+    PHYSFS_sint64 sourceSize = -1;
+
+    PHYSFS_File* src = PHYSFS_openRead(name);
+    if (src)
+    {
+        sourceSize = PHYSFS_fileLength(src);
+        PHYSFS_close(src);
+    }
+
+    if (sourceSize < 0) return false;
+
+    memory_t text   = {0, 0, 0, false};
+    bool     cached = mem_map(mem, cacheName, MEM_MAP_WILLNEED) && mem_bjson_cache_top(mem, root);
+
+    bjson_cache_header_t header = {0};
+    if (cached) header = *(bjson_cache_header_t*)mem->buffer;
+
+    // Mtimes have 1 second resolution: source changed in the same second as cache was written
+    // could keep its time and size, only hash of content is trusted then
+    bool timeResolved = sourceTime != -1 && sourceTime < cacheTime;
+
+    // Source is not modified, lexing and reading of source are skipped
+    if (cached && timeResolved && header.sourceTime == sourceTime && header.sourceSize == (uint64_t)sourceSize)
+    {
+        return true;
+    }
+
+    if (!mem_file(&text, name))
+    {
+        mem_free(mem);
+        *root = 0;
+        return false;
+    }
+
+    uint64_t hash = mem_hash(text.buffer, text.size);
+
+    // Source is touched, but content is the same
+    if (cached && header.sourceHash == hash && header.sourceSize == text.size)
+    {
+        mem_free(&text);
+
+        if (header.sourceTime == sourceTime && timeResolved) return true;
+
+        // Cache is copied before it is replaced, mapped file is never written
+        memory_t copy = {0, 0, 0, false};
+
+        if (mem_area(&copy, mem->size) && copy.buffer)
+        {
+            memcpy(copy.buffer, mem->buffer, mem->size);
+            ((bjson_cache_header_t*)copy.buffer)->sourceTime = sourceTime;
+
+            mem_free(mem);
+            *mem = copy;
+
+            mem_bjson_cache_write(name, mem->buffer, mem->size);
+            mem_bjson_cache_top(mem, root);
+        }
+
+        return true;
+    }
+
+    mem_free(mem);
+    *root = 0;
+
+    memory_t        parsed = {0, 0, 0, false};
+    mjson_element_t top    = 0;
+    size_t          size   = mjson_parse_size((const char*)text.buffer, text.size);
+    bool            result = false;
+
+    if (size && mem_area(&parsed, size))
+    {
+        // Unused tail of storage is zeroed, cache does not depend on heap contents
+        memset(parsed.buffer, 0, parsed.size);
+
+        if (!mjson_parse((const char*)text.buffer, text.size, parsed.buffer, parsed.size, &top))
+        {
+            top = 0;
+        }
+    }
+
+    // Dictionaries in cache are indexed, lookups of members in cached files are O(1)
+    size = mjson_build_index_size(top);
+
+    if (size && mem_area(mem, sizeof(bjson_cache_header_t) + size))
+    {
+        memset(mem->buffer, 0, mem->size);
+
+        mjson_element_t indexed;
+        result = mjson_build_index(top, mem->buffer + sizeof(bjson_cache_header_t), size, &indexed) != 0;
+
+        if (result)
+        {
+            bjson_cache_header_t* cacheHeader = (bjson_cache_header_t*)mem->buffer;
+
+            cacheHeader->fourcc     = BJSON_CACHE_FOURCC;
+            cacheHeader->version    = BJSON_CACHE_VERSION;
+            cacheHeader->sourceHash = hash;
+            cacheHeader->sourceTime = sourceTime;
+            cacheHeader->sourceSize = text.size;
+            cacheHeader->size       = size;
+
+            mem_bjson_cache_write(name, mem->buffer, mem->size);
+
+            *root = indexed;
+        }
+        else
+        {
+            mem_free(mem);
+        }
+    }
+
+    mem_free(&parsed);
+    mem_free(&text);
+
+    return result;
+}
+
 namespace core
 {
     void abort()
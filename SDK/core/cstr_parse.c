@@ -34,6 +34,14 @@
  * SUCH DAMAGE.
  */
 
+#include <string.h>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+#include "cstr_parse_pow5.h"
+
 static inline int char_isspace(char c)
 {
     return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
@@ -47,230 +55,718 @@ static inline int char_isdigit(char c)
 #define READ_NEXT ((s<e) ? *s++ : (++s, 0))
 #define LOOKUP(N) (((s+(N))<e) ? *(s+N) : 0)
 
-static int maxExponent = 511;   /* Largest possible base 10 exponent.  Any
-                                 * exponent larger than this will already
-                                 * produce underflow or overflow, so there's
-                                 * no need to worry about additional digits.
-                                 */
-static double powersOf10[] = {  /* Table giving binary powers of 10.  Entry */
-    10.,                        /* is 10^2^i.  Used to convert decimal */
-    100.,                       /* exponents into floating-point numbers. */
-    1.0e4,
-    1.0e8,
-    1.0e16,
-    1.0e32,
-    1.0e64,
-    1.0e128,
-    1.0e256
-};
-
 /*
  *----------------------------------------------------------------------
  *
- * cstr_todouble --
- *
- *  This procedure converts a floating-point number from an ASCII
- *  decimal representation to internal double-precision format.
+ * Decimal to binary floating-point conversion.
  *
- * Results:
- *  The return value is the double-precision floating-point
- *  representation of the characters in string.  If endPtr isn't
- *  NULL, then *endPtr is filled in with the address of the
- *  next character after the last one that was part of the
- *  floating-point number.
- *
- * Side effects:
- *	None.
+ *  Numbers with up to 19 significant digits are converted with
+ *  Clinger's fast path when mantissa and power of ten are exact,
+ *  otherwise with Eisel-Lemire algorithm: mantissa is multiplied by
+ *  128 bit approximation of power of five and the result is always
+ *  correctly rounded. Longer numbers, when first 19 digits do not
+ *  decide rounding, are converted exactly with decimal shifting
+ *  (simple decimal conversion, as in Go strconv).
  *
  *----------------------------------------------------------------------
  */
 
-/* string - A decimal ASCII floating-point number,
-*           optionally preceded by white space.
-*           Must have form "-I.FE-X", where I is the
-*           integer part of the mantissa, F is the
-*           fractional part of the mantissa, and X
-*           is the exponent.  Either of the signs
-*           may be "+", "-", or omitted.  Either I
-*           or F may be omitted, or both.  The decimal
-*           point isn't necessary unless F is present.
-*           The "E" may actually be an "e".  E and X
-*           may both be omitted (but not just one).
-*/
-errno_t cstr_todouble(const char* str, rsize_t size, const char** end, double* res)
+typedef struct
 {
-    //TODO: use better algorithm from FreeBSD vfscanf helper function parsefloat 
-    int sign, expSign = FALSE, any = TRUE;
-    double fraction, dblExp, *d;
-    const char *s;
-    const char *e;
-    int c;
-    int exp = 0;        /* Exponent read from "EX" field. */
-    int fracExp = 0;    /* Exponent that derives from the fractional
-                         * part.  Under normal circumstatnces, it is
-                         * the negative of the number of digits in F.
-                         * However, if I is very long, the last digits
-                         * of I get dropped (otherwise a long I with a
-                         * large negative exponent could cause an
-                         * unnecessary overflow on I alone).  In this
-                         * case, fracExp is incremented one for each
-                         * dropped digit. */
-    int mantSize;       /* Number of digits in mantissa. */
-    int decPt;          /* Number of mantissa digits BEFORE decimal
-                         * point. */
-    const char *pExp;   /* Temporarily holds location of exponent
-                         * in string. */
-    errno_t err;
+    int mantissa_bits;      /* explicit mantissa bits */
+    int exponent_bits;
+    int min_exponent;       /* exponent bias, negated */
+    int smallest_power10;   /* 1e19 * 10^(smallest - 1) rounds to zero */
+    int largest_power10;    /* 10^(largest + 1) is infinite */
+    int min_round_even;     /* range where product could be exactly halfway */
+    int max_round_even;
+} float_format_t;
+
+static const float_format_t float64_format = { 52, 11, -1023, -342, 308,  -4, 23 };
+static const float_format_t float32_format = { 23,  8,  -127,  -65,  38, -17, 10 };
+
+typedef struct
+{
+    uint64_t    mantissa;       /* first 19 significant digits */
+    int64_t     exponent;       /* decimal exponent of mantissa */
+    int64_t     exp_number;     /* explicit exponent after 'e' */
+    const char* int_begin;
+    const char* int_end;
+    const char* frac_begin;
+    const char* frac_end;
+    int         negative;
+    int         truncated;      /* more than 19 significant digits */
+} parsed_number_t;
+
+/* mantissa without hidden bit and biased exponent, negative exponent if not decided */
+typedef struct
+{
+    uint64_t mantissa;
+    int      power2;
+} adjusted_mantissa_t;
 
-    /*
-     * Strip off leading blanks and check for a sign.
-     */
+static const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-    s = str;
-    e = str+size;
+static inline uint64_t read_u64(const char* s)
+{
+    uint64_t val;
+    memcpy(&val, s, sizeof(uint64_t));
+    return val;
+}
 
-    do {
-        c = READ_NEXT;
-    } while (char_isspace(c));
-    if (c == '-') {
-        sign = TRUE;
-        c = READ_NEXT;
-    } else {
-        if (c == '+') {
-            c = READ_NEXT;
-        }
-        sign = FALSE;
+/* little endian only, digits are checked and converted 8 at once (SWAR) */
+static inline int is_eight_digits(uint64_t val)
+{
+    return !(((val + 0x4646464646464646ULL) | (val - 0x3030303030303030ULL)) & 0x8080808080808080ULL);
+}
+
+static inline uint32_t parse_eight_digits(uint64_t val)
+{
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 0x000F424000000064ULL;  /* 100 + (1000000 << 32) */
+    const uint64_t mul2 = 0x0000271000000001ULL;  /* 1 + (10000 << 32) */
+
+    val -= 0x3030303030303030ULL;
+    val  = (val * 10) + (val >> 8);     /* pairs of digits */
+    val  = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+
+    return (uint32_t)val;
+}
+
+static inline int leading_zeroes(uint64_t val)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, val);
+    return 63 - (int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (uint32_t)(val >> 32))) return 31 - (int)index;
+    _BitScanReverse(&index, (uint32_t)val);
+    return 63 - (int)index;
+#else
+    return __builtin_clzll(val);
+#endif
+}
+
+/* low 64 bits of product are returned */
+static inline uint64_t full_multiplication(uint64_t a, uint64_t b, uint64_t* hi)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, hi);
+#elif defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+    *hi = (uint64_t)(r >> 64);
+    return (uint64_t)r;
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lolo = a_lo * b_lo;
+    uint64_t lohi = a_lo * b_hi;
+    uint64_t hilo = a_hi * b_lo;
+    uint64_t cross = (lolo >> 32) + (uint32_t)lohi + hilo;
+
+    *hi = a_hi * b_hi + (lohi >> 32) + (cross >> 32);
+    return (cross << 32) | (uint32_t)lolo;
+#endif
+}
+
+/* digits are accumulated into val, it wraps around if there are more than 19 */
+static const char* parse_digits(const char* s, const char* e, uint64_t* val)
+{
+    uint64_t i = *val;
+    uint64_t chunk;
+
+    while (e - s >= 8 && is_eight_digits(chunk = read_u64(s)))
+    {
+        i  = i * 100000000 + parse_eight_digits(chunk);
+        s += 8;
     }
 
-    /*
-     * Count the number of digits in the mantissa (including the decimal
-     * point), and also locate the decimal point.
-     */
+    for (; s < e && char_isdigit(*s); ++s) i = i * 10 + (uint64_t)(*s - '0');
+
+    *val = i;
+
+    return s;
+}
+
+/*
+ * Leading blanks, sign, mantissa and optional exponent: "-I.FE-X",
+ * I or F could be omitted, but not both, "E" without digits is not a part of number.
+ * Returns end of number, str if there are no digits.
+ */
+static const char* parse_float_number(const char* str, rsize_t size, parsed_number_t* num)
+{
+    const char* s = str;
+    const char* e = str + size;
+    int64_t     digit_count;
+
+    while (s < e && char_isspace(*s)) ++s;
 
-    decPt = -1;
-    for (mantSize = 0;; mantSize += 1)
+    num->negative = s < e && *s == '-';
+    if (s < e && (*s == '-' || *s == '+')) ++s;
+
+    num->mantissa   = 0;
+    num->int_begin  = s;
+    num->int_end    = parse_digits(s, e, &num->mantissa);
+    num->frac_begin = num->int_end;
+    num->frac_end   = num->int_end;
+
+    s = num->int_end;
+
+    if (s < e && *s == '.')
     {
-        if (!char_isdigit(c)) {
-            if ((c != '.') || (decPt >= 0)) {
-                break;
+        num->frac_begin = s + 1;
+        num->frac_end   = parse_digits(s + 1, e, &num->mantissa);
+        s = num->frac_end;
+    }
+
+    digit_count = (num->int_end - num->int_begin) + (num->frac_end - num->frac_begin);
+    if (digit_count == 0) return str;
+
+    num->exp_number = 0;
+
+    if (s < e && (*s == 'e' || *s == 'E'))
+    {
+        const char* p = s + 1;
+        int exp_negative = p < e && *p == '-';
+
+        if (p < e && (*p == '-' || *p == '+')) ++p;
+
+        if (p < e && char_isdigit(*p))
+        {
+            for (; p < e && char_isdigit(*p); ++p)
+            {
+                /* larger exponent is out of range anyway */
+                if (num->exp_number < 0x10000000) num->exp_number = num->exp_number * 10 + (*p - '0');
             }
-            decPt = mantSize;
+
+            num->exp_number = exp_negative ? -num->exp_number : num->exp_number;
+            s = p;
         }
-        c = READ_NEXT;
     }
 
-    /*
-     * Now suck up the digits in the mantissa.  Use two integers to
-     * collect 9 digits each (this is faster than using floating-point).
-     * If the mantissa has more than 18 digits, ignore the extras, since
-     * they can't affect the value anyway.
-     */
+    num->truncated = 0;
 
-    --s;
-    pExp = s;
-    s -= mantSize;
-    if (decPt < 0) {
-        decPt = mantSize;
-    } else {
-        mantSize -= 1;          /* One of the digits was the point. */
+    num->exponent = num->exp_number - (num->frac_end - num->frac_begin);
+
+    if (digit_count <= 19) return s;
+
+    /* leading zeros are not significant */
+    {
+        const char* p;
+        uint64_t    i = 0;
+
+        for (p = num->int_begin; p < num->int_end && *p == '0'; ++p) --digit_count;
+        if (p == num->int_end)
+        {
+            for (p = num->frac_begin; p < num->frac_end && *p == '0'; ++p) --digit_count;
+        }
+
+        if (digit_count <= 19) return s;
+
+        num->truncated = 1;
+
+        for (p = num->int_begin; i < 1000000000000000000ULL && p < num->int_end; ++p) i = i * 10 + (uint64_t)(*p - '0');
+
+        if (i >= 1000000000000000000ULL)
+        {
+            num->exponent = (num->int_end - p) + num->exp_number;
+        }
+        else
+        {
+            for (p = num->frac_begin; i < 1000000000000000000ULL && p < num->frac_end; ++p) i = i * 10 + (uint64_t)(*p - '0');
+            num->exponent = (num->frac_begin - p) + num->exp_number;
+        }
+
+        num->mantissa = i;
     }
-    if (mantSize > 18) {
-        fracExp = decPt - 18;
-        mantSize = 18;
-    } else {
-        fracExp = decPt - mantSize;
+
+    return s;
+}
+
+/* Eisel-Lemire: mantissa w scaled by 10^q, rounded to nearest even */
+static adjusted_mantissa_t compute_float(const float_format_t* fmt, int64_t q, uint64_t w)
+{
+    adjusted_mantissa_t answer;
+    const uint64_t*     pow5;
+    uint64_t            lo, hi, lo2, hi2;
+    uint64_t            precision_mask = 0xFFFFFFFFFFFFFFFFULL >> (fmt->mantissa_bits + 3);
+    int                 lz, upperbit, shift;
+    int                 infinite_power = (1 << fmt->exponent_bits) - 1;
+
+    if (w == 0 || q < fmt->smallest_power10)
+    {
+        answer.mantissa = 0;
+        answer.power2   = 0;
+        return answer;
     }
-    if (mantSize == 0) {
-        fraction = 0.0;
-        err = EINVAL;
-        any = 0;
-        goto done;
-    } else {
-        int frac1, frac2;
-        frac1 = 0;
-        for (; mantSize > 9; mantSize -= 1)
+
+    if (q > fmt->largest_power10)
+    {
+        answer.mantissa = 0;
+        answer.power2   = infinite_power;
+        return answer;
+    }
+
+    lz = leading_zeroes(w);
+    w <<= lz;
+
+    /* second half of power is needed only when truncation could carry into result bits */
+    pow5 = pow5_128[q - POW5_SMALLEST_POWER];
+    lo   = full_multiplication(w, pow5[0], &hi);
+
+    if ((hi & precision_mask) == precision_mask)
+    {
+        full_multiplication(w, pow5[1], &hi2);
+        lo2 = lo + hi2;
+        if (hi2 > lo2) ++hi;
+        lo = lo2;
+    }
+
+    upperbit = (int)(hi >> 63);
+    shift    = upperbit + 64 - fmt->mantissa_bits - 3;
+
+    answer.mantissa = hi >> shift;
+    /* floor(q * log2(10)) + 63 */
+    answer.power2   = (int)((((152170 + 65536) * q) >> 16) + 63) + upperbit - lz - fmt->min_exponent;
+
+    if (answer.power2 <= 0)
+    {
+        /* subnormal */
+        if (-answer.power2 + 1 >= 64)
         {
-            c = READ_NEXT;
-            if (c == '.') {
-                c = READ_NEXT;
-            }
-            frac1 = 10 * frac1 + (c - '0');
+            answer.mantissa = 0;
+            answer.power2   = 0;
+            return answer;
         }
-        frac2 = 0;
-        for (; mantSize > 0; mantSize -= 1)
+
+        answer.mantissa >>= -answer.power2 + 1;
+        answer.mantissa  += answer.mantissa & 1;
+        answer.mantissa >>= 1;
+        answer.power2     = answer.mantissa < (1ULL << fmt->mantissa_bits) ? 0 : 1;
+        return answer;
+    }
+
+    /* exactly halfway between two floats, round to even */
+    if (lo <= 1 && q >= fmt->min_round_even && q <= fmt->max_round_even && (answer.mantissa & 3) == 1)
+    {
+        if ((answer.mantissa << shift) == hi) answer.mantissa &= ~1ULL;
+    }
+
+    answer.mantissa  += answer.mantissa & 1;
+    answer.mantissa >>= 1;
+
+    if (answer.mantissa >= (2ULL << fmt->mantissa_bits))
+    {
+        answer.mantissa = 1ULL << fmt->mantissa_bits;
+        answer.power2++;
+    }
+
+    answer.mantissa &= ~(1ULL << fmt->mantissa_bits);
+
+    if (answer.power2 >= infinite_power)
+    {
+        answer.mantissa = 0;
+        answer.power2   = infinite_power;
+    }
+
+    return answer;
+}
+
+/*
+ * Exact fallback: big decimal is shifted by powers of two until it is in [0.5, 1),
+ * then mantissa bits are shifted in and rounded.
+ */
+
+#define DECIMAL_MAX_DIGITS 800
+#define DECIMAL_MAX_SHIFT  60
+
+typedef struct
+{
+    uint8_t d[DECIMAL_MAX_DIGITS + 20]; /* digits 0-9, space for left shift */
+    int     nd;                         /* digits used */
+    int     dp;                         /* decimal point */
+    int     trunc;                      /* nonzero digits were dropped */
+} decimal_t;
+
+static void decimal_trim(decimal_t* a)
+{
+    while (a->nd > 0 && a->d[a->nd - 1] == 0) --a->nd;
+    if (a->nd == 0) a->dp = 0;
+}
+
+static void decimal_append(decimal_t* a, const char* s, const char* e)
+{
+    for (; s < e; ++s)
+    {
+        if (*s == '0' && a->nd == 0)
         {
-            c = READ_NEXT;
-            if (c == '.') {
-                c = READ_NEXT;
-            }
-            frac2 = 10 * frac2 + (c - '0');
+            --a->dp;    /* leading zeros */
+        }
+        else if (a->nd < DECIMAL_MAX_DIGITS)
+        {
+            a->d[a->nd++] = (uint8_t)(*s - '0');
+        }
+        else if (*s != '0')
+        {
+            a->trunc = 1;
         }
-        fraction = (1.0e9 * frac1) + frac2;
     }
+}
 
-    /*
-     * Skim off the exponent.
-     */
+static void decimal_set(decimal_t* a, const parsed_number_t* num)
+{
+    int64_t dp;
 
-    s = pExp;
-    c = READ_NEXT;
-    if ((c == 'E') || (c == 'e')) {
-        c = READ_NEXT;
-        if (c == '-') {
-            expSign = TRUE;
-            c = READ_NEXT;
-        } else {
-            if (c == '+') {
-                c = READ_NEXT;
+    a->nd    = 0;
+    a->dp    = 0;
+    a->trunc = 0;
+
+    decimal_append(a, num->int_begin, num->int_end);
+    a->dp = a->nd;
+    decimal_append(a, num->frac_begin, num->frac_end);
+
+    /* exponent is limited by parse_number */
+    dp    = (int64_t)a->dp + num->exp_number;
+    a->dp = dp > 100000 ? 100000 : dp < -100000 ? -100000 : (int)dp;
+
+    decimal_trim(a);
+}
+
+static void decimal_right_shift(decimal_t* a, int k)
+{
+    int      r = 0, w = 0;
+    uint64_t n = 0, dig, mask = (1ULL << k) - 1;
+
+    /* enough leading digits to cover the first shift */
+    for (; (n >> k) == 0; ++r)
+    {
+        if (r >= a->nd)
+        {
+            if (n == 0)
+            {
+                a->nd = 0;
+                return;
+            }
+            while ((n >> k) == 0)
+            {
+                n *= 10;
+                ++r;
             }
-            expSign = FALSE;
+            break;
         }
-        while (char_isdigit(c)) {
-            exp = exp * 10 + (c - '0');
-            c = READ_NEXT;
+        n = n * 10 + a->d[r];
+    }
+
+    a->dp -= r - 1;
+
+    for (; r < a->nd; ++r)
+    {
+        dig = n >> k;
+        n  &= mask;
+        a->d[w++] = (uint8_t)dig;
+        n = n * 10 + a->d[r];
+    }
+
+    while (n > 0)
+    {
+        dig = n >> k;
+        n  &= mask;
+        if (w < DECIMAL_MAX_DIGITS)
+            a->d[w++] = (uint8_t)dig;
+        else if (dig > 0)
+            a->trunc = 1;
+        n *= 10;
+    }
+
+    a->nd = w;
+    decimal_trim(a);
+}
+
+static void decimal_left_shift(decimal_t* a, int k)
+{
+    /* 2^60 adds at most 19 digits, digits are written from the end behind the old ones */
+    int      r = a->nd - 1, w = a->nd + 19, count;
+    uint64_t n = 0, quo;
+
+    for (; r >= 0; --r)
+    {
+        n  += (uint64_t)a->d[r] << k;
+        quo = n / 10;
+        a->d[--w] = (uint8_t)(n - 10 * quo);
+        n   = quo;
+    }
+
+    while (n > 0)
+    {
+        quo = n / 10;
+        a->d[--w] = (uint8_t)(n - 10 * quo);
+        n   = quo;
+    }
+
+    count  = a->nd + 19 - w;
+    a->dp += count - a->nd;
+
+    memmove(a->d, a->d + w, count);
+
+    if (count > DECIMAL_MAX_DIGITS)
+    {
+        for (r = DECIMAL_MAX_DIGITS; r < count; ++r)
+        {
+            if (a->d[r]) a->trunc = 1;
         }
+        count = DECIMAL_MAX_DIGITS;
     }
-    if (expSign) {
-        exp = fracExp - exp;
-    } else {
-        exp = fracExp + exp;
+
+    a->nd = count;
+    decimal_trim(a);
+}
+
+static void decimal_shift(decimal_t* a, int k)
+{
+    if (a->nd == 0) return;
+
+    for (; k > DECIMAL_MAX_SHIFT; k -= DECIMAL_MAX_SHIFT) decimal_left_shift(a, DECIMAL_MAX_SHIFT);
+    for (; k < -DECIMAL_MAX_SHIFT; k += DECIMAL_MAX_SHIFT) decimal_right_shift(a, DECIMAL_MAX_SHIFT);
+
+    if (k > 0) decimal_left_shift(a, k);
+    if (k < 0) decimal_right_shift(a, -k);
+}
+
+static uint64_t decimal_rounded_integer(const decimal_t* a)
+{
+    uint64_t n = 0;
+    int      i, round_up;
+
+    for (i = 0; i < a->dp && i < a->nd; ++i) n = n * 10 + a->d[i];
+    for (; i < a->dp; ++i)                   n *= 10;
+
+    if (a->dp < 0 || a->dp >= a->nd)
+        round_up = 0;
+    else if (a->d[a->dp] == 5 && a->dp + 1 == a->nd)
+        round_up = a->trunc || (a->dp > 0 && (a->d[a->dp - 1] & 1));  /* halfway, to even */
+    else
+        round_up = a->d[a->dp] >= 5;
+
+    return n + round_up;
+}
+
+static adjusted_mantissa_t decimal_to_float(const float_format_t* fmt, decimal_t* a)
+{
+    static const int powtab[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+
+    adjusted_mantissa_t answer;
+    int                 exp = 0, n;
+    int                 infinite_power = (1 << fmt->exponent_bits) - 1;
+
+    answer.mantissa = 0;
+    answer.power2   = 0;
+
+    if (a->nd == 0 || a->dp < -330) return answer;
+
+    if (a->dp > 310)
+    {
+        answer.power2 = infinite_power;
+        return answer;
     }
 
-    /*
-     * Generate a floating-point number that represents the exponent.
-     * Do this by processing the exponent one bit at a time to combine
-     * many powers of 2 of 10. Then combine the exponent with the
-     * fraction.
-     */
-    err = EOK;
-    if (exp < 0) {
-        expSign = TRUE;
-        exp = -exp;
-    } else {
-        expSign = FALSE;
+    while (a->dp > 0)
+    {
+        n = a->dp >= 9 ? 27 : powtab[a->dp];
+        decimal_shift(a, -n);
+        exp += n;
     }
-    if (exp > maxExponent) {
-        exp = maxExponent;
-        err = ERANGE;
+
+    while (a->dp < 0 || (a->dp == 0 && a->d[0] < 5))
+    {
+        n = -a->dp >= 9 ? 27 : powtab[-a->dp];
+        decimal_shift(a, n);
+        exp -= n;
+    }
+
+    /* [0.5, 1) to [1, 2) */
+    exp--;
+
+    /* denormals */
+    if (exp < fmt->min_exponent + 1)
+    {
+        n = fmt->min_exponent + 1 - exp;
+        decimal_shift(a, -n);
+        exp += n;
+    }
+
+    if (exp - fmt->min_exponent >= infinite_power)
+    {
+        answer.power2 = infinite_power;
+        return answer;
     }
-    dblExp = 1.0;
-    for (d = powersOf10; exp != 0; exp >>= 1, d += 1) {
-        if (exp & 01) {
-            dblExp *= *d;
+
+    decimal_shift(a, 1 + fmt->mantissa_bits);
+    answer.mantissa = decimal_rounded_integer(a);
+
+    /* rounding added a bit */
+    if (answer.mantissa == (2ULL << fmt->mantissa_bits))
+    {
+        answer.mantissa >>= 1;
+        exp++;
+
+        if (exp - fmt->min_exponent >= infinite_power)
+        {
+            answer.mantissa = 0;
+            answer.power2   = infinite_power;
+            return answer;
         }
     }
-    if (expSign) {
-        fraction /= dblExp;
-    } else {
-        fraction *= dblExp;
+
+    answer.power2   = (answer.mantissa & (1ULL << fmt->mantissa_bits)) ? exp - fmt->min_exponent : 0;
+    answer.mantissa = answer.mantissa & ((1ULL << fmt->mantissa_bits) - 1);
+
+    return answer;
+}
+
+static adjusted_mantissa_t convert_number(const float_format_t* fmt, const parsed_number_t* num)
+{
+    adjusted_mantissa_t answer = compute_float(fmt, num->exponent, num->mantissa);
+
+    /* digits after the first 19 decide rounding only if w and w + 1 give different results */
+    if (num->truncated)
+    {
+        adjusted_mantissa_t upper = compute_float(fmt, num->exponent, num->mantissa + 1);
+
+        if (upper.mantissa != answer.mantissa || upper.power2 != answer.power2)
+        {
+            decimal_t a;
+            decimal_set(&a, num);
+            answer = decimal_to_float(fmt, &a);
+        }
     }
-done:
-    if (sign) {
-        fraction = -fraction;
+
+    return answer;
+}
+
+/* overflow to infinity and underflow of nonzero number to zero */
+static errno_t convert_error(const float_format_t* fmt, const parsed_number_t* num, adjusted_mantissa_t am)
+{
+    if (am.power2 == (1 << fmt->exponent_bits) - 1) return ERANGE;
+    if (am.power2 == 0 && am.mantissa == 0 && num->mantissa != 0) return ERANGE;
+    return EOK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * cstr_todouble, cstr_tofloat --
+ *
+ *  Convert a floating-point number from an ASCII decimal representation
+ *  to correctly rounded (to nearest even) double or float.
+ *
+ * Results:
+ *  EOK on success, EINVAL if there are no digits, ERANGE on overflow
+ *  to infinity or underflow to zero. If end isn't NULL, then *end is
+ *  filled in with the address of the next character after the last one
+ *  that was part of the floating-point number (str if there are no digits).
+ *
+ *----------------------------------------------------------------------
+ */
+
+/* string - A decimal ASCII floating-point number,
+*           optionally preceded by white space.
+*           Must have form "-I.FE-X", where I is the
+*           integer part of the mantissa, F is the
+*           fractional part of the mantissa, and X
+*           is the exponent.  Either of the signs
+*           may be "+", "-", or omitted.  Either I
+*           or F may be omitted, or both.  The decimal
+*           point isn't necessary unless F is present.
+*           The "E" may actually be an "e".  E and X
+*           may both be omitted (but not just one,
+*           "E" without X is not a part of number).
+*/
+errno_t cstr_todouble(const char* str, rsize_t size, const char** end, double* res)
+{
+    parsed_number_t     num;
+    adjusted_mantissa_t am;
+    const char*         s = parse_float_number(str, size, &num);
+    uint64_t            bits;
+    double              value;
+    errno_t             err = EOK;
+
+    if (s == str)
+    {
+        if (res) *res = 0.0;
+        if (end) *end = str;
+        return EINVAL;
     }
 
-    if (res) *res = fraction;
-    if (end) *end = any ? s - 1 : str;
+    /* Clinger's fast path, mantissa and power of ten are exact doubles */
+    if (!num.truncated && num.exponent >= -22 && num.exponent <= 22 && num.mantissa <= (1ULL << 53))
+    {
+        value = (double)(int64_t)num.mantissa;
+        value = num.exponent < 0 ? value / exact_powers_of_ten[-num.exponent] : value * exact_powers_of_ten[num.exponent];
+    }
+    else
+    {
+        am    = convert_number(&float64_format, &num);
+        err   = convert_error(&float64_format, &num, am);
+        bits  = am.mantissa | ((uint64_t)am.power2 << 52);
+        memcpy(&value, &bits, sizeof(double));
+    }
+
+    if (res) *res = num.negative ? -value : value;
+    if (end) *end = s;
+
+    return err;
+}
+
+errno_t cstr_tofloat(const char* str, rsize_t size, const char** end, float* res)
+{
+    parsed_number_t     num;
+    adjusted_mantissa_t am;
+    const char*         s = parse_float_number(str, size, &num);
+    uint32_t            bits;
+    uint64_t            dbits;
+    double              d;
+    float               value;
+    errno_t             err = EOK;
+    int                 exact = 0;
+
+    if (s == str)
+    {
+        if (res) *res = 0.0f;
+        if (end) *end = str;
+        return EINVAL;
+    }
+
+    /*
+     * Double of Clinger's fast path is correctly rounded, so it rounds to the same float as
+     * exact value unless it is exactly halfway between two floats. Range of these values is
+     * inside normal floats. Float arithmetic would be exact only for mantissas up to 2^24.
+     */
+    if (!num.truncated && num.exponent >= -22 && num.exponent <= 22 && num.mantissa <= (1ULL << 53))
+    {
+        d = (double)(int64_t)num.mantissa;
+        d = num.exponent < 0 ? d / exact_powers_of_ten[-num.exponent] : d * exact_powers_of_ten[num.exponent];
+
+        memcpy(&dbits, &d, sizeof(double));
+
+        exact = (dbits & 0x1FFFFFFF) != 0x10000000;
+        value = (float)d;
+    }
+
+    if (!exact)
+    {
+        am    = convert_number(&float32_format, &num);
+        err   = convert_error(&float32_format, &num, am);
+        bits  = (uint32_t)am.mantissa | ((uint32_t)am.power2 << 23);
+        memcpy(&value, &bits, sizeof(float));
+    }
+
+    if (res) *res = num.negative ? -value : value;
+    if (end) *end = s;
 
     return err;
 }
@@ -857,12 +1353,16 @@ int cstr_vscanf(const char *inp, rsize_t size, char const *fmt0, va_list ap)
 #ifndef NO_FLOATING_POINT
         case CT_FLOAT: {
             double res;
+            float resf;
             const char* end;
             if (width == 0)
                 width = inr;
             else
                 width = width < inr ? width : inr;
-            cstr_todouble(inp, width, &end, &res);
+            if (flags & LONG)
+                cstr_todouble(inp, width, &end, &res);
+            else
+                cstr_tofloat(inp, width, &end, &resf);
             nr = end - inp;
             inp = end; inr -= nr;
             if (nr == 0)
@@ -871,7 +1371,7 @@ int cstr_vscanf(const char *inp, rsize_t size, char const *fmt0, va_list ap)
                 if (flags & LONG) {
                     *va_arg(ap, double *) = res;
                 } else {
-                    *va_arg(ap, float *) = (float)res;
+                    *va_arg(ap, float *) = resf;
                 }
             }
         } break;
@@ -130,6 +130,43 @@
     #endif
 #endif
 
+#ifndef ETLSF_lock
+    #if defined (_MSC_VER)
+
+        #include <intrin.h>
+
+        typedef volatile long ETLSF_lock_t;
+        #define ETLSF_lock(lock)    while (_InterlockedExchange(lock, 1) == 1) {}
+        #define ETLSF_unlock(lock)  _InterlockedExchange(lock, 0)
+
+    #else
+
+        typedef volatile long ETLSF_lock_t;
+        #define ETLSF_lock(lock)    while (__sync_lock_test_and_set(lock, 1) == 1) {}
+        #define ETLSF_unlock(lock)  __sync_lock_release(lock)
+
+    #endif
+#endif
+
+#ifndef ETLSF_cas
+    #if defined (_MSC_VER)
+        #include <intrin.h>
+        #define ETLSF_cas(ptr, old_value, new_value) (_InterlockedCompareExchange(ptr, new_value, old_value) == (old_value))
+        #define ETLSF_xchg(ptr, value) _InterlockedExchange(ptr, value)
+    #else
+        #define ETLSF_cas(ptr, old_value, new_value) __sync_bool_compare_and_swap(ptr, old_value, new_value)
+        #define ETLSF_xchg(ptr, value) __sync_lock_test_and_set(ptr, value)
+    #endif
+#endif
+
+#ifndef ETLSF_thread_local
+    #if defined (_MSC_VER)
+        #define ETLSF_thread_local __declspec(thread)
+    #else
+        #define ETLSF_thread_local __thread
+    #endif
+#endif
+
 #ifndef ETLSF_align2
     static uint32_t ETLSF_align2(uint32_t size, uint32_t align)
     {
@@ -139,9 +176,10 @@
 
 enum etlsf_private
 {
-    /* All allocation sizes and addresses are aligned to 256 bytes. */
-    ALIGN_SIZE_LOG2 = 8,
-    ALIGN_SIZE = (1 << ALIGN_SIZE_LOG2),
+    /* Allocation sizes and offsets are multiples of arena granularity, 16 to 256 bytes. */
+    ALIGN_SIZE_LOG2_MIN = 4,
+    ALIGN_SIZE_LOG2_MAX = 8,
+    ALIGN_SIZE_DEFAULT  = (1 << ALIGN_SIZE_LOG2_MAX),
 
     /* log2 of number of linear subdivisions of block sizes. */
     SL_INDEX_COUNT_LOG2 = 4,
@@ -150,134 +188,535 @@ enum etlsf_private
     /*
     ** We support allocations of sizes up to (1 << FL_INDEX_MAX) bits.
     ** However, because we linearly subdivide the second-level lists, and
-    ** our minimum size granularity is 4 bytes, it doesn't make sense to
-    ** create first-level lists for sizes smaller than SL_INDEX_COUNT * 4,
-    ** or (1 << (SL_INDEX_COUNT_LOG2 + 2)) bytes, as there we will be
+    ** our minimum size granularity is 16 bytes, it doesn't make sense to
+    ** create first-level lists for sizes smaller than SL_INDEX_COUNT * 16,
+    ** or (1 << (SL_INDEX_COUNT_LOG2 + 4)) bytes, as there we will be
     ** trying to split size ranges into more slots than we have available.
     ** Instead, we calculate the minimum threshold size, and place all
     ** blocks below that size into the 0th first-level list.
+    ** Lists are allocated for the finest granularity, coarser arenas
+    ** leave top lists unused.
     */
-    FL_INDEX_MAX   = 30,
-    FL_INDEX_SHIFT = (SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2),
-    FL_INDEX_COUNT = (FL_INDEX_MAX - FL_INDEX_SHIFT + 1),
+    FL_INDEX_MAX   = 32,
+    FL_INDEX_COUNT = (FL_INDEX_MAX - (SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2_MIN) + 1),
 
-    SMALL_ALLOC_SIZE = (1 << FL_INDEX_SHIFT),
+    /* Handle is range index in low bits and generation of range in high bits. */
+    HANDLE_INDEX_MASK      = ETLSF_MAX_ALLOCS,
+    HANDLE_GENERATION_BITS = 32 - ETLSF_INDEX_BITS,
+    HANDLE_GENERATION_MASK = (1 << HANDLE_GENERATION_BITS) - 1,
 
-    RANGE_SIZE_MIN = (size_t)1 << ALIGN_SIZE_LOG2,
-    RANGE_SIZE_MAX = (size_t)1 << FL_INDEX_MAX,
+    /*
+    ** Concurrent mode: every thread gets own cache of ranges of small
+    ** sizes (multiples of granularity up to SL_INDEX_COUNT * granularity)
+    ** and batch of frees, arena lock is taken only to refill bins or
+    ** return batch. Larger ranges are always freed to arena.
+    */
+    THREAD_CACHE_COUNT  = 64,
+    CACHE_CLASS_COUNT   = SL_INDEX_COUNT,
+    CACHE_BIN_SIZE      = 8,
+    CACHE_REFILL_COUNT  = 4,
+    FREE_BATCH_SIZE     = 32,
+    /* Granules one thread may keep in bins and batch, less for small arenas */
+    CACHE_MAX_GRANULES  = 256,
+    /* Concurrent arenas a thread keeps cache references to */
+    TLS_ARENA_COUNT     = 4,
 };
 
 struct range_data_t
 {
-    uint16_t  next_phys_index;
-    uint16_t  prev_phys_index;
+    uint32_t  next_phys_index;
+    uint32_t  prev_phys_index;
+
+    uint32_t  next_free_index;
+    uint32_t  prev_free_index;
 
-    uint32_t  offset  : 31;
-    uint32_t  is_free :  1;
+    uint32_t  offset;
 
-    uint16_t  next_free_index;
-    uint16_t  prev_free_index;
+    /* Incremented when range is freed, so stale handles do not match. */
+    uint16_t  generation;
+
+    /*
+    ** Flags are bytes, not bit fields next to offset: in concurrent mode
+    ** size of allocated range is computed from offset of next range without
+    ** arena lock, while the next range may be freed or allocated.
+    */
+    uint8_t   is_free;
+    /* Freed, but kept by thread cache or deferred queue. */
+    uint8_t   is_cached;
+};
+
+struct thread_cache_t
+{
+    /* Taken by owner thread (uncontended) and by flushes */
+    ETLSF_lock_t lock;
+    ETLSF_lock_t claimed;
+
+    /* Granules in bins and batch */
+    uint32_t cached_size;
+
+    uint32_t num_pending;
+    uint32_t pending[FREE_BATCH_SIZE];
+
+    uint8_t  bin_count[CACHE_CLASS_COUNT];
+    uint32_t bins[CACHE_CLASS_COUNT][CACHE_BIN_SIZE];
+};
+
+struct concurrent_state_t
+{
+    ETLSF_lock_t lock;
+    long         id;
+    /* Max cached_size of thread cache */
+    uint32_t     cache_limit;
+
+    struct thread_cache_t caches[THREAD_CACHE_COUNT];
+};
+
+struct tls_cache_ref_t
+{
+    long                   arena_id;
+    struct thread_cache_t* cache;
 };
 
 struct etlsf_private_t
 {
     uint32_t size;
 
+    /* Granularity and first level of first not small list */
+    uint32_t align_log2;
+    uint32_t fl_shift;
+
     /* Bitmaps for free lists. */
     uint32_t fl_bitmap;
     uint32_t sl_bitmap[FL_INDEX_COUNT];
     /* Head of free lists. */
-    uint16_t blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+    uint32_t blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+    uint32_t num_ranges;
+    uint32_t unused_range_count;
+    uint32_t first_free_storage_index;
+
+    /* Range at offset 0, changes only when compaction moves ranges */
+    uint32_t first_phys_index;
+
+    /* Ranges freed with etlsf_free_range_deferred, linked by next_free_index */
+    ETLSF_lock_t deferred_head;
+
+    /* Deferred lists kept by etlsf_flush_deferred_frames, ring indexed by frame */
+    uint32_t deferred_frames[ETLSF_MAX_FRAMES_DELAY + 1];
+    uint32_t deferred_frame;
+
+    struct concurrent_state_t* concurrent;
 
-    uint16_t num_ranges;
-    uint16_t unused_range_count;
-    uint16_t first_free_storage_index;
     struct range_data_t storage[1];
 };
 
 #define RANGE_DATA(id) (arena->storage[id])
 
-static size_t   arena_total_size(size_t max_allocs);
+/* Ranges below this size are stored in 0th first level list */
+#define SMALL_ALLOC_SIZE(arena) (1u << (arena)->fl_shift)
+
+static size_t   arena_total_size(uint32_t max_allocs);
 
-static uint16_t storage_alloc_range_data(etlsf_t arena);
-static void     storage_free_range_data (etlsf_t arena, uint16_t index);
+static uint32_t storage_alloc_range_data(etlsf_t arena);
+static void     storage_free_range_data (etlsf_t arena, uint32_t index);
 
-static uint32_t calc_range_size     (etlsf_t arena, uint16_t index);
+static uint32_t calc_range_size     (etlsf_t arena, uint32_t index);
 static void     create_initial_range(etlsf_t arena);
-static uint32_t split_range         (etlsf_t arena, uint16_t id, uint32_t size);
-static void     merge_ranges        (etlsf_t arena, uint16_t target_index, uint16_t source_index);
+static uint32_t split_range         (etlsf_t arena, uint32_t id, uint32_t size);
+static void     merge_ranges        (etlsf_t arena, uint32_t target_index, uint32_t source_index);
+static void     swap_ranges         (etlsf_t arena, uint32_t a, uint32_t b);
+
+static void     freelist_insert_range(etlsf_t arena, uint32_t index);
+static void     freelist_remove_range(etlsf_t arena, uint32_t index);
+static uint32_t freelist_find_suitable(etlsf_t arena, uint32_t size);
+
+static uint32_t arena_alloc_range(etlsf_t arena, uint32_t size);
+static void     arena_take_range (etlsf_t arena, uint32_t index, uint32_t size);
+static void     arena_free_range (etlsf_t arena, uint32_t index);
+
+static void     deferred_push(etlsf_t arena, uint32_t index);
+static void     deferred_free(etlsf_t arena, uint32_t index);
+
+static etlsf_alloc_t handle_make   (etlsf_t arena, uint32_t index);
+static uint32_t      handle_index  (etlsf_t arena, etlsf_alloc_t id);
+static uint32_t      handle_release(etlsf_t arena, etlsf_alloc_t id);
 
-static void     freelist_insert_range(etlsf_t arena, uint16_t index);
-static void     freelist_remove_range(etlsf_t arena, uint16_t index);
-static uint16_t freelist_find_suitable(etlsf_t arena, uint32_t size);
+static struct thread_cache_t* thread_cache_get  (etlsf_t arena);
+static int                    thread_cache_class(etlsf_t arena, uint32_t size);
+static void                   thread_cache_flush(etlsf_t arena, struct thread_cache_t* cache, int flush_bins);
+static void                   thread_caches_flush(etlsf_t arena, int flush_bins);
+
+static ETLSF_lock_t next_concurrent_arena_id;
+
+static ETLSF_thread_local struct tls_cache_ref_t tls_cache_refs[TLS_ARENA_COUNT];
 
 //-------------------------  API implementation  ----------------------------//
 
-etlsf_t etlsf_create(uint32_t size, uint16_t max_allocs)
+etlsf_t etlsf_create(uint32_t size, uint32_t max_allocs)
 {
-    ETLSF_assert(max_allocs > 0);
-    ETLSF_assert(size % ALIGN_SIZE == 0);
-    ETLSF_assert(RANGE_SIZE_MIN <= size && size <= RANGE_SIZE_MAX);
+    return etlsf_create_ex(size, max_allocs, ALIGN_SIZE_DEFAULT, 0);
+}
+
+etlsf_t etlsf_create_concurrent(uint32_t size, uint32_t max_allocs)
+{
+    return etlsf_create_ex(size, max_allocs, ALIGN_SIZE_DEFAULT, ETLSF_CONCURRENT);
+}
+
+etlsf_t etlsf_create_ex(uint32_t size, uint32_t max_allocs, uint32_t granularity, uint32_t flags)
+{
+    const int align_log2 = ETLSF_fls(granularity);
+
+    ETLSF_assert(max_allocs > 0 && max_allocs <= ETLSF_MAX_ALLOCS);
+    ETLSF_assert(granularity && granularity == (1u << align_log2));
+    ETLSF_assert(ALIGN_SIZE_LOG2_MIN <= align_log2 && align_log2 <= ALIGN_SIZE_LOG2_MAX);
+    ETLSF_assert(size % granularity == 0);
+    ETLSF_assert(granularity <= size);
 
     etlsf_t arena = (etlsf_t)ETLSF_alloc(arena_total_size(max_allocs));
 
     ETLSF_memset(arena, sizeof(struct etlsf_private_t), 0); // sets also all lists point to zero block
 
     arena->size = size;
+    arena->align_log2 = align_log2;
+    arena->fl_shift = SL_INDEX_COUNT_LOG2 + align_log2;
     arena->num_ranges = max_allocs;
     arena->unused_range_count = max_allocs;
     arena->first_free_storage_index = 0;
+    arena->deferred_head = 0;
+    arena->deferred_frame = 0;
+    arena->concurrent = 0;
 
+    // Generations start from zero, so handles of fresh arena are just indices
+    ETLSF_memset(arena->storage + 1, max_allocs * sizeof(struct range_data_t), 0);
 
     create_initial_range(arena);
 
+    if (flags & ETLSF_CONCURRENT)
+    {
+        struct concurrent_state_t* state = (struct concurrent_state_t*)ETLSF_alloc(sizeof(struct concurrent_state_t));
+        ETLSF_memset(state, sizeof(struct concurrent_state_t), 0);
+
+        long id;
+        do
+        {
+            id = next_concurrent_arena_id + 1;
+        }
+        while (!ETLSF_cas(&next_concurrent_arena_id, id - 1, id));
+
+        const uint32_t granules = (size >> align_log2) / THREAD_CACHE_COUNT;
+
+        state->id = id;
+        state->cache_limit = granules < CACHE_MAX_GRANULES ? granules : CACHE_MAX_GRANULES;
+        arena->concurrent = state;
+    }
+
     return arena;
 }
 
+size_t etlsf_metadata_size(uint32_t max_allocs, uint32_t flags)
+{
+    return arena_total_size(max_allocs) + (flags & ETLSF_CONCURRENT ? sizeof(struct concurrent_state_t) : 0);
+}
+
 void etlsf_destroy(etlsf_t arena)
 {
     ETLSF_assert(arena);
 
+    if (arena->concurrent)
+    {
+        ETLSF_free(arena->concurrent);
+    }
+
     ETLSF_free(arena);
 }
 
 etlsf_alloc_t etlsf_alloc_range(etlsf_t arena, uint32_t size)
 {
     ETLSF_assert(size);
-    ETLSF_assert(size <= RANGE_SIZE_MAX);
 
-    const size_t adjust = ETLSF_align2(size, RANGE_SIZE_MIN);
+    if (size > arena->size)
+    {
+        return handle_make(arena, 0);
+    }
 
-    uint16_t index = freelist_find_suitable(arena, adjust);
+    struct concurrent_state_t* state = arena->concurrent;
 
-    if (index)
+    const uint32_t adjust = ETLSF_align2(size, 1u << arena->align_log2);
+
+    if (!state)
     {
-        ETLSF_assert(RANGE_DATA(index).is_free);
+        return handle_make(arena, arena_alloc_range(arena, adjust));
+    }
 
-        freelist_remove_range(arena, index);
+    int                    size_class = thread_cache_class(arena, adjust);
+    struct thread_cache_t* cache      = size_class >= 0 ? thread_cache_get(arena) : 0;
+    uint32_t               index      = 0;
 
-        ETLSF_assert(RANGE_DATA(index).offset % RANGE_SIZE_MIN == 0);
+    if (!cache)
+    {
+        ETLSF_lock(&state->lock);
+        index = arena_alloc_range(arena, adjust);
+        ETLSF_unlock(&state->lock);
+    }
+    else
+    {
+        const uint32_t granules = (uint32_t)size_class + 1;
 
-        uint16_t remainder_index = split_range(arena, index, adjust);
+        ETLSF_lock(&cache->lock);
 
-        if (remainder_index)
+        uint8_t* count = &cache->bin_count[size_class];
+        if (*count)
+        {
+            index = cache->bins[size_class][--*count];
+            RANGE_DATA(index).is_cached = 0;
+            cache->cached_size -= granules;
+        }
+        else
         {
-            freelist_insert_range(arena, remainder_index);
+            ETLSF_lock(&state->lock);
+
+            index = arena_alloc_range(arena, adjust);
+
+            // Refill bin, so next allocations of this size skip arena lock
+            for (uint32_t i = 1; index && i < CACHE_REFILL_COUNT && cache->cached_size + granules <= state->cache_limit; ++i)
+            {
+                uint32_t extra = arena_alloc_range(arena, adjust);
+                if (!extra) break;
+
+                RANGE_DATA(extra).is_cached = 1;
+                cache->bins[size_class][(*count)++] = extra;
+                cache->cached_size += granules;
+            }
+
+            ETLSF_unlock(&state->lock);
         }
+
+        ETLSF_unlock(&cache->lock);
+    }
+
+    // Free space may be held by thread caches, return it and try again.
+    // Own cache lock is released, as flush takes locks of all caches.
+    // Deferred ranges are not flushed, they may still be in use.
+    if (!index)
+    {
+        thread_caches_flush(arena, 1);
+
+        ETLSF_lock(&state->lock);
+        index = arena_alloc_range(arena, adjust);
+        ETLSF_unlock(&state->lock);
     }
 
-    return { index };
+    return handle_make(arena, index);
 }
 
 void etlsf_free_range(etlsf_t arena, etlsf_alloc_t id)
 {
-    uint16_t index = id.value;
+    if (!id.value) return;
+
+    uint32_t index = handle_release(arena, id);
+    if (!index) return;
+
+    struct concurrent_state_t* state = arena->concurrent;
+
+    if (!state)
+    {
+        arena_free_range(arena, index);
+        return;
+    }
+
+    int                    size_class = thread_cache_class(arena, calc_range_size(arena, index));
+    struct thread_cache_t* cache      = size_class >= 0 ? thread_cache_get(arena) : 0;
+
+    if (!cache)
+    {
+        ETLSF_lock(&state->lock);
+        arena_free_range(arena, index);
+        ETLSF_unlock(&state->lock);
+
+        return;
+    }
+
+    const uint32_t granules = (uint32_t)size_class + 1;
+
+    ETLSF_lock(&cache->lock);
+
+    if (cache->cached_size + granules > state->cache_limit)
+    {
+        ETLSF_lock(&state->lock);
+        arena_free_range(arena, index);
+        ETLSF_unlock(&state->lock);
+    }
+    else
+    {
+        RANGE_DATA(index).is_cached = 1;
+        cache->cached_size += granules;
+
+        if (cache->bin_count[size_class] < CACHE_BIN_SIZE)
+        {
+            cache->bins[size_class][cache->bin_count[size_class]++] = index;
+        }
+        else
+        {
+            cache->pending[cache->num_pending++] = index;
+
+            if (cache->num_pending == FREE_BATCH_SIZE)
+            {
+                thread_cache_flush(arena, cache, 0);
+            }
+        }
+    }
+
+    ETLSF_unlock(&cache->lock);
+}
+
+void etlsf_free_range_deferred(etlsf_t arena, etlsf_alloc_t id)
+{
+    if (!id.value) return;
+
+    uint32_t index = handle_release(arena, id);
+    if (!index) return;
+
+    RANGE_DATA(index).is_cached = 1;
+
+    deferred_push(arena, index);
+}
+
+// Push only list, whole list is taken by flush, so there is no ABA problem
+static void deferred_push(etlsf_t arena, uint32_t index)
+{
+    ETLSF_assert(RANGE_DATA(index).is_cached);
+
+    long head;
+    do
+    {
+        head = arena->deferred_head;
+        RANGE_DATA(index).next_free_index = (uint32_t)head;
+    }
+    while (!ETLSF_cas(&arena->deferred_head, head, (long)index));
+}
+
+static void deferred_free(etlsf_t arena, uint32_t index)
+{
+    while (index)
+    {
+        uint32_t next = RANGE_DATA(index).next_free_index;
+        RANGE_DATA(index).is_cached = 0;
+        arena_free_range(arena, index);
+        index = next;
+    }
+}
+
+void etlsf_flush_deferred(etlsf_t arena)
+{
+    ETLSF_assert(arena);
+
+    struct concurrent_state_t* state = arena->concurrent;
+
+    uint32_t index = (uint32_t)ETLSF_xchg(&arena->deferred_head, 0);
+
+    if (state)
+    {
+        ETLSF_lock(&state->lock);
+    }
+
+    deferred_free(arena, index);
+
+    for (uint32_t i = 0; i < ETLSF_MAX_FRAMES_DELAY + 1; ++i)
+    {
+        deferred_free(arena, arena->deferred_frames[i]);
+        arena->deferred_frames[i] = 0;
+    }
+
+    if (state)
+    {
+        ETLSF_unlock(&state->lock);
+
+        thread_caches_flush(arena, 0);
+    }
+}
+
+void etlsf_flush_deferred_frames(etlsf_t arena, uint32_t frames_delay)
+{
+    ETLSF_assert(arena);
+    ETLSF_assert(frames_delay <= ETLSF_MAX_FRAMES_DELAY);
+
+    struct concurrent_state_t* state = arena->concurrent;
+
+    const uint32_t count = ETLSF_MAX_FRAMES_DELAY + 1;
+    const uint32_t frame = arena->deferred_frame++;
+
+    uint32_t index = (uint32_t)ETLSF_xchg(&arena->deferred_head, 0);
+
+    if (state)
+    {
+        ETLSF_lock(&state->lock);
+    }
+
+    // List taken frames_delay calls ago is freed, list taken now waits in its slot
+    arena->deferred_frames[frame % count] = index;
+
+    uint32_t oldest = (frame + count - frames_delay) % count;
+
+    deferred_free(arena, arena->deferred_frames[oldest]);
+    arena->deferred_frames[oldest] = 0;
+
+    if (state)
+    {
+        ETLSF_unlock(&state->lock);
+
+        thread_caches_flush(arena, 0);
+    }
+}
+
+void etlsf_trim(etlsf_t arena)
+{
+    ETLSF_assert(arena);
+
+    etlsf_flush_deferred(arena);
+
+    if (arena->concurrent)
+    {
+        thread_caches_flush(arena, 1);
+    }
+}
+
+static uint32_t arena_alloc_range(etlsf_t arena, uint32_t size)
+{
+    uint32_t index = freelist_find_suitable(arena, size);
+
     if (index)
     {
-        ETLSF_assert(etlsf_alloc_is_valid(arena, id) && "block already marked as free");
+        arena_take_range(arena, index, size);
+    }
+
+    return index;
+}
+
+// Removes free range from free lists and returns remainder after size back
+static void arena_take_range(etlsf_t arena, uint32_t index, uint32_t size)
+{
+    ETLSF_assert(RANGE_DATA(index).is_free);
+
+    freelist_remove_range(arena, index);
+
+    ETLSF_assert(RANGE_DATA(index).offset % (1u << arena->align_log2) == 0);
+
+    uint32_t remainder_index = split_range(arena, index, size);
+
+    if (remainder_index)
+    {
+        freelist_insert_range(arena, remainder_index);
+    }
+}
+
+static void arena_free_range(etlsf_t arena, uint32_t index)
+{
+    if (index)
+    {
+        ETLSF_assert(!RANGE_DATA(index).is_free && "block already marked as free");
 
         //Merge prev block if free
-        uint16_t prev_index = RANGE_DATA(index).prev_phys_index;
+        uint32_t prev_index = RANGE_DATA(index).prev_phys_index;
         if (prev_index && RANGE_DATA(prev_index).is_free)
         {
             freelist_remove_range(arena, prev_index);
@@ -287,7 +726,7 @@ void etlsf_free_range(etlsf_t arena, etlsf_alloc_t id)
         }
 
         //Merge next block if free
-        uint16_t next_index = RANGE_DATA(index).next_phys_index;
+        uint32_t next_index = RANGE_DATA(index).next_phys_index;
         if (next_index && RANGE_DATA(next_index).is_free)
         {
             freelist_remove_range(arena, next_index);
@@ -300,34 +739,344 @@ void etlsf_free_range(etlsf_t arena, etlsf_alloc_t id)
 
 uint32_t etlsf_alloc_size(etlsf_t arena, etlsf_alloc_t id)
 {
-    return etlsf_alloc_is_valid(arena, id) ? calc_range_size(arena, id.value) : 0;
+    uint32_t index = handle_index(arena, id);
+    return index ? calc_range_size(arena, index) : 0;
 }
 
 uint32_t etlsf_alloc_offset(etlsf_t arena, etlsf_alloc_t id)
 {
-    return etlsf_alloc_is_valid(arena, id) ? RANGE_DATA(id.value).offset : 0;
+    uint32_t index = handle_index(arena, id);
+    return index ? RANGE_DATA(index).offset : 0;
 }
 
 int etlsf_alloc_is_valid(etlsf_t arena, etlsf_alloc_t id)
 {
-    return (id.value != 0) && !RANGE_DATA(id.value).is_free;
+    return handle_index(arena, id) != 0;
+}
+
+void etlsf_free_stats(etlsf_t arena, etlsf_free_stats_t* stats)
+{
+    ETLSF_assert(arena);
+    ETLSF_assert(stats);
+
+    if (arena->concurrent)
+    {
+        ETLSF_lock(&arena->concurrent->lock);
+    }
+
+    stats->free_size         = 0;
+    stats->largest_free_size = 0;
+    stats->num_free_ranges   = 0;
+    stats->fragmentation     = 0.0f;
+
+    for (uint32_t fl = 0; fl < FL_INDEX_COUNT; ++fl)
+    {
+        if (!(arena->fl_bitmap & (1 << fl))) continue;
+
+        for (uint32_t sl = 0; sl < SL_INDEX_COUNT; ++sl)
+        {
+            if (!(arena->sl_bitmap[fl] & (1 << sl))) continue;
+
+            for (uint32_t index = arena->blocks[fl][sl]; index; index = RANGE_DATA(index).next_free_index)
+            {
+                uint32_t size = calc_range_size(arena, index);
+
+                stats->free_size += size;
+                stats->largest_free_size = size > stats->largest_free_size ? size : stats->largest_free_size;
+                ++stats->num_free_ranges;
+            }
+        }
+    }
+
+    if (stats->free_size)
+    {
+        stats->fragmentation = 1.0f - (float)stats->largest_free_size / (float)stats->free_size;
+    }
+
+    if (arena->concurrent)
+    {
+        ETLSF_unlock(&arena->concurrent->lock);
+    }
+}
+
+//------------------------------  Compaction  ---------------------------------//
+
+uint32_t etlsf_compact_plan(etlsf_t arena, uint32_t max_bytes, etlsf_move_t* moves, uint32_t max_moves)
+{
+    ETLSF_assert(arena);
+    ETLSF_assert(moves || !max_moves);
+
+    if (arena->concurrent)
+    {
+        ETLSF_lock(&arena->concurrent->lock);
+    }
+
+    uint32_t num_moves = 0;
+    uint32_t index     = arena->first_phys_index;
+    uint32_t lowest    = arena->first_phys_index;
+
+    // Walk to last range, ranges are evacuated from the end of arena
+    while (RANGE_DATA(index).next_phys_index)
+    {
+        index = RANGE_DATA(index).next_phys_index;
+    }
+
+    for (; index && num_moves < max_moves; index = RANGE_DATA(index).prev_phys_index)
+    {
+        const struct range_data_t* range = &RANGE_DATA(index);
+
+        while (lowest && !RANGE_DATA(lowest).is_free)
+        {
+            lowest = RANGE_DATA(lowest).next_phys_index;
+        }
+
+        // No free ranges below, arena is compact
+        if (!lowest || RANGE_DATA(lowest).offset > range->offset) break;
+
+        // Skip free ranges, ranges in caches, deferred queue and reserved by earlier moves
+        if (range->is_free || range->is_cached) continue;
+
+        uint32_t size = calc_range_size(arena, index);
+        if (size > max_bytes) continue;
+
+        // First fit by address, so moves fill lowest free ranges and never undo each other
+        uint32_t dst_index = lowest;
+        while (dst_index != index && !(RANGE_DATA(dst_index).is_free && calc_range_size(arena, dst_index) >= size))
+        {
+            dst_index = RANGE_DATA(dst_index).next_phys_index;
+        }
+
+        if (dst_index == index) continue;
+
+        arena_take_range(arena, dst_index, size);
+        RANGE_DATA(dst_index).is_cached = 1;
+
+        etlsf_move_t* move = &moves[num_moves++];
+
+        move->id         = handle_make(arena, index);
+        move->src_offset = range->offset;
+        move->dst_offset = RANGE_DATA(dst_index).offset;
+        move->size       = size;
+        move->dst_index  = dst_index;
+
+        max_bytes -= size;
+    }
+
+    if (arena->concurrent)
+    {
+        ETLSF_unlock(&arena->concurrent->lock);
+    }
+
+    return num_moves;
+}
+
+int etlsf_compact_commit(etlsf_t arena, const etlsf_move_t* move)
+{
+    ETLSF_assert(arena);
+    ETLSF_assert(move && move->dst_index && move->dst_index <= arena->num_ranges);
+    ETLSF_assert(RANGE_DATA(move->dst_index).is_cached && RANGE_DATA(move->dst_index).offset == move->dst_offset);
+
+    if (arena->concurrent)
+    {
+        ETLSF_lock(&arena->concurrent->lock);
+    }
+
+    uint32_t index = handle_index(arena, move->id);
+    int      moved = index && RANGE_DATA(index).offset == move->src_offset;
+
+    if (moved)
+    {
+        // Allocation takes reserved place, reservation takes source place
+        // and is freed with deferred ranges, as source may be still in use
+        swap_ranges(arena, index, move->dst_index);
+        deferred_push(arena, move->dst_index);
+    }
+    else
+    {
+        // Allocation was freed after planning, reservation is not needed
+        RANGE_DATA(move->dst_index).is_cached = 0;
+        arena_free_range(arena, move->dst_index);
+    }
+
+    if (arena->concurrent)
+    {
+        ETLSF_unlock(&arena->concurrent->lock);
+    }
+
+    return moved;
+}
+
+void etlsf_compact_cancel(etlsf_t arena, const etlsf_move_t* move)
+{
+    ETLSF_assert(arena);
+    ETLSF_assert(move && move->dst_index && move->dst_index <= arena->num_ranges);
+    ETLSF_assert(RANGE_DATA(move->dst_index).is_cached && RANGE_DATA(move->dst_index).offset == move->dst_offset);
+
+    if (arena->concurrent)
+    {
+        ETLSF_lock(&arena->concurrent->lock);
+    }
+
+    RANGE_DATA(move->dst_index).is_cached = 0;
+    arena_free_range(arena, move->dst_index);
+
+    if (arena->concurrent)
+    {
+        ETLSF_unlock(&arena->concurrent->lock);
+    }
+}
+
+//-------------------------------  Handles  -----------------------------------//
+
+static etlsf_alloc_t handle_make(etlsf_t arena, uint32_t index)
+{
+    etlsf_alloc_t id;
+
+    id.value = index ? ((uint32_t)RANGE_DATA(index).generation << ETLSF_INDEX_BITS) | index : 0;
+
+    return id;
+}
+
+// Range index of live allocation, 0 for null, stale or freed handles
+static uint32_t handle_index(etlsf_t arena, etlsf_alloc_t id)
+{
+    uint32_t index      = id.value & HANDLE_INDEX_MASK;
+    uint32_t generation = id.value >> ETLSF_INDEX_BITS;
+
+    if (!index || index > arena->num_ranges) return 0;
+
+    const struct range_data_t* range = &RANGE_DATA(index);
+
+    return range->generation == generation && !range->is_free && !range->is_cached ? index : 0;
+}
+
+// Invalidates handle of range before it is freed
+static uint32_t handle_release(etlsf_t arena, etlsf_alloc_t id)
+{
+    uint32_t index = handle_index(arena, id);
+
+    ETLSF_assert(index && "block already marked as free or handle is stale");
+
+    if (index)
+    {
+        RANGE_DATA(index).generation = (RANGE_DATA(index).generation + 1) & HANDLE_GENERATION_MASK;
+    }
+
+    return index;
+}
+
+//----------------------------  Thread caches  --------------------------------//
+
+// Bin index for ranges that are cached by threads, -1 for other sizes
+static int thread_cache_class(etlsf_t arena, uint32_t size)
+{
+    if (size > SMALL_ALLOC_SIZE(arena) || size & ((1u << arena->align_log2) - 1)) return -1;
+
+    return (size >> arena->align_log2) - 1;
+}
+
+// Cache of calling thread or 0 if all caches are claimed by other threads.
+// Caches are never released, threads that exit keep their caches claimed.
+static struct thread_cache_t* thread_cache_get(etlsf_t arena)
+{
+    struct concurrent_state_t* state = arena->concurrent;
+    struct tls_cache_ref_t*    ref   = &tls_cache_refs[state->id % TLS_ARENA_COUNT];
+
+    for (uint32_t i = 0; i < TLS_ARENA_COUNT; ++i)
+    {
+        if (tls_cache_refs[i].arena_id == state->id)
+        {
+            return tls_cache_refs[i].cache;
+        }
+
+        // Prefer unused slot, otherwise reference of other arena is replaced
+        if (tls_cache_refs[i].arena_id == 0)
+        {
+            ref = &tls_cache_refs[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < THREAD_CACHE_COUNT; ++i)
+    {
+        struct thread_cache_t* cache = &state->caches[i];
+
+        if (!cache->claimed && ETLSF_cas(&cache->claimed, 0, 1))
+        {
+            ref->arena_id = state->id;
+            ref->cache    = cache;
+
+            return cache;
+        }
+    }
+
+    return 0;
+}
+
+// Called with cache lock taken
+static void thread_cache_flush(etlsf_t arena, struct thread_cache_t* cache, int flush_bins)
+{
+    struct concurrent_state_t* state = arena->concurrent;
+
+    ETLSF_lock(&state->lock);
+
+    for (uint32_t i = 0; i < cache->num_pending; ++i)
+    {
+        RANGE_DATA(cache->pending[i]).is_cached = 0;
+        cache->cached_size -= calc_range_size(arena, cache->pending[i]) >> arena->align_log2;
+        arena_free_range(arena, cache->pending[i]);
+    }
+    cache->num_pending = 0;
+
+    if (flush_bins)
+    {
+        for (uint32_t size_class = 0; size_class < CACHE_CLASS_COUNT; ++size_class)
+        {
+            for (uint32_t i = 0; i < cache->bin_count[size_class]; ++i)
+            {
+                RANGE_DATA(cache->bins[size_class][i]).is_cached = 0;
+                arena_free_range(arena, cache->bins[size_class][i]);
+            }
+            cache->cached_size -= cache->bin_count[size_class] * (size_class + 1);
+            cache->bin_count[size_class] = 0;
+        }
+    }
+
+    ETLSF_unlock(&state->lock);
+}
+
+// Flushes caches of all threads, called without any cache lock taken
+static void thread_caches_flush(etlsf_t arena, int flush_bins)
+{
+    struct concurrent_state_t* state = arena->concurrent;
+
+    for (uint32_t i = 0; i < THREAD_CACHE_COUNT; ++i)
+    {
+        struct thread_cache_t* cache = &state->caches[i];
+
+        if (cache->claimed)
+        {
+            ETLSF_lock(&cache->lock);
+            if (flush_bins || cache->num_pending) thread_cache_flush(arena, cache, flush_bins);
+            ETLSF_unlock(&cache->lock);
+        }
+    }
 }
 
 //------------------------------  Arena utils  --------------------------------//
 
-static size_t arena_total_size(size_t max_allocs)
+static size_t arena_total_size(uint32_t max_allocs)
 {
     return sizeof(etlsf_private_t) + max_allocs * sizeof(struct range_data_t);
 }
 
 //----------------------------  Storage utils  --------------------------------//
-static uint16_t storage_alloc_range_data(etlsf_t arena)
+static uint32_t storage_alloc_range_data(etlsf_t arena)
 {
     if (arena->first_free_storage_index)
     {
         ETLSF_assert(arena->first_free_storage_index <= arena->num_ranges);
 
-        uint16_t id = arena->first_free_storage_index;
+        uint32_t id = arena->first_free_storage_index;
         arena->first_free_storage_index = RANGE_DATA(id).next_phys_index;
 
         return id;
@@ -335,7 +1084,7 @@ static uint16_t storage_alloc_range_data(etlsf_t arena)
 
     if (arena->unused_range_count > 0)
     {
-        uint16_t id = arena->num_ranges + 1 - arena->unused_range_count;
+        uint32_t id = arena->num_ranges + 1 - arena->unused_range_count;
         --arena->unused_range_count;
 
         return id;
@@ -344,7 +1093,7 @@ static uint16_t storage_alloc_range_data(etlsf_t arena)
     return 0;
 }
 
-static void storage_free_range_data(etlsf_t arena, uint16_t index)
+static void storage_free_range_data(etlsf_t arena, uint32_t index)
 {
     ETLSF_assert(index > 0);
     ETLSF_assert(index <= arena->num_ranges);
@@ -363,12 +1112,12 @@ static void storage_free_range_data(etlsf_t arena, uint16_t index)
 
 //---------------------------  Physical ranges operations  --------------------------//
 
-static uint32_t calc_range_size(etlsf_t arena, uint16_t index)
+static uint32_t calc_range_size(etlsf_t arena, uint32_t index)
 {
     assert(arena);
     assert(index);
 
-    uint16_t next = RANGE_DATA(index).next_phys_index;
+    uint32_t next = RANGE_DATA(index).next_phys_index;
     return (next ? RANGE_DATA(next).offset : arena->size) - RANGE_DATA(index).offset;
 }
 
@@ -380,28 +1129,30 @@ static void create_initial_range(etlsf_t arena)
     ** so that the prev_phys_block field falls outside of the pool -
     ** it will never be used.
     */
-    uint16_t index = storage_alloc_range_data(arena);
+    uint32_t index = storage_alloc_range_data(arena);
+    arena->first_phys_index = index;
     RANGE_DATA(index).prev_phys_index = 0;
     RANGE_DATA(index).next_phys_index = 0;
     RANGE_DATA(index).offset = 0;
+    RANGE_DATA(index).is_cached = 0;
     freelist_insert_range(arena, index);
 }
 
 // returns block created after split
-static uint32_t split_range(etlsf_t arena, uint16_t id, uint32_t size)
+static uint32_t split_range(etlsf_t arena, uint32_t id, uint32_t size)
 {
     ETLSF_assert(arena);
     ETLSF_assert(id);
-    ETLSF_assert(size >= RANGE_SIZE_MIN);
+    ETLSF_assert(size >= (1u << arena->align_log2));
 
     uint32_t bsize = calc_range_size(arena, id);
 
-    uint16_t new_index = 0;
-    bool can_split = bsize >= size + RANGE_SIZE_MIN;
+    uint32_t new_index = 0;
+    bool can_split = bsize - size >= (1u << arena->align_log2);
 
     if (can_split && (new_index = storage_alloc_range_data(arena)))
     {
-        uint16_t next = RANGE_DATA(id).next_phys_index;
+        uint32_t next = RANGE_DATA(id).next_phys_index;
         uint32_t offset = RANGE_DATA(id).offset;
 
         RANGE_DATA(id).next_phys_index = new_index;
@@ -409,6 +1160,7 @@ static uint32_t split_range(etlsf_t arena, uint16_t id, uint32_t size)
         RANGE_DATA(new_index).offset = offset + size;
         RANGE_DATA(new_index).next_phys_index = next;
         RANGE_DATA(new_index).prev_phys_index = id;
+        RANGE_DATA(new_index).is_cached = 0;
 
         RANGE_DATA(next).prev_phys_index = new_index;
     }
@@ -416,50 +1168,95 @@ static uint32_t split_range(etlsf_t arena, uint16_t id, uint32_t size)
     return new_index;
 }
 
-static void merge_ranges(etlsf_t arena, uint16_t target_index, uint16_t source_index)
+static void merge_ranges(etlsf_t arena, uint32_t target_index, uint32_t source_index)
 {
     ETLSF_assert(arena);
     ETLSF_assert(target_index);
     ETLSF_assert(source_index);
     ETLSF_assert(RANGE_DATA(target_index).next_phys_index == source_index);
 
-    RANGE_DATA(target_index).next_phys_index = RANGE_DATA(source_index).next_phys_index;
+    uint32_t next = RANGE_DATA(source_index).next_phys_index;
+
+    RANGE_DATA(target_index).next_phys_index = next;
+    RANGE_DATA(next).prev_phys_index = target_index;
 
     storage_free_range_data(arena, source_index);
 }
 
+// Exchanges places of two allocated ranges in physical list, places keep their offsets and sizes
+static void swap_ranges(etlsf_t arena, uint32_t a, uint32_t b)
+{
+    ETLSF_assert(arena);
+    ETLSF_assert(a && b && a != b);
+    ETLSF_assert(!RANGE_DATA(a).is_free && !RANGE_DATA(b).is_free);
+
+    struct range_data_t* ra = &RANGE_DATA(a);
+    struct range_data_t* rb = &RANGE_DATA(b);
+
+    // Links are remapped, so adjacent ranges end up pointing at each other
+    #define swap_ranges_map(index) ((index) == a ? b : (index) == b ? a : (index))
+
+    uint32_t a_prev = swap_ranges_map(rb->prev_phys_index), a_next = swap_ranges_map(rb->next_phys_index);
+    uint32_t b_prev = swap_ranges_map(ra->prev_phys_index), b_next = swap_ranges_map(ra->next_phys_index);
+
+    #undef swap_ranges_map
+
+    uint32_t offset = ra->offset;
+    ra->offset = rb->offset;
+    rb->offset = offset;
+
+    ra->prev_phys_index = a_prev;
+    ra->next_phys_index = a_next;
+    rb->prev_phys_index = b_prev;
+    rb->next_phys_index = b_next;
+
+    RANGE_DATA(a_prev).next_phys_index = a;
+    RANGE_DATA(a_next).prev_phys_index = a;
+    RANGE_DATA(b_prev).next_phys_index = b;
+    RANGE_DATA(b_next).prev_phys_index = b;
+
+    if (arena->first_phys_index == a)
+    {
+        arena->first_phys_index = b;
+    }
+    else if (arena->first_phys_index == b)
+    {
+        arena->first_phys_index = a;
+    }
+}
+
 
 //------------------------------  Size utils  -------------------------------//
 
-#define size_to_fl_sl(size, fl, sl)                                                      \
+#define size_to_fl_sl(arena, size, fl, sl)                                               \
 {                                                                                        \
-    if (size < SMALL_ALLOC_SIZE)                                                         \
+    if (size < SMALL_ALLOC_SIZE(arena))                                                  \
     {                                                                                    \
         /* Store small blocks in first list. */                                          \
         fl = 0;                                                                          \
-        sl = size / (SMALL_ALLOC_SIZE / SL_INDEX_COUNT);                                 \
+        sl = size >> arena->align_log2;                                                  \
     }                                                                                    \
     else                                                                                 \
     {                                                                                    \
         fl = ETLSF_fls(size);                                                            \
         sl = (size >> (fl - SL_INDEX_COUNT_LOG2)) ^ (1 << SL_INDEX_COUNT_LOG2);          \
-        fl -= (FL_INDEX_SHIFT - 1);                                                      \
+        fl -= (arena->fl_shift - 1);                                                     \
     }                                                                                    \
 }                                                                                        \
 
 //------------------------------  Free list operations  ------------------------------//
 
 //It is a bug when prev phys block is free
-static void freelist_insert_range(etlsf_t arena, uint16_t index)
+static void freelist_insert_range(etlsf_t arena, uint32_t index)
 {
     ETLSF_assert(arena);
     ETLSF_assert(index);
 
     uint32_t fl = 0, sl = 0;
     uint32_t size = calc_range_size(arena, index);
-    size_to_fl_sl(size, fl, sl);
+    size_to_fl_sl(arena, size, fl, sl);
 
-    uint16_t next_free_index = arena->blocks[fl][sl];
+    uint32_t next_free_index = arena->blocks[fl][sl];
     ETLSF_assert(index <= arena->num_ranges);
     ETLSF_assert(next_free_index <= arena->num_ranges);
 
@@ -478,17 +1275,17 @@ static void freelist_insert_range(etlsf_t arena, uint16_t index)
     arena->sl_bitmap[fl] |= (1 << sl);
 }
 
-static void freelist_remove_range(etlsf_t arena, uint16_t index)
+static void freelist_remove_range(etlsf_t arena, uint32_t index)
 {
     assert(arena);
     assert(index);
 
     uint32_t size = calc_range_size(arena, index);
     uint32_t  fl = 0, sl = 0;
-    size_to_fl_sl(size, fl, sl);
+    size_to_fl_sl(arena, size, fl, sl);
 
-    uint16_t prev_index = RANGE_DATA(index).prev_free_index;
-    uint16_t next_index = RANGE_DATA(index).next_free_index;
+    uint32_t prev_index = RANGE_DATA(index).prev_free_index;
+    uint32_t next_index = RANGE_DATA(index).next_free_index;
 
     ETLSF_assert(prev_index <= arena->num_ranges);
     ETLSF_assert(next_index <= arena->num_ranges);
@@ -518,35 +1315,56 @@ static void freelist_remove_range(etlsf_t arena, uint16_t index)
     }
 }
 
-static uint16_t freelist_find_suitable(etlsf_t arena, uint32_t size)
+static uint32_t freelist_find_suitable(etlsf_t arena, uint32_t size)
 {
-    uint16_t index = 0;
+    ETLSF_assert(size);
+
+    uint32_t fl = 0, sl = 0;
+    uint32_t search = size;
+
+    /* Round up to next list, so any range in found list fits. */
+    if (search >= SMALL_ALLOC_SIZE(arena))
+    {
+        const uint32_t round = (1 << (ETLSF_fls(search) - SL_INDEX_COUNT_LOG2)) - 1;
+        search = search <= 0xFFFFFFFF - round ? search + round : 0;
+    }
 
-    if (size)
+    if (search)
     {
-        uint32_t fl_req = 0, sl_req = 0;
-        size_to_fl_sl(size, fl_req, sl_req);
+        size_to_fl_sl(arena, search, fl, sl);
 
-        const uint32_t fl_mask = 0xFFFFFFFF << fl_req;
-        const uint32_t fl_map = arena->fl_bitmap & fl_mask;
+        uint32_t sl_map = arena->sl_bitmap[fl] & (0xFFFFFFFF << sl);
 
-        if (!fl_map)
+        if (!sl_map)
         {
-            return 0; // Out of memory
-        }
+            /* No range in this first level list, search larger ones. */
+            const uint32_t fl_map = fl + 1 < FL_INDEX_COUNT ? arena->fl_bitmap & (0xFFFFFFFF << (fl + 1)) : 0;
 
-        const uint32_t fl = ETLSF_ffs(fl_map);
-        const uint32_t sl_map = arena->sl_bitmap[fl];
+            if (fl_map)
+            {
+                fl = ETLSF_ffs(fl_map);
+                sl_map = arena->sl_bitmap[fl];
+
+                ETLSF_assert(sl_map && "internal error - second level bitmap is null");
+            }
+        }
 
-        ETLSF_assert(sl_map && "internal error - second level bitmap is null");
+        if (sl_map)
+        {
+            sl = ETLSF_ffs(sl_map);
 
-        const uint32_t sl_mask = 0xFFFFFFFF << ((fl > fl_req) ? 0 : sl_req);
-        const uint32_t sl = ETLSF_ffs(sl_map & sl_mask);
+            /* Return the first block in the free list. */
+            uint32_t index = arena->blocks[fl][sl];
+            ETLSF_assert(calc_range_size(arena, index) >= size);
 
-        /* Return the first block in the free list. */
-        index = arena->blocks[fl][sl];
-        ETLSF_assert(calc_range_size(arena, index) >= size);
+            return index;
+        }
     }
 
-    return index;
+    /* Nothing in larger lists, first range of exact size list may still fit. */
+    size_to_fl_sl(arena, size, fl, sl);
+
+    uint32_t index = arena->blocks[fl][sl];
+
+    return index && calc_range_size(arena, index) >= size ? index : 0; // Out of memory otherwise
 }
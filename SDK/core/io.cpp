@@ -0,0 +1,472 @@
+namespace io
+{
+    enum RequestState
+    {
+        STATE_QUEUED,       // In priority queue
+        STATE_BATCHED,      // Taken by I/O thread, read is not started
+        STATE_READING,
+        STATE_COMPLETING,   // Completion job is scheduled
+    };
+
+    struct request_data_t
+    {
+        char              name[MAX_NAME];
+        completion_func_t completion;
+        void*             arg;
+        memory_t          data;
+        size_t            reserved;     // Bytes in flight, released when request is freed
+        request_t         handle;
+        request_data_t*   next;         // Queue or batch
+        uint32_t          priority;
+        uint32_t          state;
+        int               status;
+        bool              cancelled;
+    };
+
+    struct io_service_t
+    {
+        SDL_mutex*          mutex;
+        SDL_cond*           requestCond;    // New requests or shutdown
+        SDL_cond*           completeCond;   // Completions, bytes in flight are released
+
+        core::handle_pool_t<request_data_t, MAX_REQUESTS> requests;
+
+        request_data_t*     heads[PRIORITY_COUNT];
+        request_data_t*     tails[PRIORITY_COUNT];
+
+        size_t              bytesInFlight;
+        size_t              maxBytesInFlight;
+
+        SDL_Thread*         threads[MAX_THREADS];
+        int                 numThreads;
+        bool                shutdown;
+    };
+
+    static io_service_t service;
+
+    static void freeRequest(request_data_t* request)
+    {
+        SDL_LockMutex(service.mutex);
+        service.bytesInFlight -= request->reserved;
+        core::handle_pool_free(service.requests, request->handle);
+        SDL_CondBroadcast(service.completeCond);
+        SDL_UnlockMutex(service.mutex);
+    }
+
+    static void completeBatch(void* arg)
+    {
+        PROFILER_CPU_TIMESLICE("io completion");
+
+        request_data_t* request = (request_data_t*)arg;
+
+        while (request)
+        {
+            request_data_t* next = request->next;
+            memory_t        data = request->data;
+
+            // Completion owns data
+            memset(&request->data, 0, sizeof(memory_t));
+            request->completion(request->arg, request->status, &data);
+
+            freeRequest(request);
+
+            request = next;
+        }
+    }
+
+    static void scheduleBatch(request_data_t* batch)
+    {
+        if (!batch) return;
+
+        mt::job_t* job = mt::createJob(completeBatch, batch);
+        if (!job || mt::runJob(job) != mt::noError)
+        {
+            // No free job slot, complete in place
+            completeBatch(batch);
+        }
+    }
+
+    // Mutex should be locked
+    static request_data_t* popRequest()
+    {
+        for (int priority = PRIORITY_COUNT - 1; priority >= 0; --priority)
+        {
+            request_data_t* request = service.heads[priority];
+            if (request)
+            {
+                service.heads[priority] = request->next;
+                if (!request->next) service.tails[priority] = 0;
+
+                request->next  = 0;
+                request->state = STATE_BATCHED;
+
+                return request;
+            }
+        }
+
+        return 0;
+    }
+
+    // Mutex should be locked
+    static void unlinkRequest(request_data_t* request)
+    {
+        request_data_t** link = &service.heads[request->priority];
+        request_data_t*  prev = 0;
+
+        while (*link != request)
+        {
+            prev = *link;
+            link = &prev->next;
+        }
+
+        *link = request->next;
+        if (service.tails[request->priority] == request) service.tails[request->priority] = prev;
+
+        request->next = 0;
+    }
+
+    // Reserves bytes in flight, completions of own batch are scheduled before waiting.
+    // Nothing is reserved if service is shut down while waiting.
+    static bool reserveBytes(size_t size, request_data_t** batch, request_data_t*** batchTail)
+    {
+        SDL_LockMutex(service.mutex);
+
+        bool fits = service.bytesInFlight == 0 || service.bytesInFlight + size <= service.maxBytesInFlight;
+
+        if (!fits && *batch)
+        {
+            SDL_UnlockMutex(service.mutex);
+            scheduleBatch(*batch);
+            *batch     = 0;
+            *batchTail = batch;
+            SDL_LockMutex(service.mutex);
+        }
+
+        while (!service.shutdown && service.bytesInFlight && service.bytesInFlight + size > service.maxBytesInFlight)
+        {
+            SDL_CondWait(service.completeCond, service.mutex);
+        }
+
+        bool reserved = !service.shutdown;
+
+        if (reserved) service.bytesInFlight += size;
+
+        SDL_UnlockMutex(service.mutex);
+
+        return reserved;
+    }
+
+    // Files in directories are mapped without copy, pages are prefetched by OS
+    static bool mapRequest(request_data_t* request)
+    {
+        char     path[1024];
+        memory_t view;
+
+        if (!request->data.size || !mem_native_path(path, sizeof(path), request->name)) return false;
+        if (!mem_map_native(&view, path, MEM_MAP_SEQUENTIAL | MEM_MAP_WILLNEED)) return false;
+
+        // File was changed after its length was reserved
+        if (view.size != request->data.size)
+        {
+            mem_unmap(&view);
+            return false;
+        }
+
+        request->data = view;
+
+        return true;
+    }
+
+    static void readRequest(request_data_t* request, request_data_t** batch, request_data_t*** batchTail)
+    {
+        PROFILER_CPU_TIMESLICE("io read");
+
+        request->status = STATUS_FAILED;
+
+        PHYSFS_File* src = PHYSFS_openRead(request->name);
+        if (!src) return;
+
+        PHYSFS_sint64 length = PHYSFS_fileLength(src);
+
+        if (length >= 0 && (uint64_t)length < SIZE_MAX && reserveBytes((size_t)length, batch, batchTail))
+        {
+            request->reserved       = (size_t)length;
+            request->data.size      = (size_t)length;
+            request->data.allocated = 0;
+            request->data.mapped    = false;
+
+            if (mapRequest(request))
+            {
+                request->status = STATUS_COMPLETE;
+            }
+            else
+            {
+                // Files in archives and files that can not be mapped are read into heap
+                request->data.buffer = (uint8_t*)malloc(request->data.size + 1);
+
+                if (request->data.buffer && PHYSFS_read(src, request->data.buffer, 1, (PHYSFS_uint32)length) == length)
+                {
+                    request->status = STATUS_COMPLETE;
+                }
+                else
+                {
+                    free(request->data.buffer);
+                    memset(&request->data, 0, sizeof(memory_t));
+                }
+            }
+        }
+
+        PHYSFS_close(src);
+    }
+
+    static int SDLCALL ioThread(void* index)
+    {
+        char threadName[16];
+        SDL_snprintf(threadName, sizeof(threadName), "IO%d", (int)(intptr_t)index);
+        profilerRegisterThread(threadName);
+
+        SDL_LockMutex(service.mutex);
+
+        while (!service.shutdown)
+        {
+            request_data_t* requests[MAX_BATCH];
+            uint32_t        count = 0;
+
+            while (count < MAX_BATCH && (requests[count] = popRequest()))
+            {
+                ++count;
+            }
+
+            if (!count)
+            {
+                SDL_CondWait(service.requestCond, service.mutex);
+                continue;
+            }
+
+            request_data_t*  batch     = 0;
+            request_data_t** batchTail = &batch;
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                request_data_t* request   = requests[i];
+                bool            cancelled = request->cancelled;
+
+                request->state = cancelled ? STATE_COMPLETING : STATE_READING;
+                SDL_UnlockMutex(service.mutex);
+
+                if (cancelled)
+                {
+                    request->status = STATUS_CANCELLED;
+                }
+                else
+                {
+                    readRequest(request, &batch, &batchTail);
+                }
+
+                *batchTail = request;
+                batchTail  = &request->next;
+
+                SDL_LockMutex(service.mutex);
+                request->state = STATE_COMPLETING;
+            }
+
+            SDL_UnlockMutex(service.mutex);
+            scheduleBatch(batch);
+            SDL_LockMutex(service.mutex);
+        }
+
+        SDL_UnlockMutex(service.mutex);
+
+        profilerUnregisterThread();
+
+        return 0;
+    }
+
+    void init(int threadCount, size_t maxBytesInFlight)
+    {
+        char threadName[16];
+
+        memset(&service, 0, sizeof(io_service_t));
+
+        service.mutex            = SDL_CreateMutex();
+        service.requestCond      = SDL_CreateCond();
+        service.completeCond     = SDL_CreateCond();
+        service.maxBytesInFlight = maxBytesInFlight;
+
+        threadCount = core::min<int>(core::max(threadCount, 1), MAX_THREADS);
+
+        for (int i = 0; i < threadCount; ++i)
+        {
+            SDL_snprintf(threadName, sizeof(threadName), "IO%d", i);
+
+            service.threads[i] = SDL_CreateThread(ioThread, threadName, (void*)(intptr_t)i);
+            if (service.threads[i] == 0) break;
+
+            ++service.numThreads;
+        }
+    }
+
+    void fini()
+    {
+        if (!service.mutex) return;
+
+        request_data_t*  cancelled = 0;
+        request_data_t** tail      = &cancelled;
+
+        SDL_LockMutex(service.mutex);
+
+        service.shutdown = true;
+        SDL_CondBroadcast(service.requestCond);
+        SDL_CondBroadcast(service.completeCond);
+
+        while (request_data_t* request = popRequest())
+        {
+            request->state  = STATE_COMPLETING;
+            request->status = STATUS_CANCELLED;
+
+            *tail = request;
+            tail  = &request->next;
+        }
+
+        SDL_UnlockMutex(service.mutex);
+
+        for (int i = 0; i < service.numThreads; ++i)
+        {
+            SDL_WaitThread(service.threads[i], NULL);
+        }
+
+        completeBatch(cancelled);
+
+        // Completion jobs of finished reads
+        SDL_LockMutex(service.mutex);
+        while (core::handle_pool_count(service.requests))
+        {
+            SDL_UnlockMutex(service.mutex);
+            if (!mt::runPendingJob()) SDL_Delay(0);
+            SDL_LockMutex(service.mutex);
+        }
+        SDL_UnlockMutex(service.mutex);
+
+        SDL_DestroyCond(service.completeCond);
+        SDL_DestroyCond(service.requestCond);
+        SDL_DestroyMutex(service.mutex);
+
+        memset(&service, 0, sizeof(io_service_t));
+    }
+
+    request_t read(const char* name, int priority, completion_func_t completion, void* arg)
+    {
+        assert(service.mutex);
+        assert(completion);
+        assert(priority >= PRIORITY_LOW && priority < PRIORITY_COUNT);
+
+        request_t handle = request_t();
+
+        if (!name || strlen(name) >= MAX_NAME) return handle;
+
+        SDL_LockMutex(service.mutex);
+
+        if (!service.shutdown)
+        {
+            handle = core::handle_pool_alloc(service.requests);
+        }
+
+        request_data_t* request = core::handle_pool_get(service.requests, handle);
+
+        if (request)
+        {
+            strcpy(request->name, name);
+
+            request->completion = completion;
+            request->arg        = arg;
+            request->reserved   = 0;
+            request->handle     = handle;
+            request->next       = 0;
+            request->priority   = priority;
+            request->state      = STATE_QUEUED;
+            request->status     = STATUS_FAILED;
+            request->cancelled  = false;
+
+            memset(&request->data, 0, sizeof(memory_t));
+
+            if (service.tails[priority])
+                service.tails[priority]->next = request;
+            else
+                service.heads[priority] = request;
+
+            service.tails[priority] = request;
+
+            SDL_CondSignal(service.requestCond);
+        }
+
+        SDL_UnlockMutex(service.mutex);
+
+        return handle;
+    }
+
+    bool cancel(request_t handle)
+    {
+        request_data_t* queued = 0;
+        bool            result = false;
+
+        SDL_LockMutex(service.mutex);
+
+        request_data_t* request = core::handle_pool_get(service.requests, handle);
+
+        if (request && request->state == STATE_QUEUED)
+        {
+            unlinkRequest(request);
+
+            request->state  = STATE_COMPLETING;
+            request->status = STATUS_CANCELLED;
+
+            queued = request;
+            result = true;
+        }
+        else if (request && request->state == STATE_BATCHED)
+        {
+            // Thread that took request completes it
+            request->cancelled = true;
+            result = true;
+        }
+
+        SDL_UnlockMutex(service.mutex);
+
+        scheduleBatch(queued);
+
+        return result;
+    }
+
+    bool isComplete(request_t handle)
+    {
+        SDL_LockMutex(service.mutex);
+        bool complete = !core::handle_pool_is_valid(service.requests, handle);
+        SDL_UnlockMutex(service.mutex);
+
+        return complete;
+    }
+
+    void wait(request_t handle)
+    {
+        while (!isComplete(handle))
+        {
+            if (mt::runPendingJob()) continue;
+
+            SDL_LockMutex(service.mutex);
+            if (core::handle_pool_is_valid(service.requests, handle))
+            {
+                SDL_CondWaitTimeout(service.completeCond, service.mutex, 1);
+            }
+            SDL_UnlockMutex(service.mutex);
+        }
+    }
+
+    size_t getBytesInFlight()
+    {
+        SDL_LockMutex(service.mutex);
+        size_t bytes = service.bytesInFlight;
+        SDL_UnlockMutex(service.mutex);
+
+        return bytes;
+    }
+}
@@ -3,17 +3,314 @@
 #define ONLY_MSPACES 1
 #include "malloc.c.h"
 
-mspace_t mem_create_space(size_t capacity)
+#ifdef CORE_ENABLE_MEM_TAGS
+
+// Header is placed right before user memory of every block,
+// offset is distance from start of dlmalloc block to user memory
+typedef struct mem_block_header_t
+{
+    uint32_t offset;
+    uint32_t tag;
+    uint64_t size;
+} mem_block_header_t;
+
+typedef struct mem_tag_data_t
+{
+    const char*       name;
+    volatile int64_t  liveBytes;
+    volatile int64_t  peakBytes;
+    volatile int64_t  frameBytes;
+    SDL_atomic_t      liveCount;
+    SDL_atomic_t      frameAllocs;
+
+    // Last complete frame
+    int64_t           lastFrameBytes;
+    uint32_t          lastFrameAllocs;
+
+    uint16_t          liveGauge;
+    uint16_t          rateGauge;
+    char              liveGaugeName[48];
+    char              rateGaugeName[48];
+} mem_tag_data_t;
+
+// Tagged blocks of one mspace, kept in extension field of mspace state,
+// blocks still live when mspace is destroyed are released and are not leaks
+typedef struct mem_space_tags_t
 {
-    return (mspace_t)create_mspace(capacity, 1);
+    volatile int64_t liveBytes[MEM_MAX_TAGS];
+    SDL_atomic_t     liveCount[MEM_MAX_TAGS];
+} mem_space_tags_t;
+
+static mem_tag_data_t memTags[MEM_MAX_TAGS] = {{"untagged"}};
+static SDL_atomic_t   memNumTags = {1};
+static SDL_SpinLock   memTagsLock;
+
+static mem_space_tags_t* mem_space_tags(mspace_t mspace)
+{
+    return (mem_space_tags_t*)((mstate)mspace)->extp;
 }
 
-void mem_destroy_space(mspace_t mspace)
+static void mem_space_tags_add(mspace_t mspace, mem_tag_t tag, int64_t size, int count)
+{
+    mem_space_tags_t* tags = mem_space_tags(mspace);
+
+    _InterlockedExchangeAdd64(&tags->liveBytes[tag], size);
+    SDL_AtomicAdd(&tags->liveCount[tag], count);
+}
+
+static void mem_space_tags_init(mspace_t mspace)
+{
+    mem_space_tags_t* tags = (mem_space_tags_t*)mspace_malloc(mspace, sizeof(mem_space_tags_t));
+    assert(tags);
+
+    memset(tags, 0, sizeof(mem_space_tags_t));
+    ((mstate)mspace)->extp = tags;
+}
+
+static void mem_space_tags_release(mspace_t mspace)
+{
+    mem_space_tags_t* tags = mem_space_tags(mspace);
+
+    for (int i = 0; i < MEM_MAX_TAGS; ++i)
+    {
+        _InterlockedExchangeAdd64(&memTags[i].liveBytes, -tags->liveBytes[i]);
+        SDL_AtomicAdd(&memTags[i].liveCount, -SDL_AtomicGet(&tags->liveCount[i]));
+    }
+}
+
+static void mem_tag_gauges_init(mem_tag_data_t* tag)
+{
+    SDL_snprintf(tag->liveGaugeName, sizeof(tag->liveGaugeName), "mem %s live bytes", tag->name);
+    SDL_snprintf(tag->rateGaugeName, sizeof(tag->rateGaugeName), "mem %s bytes/frame", tag->name);
+
+    tag->liveGauge = profilerGenerateId();
+    tag->rateGauge = profilerGenerateId();
+    profilerAddDesc(tag->liveGauge, tag->liveGaugeName);
+    profilerAddDesc(tag->rateGauge, tag->rateGaugeName);
+}
+
+mem_tag_t mem_register_tag(const char* name)
+{
+    mem_tag_t result = MEM_TAG_UNTAGGED;
+
+    SDL_AtomicLock(&memTagsLock);
+
+    int numTags = SDL_AtomicGet(&memNumTags);
+    for (int i = 1; i < numTags; ++i)
+    {
+        if (strcmp(memTags[i].name, name) == 0)
+        {
+            result = i;
+            break;
+        }
+    }
+
+    if (result == MEM_TAG_UNTAGGED && numTags < MEM_MAX_TAGS)
+    {
+        memTags[numTags].name = name;
+        mem_tag_gauges_init(&memTags[numTags]);
+
+        result = numTags;
+        SDL_AtomicSet(&memNumTags, numTags + 1);
+    }
+
+    SDL_AtomicUnlock(&memTagsLock);
+
+    assert(result != MEM_TAG_UNTAGGED && "Out of memory tags");
+
+    return result;
+}
+
+static void mem_tag_add(mem_tag_t tag, int64_t size)
+{
+    mem_tag_data_t* data = &memTags[tag];
+
+    int64_t live = _InterlockedExchangeAdd64(&data->liveBytes, size) + size;
+    int64_t peak = data->peakBytes;
+
+    while (live > peak)
+    {
+        int64_t prev = _InterlockedCompareExchange64(&data->peakBytes, live, peak);
+        if (prev == peak) break;
+        peak = prev;
+    }
+
+    _InterlockedExchangeAdd64(&data->frameBytes, size);
+    SDL_AtomicAdd(&data->frameAllocs, 1);
+}
+
+static void* mem_block_init(void* block, size_t offset, size_t size, mem_tag_t tag)
+{
+    if (!block) return 0;
+
+    uint8_t*            ptr    = (uint8_t*)block + offset;
+    mem_block_header_t* header = (mem_block_header_t*)ptr - 1;
+
+    header->offset = (uint32_t)offset;
+    header->tag    = tag;
+    header->size   = size;
+
+    return ptr;
+}
+
+static mem_block_header_t* mem_block_header(void* ptr)
+{
+    mem_block_header_t* header = (mem_block_header_t*)ptr - 1;
+    assert(header->tag < MEM_MAX_TAGS);
+
+    return header;
+}
+
+// Header takes place of alignment, so user memory keeps requested alignment
+static size_t mem_block_offset(size_t alignment)
+{
+    return alignment > sizeof(mem_block_header_t) ? alignment : sizeof(mem_block_header_t);
+}
+
+// Blocks taken from mspace bypassing block header
+static void mem_tag_account(mspace_t mspace, mem_tag_t tag, int64_t size)
+{
+    if (size > 0)
+    {
+        mem_tag_add(tag, size);
+        SDL_AtomicAdd(&memTags[tag].liveCount, 1);
+    }
+    else
+    {
+        _InterlockedExchangeAdd64(&memTags[tag].liveBytes, size);
+        SDL_AtomicAdd(&memTags[tag].liveCount, -1);
+    }
+
+    mem_space_tags_add(mspace, tag, size, size > 0 ? 1 : -1);
+}
+
+void* mem_alloc_tagged(mspace_t mspace, size_t size, size_t alignment, mem_tag_t tag)
 {
     assert(mspace);
-    destroy_mspace(mspace);
+    assert(tag < (mem_tag_t)SDL_AtomicGet(&memNumTags));
+
+    size_t offset = mem_block_offset(alignment);
+    void*  ptr    = mem_block_init(mspace_malloc2(mspace, offset + size, alignment, 0), offset, size, tag);
+
+    if (ptr)
+    {
+        mem_tag_add(tag, (int64_t)size);
+        SDL_AtomicAdd(&memTags[tag].liveCount, 1);
+        mem_space_tags_add(mspace, tag, (int64_t)size, 1);
+    }
+
+    return ptr;
 }
 
+void* mem_alloc(mspace_t mspace, size_t size, size_t alignment)
+{
+    return mem_alloc_tagged(mspace, size, alignment, MEM_TAG_UNTAGGED);
+}
+
+void* mem_realloc(mspace_t mspace, void* ptr, size_t size, size_t alignment)
+{
+    assert(mspace);
+
+    if (!ptr) return mem_alloc(mspace, size, alignment);
+
+    mem_block_header_t* header  = mem_block_header(ptr);
+    mem_tag_t           tag     = header->tag;
+    size_t              offset  = header->offset;
+    int64_t             oldSize = (int64_t)header->size;
+
+    assert(offset == mem_block_offset(alignment) && "Realloc should keep alignment of block");
+
+    void* block = mspace_realloc2(mspace, (uint8_t*)ptr - offset, offset + size, alignment, 0);
+
+    if (block)
+    {
+        _InterlockedExchangeAdd64(&memTags[tag].liveBytes, -oldSize);
+        mem_tag_add(tag, (int64_t)size);
+        mem_space_tags_add(mspace, tag, (int64_t)size - oldSize, 0);
+    }
+
+    return mem_block_init(block, offset, size, tag);
+}
+
+void mem_free(mspace_t mspace, void* ptr)
+{
+    assert(mspace);
+
+    if (!ptr) return;
+
+    mem_block_header_t* header = mem_block_header(ptr);
+
+    _InterlockedExchangeAdd64(&memTags[header->tag].liveBytes, -(int64_t)header->size);
+    SDL_AtomicAdd(&memTags[header->tag].liveCount, -1);
+    mem_space_tags_add(mspace, header->tag, -(int64_t)header->size, -1);
+
+    mspace_free(mspace, (uint8_t*)ptr - header->offset);
+}
+
+void mem_tags_frame_begin()
+{
+    int numTags = SDL_AtomicGet(&memNumTags);
+
+    for (int i = 0; i < numTags; ++i)
+    {
+        mem_tag_data_t* tag = &memTags[i];
+
+        tag->lastFrameBytes  = _InterlockedExchange64(&tag->frameBytes, 0);
+        tag->lastFrameAllocs = (uint32_t)SDL_AtomicSet(&tag->frameAllocs, 0);
+
+        // Untagged blocks are covered by mspace gauges
+        if (i != MEM_TAG_UNTAGGED)
+        {
+            profilerAddGauge(tag->liveGauge, tag->liveBytes);
+            profilerAddGauge(tag->rateGauge, tag->lastFrameBytes);
+        }
+    }
+}
+
+uint32_t mem_tags_snapshot(mem_tag_stats_t* stats, uint32_t maxStats)
+{
+    uint32_t numTags = (uint32_t)SDL_AtomicGet(&memNumTags);
+
+    if (numTags > maxStats) numTags = maxStats;
+
+    for (uint32_t i = 0; i < numTags; ++i)
+    {
+        mem_tag_data_t* tag = &memTags[i];
+
+        stats[i].name        = tag->name;
+        stats[i].liveBytes   = tag->liveBytes;
+        stats[i].peakBytes   = tag->peakBytes;
+        stats[i].liveCount   = (uint32_t)SDL_AtomicGet(&tag->liveCount);
+        stats[i].frameAllocs = tag->lastFrameAllocs;
+        stats[i].frameBytes  = tag->lastFrameBytes;
+    }
+
+    return numTags;
+}
+
+uint32_t mem_tags_report_leaks()
+{
+    uint32_t leaks   = 0;
+    int      numTags = SDL_AtomicGet(&memNumTags);
+
+    for (int i = 0; i < numTags; ++i)
+    {
+        mem_tag_data_t* tag   = &memTags[i];
+        int             count = SDL_AtomicGet(&tag->liveCount);
+
+        if (count)
+        {
+            core_log(LOG_CAT_SYS, LOG_PRIO_WARN, "Memory leak: tag \"%s\", %d blocks, %lld bytes (peak %lld bytes)\n",
+                     tag->name, count, (long long)tag->liveBytes, (long long)tag->peakBytes);
+            leaks += count;
+        }
+    }
+
+    return leaks;
+}
+
+#else
+
 void* mem_alloc(mspace_t mspace, size_t size, size_t alignment)
 {
     assert(mspace);
@@ -31,3 +328,419 @@ void  mem_free(mspace_t mspace, void* ptr)
     assert(mspace);
     mspace_free(mspace, ptr);
 }
+
+static void mem_tag_account(mspace_t, mem_tag_t, int64_t) {}
+static void mem_space_tags_init(mspace_t) {}
+static void mem_space_tags_release(mspace_t) {}
+
+#endif
+
+mspace_t mem_create_space(size_t capacity)
+{
+    mspace_t mspace = (mspace_t)create_mspace(capacity, 1);
+
+    if (mspace) mem_space_tags_init(mspace);
+
+    return mspace;
+}
+
+void mem_destroy_space(mspace_t mspace)
+{
+    assert(mspace);
+
+    mem_space_tags_release(mspace);
+    destroy_mspace(mspace);
+}
+
+size_t mem_space_used(mspace_t mspace)
+{
+    assert(mspace);
+    return mspace_mallinfo(mspace).uordblks;
+}
+
+// Thread caching front end. Small blocks are carved from 64Kb spans aligned to span size,
+// so span header is found from block address. Span remembers thread slot that carved it,
+// blocks freed by other threads are pushed to remote list of that slot without locks
+// and are moved to bins of owner on next refill. Slot released by flush keeps its spans,
+// remote list of free slot is returned to central bins by flush and by freeing thread.
+#define MEM_CACHE_SPAN_SIZE     (64*1024)
+#define MEM_CACHE_SPAN_HEADER   64
+#define MEM_CACHE_BATCH         32
+#define MEM_CACHE_NUM_CLASSES   12
+
+static const uint32_t memCacheClassSizes[MEM_CACHE_NUM_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, MEM_CACHE_MAX_SIZE
+};
+
+// Size class of every 16 bytes step
+static const uint8_t memCacheClasses[MEM_CACHE_MAX_SIZE/16 + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7,
+    7, 8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9,
+    9, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11
+};
+
+static_assert(MEM_CACHE_MAX_SIZE == 1024, "Size classes should be updated");
+
+typedef struct mem_span_t
+{
+    struct mem_span_t* next;        // All spans of cache
+    uint32_t           sizeClass;
+    uint32_t           owner;       // Thread slot + 1, 0 if span was carved by thread without slot
+} mem_span_t;
+
+static_assert(sizeof(mem_span_t) <= MEM_CACHE_SPAN_HEADER, "Span header does not fit");
+
+typedef struct mem_bin_t
+{
+    void*    head;
+    uint32_t count;
+} mem_bin_t;
+
+typedef struct mem_thread_cache_t
+{
+    SDL_atomic_t thread;            // Id of thread using slot, 0 if slot is free
+    void*        remoteFree;        // Blocks freed by other threads, any size class
+    mem_bin_t    bins[MEM_CACHE_NUM_CLASSES];
+    uint8_t      padding[64];       // Bins of neighbour threads are not on same cache line
+} mem_thread_cache_t;
+
+typedef struct mem_central_bin_t
+{
+    SDL_SpinLock lock;
+    uint32_t     count;
+    void*        head;
+} mem_central_bin_t;
+
+struct mem_cache_internal_t
+{
+    mspace_t           mspace;
+    mem_tag_t          tag;
+    int                id;
+
+    SDL_SpinLock       spansLock;
+    mem_span_t*        spans;
+
+    mem_central_bin_t  central[MEM_CACHE_NUM_CLASSES];
+    mem_thread_cache_t threads[MEM_CACHE_MAX_THREADS];
+};
+
+static SDL_atomic_t memThreadIds;
+static SDL_atomic_t memCacheIds;
+
+static CORE_THREAD_LOCAL int                 memThreadId;
+static CORE_THREAD_LOCAL int                 memLastCacheId;
+static CORE_THREAD_LOCAL mem_thread_cache_t* memLastThreadCache;
+
+static uint32_t mem_cache_class(size_t size)
+{
+    return memCacheClasses[(size + 15) / 16];
+}
+
+static mem_span_t* mem_cache_span(void* block)
+{
+    return (mem_span_t*)((uintptr_t)block & ~(uintptr_t)(MEM_CACHE_SPAN_SIZE - 1));
+}
+
+mem_cache_t mem_create_cache(mspace_t mspace, mem_tag_t tag)
+{
+    assert(mspace);
+
+    mem_cache_t cache = (mem_cache_t)mspace_malloc2(mspace, sizeof(struct mem_cache_internal_t), 64, 0);
+    if (!cache) return 0;
+
+    memset(cache, 0, sizeof(struct mem_cache_internal_t));
+
+    cache->mspace = mspace;
+    cache->tag    = tag;
+    cache->id     = SDL_AtomicAdd(&memCacheIds, 1) + 1;
+
+    return cache;
+}
+
+void mem_destroy_cache(mem_cache_t cache)
+{
+    assert(cache);
+
+    mem_span_t* span = cache->spans;
+    while (span)
+    {
+        mem_span_t* next = span->next;
+        mspace_free(cache->mspace, span);
+        mem_tag_account(cache->mspace, cache->tag, -MEM_CACHE_SPAN_SIZE);
+        span = next;
+    }
+
+    mspace_free(cache->mspace, cache);
+}
+
+// Slot of calling thread, slot is taken on first use, 0 if all slots are taken
+static mem_thread_cache_t* mem_cache_thread(mem_cache_t cache, int claim)
+{
+    if (memLastCacheId == cache->id) return memLastThreadCache;
+
+    if (!memThreadId)
+    {
+        memThreadId = SDL_AtomicAdd(&memThreadIds, 1) + 1;
+    }
+
+    mem_thread_cache_t* thread = 0;
+
+    for (size_t i = 0; i < MEM_CACHE_MAX_THREADS && !thread; ++i)
+    {
+        if (SDL_AtomicGet(&cache->threads[i].thread) == memThreadId) thread = &cache->threads[i];
+    }
+
+    for (size_t i = 0; i < MEM_CACHE_MAX_THREADS && !thread && claim; ++i)
+    {
+        if (SDL_AtomicCAS(&cache->threads[i].thread, 0, memThreadId)) thread = &cache->threads[i];
+    }
+
+    if (thread)
+    {
+        memLastCacheId     = cache->id;
+        memLastThreadCache = thread;
+    }
+
+    return thread;
+}
+
+// Central bin should be locked
+static int mem_cache_add_span(mem_cache_t cache, uint32_t sizeClass, uint32_t owner)
+{
+    mem_span_t* span = (mem_span_t*)mspace_malloc2(cache->mspace, MEM_CACHE_SPAN_SIZE, MEM_CACHE_SPAN_SIZE, 0);
+    if (!span) return 0;
+
+    mem_tag_account(cache->mspace, cache->tag, MEM_CACHE_SPAN_SIZE);
+
+    span->sizeClass = sizeClass;
+    span->owner     = owner;
+
+    SDL_AtomicLock(&cache->spansLock);
+    span->next   = cache->spans;
+    cache->spans = span;
+    SDL_AtomicUnlock(&cache->spansLock);
+
+    mem_central_bin_t* central = &cache->central[sizeClass];
+
+    uint32_t size  = memCacheClassSizes[sizeClass];
+    uint32_t count = (MEM_CACHE_SPAN_SIZE - MEM_CACHE_SPAN_HEADER) / size;
+    uint8_t* first = (uint8_t*)span + MEM_CACHE_SPAN_HEADER;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        *(void**)(first + i*size) = i + 1 < count ? first + (i + 1)*size : central->head;
+    }
+
+    central->head   = first;
+    central->count += count;
+
+    return 1;
+}
+
+// Moves up to maxCount blocks from central bin, carves new span if central bin is empty
+static uint32_t mem_cache_take(mem_cache_t cache, uint32_t sizeClass, uint32_t owner, uint32_t maxCount, void** head)
+{
+    mem_central_bin_t* central = &cache->central[sizeClass];
+    uint32_t           count   = 0;
+
+    SDL_AtomicLock(&central->lock);
+
+    if (central->head || mem_cache_add_span(cache, sizeClass, owner))
+    {
+        void*  first = central->head;
+        void** tail  = &central->head;
+
+        while (*tail && count < maxCount)
+        {
+            tail = (void**)*tail;
+            ++count;
+        }
+
+        central->head   = *tail;
+        central->count -= count;
+
+        *tail = 0;
+        *head = first;
+    }
+
+    SDL_AtomicUnlock(&central->lock);
+
+    return count;
+}
+
+// Moves first count blocks of list to central bin
+static void mem_cache_give(mem_cache_t cache, uint32_t sizeClass, void* head, uint32_t count)
+{
+    mem_central_bin_t* central = &cache->central[sizeClass];
+
+    if (!count) return;
+
+    void** tail = (void**)head;
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        tail = (void**)*tail;
+    }
+
+    SDL_AtomicLock(&central->lock);
+    *tail           = central->head;
+    central->head   = head;
+    central->count += count;
+    SDL_AtomicUnlock(&central->lock);
+}
+
+static void mem_bin_push(mem_bin_t* bin, void* block)
+{
+    *(void**)block = bin->head;
+    bin->head      = block;
+    ++bin->count;
+}
+
+static void mem_cache_drain_remote(mem_thread_cache_t* thread)
+{
+    if (!SDL_AtomicGetPtr(&thread->remoteFree)) return;
+
+    void* block = SDL_AtomicSetPtr(&thread->remoteFree, 0);
+
+    while (block)
+    {
+        void* next = *(void**)block;
+        mem_bin_push(&thread->bins[mem_cache_span(block)->sizeClass], block);
+        block = next;
+    }
+}
+
+// Remote list of released slot goes to central bins, concurrent callers take disjoint lists
+static void mem_cache_return_remote(mem_cache_t cache, mem_thread_cache_t* thread)
+{
+    void* block = SDL_AtomicSetPtr(&thread->remoteFree, 0);
+
+    while (block)
+    {
+        void* next = *(void**)block;
+        mem_cache_give(cache, mem_cache_span(block)->sizeClass, block, 1);
+        block = next;
+    }
+}
+
+void* mem_cache_alloc(mem_cache_t cache, size_t size)
+{
+    assert(cache);
+
+    if (size > MEM_CACHE_MAX_SIZE)
+    {
+        return mem_alloc_tagged(cache->mspace, size, 16, cache->tag);
+    }
+
+    uint32_t            sizeClass = mem_cache_class(size);
+    mem_thread_cache_t* thread    = mem_cache_thread(cache, 1);
+    void*               block     = 0;
+
+    if (!thread)
+    {
+        mem_cache_take(cache, sizeClass, 0, 1, &block);
+        return block;
+    }
+
+    mem_bin_t* bin = &thread->bins[sizeClass];
+
+    if (!bin->head)
+    {
+        mem_cache_drain_remote(thread);
+    }
+
+    if (!bin->head)
+    {
+        uint32_t owner = (uint32_t)(thread - cache->threads) + 1;
+        bin->count = mem_cache_take(cache, sizeClass, owner, MEM_CACHE_BATCH, &bin->head);
+        if (!bin->count) return 0;
+    }
+
+    block     = bin->head;
+    bin->head = *(void**)block;
+    --bin->count;
+
+    return block;
+}
+
+void mem_cache_free(mem_cache_t cache, void* ptr, size_t size)
+{
+    assert(cache);
+
+    if (!ptr) return;
+
+    if (size > MEM_CACHE_MAX_SIZE)
+    {
+        mem_free(cache->mspace, ptr);
+        return;
+    }
+
+    mem_span_t* span = mem_cache_span(ptr);
+    assert(span->sizeClass == mem_cache_class(size) && "Size does not match allocation");
+
+    mem_thread_cache_t* thread = mem_cache_thread(cache, 0);
+
+    if (thread && span->owner == (uint32_t)(thread - cache->threads) + 1)
+    {
+        mem_bin_t* bin = &thread->bins[span->sizeClass];
+
+        mem_bin_push(bin, ptr);
+
+        if (bin->count > 2*MEM_CACHE_BATCH)
+        {
+            void* head = bin->head;
+            for (uint32_t i = 0; i < MEM_CACHE_BATCH; ++i)
+            {
+                bin->head = *(void**)bin->head;
+            }
+            bin->count -= MEM_CACHE_BATCH;
+
+            mem_cache_give(cache, span->sizeClass, head, MEM_CACHE_BATCH);
+        }
+    }
+    else if (span->owner)
+    {
+        mem_thread_cache_t* owner = &cache->threads[span->owner - 1];
+        void*               head;
+
+        do
+        {
+            head = SDL_AtomicGetPtr(&owner->remoteFree);
+            *(void**)ptr = head;
+        }
+        while (!SDL_AtomicCASPtr(&owner->remoteFree, head, ptr));
+
+        // Owner flushed, nobody drains remote list until slot is claimed again
+        if (!SDL_AtomicGet(&owner->thread)) mem_cache_return_remote(cache, owner);
+    }
+    else
+    {
+        mem_cache_give(cache, span->sizeClass, ptr, 1);
+    }
+}
+
+void mem_cache_flush(mem_cache_t cache)
+{
+    assert(cache);
+
+    mem_thread_cache_t* thread = mem_cache_thread(cache, 0);
+    if (!thread) return;
+
+    mem_cache_drain_remote(thread);
+
+    for (uint32_t i = 0; i < MEM_CACHE_NUM_CLASSES; ++i)
+    {
+        mem_cache_give(cache, i, thread->bins[i].head, thread->bins[i].count);
+        thread->bins[i].head  = 0;
+        thread->bins[i].count = 0;
+    }
+
+    SDL_AtomicSet(&thread->thread, 0);
+
+    // Blocks freed by other threads before slot was released
+    mem_cache_return_remote(cache, thread);
+
+    memLastCacheId     = 0;
+    memLastThreadCache = 0;
+}
@@ -1,46 +1,123 @@
-void mem_set(void *dest, size_t len, uint8_t value)
-{
-    uint8_t *dp = (uint8_t*)dest;
-    size_t tlen = len;
-
-    if (tlen)  do { *dp++ = value; } while(--tlen);
-}
-
-void mem_set8(uint8_t *dp, size_t len, uint8_t value)
+// Vectorized memory fill and copy. Sizes are split into classes:
+//   small  (<= 16 bytes)  - overlapping scalar loads/stores, no loops
+//   medium (<= 4 vectors) - overlapping unaligned vector loads/stores
+//   large                 - destination aligned loop, head and tail are
+//                           handled by overlapping unaligned stores
+// All loads of a step are issued before its stores, so the same code is used
+// for overlapping moves. Implementation is selected on first call, AVX2 is used
+// when both CPU and OS support it.
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#   define MEM_UTILS_X86 1
+#   include <emmintrin.h>
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#       define MEM_TARGET_AVX2
+#   else
+#       include <cpuid.h>
+#       define MEM_TARGET_AVX2 __attribute__((target("avx2")))
+#   endif
+#else
+#   define MEM_UTILS_X86 0
+#endif
+
+typedef void (*mem_move_func_t)(void* dest, const void* src, size_t len);
+typedef void (*mem_fill_func_t)(void* dest, size_t len, uint32_t pattern);
+
+static void mem_move_resolve  (void* dest, const void* src, size_t len);
+static void mem_stream_resolve(void* dest, const void* src, size_t len);
+static void mem_fill_resolve  (void* dest, size_t len, uint32_t pattern);
+
+static mem_move_func_t mem_move_impl   = mem_move_resolve;
+static mem_move_func_t mem_stream_impl = mem_stream_resolve;
+static mem_fill_func_t mem_fill_impl   = mem_fill_resolve;
+static int             mem_isa         = -1;
+
+// Streaming pays off only when data does not fit in cache anyway
+static const size_t MEM_STREAM_THRESHOLD = 16*1024;
+
+static uint64_t mem_load64(const uint8_t* p)  { uint64_t v; memcpy(&v, p, 8); return v; }
+static uint32_t mem_load32(const uint8_t* p)  { uint32_t v; memcpy(&v, p, 4); return v; }
+static uint16_t mem_load16(const uint8_t* p)  { uint16_t v; memcpy(&v, p, 2); return v; }
+static void mem_store64(uint8_t* p, uint64_t v) { memcpy(p, &v, 8); }
+static void mem_store32(uint8_t* p, uint32_t v) { memcpy(p, &v, 4); }
+static void mem_store16(uint8_t* p, uint16_t v) { memcpy(p, &v, 2); }
+
+static void mem_move_small(uint8_t* dp, const uint8_t* sp, size_t len)
 {
-    size_t tlen = len;
+    assert(len <= 16);
 
-    if (tlen)  do { *dp++ = value; } while(--tlen);
+    if (len >= 8)
+    {
+        uint64_t head = mem_load64(sp), tail = mem_load64(sp + len - 8);
+        mem_store64(dp, head);
+        mem_store64(dp + len - 8, tail);
+    }
+    else if (len >= 4)
+    {
+        uint32_t head = mem_load32(sp), tail = mem_load32(sp + len - 4);
+        mem_store32(dp, head);
+        mem_store32(dp + len - 4, tail);
+    }
+    else if (len >= 2)
+    {
+        uint16_t head = mem_load16(sp), tail = mem_load16(sp + len - 2);
+        mem_store16(dp, head);
+        mem_store16(dp + len - 2, tail);
+    }
+    else if (len == 1)
+    {
+        *dp = *sp;
+    }
 }
 
-void mem_set16(uint16_t *dp, size_t len, uint16_t value)
+// Pattern is 32-bit replicated value, len is multiple of element size and
+// all stores are at offsets multiple of element size.
+static void mem_fill_small(uint8_t* dp, size_t len, uint32_t pattern)
 {
-    size_t tlen = len;
+    assert(len <= 16);
 
-    if (tlen)  do { *dp++ = value; } while(--tlen);
-}
-
-
-void mem_set32(uint32_t *dp, size_t len, uint32_t value)
-{
-    size_t tlen = len;
+    uint64_t pattern64 = ((uint64_t)pattern << 32) | pattern;
 
-    if (tlen)  do { *dp++ = value; } while(--tlen);
+    if (len >= 8)
+    {
+        mem_store64(dp, pattern64);
+        mem_store64(dp + len - 8, pattern64);
+    }
+    else if (len >= 4)
+    {
+        mem_store32(dp, pattern);
+        mem_store32(dp + len - 4, pattern);
+    }
+    else if (len >= 2)
+    {
+        mem_store16(dp, (uint16_t)pattern);
+        mem_store16(dp + len - 2, (uint16_t)pattern);
+    }
+    else if (len == 1)
+    {
+        *dp = (uint8_t)pattern;
+    }
 }
 
-void mem_move(void *dest, const void *src, size_t len)
+static void mem_move_scalar(void* dest, const void* src, size_t len)
 {
     const uint8_t*  sp = (const uint8_t*)src;
     uint8_t*        dp = (uint8_t*)dest;
 
-    uint32_t tlen = len;
+    if (len <= 16)
+    {
+        mem_move_small(dp, sp, len);
+        return;
+    }
 
-    if (tlen == 0) return;
-    
     //  Determine if we need to copy forward or backward (overlap)
     if ((uintptr_t)dp < (uintptr_t)sp) {
         //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
+        do { *dp++ = *sp++; } while(--len);
     } else {
         //  Copy backwards,
 
@@ -48,94 +125,539 @@ void mem_move(void *dest, const void *src, size_t len)
         sp += len;
         dp += len;
 
-        do { *--dp = *--sp; } while (--tlen);
+        do { *--dp = *--sp; } while (--len);
     }
 }
 
+static void mem_fill_scalar(void* dest, size_t len, uint32_t pattern)
+{
+    uint8_t* dp = (uint8_t*)dest;
 
-void mem_move8(uint8_t *dp, const uint8_t *sp, size_t len)
+    while (len > 16)
+    {
+        mem_fill_small(dp, 16, pattern);
+        dp  += 16;
+        len -= 16;
+    }
+
+    mem_fill_small(dp, len, pattern);
+}
+
+#if MEM_UTILS_X86
+
+static void mem_move_sse2(void* dest, const void* src, size_t len)
 {
-    uint32_t tlen = len;
+    const uint8_t*  sp = (const uint8_t*)src;
+    uint8_t*        dp = (uint8_t*)dest;
 
-    if (tlen == 0) return;
+    if (len <= 16)
+    {
+        mem_move_small(dp, sp, len);
+        return;
+    }
 
-    //  Determine if we need to copy forward or backward (overlap)
-    if (dp < sp) {
-        //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
-    } else {
-        //  Copy backwards,
+    if (len <= 32)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)sp);
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(sp + len - 16));
+        _mm_storeu_si128((__m128i*)dp, v0);
+        _mm_storeu_si128((__m128i*)(dp + len - 16), v1);
+        return;
+    }
 
-        //go to end of the memory to copy
-        sp += len;
-        dp += len;
+    if (len <= 64)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)sp);
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(sp + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(sp + len - 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(sp + len - 16));
+        _mm_storeu_si128((__m128i*)dp, v0);
+        _mm_storeu_si128((__m128i*)(dp + 16), v1);
+        _mm_storeu_si128((__m128i*)(dp + len - 32), v2);
+        _mm_storeu_si128((__m128i*)(dp + len - 16), v3);
+        return;
+    }
 
-        do { *--dp = *--sp; } while (--tlen);
+    // Head and tail are loaded before the loop can overwrite them
+    __m128i head = _mm_loadu_si128((const __m128i*)sp);
+    __m128i tail = _mm_loadu_si128((const __m128i*)(sp + len - 16));
+
+    if ((uintptr_t)dp - (uintptr_t)sp >= len)
+    {
+        // Forward, destination is before source or does not overlap it
+        size_t   skip = 16 - ((uintptr_t)dp & 15);
+        uint8_t* end  = dp + len - 16;
+
+        const uint8_t* s = sp + skip;
+        uint8_t*       d = dp + skip;
+
+        for (; d + 64 <= end; s += 64, d += 64)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)s);
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(s + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i*)(s + 32));
+            __m128i v3 = _mm_loadu_si128((const __m128i*)(s + 48));
+            _mm_store_si128((__m128i*)d, v0);
+            _mm_store_si128((__m128i*)(d + 16), v1);
+            _mm_store_si128((__m128i*)(d + 32), v2);
+            _mm_store_si128((__m128i*)(d + 48), v3);
+        }
+
+        for (; d < end; s += 16, d += 16)
+        {
+            _mm_store_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+        }
     }
+    else
+    {
+        // Backward, destination overlaps end of source
+        size_t   skip = (uintptr_t)(dp + len) & 15;
+        uint8_t* begin = dp + 16;
+
+        const uint8_t* s = sp + len - skip;
+        uint8_t*       d = dp + len - skip;
+
+        for (; d - 64 >= begin; )
+        {
+            s -= 64;
+            d -= 64;
+            __m128i v3 = _mm_loadu_si128((const __m128i*)(s + 48));
+            __m128i v2 = _mm_loadu_si128((const __m128i*)(s + 32));
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(s + 16));
+            __m128i v0 = _mm_loadu_si128((const __m128i*)s);
+            _mm_store_si128((__m128i*)(d + 48), v3);
+            _mm_store_si128((__m128i*)(d + 32), v2);
+            _mm_store_si128((__m128i*)(d + 16), v1);
+            _mm_store_si128((__m128i*)d, v0);
+        }
+
+        for (; d > begin; )
+        {
+            s -= 16;
+            d -= 16;
+            _mm_store_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+        }
+    }
+
+    _mm_storeu_si128((__m128i*)dp, head);
+    _mm_storeu_si128((__m128i*)(dp + len - 16), tail);
 }
 
+static void mem_fill_sse2(void* dest, size_t len, uint32_t pattern)
+{
+    uint8_t* dp = (uint8_t*)dest;
 
-void mem_move16(uint16_t *dp, const uint16_t *sp, size_t len)
+    if (len <= 16)
+    {
+        mem_fill_small(dp, len, pattern);
+        return;
+    }
+
+    __m128i v = _mm_set1_epi32((int)pattern);
+
+    _mm_storeu_si128((__m128i*)dp, v);
+    _mm_storeu_si128((__m128i*)(dp + len - 16), v);
+
+    if (len <= 32) return;
+
+    uint8_t* d   = (uint8_t*)(((uintptr_t)dp + 16) & ~(uintptr_t)15);
+    uint8_t* end = dp + len - 16;
+
+    for (; d + 64 <= end; d += 64)
+    {
+        _mm_store_si128((__m128i*)d, v);
+        _mm_store_si128((__m128i*)(d + 16), v);
+        _mm_store_si128((__m128i*)(d + 32), v);
+        _mm_store_si128((__m128i*)(d + 48), v);
+    }
+
+    for (; d < end; d += 16)
+    {
+        _mm_store_si128((__m128i*)d, v);
+    }
+}
+
+// Destination is write-only, does not overlap source
+static void mem_stream_sse2(void* dest, const void* src, size_t len)
 {
-    uint32_t tlen = len;
+    if (len < MEM_STREAM_THRESHOLD)
+    {
+        mem_move_sse2(dest, src, len);
+        return;
+    }
 
-    if (tlen == 0) return;
+    const uint8_t*  sp = (const uint8_t*)src;
+    uint8_t*        dp = (uint8_t*)dest;
 
-    //  Determine if we need to copy forward or backward (overlap)
-    if (dp < sp) {
-        //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
-    } else {
-        //  Copy backwards,
+    size_t   skip = 16 - ((uintptr_t)dp & 15);
+    uint8_t* end  = dp + len - 16;
 
-        //go to end of the memory to copy
-        sp += len;
-        dp += len;
+    _mm_storeu_si128((__m128i*)dp, _mm_loadu_si128((const __m128i*)sp));
+
+    const uint8_t* s = sp + skip;
+    uint8_t*       d = dp + skip;
+
+    for (; d + 64 <= end; s += 64, d += 64)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)s);
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_stream_si128((__m128i*)d, v0);
+        _mm_stream_si128((__m128i*)(d + 16), v1);
+        _mm_stream_si128((__m128i*)(d + 32), v2);
+        _mm_stream_si128((__m128i*)(d + 48), v3);
+    }
 
-        do { *--dp = *--sp; } while (--tlen);
+    for (; d < end; s += 16, d += 16)
+    {
+        _mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
     }
 
+    _mm_sfence();
+
+    _mm_storeu_si128((__m128i*)end, _mm_loadu_si128((const __m128i*)(sp + len - 16)));
 }
 
+MEM_TARGET_AVX2 static void mem_move_avx2(void* dest, const void* src, size_t len)
+{
+    const uint8_t*  sp = (const uint8_t*)src;
+    uint8_t*        dp = (uint8_t*)dest;
 
-void mem_move32(uint32_t *dp, const uint32_t *sp, size_t len)
+    if (len <= 32)
+    {
+        mem_move_sse2(dp, sp, len);
+        return;
+    }
+
+    if (len <= 64)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)sp);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(sp + len - 32));
+        _mm256_storeu_si256((__m256i*)dp, v0);
+        _mm256_storeu_si256((__m256i*)(dp + len - 32), v1);
+        _mm256_zeroupper();
+        return;
+    }
+
+    if (len <= 128)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)sp);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(sp + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(sp + len - 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*)(sp + len - 32));
+        _mm256_storeu_si256((__m256i*)dp, v0);
+        _mm256_storeu_si256((__m256i*)(dp + 32), v1);
+        _mm256_storeu_si256((__m256i*)(dp + len - 64), v2);
+        _mm256_storeu_si256((__m256i*)(dp + len - 32), v3);
+        _mm256_zeroupper();
+        return;
+    }
+
+    __m256i head = _mm256_loadu_si256((const __m256i*)sp);
+    __m256i tail = _mm256_loadu_si256((const __m256i*)(sp + len - 32));
+
+    if ((uintptr_t)dp - (uintptr_t)sp >= len)
+    {
+        size_t   skip = 32 - ((uintptr_t)dp & 31);
+        uint8_t* end  = dp + len - 32;
+
+        const uint8_t* s = sp + skip;
+        uint8_t*       d = dp + skip;
+
+        for (; d + 128 <= end; s += 128, d += 128)
+        {
+            __m256i v0 = _mm256_loadu_si256((const __m256i*)s);
+            __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+            __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+            __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+            _mm256_store_si256((__m256i*)d, v0);
+            _mm256_store_si256((__m256i*)(d + 32), v1);
+            _mm256_store_si256((__m256i*)(d + 64), v2);
+            _mm256_store_si256((__m256i*)(d + 96), v3);
+        }
+
+        for (; d < end; s += 32, d += 32)
+        {
+            _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+        }
+    }
+    else
+    {
+        size_t   skip  = (uintptr_t)(dp + len) & 31;
+        uint8_t* begin = dp + 32;
+
+        const uint8_t* s = sp + len - skip;
+        uint8_t*       d = dp + len - skip;
+
+        for (; d - 128 >= begin; )
+        {
+            s -= 128;
+            d -= 128;
+            __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+            __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+            __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+            __m256i v0 = _mm256_loadu_si256((const __m256i*)s);
+            _mm256_store_si256((__m256i*)(d + 96), v3);
+            _mm256_store_si256((__m256i*)(d + 64), v2);
+            _mm256_store_si256((__m256i*)(d + 32), v1);
+            _mm256_store_si256((__m256i*)d, v0);
+        }
+
+        for (; d > begin; )
+        {
+            s -= 32;
+            d -= 32;
+            _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+        }
+    }
+
+    _mm256_storeu_si256((__m256i*)dp, head);
+    _mm256_storeu_si256((__m256i*)(dp + len - 32), tail);
+    _mm256_zeroupper();
+}
+
+MEM_TARGET_AVX2 static void mem_fill_avx2(void* dest, size_t len, uint32_t pattern)
 {
-    uint32_t tlen = len;
+    uint8_t* dp = (uint8_t*)dest;
 
-    if (tlen == 0) return;
+    if (len <= 32)
+    {
+        mem_fill_sse2(dp, len, pattern);
+        return;
+    }
 
-    //  Determine if we need to copy forward or backward (overlap)
-    if (dp < sp) {
-        //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
-    } else {
-        //  Copy backwards,
+    __m256i v = _mm256_set1_epi32((int)pattern);
 
-        //go to end of the memory to copy
-        sp += len;
-        dp += len;
+    _mm256_storeu_si256((__m256i*)dp, v);
+    _mm256_storeu_si256((__m256i*)(dp + len - 32), v);
+
+    uint8_t* d   = (uint8_t*)(((uintptr_t)dp + 32) & ~(uintptr_t)31);
+    uint8_t* end = dp + len - 32;
 
-        do { *--dp = *--sp; } while (--tlen);
+    for (; d + 128 <= end; d += 128)
+    {
+        _mm256_store_si256((__m256i*)d, v);
+        _mm256_store_si256((__m256i*)(d + 32), v);
+        _mm256_store_si256((__m256i*)(d + 64), v);
+        _mm256_store_si256((__m256i*)(d + 96), v);
     }
 
+    for (; d < end; d += 32)
+    {
+        _mm256_store_si256((__m256i*)d, v);
+    }
+
+    _mm256_zeroupper();
+}
+
+MEM_TARGET_AVX2 static void mem_stream_avx2(void* dest, const void* src, size_t len)
+{
+    if (len < MEM_STREAM_THRESHOLD)
+    {
+        mem_move_avx2(dest, src, len);
+        return;
+    }
+
+    const uint8_t*  sp = (const uint8_t*)src;
+    uint8_t*        dp = (uint8_t*)dest;
+
+    size_t   skip = 32 - ((uintptr_t)dp & 31);
+    uint8_t* end  = dp + len - 32;
+
+    _mm256_storeu_si256((__m256i*)dp, _mm256_loadu_si256((const __m256i*)sp));
+
+    const uint8_t* s = sp + skip;
+    uint8_t*       d = dp + skip;
+
+    for (; d + 128 <= end; s += 128, d += 128)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)s);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+        _mm256_stream_si256((__m256i*)d, v0);
+        _mm256_stream_si256((__m256i*)(d + 32), v1);
+        _mm256_stream_si256((__m256i*)(d + 64), v2);
+        _mm256_stream_si256((__m256i*)(d + 96), v3);
+    }
+
+    for (; d < end; s += 32, d += 32)
+    {
+        _mm256_stream_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+    }
+
+    _mm_sfence();
+
+    _mm256_storeu_si256((__m256i*)end, _mm256_loadu_si256((const __m256i*)(sp + len - 32)));
+    _mm256_zeroupper();
+}
+
+static int mem_cpu_has_avx2()
+{
+    unsigned int info[4] = {0};
+
+#if defined(_MSC_VER)
+    __cpuid((int*)info, 0);
+    if (info[0] < 7) return 0;
+
+    __cpuid((int*)info, 1);
+#else
+    if (__get_cpuid_max(0, 0) < 7) return 0;
+
+    __cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+
+    // AVX and OSXSAVE
+    if ((info[2] & (1<<27)) == 0 || (info[2] & (1<<28)) == 0) return 0;
+
+    // OS saves XMM and YMM state on context switch
+#if defined(_MSC_VER)
+    uint64_t xcr0 = _xgetbv(0);
+#else
+    uint32_t xcr0lo, xcr0hi;
+    __asm__ __volatile__ ("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+    uint64_t xcr0 = ((uint64_t)xcr0hi << 32) | xcr0lo;
+#endif
+    if ((xcr0 & 6) != 6) return 0;
+
+#if defined(_MSC_VER)
+    __cpuidex((int*)info, 7, 0);
+#else
+    __cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+#endif
+
+    return (info[1] & (1<<5)) != 0;
+}
+
+#endif
+
+int mem_utils_select_isa(int isa)
+{
+#if MEM_UTILS_X86
+    int supported = mem_cpu_has_avx2() ? MEM_ISA_AVX2 : MEM_ISA_SSE2;
+#else
+    int supported = MEM_ISA_SCALAR;
+#endif
+
+    isa = isa < 0 || isa > supported ? supported : isa;
+
+    switch (isa)
+    {
+#if MEM_UTILS_X86
+    case MEM_ISA_AVX2:
+        mem_move_impl   = mem_move_avx2;
+        mem_stream_impl = mem_stream_avx2;
+        mem_fill_impl   = mem_fill_avx2;
+        break;
+    case MEM_ISA_SSE2:
+        mem_move_impl   = mem_move_sse2;
+        mem_stream_impl = mem_stream_sse2;
+        mem_fill_impl   = mem_fill_sse2;
+        break;
+#endif
+    default:
+        mem_move_impl   = mem_move_scalar;
+        mem_stream_impl = mem_move_scalar;
+        mem_fill_impl   = mem_fill_scalar;
+        break;
+    }
+
+    mem_isa = isa;
+
+    return isa;
+}
+
+int mem_utils_isa()
+{
+    if (mem_isa < 0)
+    {
+        mem_utils_select_isa(-1);
+    }
+
+    return mem_isa;
+}
+
+// Selection is idempotent, so racing first calls are harmless
+static void mem_move_resolve(void* dest, const void* src, size_t len)
+{
+    mem_utils_select_isa(-1);
+    mem_move_impl(dest, src, len);
+}
+
+static void mem_stream_resolve(void* dest, const void* src, size_t len)
+{
+    mem_utils_select_isa(-1);
+    mem_stream_impl(dest, src, len);
+}
+
+static void mem_fill_resolve(void* dest, size_t len, uint32_t pattern)
+{
+    mem_utils_select_isa(-1);
+    mem_fill_impl(dest, len, pattern);
+}
+
+void mem_set(void *dest, size_t len, uint8_t value)
+{
+    mem_fill_impl(dest, len, value * 0x01010101u);
+}
+
+void mem_set8(uint8_t *dp, size_t len, uint8_t value)
+{
+    mem_fill_impl(dp, len, value * 0x01010101u);
+}
+
+void mem_set16(uint16_t *dp, size_t len, uint16_t value)
+{
+    mem_fill_impl(dp, len * sizeof(uint16_t), value * 0x00010001u);
+}
+
+void mem_set32(uint32_t *dp, size_t len, uint32_t value)
+{
+    mem_fill_impl(dp, len * sizeof(uint32_t), value);
+}
+
+void mem_move(void *dest, const void *src, size_t len)
+{
+    mem_move_impl(dest, src, len);
+}
+
+void mem_move8(uint8_t *dp, const uint8_t *sp, size_t len)
+{
+    mem_move_impl(dp, sp, len);
+}
+
+void mem_move16(uint16_t *dp, const uint16_t *sp, size_t len)
+{
+    mem_move_impl(dp, sp, len * sizeof(uint16_t));
+}
+
+void mem_move32(uint32_t *dp, const uint32_t *sp, size_t len)
+{
+    mem_move_impl(dp, sp, len * sizeof(uint32_t));
 }
 
 void mem_copy(void *dest, const void *src, size_t len)
 {
-    mem_move(dest, src, len);
+    mem_move_impl(dest, src, len);
 }
 
 void mem_copy8(uint8_t *dp, const uint8_t *sp, size_t len)
 {
-    mem_move8(dp, sp, len);
+    mem_move_impl(dp, sp, len);
 }
 
 void mem_copy16(uint16_t *dp, const uint16_t *sp, size_t len)
 {
-    mem_move16(dp, dp, len);
+    mem_move_impl(dp, sp, len * sizeof(uint16_t));
 }
 
 void mem_copy32(uint32_t *dp, const uint32_t *sp, size_t len)
 {
-    mem_move32(dp, sp, len);
+    mem_move_impl(dp, sp, len * sizeof(uint32_t));
+}
+
+void mem_copy_stream(void *dest, const void *src, size_t len)
+{
+    mem_stream_impl(dest, src, len);
 }
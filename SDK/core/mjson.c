@@ -5,6 +5,21 @@
 
 #include "mjson.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#   define MJSON_X86 1
+#   include <emmintrin.h>
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#       define MJSON_TARGET_AVX2
+#   else
+#       include <cpuid.h>
+#       define MJSON_TARGET_AVX2 __attribute__((target("avx2")))
+#   endif
+#else
+#   define MJSON_X86 0
+#endif
+
 enum mjson_token_t
 {
     TOK_NONE,
@@ -38,6 +53,9 @@ struct _mjson_parser_t
     uint8_t* end;
     uint8_t* bjson;
     uint8_t* bjson_limit;
+    uint8_t* bjson_start;
+    mjson_realloc_t realloc_fn;     /* growable output if not NULL */
+    void*           user_data;
 };
 
 struct _mjson_entry_t
@@ -63,56 +81,103 @@ typedef struct _mjson_entry_t   mjson_entry_t;
 static void* parsectx_allocate_output(mjson_parser_t* ctx, ptrdiff_t size);
 
 static void parsectx_next_token    (mjson_parser_t* context);
+static void parsectx_next_token_re2c(mjson_parser_t* context);
 
+static int parse_document      (mjson_parser_t *context, mjson_element_t* top_element);
 static int parse_value_list    (mjson_parser_t *context);
 static int parse_key_value_pair(mjson_parser_t *context, int stop_token);
 
 static mjson_element_t next_element(mjson_element_t element);
 
+static mjson_element_t index_find_member(mjson_element_t dictionary, const char* name);
+static int             index_copy_element(mjson_parser_t* ctx, mjson_element_t element);
+static size_t          index_element_size(mjson_element_t element);
+static int             validate_element(mjson_element_t element, const uint8_t* end, int depth);
+
 int mjson_parse(const char *json_data, size_t json_data_size, void* storage_buf, size_t storage_buf_size, const mjson_entry_t** top_element)
 {
-    uint32_t* fourcc;
     mjson_parser_t c = {
         TOK_NONE, 0,
         (uint8_t*)json_data,   (uint8_t*)json_data + json_data_size,
-        (uint8_t*)storage_buf, (uint8_t*)storage_buf + storage_buf_size
+        (uint8_t*)storage_buf, (uint8_t*)storage_buf + storage_buf_size,
+        (uint8_t*)storage_buf, NULL, NULL
     };
-    int stop_token = TOK_NONE;
 
-    *top_element = 0;
+    return parse_document(&c, top_element);
+}
 
-    fourcc = (uint32_t*)parsectx_allocate_output(&c, (ptrdiff_t)sizeof(uint32_t));
+int mjson_parse_alloc(const char *json_data, size_t json_data_size, mjson_realloc_t realloc_fn, void* user_data, void** storage_buf, size_t* storage_buf_size, mjson_element_t* top_element)
+{
+    int result;
+    mjson_parser_t c = {
+        TOK_NONE, 0,
+        (uint8_t*)json_data,    (uint8_t*)json_data + json_data_size,
+        (uint8_t*)*storage_buf, (uint8_t*)*storage_buf + *storage_buf_size,
+        (uint8_t*)*storage_buf, realloc_fn, user_data
+    };
 
-    if (!fourcc) return 0;
+    assert(realloc_fn);
 
-    *fourcc = '23JB';
+    result = parse_document(&c, top_element);
+
+    *storage_buf      = c.bjson_start;
+    *storage_buf_size = c.bjson_limit - c.bjson_start;
 
+    return result;
+}
+
+size_t mjson_parse_size(const char *json_data, size_t json_data_size)
+{
+    mjson_parser_t c = {
+        TOK_NONE, 0,
+        (uint8_t*)json_data, (uint8_t*)json_data + json_data_size,
+        NULL, NULL, NULL, NULL, NULL
+    };
+    size_t size = sizeof(uint32_t);
+    size_t len;
+
+    /* only lexer is run, sizes of entries follow parse_* functions */
     parsectx_next_token(&c);
 
-    if (c.token == TOK_LEFT_BRACKET)
-    {
-        parsectx_next_token(&c);
-        if (!parse_value_list(&c))
-            return 0;
-    }
-    else
+    /* top level dictionary without braces */
+    if (c.token != TOK_LEFT_BRACKET && c.token != TOK_LEFT_CURLY_BRACKET)
+        size += sizeof(mjson_entry_t);
+
+    while (c.token != TOK_NONE)
     {
-        if (c.token == TOK_LEFT_CURLY_BRACKET)
+        switch (c.token)
         {
-            stop_token = TOK_RIGHT_CURLY_BRACKET;
-            parsectx_next_token(&c);
+            case TOK_NULL:
+            case TOK_FALSE:
+            case TOK_TRUE:
+                size += sizeof(uint32_t);
+                break;
+
+            case TOK_OCT_NUMBER:
+            case TOK_HEX_NUMBER:
+            case TOK_DEC_NUMBER:
+            case TOK_FLOAT_NUMBER:
+            case TOK_LEFT_BRACKET:
+            case TOK_LEFT_CURLY_BRACKET:
+                size += sizeof(mjson_entry_t);
+                break;
+
+            /* escaped string is never longer than source */
+            case TOK_IDENTIFIER:
+            case TOK_NOESC_STRING:
+            case TOK_STRING:
+                len   = c.next - c.start - (c.token == TOK_IDENTIFIER ? 0 : 2);
+                size += sizeof(mjson_entry_t) + ((len + 1 + 3) & ~(size_t)3);
+                break;
+
+            case TOK_INVALID:
+                return 0;
         }
 
-        if (!parse_key_value_pair(&c, stop_token))
-            return 0;
+        parsectx_next_token(&c);
     }
 
-    if (c.token != TOK_NONE)
-        return 0;
-
-    *top_element = (mjson_entry_t*)(fourcc + 1);
-
-    return 1;
+    return size;
 }
 
 mjson_element_t mjson_get_top_element(void* storage_buf, size_t storage_buf_size)
@@ -120,8 +185,17 @@ mjson_element_t mjson_get_top_element(void* storage_buf, size_t storage_buf_size
     mjson_element_t top = (mjson_element_t)storage_buf;
     
     RETURN_VAL_IF_FAIL(top, NULL);
+
+    /* storage written by mjson_parse starts with fourcc */
+    if (storage_buf_size >= sizeof(uint32_t) && *(const uint32_t*)storage_buf == '23JB')
+    {
+        top = (mjson_element_t)((const uint32_t*)storage_buf + 1);
+        storage_buf_size -= sizeof(uint32_t);
+    }
+
+    RETURN_VAL_IF_FAIL(storage_buf_size >= sizeof(mjson_entry_t), NULL);
     RETURN_VAL_IF_FAIL(top->id == MJSON_ID_DICT32 || top->id == MJSON_ID_ARRAY32, NULL);
-    RETURN_VAL_IF_FAIL(top->val_u32 <= storage_buf_size, NULL);
+    RETURN_VAL_IF_FAIL(top->val_u32 <= storage_buf_size - sizeof(mjson_entry_t), NULL);
     
     return top;
 }
@@ -163,13 +237,20 @@ mjson_element_t mjson_get_element(mjson_element_t array, int index)
 
 mjson_element_t mjson_get_member_first(mjson_element_t dictionary, mjson_element_t* value)
 {
+    mjson_element_t key;
+
     RETURN_VAL_IF_FAIL(dictionary, NULL);
     RETURN_VAL_IF_FAIL(dictionary->id == MJSON_ID_DICT32, NULL);
-    RETURN_VAL_IF_FAIL((dictionary+1)->id == MJSON_ID_UTF8_KEY32, NULL);
+
+    key = dictionary + 1;
+    if (key->id == MJSON_ID_INDEX32)
+        key = next_element(key);
+
+    RETURN_VAL_IF_FAIL(key->id == MJSON_ID_UTF8_KEY32, NULL);
     
-    *value = next_element(dictionary+1);
+    *value = next_element(key);
     
-    return dictionary + 1;
+    return key;
 }
 
 mjson_element_t mjson_get_member_next(mjson_element_t dictionary, mjson_element_t current_key, mjson_element_t* next_value)
@@ -196,13 +277,64 @@ mjson_element_t mjson_get_member_next(mjson_element_t dictionary, mjson_element_
 
 mjson_element_t mjson_get_member(mjson_element_t dictionary, const char* name)
 {
-    mjson_element_t key, result;
-    
+    mjson_element_t key, result = NULL;
+    size_t          len;
+
+    RETURN_VAL_IF_FAIL(dictionary, NULL);
+    RETURN_VAL_IF_FAIL(dictionary->id == MJSON_ID_DICT32, NULL);
+
+    if ((dictionary+1)->id == MJSON_ID_INDEX32)
+        return index_find_member(dictionary, name);
+
+    len = strlen(name);
     key = mjson_get_member_first(dictionary, &result);
-    while (key && strncmp(name, (char*)(key+1), key->val_u32) != 0)
-        result = mjson_get_member_next(dictionary, key, &result);
+    while (key && (key->val_u32 != len || memcmp(name, key+1, len) != 0))
+        key = mjson_get_member_next(dictionary, key, &result);
     
-    return result;
+    return key ? result : NULL;
+}
+
+int mjson_build_index(mjson_element_t top_element, void* storage_buf, size_t storage_buf_size, mjson_element_t* indexed_top)
+{
+    uint32_t* fourcc;
+    mjson_parser_t c = {
+        TOK_NONE, 0, 0, 0,
+        (uint8_t*)storage_buf, (uint8_t*)storage_buf + storage_buf_size,
+        (uint8_t*)storage_buf, NULL, NULL
+    };
+
+    *indexed_top = 0;
+
+    RETURN_VAL_IF_FAIL(top_element, 0);
+
+    fourcc = (uint32_t*)parsectx_allocate_output(&c, (ptrdiff_t)sizeof(uint32_t));
+
+    if (!fourcc) return 0;
+
+    *fourcc = '23JB';
+
+    if (!index_copy_element(&c, top_element))
+        return 0;
+
+    *indexed_top = (mjson_entry_t*)(fourcc + 1);
+
+    return 1;
+}
+
+int mjson_validate(void* storage_buf, size_t storage_buf_size)
+{
+    mjson_element_t top = mjson_get_top_element(storage_buf, storage_buf_size);
+
+    RETURN_VAL_IF_FAIL(top, 0);
+
+    return validate_element(top, (const uint8_t*)storage_buf + storage_buf_size, 0);
+}
+
+size_t mjson_build_index_size(mjson_element_t top_element)
+{
+    RETURN_VAL_IF_FAIL(top_element, 0);
+
+    return sizeof(uint32_t) + index_element_size(top_element);
 }
 
 int mjson_get_type(mjson_element_t element)
@@ -212,172 +344,1103 @@ int mjson_get_type(mjson_element_t element)
     return element->id;
 }
 
-const char* mjson_get_string(mjson_element_t element, const char* fallback)
+const char* mjson_get_string(mjson_element_t element, const char* fallback)
+{
+    RETURN_VAL_IF_FAIL(element, fallback);
+    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_UTF8_STRING32 ||
+                       element->id == MJSON_ID_UTF8_KEY32,
+                       fallback);
+    
+    return (const char*)(element+1);
+}
+
+int32_t mjson_get_int(mjson_element_t element, int32_t fallback)
+{
+    RETURN_VAL_IF_FAIL(element, fallback);
+    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_SINT32, fallback);
+    
+    return element->val_s32;
+}
+
+float mjson_get_float(mjson_element_t element, float fallback)
+{
+    RETURN_VAL_IF_FAIL(element, fallback);
+    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_FLOAT32, fallback);
+    
+    return element->val_f32;
+}
+
+int mjson_get_bool(mjson_element_t element, int fallback)
+{
+    RETURN_VAL_IF_FAIL(element, fallback);
+    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_TRUE || element->id == MJSON_ID_FALSE, fallback);
+    
+    return element->id == MJSON_ID_TRUE;
+}
+
+int mjson_is_null(mjson_element_t element)
+{
+    RETURN_VAL_IF_FAIL(element, TRUE);
+
+    return element->id == MJSON_ID_NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// API helpers
+/////////////////////////////////////////////////////////////////////////////
+
+static size_t element_size(mjson_element_t element)
+{
+    RETURN_VAL_IF_FAIL(element, 0);
+
+    switch(element->id)
+    {
+        case MJSON_ID_NULL:
+        case MJSON_ID_FALSE:
+        case MJSON_ID_EMPTY_STRING:
+        case MJSON_ID_TRUE:
+            return sizeof(uint32_t);
+
+        case MJSON_ID_UINT32:
+        case MJSON_ID_SINT32:
+        case MJSON_ID_FLOAT32:
+            return sizeof(mjson_entry_t);
+
+        case MJSON_ID_UTF8_KEY32:
+        case MJSON_ID_UTF8_STRING32:
+            return sizeof(mjson_entry_t) + ((element->val_u32 + 1 + 3) & (~3));
+
+        case MJSON_ID_BINARY32:
+        case MJSON_ID_ARRAY32:
+        case MJSON_ID_DICT32:
+        case MJSON_ID_INDEX32:
+            return sizeof(mjson_entry_t) + ((element->val_u32 + 3) & (~3));
+    };
+
+    return 0;
+}
+
+static mjson_element_t next_element(mjson_element_t element)
+{
+    size_t size;
+    
+    RETURN_VAL_IF_FAIL(element, 0);
+
+    size = element_size(element);
+    assert(size>0);
+    
+    return (mjson_element_t)((uint8_t*)element + size);
+}
+
+static ptrdiff_t parsectx_output_offset(mjson_parser_t* ctx, const void* ptr)
+{
+    return (const uint8_t*)ptr - ctx->bjson_start;
+}
+
+/* pointers to output are not valid after growing, offsets are kept instead */
+static int parsectx_grow_output(mjson_parser_t* ctx, ptrdiff_t size)
+{
+    ptrdiff_t used     = ctx->bjson - ctx->bjson_start;
+    size_t    capacity = ctx->bjson_limit - ctx->bjson_start;
+    uint8_t*  buffer;
+
+    if (!ctx->realloc_fn) return 0;
+
+    if (capacity < 256) capacity = 256;
+    while (capacity - used < (size_t)size) capacity *= 2;
+
+    buffer = (uint8_t*)ctx->realloc_fn(ctx->user_data, ctx->bjson_start, capacity);
+
+    if (!buffer) return 0;
+
+    ctx->bjson_start = buffer;
+    ctx->bjson       = buffer + used;
+    ctx->bjson_limit = buffer + capacity;
+
+    return 1;
+}
+
+static void* parsectx_reserve_output(mjson_parser_t* ctx, ptrdiff_t size)
+{
+    if (ctx->bjson_limit - ctx->bjson < size && !parsectx_grow_output(ctx, size))
+        return 0;
+
+    return ctx->bjson;
+}
+
+static void parsectx_advance_output(mjson_parser_t* ctx, ptrdiff_t size)
+{
+    ctx->bjson += size;
+}
+
+static void* parsectx_allocate_output(mjson_parser_t* ctx, ptrdiff_t size)
+{
+    void* ptr = parsectx_reserve_output(ctx, size);
+
+    if (ptr)
+        ctx->bjson += size;
+
+    return ptr;
+}
+
+static void parsectx_align4_output(mjson_parser_t* ctx)
+{
+    ptrdiff_t padding = -parsectx_output_offset(ctx, ctx->bjson) & 3;
+
+    /* padding is zeroed, so output does not depend on old storage contents.
+       padding past limit is not written, next allocation fails */
+    if (parsectx_reserve_output(ctx, padding))
+        memset(ctx->bjson, 0, padding);
+
+    ctx->bjson += padding;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Dictionary index
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ * index entry payload: capacity (power of 2) followed by open addressing table
+ * of {key hash, key offset from dictionary entry} pairs, zero offset marks empty slot.
+ * table is at most half full, so linear probing stays short.
+ */
+
+static uint32_t index_hash(const char* str, size_t len)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    size_t   i;
+
+    for (i = 0; i < len; ++i)
+    {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static mjson_element_t index_find_member(mjson_element_t dictionary, const char* name)
+{
+    const uint32_t* table = (const uint32_t*)(dictionary + 2);
+    uint32_t        mask  = table[0] - 1;
+    size_t          len   = strlen(name);
+    uint32_t        hash  = index_hash(name, len);
+    uint32_t        slot;
+
+    for (slot = hash & mask; table[1 + slot*2 + 1]; slot = (slot + 1) & mask)
+    {
+        mjson_element_t key;
+
+        if (table[1 + slot*2] != hash)
+            continue;
+
+        key = (mjson_element_t)((uint8_t*)dictionary + table[1 + slot*2 + 1]);
+        if (key->val_u32 == len && memcmp(name, key+1, len) == 0)
+            return next_element(key);
+    }
+
+    return NULL;
+}
+
+/* members are walked by range, index of source dictionary is skipped */
+static uint32_t index_count_members(mjson_element_t src, mjson_element_t* first, const uint8_t** end)
+{
+    mjson_element_t key;
+    uint32_t        count = 0;
+
+    *first = src + 1;
+    *end   = (const uint8_t*)(src + 1) + src->val_u32;
+
+    if ((const uint8_t*)*first < *end && (*first)->id == MJSON_ID_INDEX32)
+        *first = next_element(*first);
+
+    for (key = *first; (const uint8_t*)key < *end; key = next_element(next_element(key)))
+        ++count;
+
+    return count;
+}
+
+/* zero for dictionaries that are not indexed */
+static uint32_t index_capacity(uint32_t count)
+{
+    uint32_t capacity = 0;
+
+    if (count >= MJSON_INDEX_MIN_MEMBERS)
+        for (capacity = 1; capacity < count*2; capacity *= 2);
+
+    return capacity;
+}
+
+static int index_copy_dictionary(mjson_parser_t* ctx, mjson_element_t src)
+{
+    mjson_entry_t*  dictionary;
+    mjson_entry_t*  index = NULL;
+    uint32_t*       table = NULL;
+    uint8_t*        data_start;
+    mjson_element_t first, key, value;
+    const uint8_t*  end;
+    uint32_t        capacity, mask, slot, hash;
+    size_t          size;
+
+    capacity = index_capacity(index_count_members(src, &first, &end));
+
+    dictionary = (mjson_entry_t*)parsectx_allocate_output(ctx, sizeof(mjson_entry_t));
+
+    if (!dictionary) return 0;
+
+    dictionary->id = MJSON_ID_DICT32;
+    data_start     = ctx->bjson;
+
+    if (capacity)
+    {
+        index = (mjson_entry_t*)parsectx_allocate_output(ctx, sizeof(mjson_entry_t));
+        table = (uint32_t*)parsectx_allocate_output(ctx, (1 + capacity*2) * sizeof(uint32_t));
+
+        if (!index || !table) return 0;
+
+        index->id      = MJSON_ID_INDEX32;
+        index->val_u32 = (1 + capacity*2) * sizeof(uint32_t);
+
+        memset(table, 0, index->val_u32);
+        table[0] = capacity;
+    }
+
+    mask = capacity - 1;
+
+    for (key = first; (const uint8_t*)key < end; key = next_element(value))
+    {
+        uint32_t offset = (uint32_t)(ctx->bjson - (uint8_t*)dictionary);
+
+        size = element_size(key);
+        if (!parsectx_reserve_output(ctx, (ptrdiff_t)size)) return 0;
+        memcpy(ctx->bjson, key, size);
+        parsectx_advance_output(ctx, (ptrdiff_t)size);
+
+        value = next_element(key);
+
+        if (table)
+        {
+            hash = index_hash((const char*)(key+1), key->val_u32);
+
+            /* first of duplicated keys wins, as with linear search */
+            for (slot = hash & mask; table[1 + slot*2 + 1]; slot = (slot + 1) & mask)
+            {
+                mjson_element_t other = (mjson_element_t)((uint8_t*)dictionary + table[1 + slot*2 + 1]);
+
+                if (table[1 + slot*2] == hash && other->val_u32 == key->val_u32 &&
+                    memcmp(other+1, key+1, key->val_u32) == 0)
+                    break;
+            }
+
+            if (!table[1 + slot*2 + 1])
+            {
+                table[1 + slot*2]     = hash;
+                table[1 + slot*2 + 1] = offset;
+            }
+        }
+
+        if (!index_copy_element(ctx, value))
+            return 0;
+    }
+
+    dictionary->val_u32 = (uint32_t)(ctx->bjson - data_start);
+
+    return 1;
+}
+
+static int index_copy_element(mjson_parser_t* ctx, mjson_element_t element)
+{
+    mjson_entry_t*  array;
+    uint8_t*        data_start;
+    mjson_element_t value;
+    const uint8_t*  end;
+    size_t          size;
+
+    switch (element->id)
+    {
+        case MJSON_ID_DICT32:
+            return index_copy_dictionary(ctx, element);
+
+        case MJSON_ID_ARRAY32:
+            array = (mjson_entry_t*)parsectx_allocate_output(ctx, sizeof(mjson_entry_t));
+
+            if (!array) return 0;
+
+            array->id  = MJSON_ID_ARRAY32;
+            data_start = ctx->bjson;
+
+            end = (const uint8_t*)(element + 1) + element->val_u32;
+
+            for (value = element + 1; (const uint8_t*)value < end; value = next_element(value))
+            {
+                if (!index_copy_element(ctx, value))
+                    return 0;
+            }
+
+            array->val_u32 = (uint32_t)(ctx->bjson - data_start);
+
+            return 1;
+    }
+
+    size = element_size(element);
+
+    RETURN_VAL_IF_FAIL(size, 0);
+    RETURN_VAL_IF_FAIL(parsectx_reserve_output(ctx, (ptrdiff_t)size), 0);
+
+    memcpy(ctx->bjson, element, size);
+    parsectx_advance_output(ctx, (ptrdiff_t)size);
+
+    return 1;
+}
+
+/* sizes follow index_copy_* functions */
+static size_t index_element_size(mjson_element_t element)
+{
+    mjson_element_t first, key, value;
+    const uint8_t*  end;
+    uint32_t        capacity;
+    size_t          size = sizeof(mjson_entry_t);
+
+    switch (element->id)
+    {
+        case MJSON_ID_DICT32:
+            capacity = index_capacity(index_count_members(element, &first, &end));
+
+            if (capacity)
+                size += sizeof(mjson_entry_t) + (1 + capacity*2) * sizeof(uint32_t);
+
+            for (key = first; (const uint8_t*)key < end; key = next_element(value))
+            {
+                value = next_element(key);
+                size += element_size(key) + index_element_size(value);
+            }
+
+            return size;
+
+        case MJSON_ID_ARRAY32:
+            end = (const uint8_t*)(element + 1) + element->val_u32;
+
+            for (value = element + 1; (const uint8_t*)value < end; value = next_element(value))
+                size += index_element_size(value);
+
+            return size;
+    }
+
+    return element_size(element);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Validation
+/////////////////////////////////////////////////////////////////////////////
+
+/* deeper trees are rejected, so corrupted storage can not exhaust the stack */
+#define VALIDATE_MAX_DEPTH 1024
+
+/* every non-empty slot of index should point to a key of dictionary, one slot should be empty */
+static int validate_index(mjson_element_t dictionary, mjson_element_t index, mjson_element_t first, const uint8_t* end)
+{
+    const uint32_t* table = (const uint32_t*)(index + 1);
+    mjson_element_t key;
+    uint32_t        capacity, mask, slot, hash, used = 0, found = 0;
+
+    RETURN_VAL_IF_FAIL(index->val_u32 >= 3 * sizeof(uint32_t), FALSE);
+
+    capacity = table[0];
+
+    RETURN_VAL_IF_FAIL(capacity && (capacity & (capacity - 1)) == 0, FALSE);
+    RETURN_VAL_IF_FAIL(capacity <= (index->val_u32 / sizeof(uint32_t) - 1) / 2, FALSE);
+    RETURN_VAL_IF_FAIL(index->val_u32 == (1 + capacity*2) * sizeof(uint32_t), FALSE);
+
+    mask = capacity - 1;
+
+    for (slot = 0; slot < capacity; ++slot)
+        used += table[1 + slot*2 + 1] != 0;
+
+    RETURN_VAL_IF_FAIL(used < capacity, FALSE);
+
+    for (key = first; (const uint8_t*)key < end; key = next_element(next_element(key)))
+    {
+        uint32_t offset = (uint32_t)((const uint8_t*)key - (const uint8_t*)dictionary);
+
+        hash = index_hash((const char*)(key+1), key->val_u32);
+
+        for (slot = hash & mask; table[1 + slot*2 + 1]; slot = (slot + 1) & mask)
+        {
+            if (table[1 + slot*2 + 1] == offset)
+            {
+                RETURN_VAL_IF_FAIL(table[1 + slot*2] == hash, FALSE);
+                ++found;
+                break;
+            }
+        }
+    }
+
+    return found == used;
+}
+
+/* size of element if it lies inside of buffer, 0 otherwise */
+static size_t validate_size(mjson_element_t element, const uint8_t* end)
+{
+    size_t available = end - (const uint8_t*)element;
+    size_t size;
+
+    RETURN_VAL_IF_FAIL(available >= sizeof(uint32_t), 0);
+
+    /* elements without value are single id */
+    if (element->id <= MJSON_ID_TRUE)
+        return sizeof(uint32_t);
+
+    RETURN_VAL_IF_FAIL(available >= sizeof(mjson_entry_t), 0);
+
+    /* value of numbers is not size */
+    if (element->id == MJSON_ID_UINT32 || element->id == MJSON_ID_SINT32 || element->id == MJSON_ID_FLOAT32)
+        return sizeof(mjson_entry_t);
+
+    RETURN_VAL_IF_FAIL(element->val_u32 <= available - sizeof(mjson_entry_t), 0);
+
+    size = element_size(element);
+
+    return size <= available ? size : 0;
+}
+
+static int validate_element(mjson_element_t element, const uint8_t* end, int depth)
+{
+    const uint8_t*  data_end;
+    mjson_element_t child, first;
+    int             is_key;
+
+    RETURN_VAL_IF_FAIL(validate_size(element, end), FALSE);
+    RETURN_VAL_IF_FAIL(depth < VALIDATE_MAX_DEPTH, FALSE);
+
+    if (element->id <= MJSON_ID_TRUE)
+        return TRUE;
+
+    data_end = (const uint8_t*)(element + 1) + element->val_u32;
+
+    switch (element->id)
+    {
+        case MJSON_ID_UTF8_KEY32:
+        case MJSON_ID_UTF8_STRING32:
+            return *data_end == 0;
+
+        case MJSON_ID_ARRAY32:
+            for (child = element + 1; (const uint8_t*)child < data_end; child = next_element(child))
+            {
+                if (!validate_element(child, data_end, depth + 1))
+                    return FALSE;
+            }
+
+            return (const uint8_t*)child == data_end;
+
+        case MJSON_ID_DICT32:
+            first = element + 1;
+
+            if ((const uint8_t*)first + sizeof(uint32_t) <= data_end && first->id == MJSON_ID_INDEX32)
+            {
+                RETURN_VAL_IF_FAIL(validate_size(first, data_end), FALSE);
+                first = next_element(first);
+            }
+
+            is_key = TRUE;
+
+            for (child = first; (const uint8_t*)child < data_end; child = next_element(child))
+            {
+                if (is_key)
+                {
+                    RETURN_VAL_IF_FAIL(validate_size(child, data_end), FALSE);
+                    RETURN_VAL_IF_FAIL(child->id == MJSON_ID_UTF8_KEY32, FALSE);
+                }
+
+                RETURN_VAL_IF_FAIL(validate_element(child, data_end, depth + 1), FALSE);
+
+                is_key = !is_key;
+            }
+
+            /* every key has value */
+            RETURN_VAL_IF_FAIL((const uint8_t*)child == data_end && is_key, FALSE);
+
+            if (first != element + 1)
+                return validate_index(element, element + 1, first, data_end);
+
+            return TRUE;
+
+        case MJSON_ID_INDEX32:
+            /* index is valid only as first entry of dictionary */
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void unicode_cp_to_utf8(uint32_t uni_cp, uint8_t* utf8char/*[6]*/, size_t* charlen)
+{
+    uint32_t first, i;
+    
+    if (uni_cp < 0x80)
+    {
+        first   = 0;
+        *charlen = 1;
+    }
+    else if (uni_cp < 0x800)
+    {
+        first   = 0xc0;
+        *charlen = 2;
+    }
+    else if (uni_cp < 0x10000)
+    {
+        first   = 0xe0;
+        *charlen = 3;
+    }
+    else if (uni_cp < 0x200000)
+    {
+        first   = 0xf0;
+        *charlen = 4;
+    }
+    else if (uni_cp < 0x4000000)
+    {
+        first   = 0xf8;
+        *charlen = 5;
+    }
+    else
+    {
+        first   = 0xfc;
+        *charlen = 6;
+    }
+
+    for (i = *charlen - 1; i > 0; --i)
+    {
+        utf8char[i] = (uni_cp & 0x3f) | 0x80;
+        uni_cp >>= 6;
+    }
+    utf8char[0] = uni_cp | first;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Lexer+Parser code
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ * lexer front end: whitespace, comments, strings without escapes, decimal numbers
+ * and punctuation are scanned up to 32 bytes at once. other tokens, and every case
+ * where state machine behaves in a special way (escapes, exponents, NUL bytes,
+ * unterminated comments), are lexed by parsectx_next_token_re2c from token start,
+ * so tokens are always the same as produced by state machine alone.
+ */
+
+typedef uint8_t* (*lex_scan_func_t)(uint8_t* c, uint8_t* e);
+
+typedef struct
+{
+    lex_scan_func_t skip_space;     /* first byte that is not ' ', '\t', '\r', '\n' */
+    lex_scan_func_t skip_digits;    /* first byte that is not decimal digit */
+    lex_scan_func_t find_quote;     /* first '"', '\\' or NUL */
+    lex_scan_func_t find_star;      /* first '*' or NUL */
+    lex_scan_func_t find_newline;   /* first '\n' or NUL */
+} lex_scanner_t;
+
+static const lex_scanner_t* lex_scanner = NULL;
+static int                  lex_isa     = -1;
+
+static int lex_is_space(uint8_t ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+static int lex_is_digit(uint8_t ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+static uint8_t* lex_skip_space_scalar(uint8_t* c, uint8_t* e)
+{
+    while (c < e && lex_is_space(*c)) ++c;
+    return c;
+}
+
+static uint8_t* lex_skip_digits_scalar(uint8_t* c, uint8_t* e)
+{
+    while (c < e && lex_is_digit(*c)) ++c;
+    return c;
+}
+
+static uint8_t* lex_find3_scalar(uint8_t* c, uint8_t* e, uint8_t a, uint8_t b)
+{
+    while (c < e && *c != a && *c != b && *c != 0) ++c;
+    return c;
+}
+
+static uint8_t* lex_find_quote_scalar(uint8_t* c, uint8_t* e)
+{
+    return lex_find3_scalar(c, e, '"', '\\');
+}
+
+static uint8_t* lex_find_star_scalar(uint8_t* c, uint8_t* e)
+{
+    return lex_find3_scalar(c, e, '*', '*');
+}
+
+static uint8_t* lex_find_newline_scalar(uint8_t* c, uint8_t* e)
+{
+    return lex_find3_scalar(c, e, '\n', '\n');
+}
+
+static const lex_scanner_t lex_scanner_scalar = {
+    lex_skip_space_scalar,
+    lex_skip_digits_scalar,
+    lex_find_quote_scalar,
+    lex_find_star_scalar,
+    lex_find_newline_scalar
+};
+
+#if MJSON_X86
+
+static unsigned lex_first_bit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+/* bytes of vector that stop the scan, one bit per byte */
+
+static uint32_t lex_space_mask_sse2(__m128i v)
+{
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')))
+    );
+    return ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+}
+
+static uint32_t lex_digits_mask_sse2(__m128i v)
+{
+    /* '0'..'9' are moved to -128..-119, so single signed compare checks range */
+    __m128i biased = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - '0')));
+    __m128i digits = _mm_cmplt_epi8(biased, _mm_set1_epi8((char)(0x80 + 10)));
+    return ~(uint32_t)_mm_movemask_epi8(digits) & 0xFFFF;
+}
+
+static uint32_t lex_find3_mask_sse2(__m128i v, uint8_t a, uint8_t b)
+{
+    __m128i found = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)a)), _mm_cmpeq_epi8(v, _mm_set1_epi8((char)b))),
+        _mm_cmpeq_epi8(v, _mm_setzero_si128())
+    );
+    return (uint32_t)_mm_movemask_epi8(found);
+}
+
+static uint8_t* lex_skip_space_sse2(uint8_t* c, uint8_t* e)
+{
+    uint32_t mask;
+
+    for (; e - c >= 16; c += 16)
+    {
+        mask = lex_space_mask_sse2(_mm_loadu_si128((const __m128i*)c));
+        if (mask) return c + lex_first_bit(mask);
+    }
+
+    return lex_skip_space_scalar(c, e);
+}
+
+static uint8_t* lex_skip_digits_sse2(uint8_t* c, uint8_t* e)
+{
+    uint32_t mask;
+
+    for (; e - c >= 16; c += 16)
+    {
+        mask = lex_digits_mask_sse2(_mm_loadu_si128((const __m128i*)c));
+        if (mask) return c + lex_first_bit(mask);
+    }
+
+    return lex_skip_digits_scalar(c, e);
+}
+
+static uint8_t* lex_find3_sse2(uint8_t* c, uint8_t* e, uint8_t a, uint8_t b)
 {
-    RETURN_VAL_IF_FAIL(element, fallback);
-    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_UTF8_STRING32 ||
-                       element->id == MJSON_ID_UTF8_KEY32,
-                       fallback);
-    
-    return (const char*)(element+1);
+    uint32_t mask;
+
+    for (; e - c >= 16; c += 16)
+    {
+        mask = lex_find3_mask_sse2(_mm_loadu_si128((const __m128i*)c), a, b);
+        if (mask) return c + lex_first_bit(mask);
+    }
+
+    return lex_find3_scalar(c, e, a, b);
 }
 
-int32_t mjson_get_int(mjson_element_t element, int32_t fallback)
+static uint8_t* lex_find_quote_sse2(uint8_t* c, uint8_t* e)
 {
-    RETURN_VAL_IF_FAIL(element, fallback);
-    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_SINT32, fallback);
-    
-    return element->val_s32;
+    return lex_find3_sse2(c, e, '"', '\\');
 }
 
-float mjson_get_float(mjson_element_t element, float fallback)
+static uint8_t* lex_find_star_sse2(uint8_t* c, uint8_t* e)
 {
-    RETURN_VAL_IF_FAIL(element, fallback);
-    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_FLOAT32, fallback);
-    
-    return element->val_f32;
+    return lex_find3_sse2(c, e, '*', '*');
 }
 
-int mjson_get_bool(mjson_element_t element, int fallback)
+static uint8_t* lex_find_newline_sse2(uint8_t* c, uint8_t* e)
 {
-    RETURN_VAL_IF_FAIL(element, fallback);
-    RETURN_VAL_IF_FAIL(element->id == MJSON_ID_TRUE || element->id == MJSON_ID_FALSE, fallback);
-    
-    return element->id == MJSON_ID_TRUE;
+    return lex_find3_sse2(c, e, '\n', '\n');
 }
 
-int mjson_is_null(mjson_element_t element)
+static const lex_scanner_t lex_scanner_sse2 = {
+    lex_skip_space_sse2,
+    lex_skip_digits_sse2,
+    lex_find_quote_sse2,
+    lex_find_star_sse2,
+    lex_find_newline_sse2
+};
+
+/* AVX2 versions scan 32 bytes per step, tails shorter than 32 bytes are left to SSE2 */
+
+MJSON_TARGET_AVX2 static uint8_t* lex_skip_space_avx2(uint8_t* c, uint8_t* e)
 {
-    RETURN_VAL_IF_FAIL(element, TRUE);
+    __m256i  v, ws;
+    uint32_t mask;
 
-    return element->id == MJSON_ID_NULL;
-}
+    for (; e - c >= 32; c += 32)
+    {
+        v  = _mm256_loadu_si256((const __m256i*)c);
+        ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')))
+        );
+        mask = ~(uint32_t)_mm256_movemask_epi8(ws);
+        if (mask)
+        {
+            _mm256_zeroupper();
+            return c + lex_first_bit(mask);
+        }
+    }
 
-/////////////////////////////////////////////////////////////////////////////
-// API helpers
-/////////////////////////////////////////////////////////////////////////////
+    _mm256_zeroupper();
+    return lex_skip_space_sse2(c, e);
+}
 
-static size_t element_size(mjson_element_t element)
+MJSON_TARGET_AVX2 static uint8_t* lex_skip_digits_avx2(uint8_t* c, uint8_t* e)
 {
-    RETURN_VAL_IF_FAIL(element, 0);
+    __m256i  v, digits;
+    uint32_t mask;
 
-    switch(element->id)
+    for (; e - c >= 32; c += 32)
     {
-        case MJSON_ID_NULL:
-        case MJSON_ID_FALSE:
-        case MJSON_ID_EMPTY_STRING:
-        case MJSON_ID_TRUE:
-            return sizeof(uint32_t);
+        v      = _mm256_loadu_si256((const __m256i*)c);
+        digits = _mm256_and_si256(
+            _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v)
+        );
+        mask = ~(uint32_t)_mm256_movemask_epi8(digits);
+        if (mask)
+        {
+            _mm256_zeroupper();
+            return c + lex_first_bit(mask);
+        }
+    }
 
-        case MJSON_ID_UINT32:
-        case MJSON_ID_SINT32:
-        case MJSON_ID_FLOAT32:
-            return sizeof(mjson_entry_t);
+    _mm256_zeroupper();
+    return lex_skip_digits_sse2(c, e);
+}
 
-        case MJSON_ID_UTF8_KEY32:
-        case MJSON_ID_UTF8_STRING32:
-            return sizeof(mjson_entry_t) + ((element->val_u32 + 1 + 3) & (~3));
+MJSON_TARGET_AVX2 static uint8_t* lex_find3_avx2(uint8_t* c, uint8_t* e, uint8_t a, uint8_t b)
+{
+    __m256i  v, found;
+    uint32_t mask;
 
-        case MJSON_ID_BINARY32:
-        case MJSON_ID_ARRAY32:
-        case MJSON_ID_DICT32:
-            return sizeof(mjson_entry_t) + ((element->val_u32 + 3) & (~3));
-    };
+    for (; e - c >= 32; c += 32)
+    {
+        v     = _mm256_loadu_si256((const __m256i*)c);
+        found = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)a)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)b))),
+            _mm256_cmpeq_epi8(v, _mm256_setzero_si256())
+        );
+        mask = (uint32_t)_mm256_movemask_epi8(found);
+        if (mask)
+        {
+            _mm256_zeroupper();
+            return c + lex_first_bit(mask);
+        }
+    }
 
-    return 0;
+    _mm256_zeroupper();
+    return lex_find3_sse2(c, e, a, b);
 }
 
-static mjson_element_t next_element(mjson_element_t element)
+static uint8_t* lex_find_quote_avx2(uint8_t* c, uint8_t* e)
 {
-    size_t size;
-    
-    RETURN_VAL_IF_FAIL(element, 0);
+    return lex_find3_avx2(c, e, '"', '\\');
+}
 
-    size = element_size(element);
-    assert(size>0);
-    
-    return (mjson_element_t)((uint8_t*)element + size);
+static uint8_t* lex_find_star_avx2(uint8_t* c, uint8_t* e)
+{
+    return lex_find3_avx2(c, e, '*', '*');
 }
 
-static void* parsectx_reserve_output(mjson_parser_t* ctx, ptrdiff_t size)
+static uint8_t* lex_find_newline_avx2(uint8_t* c, uint8_t* e)
 {
-    return (ctx->bjson_limit - ctx->bjson < size) ? 0 : ctx->bjson;
+    return lex_find3_avx2(c, e, '\n', '\n');
 }
 
-static void parsectx_advance_output(mjson_parser_t* ctx, ptrdiff_t size)
+static const lex_scanner_t lex_scanner_avx2 = {
+    lex_skip_space_avx2,
+    lex_skip_digits_avx2,
+    lex_find_quote_avx2,
+    lex_find_star_avx2,
+    lex_find_newline_avx2
+};
+
+static int lex_cpu_has_avx2()
 {
-    ctx->bjson += size;
+    unsigned int info[4] = {0};
+    uint64_t     xcr0;
+
+#if defined(_MSC_VER)
+    __cpuid((int*)info, 0);
+    if (info[0] < 7) return 0;
+
+    __cpuid((int*)info, 1);
+#else
+    if (__get_cpuid_max(0, 0) < 7) return 0;
+
+    __cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+
+    /* AVX and OSXSAVE */
+    if ((info[2] & (1<<27)) == 0 || (info[2] & (1<<28)) == 0) return 0;
+
+    /* OS saves YMM state */
+#if defined(_MSC_VER)
+    xcr0 = _xgetbv(0);
+#else
+    {
+        uint32_t xcr0lo, xcr0hi;
+        __asm__ __volatile__ ("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+        xcr0 = ((uint64_t)xcr0hi << 32) | xcr0lo;
+    }
+#endif
+    if ((xcr0 & 6) != 6) return 0;
+
+#if defined(_MSC_VER)
+    __cpuidex((int*)info, 7, 0);
+#else
+    __cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+#endif
+
+    return (info[1] & (1<<5)) != 0;
 }
 
-static void* parsectx_allocate_output(mjson_parser_t* ctx, ptrdiff_t size)
+#endif
+
+int mjson_select_lexer(int lexer)
 {
-    void* ptr;
+#if MJSON_X86
+    int supported = lex_cpu_has_avx2() ? MJSON_LEXER_AVX2 : MJSON_LEXER_SSE2;
+#else
+    int supported = MJSON_LEXER_SCALAR;
+#endif
 
-    if (ctx->bjson_limit - ctx->bjson < size)
-        return 0;
+    lexer = lexer < 0 || lexer > supported ? supported : lexer;
 
-    ptr = ctx->bjson;
-    ctx->bjson += size;
+    switch (lexer)
+    {
+#if MJSON_X86
+        case MJSON_LEXER_AVX2:
+            lex_scanner = &lex_scanner_avx2;
+            break;
+        case MJSON_LEXER_SSE2:
+            lex_scanner = &lex_scanner_sse2;
+            break;
+#endif
+        case MJSON_LEXER_SCALAR:
+            lex_scanner = &lex_scanner_scalar;
+            break;
+        default:
+            lex_scanner = NULL;
+            break;
+    }
 
-    return ptr;
+    lex_isa = lexer;
+
+    return lexer;
 }
 
-//TODO: what about 64 bit code????
-static void parsectx_align4_output(mjson_parser_t* ctx)
+/* runs are mostly short, vector scan is started only after a few bytes */
+
+static uint8_t* lex_skip_space(const lex_scanner_t* scan, uint8_t* c, uint8_t* e)
 {
-    ctx->bjson = (uint8_t*)(((ptrdiff_t)ctx->bjson + 3) & (~3));
+    uint8_t* head = e - c > 4 ? c + 4 : e;
+
+    while (c < head && lex_is_space(*c)) ++c;
+
+    return c < head || c == e ? c : scan->skip_space(c, e);
 }
 
-static void unicode_cp_to_utf8(uint32_t uni_cp, uint8_t* utf8char/*[6]*/, size_t* charlen)
+static uint8_t* lex_skip_digits(const lex_scanner_t* scan, uint8_t* c, uint8_t* e)
 {
-    uint32_t first, i;
-    
-    if (uni_cp < 0x80)
-    {
-        first   = 0;
-        *charlen = 1;
-    }
-    else if (uni_cp < 0x800)
-    {
-        first   = 0xc0;
-        *charlen = 2;
-    }
-    else if (uni_cp < 0x10000)
+    uint8_t* head = e - c > 8 ? c + 8 : e;
+
+    while (c < head && lex_is_digit(*c)) ++c;
+
+    return c < head || c == e ? c : scan->skip_digits(c, e);
+}
+
+/*
+ * digits of [+-]?[1-9][0-9]* are skipped already, returns TOK_NONE
+ * if the rest of number should be lexed by state machine
+ */
+static int lex_number_tail(const lex_scanner_t* scan, uint8_t** cursor, uint8_t* e, int is_signed)
+{
+    uint8_t* c  = *cursor;
+    uint8_t  ch = c < e ? *c : 0;
+
+    if (ch == '.')
     {
-        first   = 0xe0;
-        *charlen = 3;
+        c  = lex_skip_digits(scan, c + 1, e);
+        ch = c < e ? *c : 0;
+
+        RETURN_VAL_IF_FAIL(ch != 'e' && ch != 'E', TOK_NONE);
+
+        *cursor = c;
+        return TOK_FLOAT_NUMBER;
     }
-    else if (uni_cp < 0x200000)
+
+    RETURN_VAL_IF_FAIL(ch != 'e' && ch != 'E', TOK_NONE);
+
+    /* letters right after unsigned number make invalid token, signed number ends before them */
+    if (!is_signed)
     {
-        first   = 0xf0;
-        *charlen = 4;
+        RETURN_VAL_IF_FAIL(ch != '_', TOK_NONE);
+        RETURN_VAL_IF_FAIL((ch < 'A' || ch > 'Z') && (ch < 'a' || ch > 'z'), TOK_NONE);
     }
-    else if (uni_cp < 0x4000000)
+
+    return TOK_DEC_NUMBER;
+}
+
+static void parsectx_next_token(mjson_parser_t* context)
+{
+    const lex_scanner_t* scan;
+    uint8_t* next;
+    uint8_t* c;
+    uint8_t* e;
+    uint8_t* s;
+    int token;
+
+    assert(context);
+    RETURN_IF_FAIL(context->next != NULL);
+
+    if (lex_isa < 0) mjson_select_lexer(-1);
+
+    scan = lex_scanner;
+    if (!scan)
     {
-        first   = 0xf8;
-        *charlen = 5;
+        parsectx_next_token_re2c(context);
+        return;
     }
-    else
+
+    next = context->next;
+    c    = next;
+    e    = context->end;
+
+    /* whitespace and comments */
+    while (c < e)
     {
-        first   = 0xfc;
-        *charlen = 6;
+        s = c;
+
+        if (lex_is_space(*c))
+        {
+            c = lex_skip_space(scan, c + 1, e);
+        }
+        else if (*c == '/' && e - c >= 2 && c[1] == '/')
+        {
+            /* line comment is closed by newline only */
+            c = scan->find_newline(c + 2, e);
+            if (c == e || *c != '\n') goto fallback;
+            ++c;
+        }
+        else if (*c == '/' && e - c >= 2 && c[1] == '*')
+        {
+            for (c = scan->find_star(c + 2, e); c < e && *c == '*'; c = scan->find_star(c + 1, e))
+            {
+                if (e - c >= 2 && c[1] == '/') break;
+            }
+
+            if (c == e || *c != '*') goto fallback;
+
+            /* state machine could extend comment ending with two stars to the next terminator */
+            if (c - s > 2 && c[-1] == '*') goto fallback;
+
+            c += 2;
+        }
+        else
+        {
+            break;
+        }
     }
 
-    for (i = *charlen - 1; i > 0; --i)
+    s = c;
+
+    if (c == e) goto fallback;
+
+    switch (*c)
     {
-        utf8char[i] = (uni_cp & 0x3f) | 0x80;
-        uni_cp >>= 6;
+        case '"':
+            c = scan->find_quote(c + 1, e);
+            if (c == e || *c != '"') goto fallback;
+
+            ++c;
+            token = TOK_NOESC_STRING;
+            break;
+
+        case '-': case '+':
+            if (e - c < 2 || c[1] < '1' || c[1] > '9') goto fallback;
+
+            c     = lex_skip_digits(scan, c + 2, e);
+            token = lex_number_tail(scan, &c, e, TRUE);
+            break;
+
+        case '1': case '2': case '3': case '4': case '5':
+        case '6': case '7': case '8': case '9':
+            c     = lex_skip_digits(scan, c + 1, e);
+            token = lex_number_tail(scan, &c, e, FALSE);
+            break;
+
+        case '{': ++c; token = TOK_LEFT_CURLY_BRACKET;  break;
+        case '}': ++c; token = TOK_RIGHT_CURLY_BRACKET; break;
+        case '[': ++c; token = TOK_LEFT_BRACKET;        break;
+        case ']': ++c; token = TOK_RIGHT_BRACKET;       break;
+        case ',': ++c; token = TOK_COMMA;               break;
+        case ':': ++c; token = TOK_COLON;               break;
+        case '=': ++c; token = TOK_EQUAL;               break;
+
+        default:
+            token = TOK_NONE;
+            break;
     }
-    utf8char[0] = uni_cp | first;
-}
 
-/////////////////////////////////////////////////////////////////////////////
-// Lexer+Parser code
-/////////////////////////////////////////////////////////////////////////////
+    if (token == TOK_NONE) goto fallback;
+
+    context->token = token;
+    context->start = s;
+    context->next  = c;
 
+    return;
 
+fallback:
+    context->next = s;
+    parsectx_next_token_re2c(context);
 
-static void parsectx_next_token(mjson_parser_t* context)
+    /* state machine keeps position for end of input and invalid tokens */
+    if (context->token == TOK_NONE || context->token == TOK_INVALID)
+    {
+        context->next = next;
+    }
+}
+
+static void parsectx_next_token_re2c(mjson_parser_t* context)
 {
 #define YYREADINPUT(c) (c>=e?0:*c)
 #define YYCTYPE        uint8_t
@@ -1340,6 +2403,8 @@ static int parse_number(mjson_parser_t *context)
     uint8_t        bjson_id;
     const char*    format;
     mjson_entry_t* bdata;
+    char           number[64];
+    size_t         len = context->next - context->start;
 
     switch(context->token)
     {
@@ -1368,7 +2433,18 @@ static int parse_number(mjson_parser_t *context)
     if (!bdata) return 0;
 
     bdata->id = bjson_id;
-    num_parsed = sscanf((char*)context->start, format, &bdata->val_u32);
+
+    /* sscanf measures length of the whole input, token is copied to keep parsing linear */
+    if (len < sizeof(number))
+    {
+        memcpy(number, context->start, len);
+        number[len] = 0;
+        num_parsed = sscanf(number, format, &bdata->val_u32);
+    }
+    else
+    {
+        num_parsed = sscanf((char*)context->start, format, &bdata->val_u32);
+    }
     assert(num_parsed == 1);
 
     parsectx_next_token(context);
@@ -1388,6 +2464,7 @@ static int parse_string(mjson_parser_t *context, uint32_t id)
     uint8_t* s;
 
     mjson_entry_t* bdata;
+    ptrdiff_t      bdata_offset;
     uint32_t       ch = 0;
     uint8_t*       str_dst;
     const uint8_t* str_src;
@@ -1405,7 +2482,8 @@ static int parse_string(mjson_parser_t *context, uint32_t id)
     
     if (!bdata) return 0;
     
-    bdata->id = id;
+    bdata->id    = id;
+    bdata_offset = parsectx_output_offset(context, bdata);
 
     if (context->token != TOK_STRING)
     {
@@ -1496,8 +2574,15 @@ yy132:
 yy133:
             ++YYCURSOR;
             {
-                bdata->val_u32 = context->bjson - (uint8_t*)(bdata + 1);
-                *context->bjson++ = 0;
+                str_dst = (uint8_t*)parsectx_allocate_output(context, 1);
+
+                if (!str_dst) return 0;
+
+                *str_dst = 0;
+
+                bdata = (mjson_entry_t*)(context->bjson_start + bdata_offset);
+                bdata->val_u32 = str_dst - (uint8_t*)(bdata + 1);
+
                 parsectx_align4_output(context);
                 parsectx_next_token(context);
 
@@ -1689,10 +2774,53 @@ static int parse_value(mjson_parser_t *context)
     return 0;
 }
 
+static int parse_document(mjson_parser_t *context, mjson_element_t* top_element)
+{
+    uint32_t* fourcc;
+    int stop_token = TOK_NONE;
+
+    *top_element = 0;
+
+    fourcc = (uint32_t*)parsectx_allocate_output(context, (ptrdiff_t)sizeof(uint32_t));
+
+    if (!fourcc) return 0;
+
+    *fourcc = '23JB';
+
+    parsectx_next_token(context);
+
+    if (context->token == TOK_LEFT_BRACKET)
+    {
+        parsectx_next_token(context);
+        if (!parse_value_list(context))
+            return 0;
+    }
+    else
+    {
+        if (context->token == TOK_LEFT_CURLY_BRACKET)
+        {
+            stop_token = TOK_RIGHT_CURLY_BRACKET;
+            parsectx_next_token(context);
+        }
+
+        if (!parse_key_value_pair(context, stop_token))
+            return 0;
+    }
+
+    if (context->token != TOK_NONE)
+        return 0;
+
+    /* output could be moved while growing */
+    *top_element = (mjson_entry_t*)(context->bjson_start + sizeof(uint32_t));
+
+    return 1;
+}
+
 static int parse_value_list(mjson_parser_t *context)
 {
     mjson_entry_t* array;
-    uint8_t*       data_start;
+    ptrdiff_t      array_offset;
+    ptrdiff_t      data_start;
     int            expect_separator;
 
     assert(context);
@@ -1701,8 +2829,9 @@ static int parse_value_list(mjson_parser_t *context)
 
     if (!array) return 0;
     
-    array->id  = MJSON_ID_ARRAY32;
-    data_start = context->bjson;
+    array->id    = MJSON_ID_ARRAY32;
+    array_offset = parsectx_output_offset(context, array);
+    data_start   = parsectx_output_offset(context, context->bjson);
 
     expect_separator = FALSE;
 
@@ -1717,7 +2846,8 @@ static int parse_value_list(mjson_parser_t *context)
             return 0;
     }
 
-    array->val_u32 = context->bjson - data_start;
+    array = (mjson_entry_t*)(context->bjson_start + array_offset);
+    array->val_u32 = parsectx_output_offset(context, context->bjson) - data_start;
 
     assert((array->val_u32 & 3) == 0);
 
@@ -1729,7 +2859,8 @@ static int parse_value_list(mjson_parser_t *context)
 static int parse_key_value_pair(mjson_parser_t* context, int stop_token)
 {
     mjson_entry_t* dictionary;
-    uint8_t*       data_start;
+    ptrdiff_t      dictionary_offset;
+    ptrdiff_t      data_start;
     int            expect_separator;
  
     assert(context);
@@ -1738,8 +2869,9 @@ static int parse_key_value_pair(mjson_parser_t* context, int stop_token)
     
     if (!dictionary) return 0;
     
-    dictionary->id = MJSON_ID_DICT32;
-    data_start     = context->bjson;
+    dictionary->id    = MJSON_ID_DICT32;
+    dictionary_offset = parsectx_output_offset(context, dictionary);
+    data_start        = parsectx_output_offset(context, context->bjson);
     
     expect_separator = FALSE;
     while (context->token != stop_token)
@@ -1769,7 +2901,8 @@ static int parse_key_value_pair(mjson_parser_t* context, int stop_token)
             return 0;
     }
 
-    dictionary->val_u32 = context->bjson - data_start;
+    dictionary = (mjson_entry_t*)(context->bjson_start + dictionary_offset);
+    dictionary->val_u32 = parsectx_output_offset(context, context->bjson) - data_start;
     
     assert((dictionary->val_u32 & 3) == 0);
     
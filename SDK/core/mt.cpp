@@ -4,7 +4,7 @@
 namespace mt
 {
     static const uint32_t MAX_EVENTS = 128;
-    
+
     static const uint32_t ID_TYPE_BITS  =  4;
     static const uint32_t ID_GEN_BITS   =  8;
     static const uint32_t ID_INDEX_BITS = 20;
@@ -14,7 +14,7 @@ namespace mt
     static const uint32_t ID_INDEX_OFFSET = 0;
 
     static const uint32_t ID_TYPE_MASK  = ((1 << ID_TYPE_BITS ) - 1) << ID_TYPE_OFFSET;
-    static const uint32_t ID_GEN_NASK   = ((1 << ID_GEN_BITS  ) - 1) << ID_GEN_OFFSET;
+    static const uint32_t ID_GEN_MASK   = ((1 << ID_GEN_BITS  ) - 1) << ID_GEN_OFFSET;
     static const uint32_t ID_INDEX_MASK = ((1 << ID_INDEX_BITS) - 1) << ID_INDEX_OFFSET;
 
     static const uint32_t ID_TYPE_MT_EVENT = 1;
@@ -36,7 +36,7 @@ namespace mt
 
     uint32_t handleIncGen(uint32_t handle)
     {
-        return (handle & ~ID_GEN_NASK) | ((handle + (1 << ID_GEN_OFFSET)) & ID_GEN_NASK);
+        return (handle & ~ID_GEN_MASK) | ((handle + (1 << ID_GEN_OFFSET)) & ID_GEN_MASK);
     }
 
     struct FixedStack
@@ -45,21 +45,22 @@ namespace mt
         uint32_t pointer;
     };
 
-    FixedStack freeEventID;
+    FixedStack   freeEventID;
+    SDL_SpinLock freeEventLock;
 
     struct event_t
     {
-        uint32_t   handle;
-        uint32_t   signaled;
-        SDL_cond*  cond;
-        SDL_mutex* mutex;
+        uint32_t     handle;
+        SDL_atomic_t signaled;
+        SDL_cond*    cond;
+        SDL_mutex*   mutex;
     };
 
     event_t eventPool[MAX_EVENTS];
 
     event_t* getEventByHandle(uint32_t eventID)
     {
-        uint32_t index = eventID & ID_INDEX_OFFSET;
+        uint32_t index = (eventID & ID_INDEX_MASK) >> ID_INDEX_OFFSET;
         if (index < MAX_EVENTS && eventPool[index].handle == eventID)
         {
             return &eventPool[index];
@@ -68,45 +69,51 @@ namespace mt
         return 0;
     }
 
+    // Returns INVALID_HANDLE when all events are in use
     uint32_t eventPoolAllocEvent()
     {
-        assert(freeEventID.pointer < MAX_EVENTS);
+        SDL_AtomicLock(&freeEventLock);
+
+        if (freeEventID.pointer >= MAX_EVENTS)
+        {
+            SDL_AtomicUnlock(&freeEventLock);
+            return INVALID_HANDLE;
+        }
 
         uint32_t handle = handleIncGen(freeEventID.array[freeEventID.pointer++]);
-        uint32_t index  = handle & ID_INDEX_OFFSET;
+        uint32_t index  = (handle & ID_INDEX_MASK) >> ID_INDEX_OFFSET;
         assert(index < MAX_EVENTS);
 
-        eventPool[index].handle   = handle;
-        eventPool[index].signaled = false;
+        eventPool[index].handle = handle;
+        SDL_AtomicSet(&eventPool[index].signaled, 0);
+
+        SDL_AtomicUnlock(&freeEventLock);
 
         return handle;
     }
 
     void eventPoolReleaseEvent(uint32_t eventID)
     {
+        SDL_AtomicLock(&freeEventLock);
+
         assert(freeEventID.pointer > 0);
-        
+
         event_t* event = getEventByHandle(eventID);
         assert(event);
 
         event->handle = INVALID_HANDLE;
 
         freeEventID.array[--freeEventID.pointer] = eventID;
+
+        SDL_AtomicUnlock(&freeEventLock);
     }
 
-    void syncAndReleaseEvent(uint32_t handle)
+    void eventSignal(event_t* event)
     {
-        event_t* event = getEventByHandle(handle);
-        assert(event);
-
         SDL_LockMutex(event->mutex);
-        while (!event->signaled)
-        {
-            SDL_CondWait(event->cond, event->mutex);
-        }
+        SDL_AtomicSet(&event->signaled, 1);
+        SDL_CondBroadcast(event->cond);
         SDL_UnlockMutex(event->mutex);
-
-        eventPoolReleaseEvent(handle);
     }
 
     void eventPoolCreate()
@@ -117,14 +124,15 @@ namespace mt
         }
 
         freeEventID.pointer = 0;
+        freeEventLock       = 0;
 
         for (size_t i = 0; i < MAX_EVENTS; ++i)
         {
             eventPool[i].handle   = INVALID_HANDLE;
-            eventPool[i].signaled = 0;
             eventPool[i].cond     = SDL_CreateCond();
             eventPool[i].mutex    = SDL_CreateMutex();
-        }        
+            SDL_AtomicSet(&eventPool[i].signaled, 0);
+        }
     }
 
     void eventPoolDestroy()
@@ -134,250 +142,1041 @@ namespace mt
         for (size_t i = 0; i < MAX_EVENTS; ++i)
         {
             eventPool[i].handle   = INVALID_HANDLE;
-            eventPool[i].signaled = 0;
+            SDL_AtomicSet(&eventPool[i].signaled, 0);
             SDL_DestroyCond(eventPool[i].cond);
             SDL_DestroyMutex(eventPool[i].mutex);
-        }        
-    }
-
-    static const size_t MAX_POOL_THREADS = 8;
-
-    typedef struct {
-        void (*function)(void *);
-        void*     argument;
-        event_t*  event;
-    } task_t;
-
-    struct threadpool_t
-    {
-        SDL_mutex*  lock;
-        SDL_cond*   notify;
-        SDL_Thread* threads[MAX_POOL_THREADS];
-        task_t*     queue;
-        int         thread_count;
-        int         queue_size;
-        int         head;
-        int         tail;
-        int         count;
-        int         shutdown;
-        int         started;
+        }
+    }
+
+    static const int      MAX_WORKERS   = 16;
+    static const uint32_t IDLE_WAIT_MS  = 10;
+
+    struct job_t
+    {
+        task_func_t   function;
+        void*         argument;
+        job_t*        parent;
+        event_t*      event;
+        uint8_t       data[JOB_DATA_SIZE];
+        SDL_atomic_t  unfinished;
+        SDL_atomic_t  generation;   // Incremented every time ring slot is reused
+    };
+
+    // Job ring: slot can be reused as soon as job and all its children are finished.
+    struct job_ring_t
+    {
+        job_t*        jobs;
+        uint32_t      next;
+    };
+
+    struct worker_t
+    {
+        // Chase-Lev deque, owner works on bottom, thieves take from top.
+        SDL_atomic_t  top;
+        SDL_atomic_t  bottom;
+        job_t**       deque;
+        job_ring_t    ring;
+        uint32_t      rng;
+        SDL_Thread*   thread;
     };
 
-    static int SDLCALL threadpoolThread(void* poolPtr);
-    static void releaseMTResources();
+    struct scheduler_t
+    {
+        worker_t      workers[MAX_WORKERS];
+        int           numWorkers;
+        uint32_t      mask;
+
+        // Submission from non worker threads.
+        SDL_SpinLock       injectLock;
+        job_t**            injectQueue;
+        uint32_t           injectHead;
+        SDL_atomic_t       injectCount;
+        job_ring_t         sharedRing;
+
+        SDL_sem*      wakeup;
+        SDL_atomic_t  numSleeping;
+        SDL_atomic_t  shutdown;
+
+        uint16_t      queueDepthGauge;
+    };
+
+    static scheduler_t sched;
+
+    static CORE_THREAD_LOCAL int workerIndex = -1;
 
-    threadpool_t pool;
+    static int SDLCALL workerThread(void* workerPtr);
+
+    static worker_t* getCurrentWorker()
+    {
+        return workerIndex >= 0 ? &sched.workers[workerIndex] : 0;
+    }
 
-    void init(int thread_count, int queue_size)
+    static uint32_t roundUpPow2(uint32_t value)
     {
-        int  i;
-        char threadName[8] = "Worker\0";
+        uint32_t result = 1;
+        while (result < value) result <<= 1;
+        return result;
+    }
 
-        assert(thread_count < MAX_POOL_THREADS);
+    static bool dequePush(worker_t* worker, job_t* job)
+    {
+        int b = SDL_AtomicGet(&worker->bottom);
+        int t = SDL_AtomicGet(&worker->top);
 
-        memset(&pool, 0, sizeof(threadpool_t));
+        if ((uint32_t)(b - t) > sched.mask)
+        {
+            return false;
+        }
 
-        /* Initialize */
-        pool.thread_count = thread_count;
-        pool.queue_size   = queue_size;
+        worker->deque[b & sched.mask] = job;
+        // Job must be visible before bottom is published
+        SDL_CompilerBarrier();
+        SDL_AtomicSet(&worker->bottom, b + 1);
 
-        /* Allocate thread and task queue */
-        pool.queue = (task_t*)malloc(sizeof(task_t) * queue_size);
+        return true;
+    }
 
-        pool.lock   = SDL_CreateMutex();
-        pool.notify = SDL_CreateCond();
+    static job_t* dequePop(worker_t* worker)
+    {
+        int b = SDL_AtomicGet(&worker->bottom) - 1;
+        // Full barrier: store to bottom must be visible before top is read
+        SDL_AtomicSet(&worker->bottom, b);
+        int t = SDL_AtomicGet(&worker->top);
 
-        /* Initialize mutex and conditional variable first */
-        if (pool.lock    == NULL  ||
-            pool.notify  == NULL  ||
-            pool.queue   == NULL)
+        if (t > b)
         {
-            goto err;
+            SDL_AtomicSet(&worker->bottom, t);
+            return 0;
+        }
+
+        job_t* job = worker->deque[b & sched.mask];
+        if (t != b)
+        {
+            return job;
+        }
+
+        // Last job, race against thieves
+        if (!SDL_AtomicCAS(&worker->top, t, t + 1))
+        {
+            job = 0;
+        }
+        SDL_AtomicSet(&worker->bottom, t + 1);
+
+        return job;
+    }
+
+    static job_t* dequeSteal(worker_t* worker)
+    {
+        int t = SDL_AtomicGet(&worker->top);
+        int b = SDL_AtomicGet(&worker->bottom);
+
+        if (t >= b)
+        {
+            return 0;
+        }
+
+        job_t* job = worker->deque[t & sched.mask];
+        if (!SDL_AtomicCAS(&worker->top, t, t + 1))
+        {
+            return 0;
+        }
+
+        return job;
+    }
+
+    static bool injectPush(job_t* job)
+    {
+        bool result = false;
+
+        SDL_AtomicLock(&sched.injectLock);
+        uint32_t count = (uint32_t)SDL_AtomicGet(&sched.injectCount);
+        if (count <= sched.mask)
+        {
+            sched.injectQueue[(sched.injectHead + count) & sched.mask] = job;
+            SDL_AtomicSet(&sched.injectCount, count + 1);
+            result = true;
+        }
+        SDL_AtomicUnlock(&sched.injectLock);
+
+        return result;
+    }
+
+    static job_t* injectPop()
+    {
+        job_t* job = 0;
+
+        if (SDL_AtomicGet(&sched.injectCount) == 0)
+        {
+            return 0;
         }
 
-        for(i = 0; i < thread_count; i++)
+        SDL_AtomicLock(&sched.injectLock);
+        if (SDL_AtomicGet(&sched.injectCount) > 0)
+        {
+            job = sched.injectQueue[sched.injectHead & sched.mask];
+            ++sched.injectHead;
+            SDL_AtomicAdd(&sched.injectCount, -1);
+        }
+        SDL_AtomicUnlock(&sched.injectLock);
+
+        return job;
+    }
+
+    static bool hasPendingJobs()
+    {
+        if (SDL_AtomicGet(&sched.injectCount) > 0)
         {
-            threadName[6] = 0x30+i;
+            return true;
+        }
 
-            pool.threads[i] = SDL_CreateThread(threadpoolThread, threadName, &pool);
-            if (pool.threads[i] == 0)
+        for (int i = 0; i < sched.numWorkers; ++i)
+        {
+            worker_t* worker = &sched.workers[i];
+            if (SDL_AtomicGet(&worker->bottom) - SDL_AtomicGet(&worker->top) > 0)
             {
-                goto err;
+                return true;
             }
-
-            pool.started++;
         }
 
-        return;
+        return false;
+    }
 
-    err:
-        releaseMTResources();
+    // Jobs in all deques and injection queue, sampled once per frame by profiler sync point
+    static int64_t sampleQueueDepth(void*)
+    {
+        int64_t depth = SDL_AtomicGet(&sched.injectCount);
+
+        for (int i = 0; i < sched.numWorkers; ++i)
+        {
+            worker_t* worker = &sched.workers[i];
+            depth += core::max(SDL_AtomicGet(&worker->bottom) - SDL_AtomicGet(&worker->top), 0);
+        }
+
+        return depth;
     }
 
-    void fini()
+    static job_t* getJob(worker_t* self)
     {
-        if (SDL_LockMutex(pool.lock) != 0)
+        job_t* job = self ? dequePop(self) : 0;
+
+        if (!job)
         {
-            return;
+            job = injectPop();
         }
 
-        do
+        if (!job && sched.numWorkers > 0)
         {
-            /* Already shutting down */
-            if(pool.shutdown)
+            uint32_t start = 0;
+            if (self)
             {
-                break;
+                // xorshift for victim selection
+                self->rng ^= self->rng << 13;
+                self->rng ^= self->rng >> 17;
+                self->rng ^= self->rng << 5;
+                start = self->rng;
+            }
+
+            for (int i = 0; i < sched.numWorkers && !job; ++i)
+            {
+                worker_t* victim = &sched.workers[(start + i) % sched.numWorkers];
+                if (victim != self)
+                {
+                    job = dequeSteal(victim);
+                }
             }
+        }
+
+        return job;
+    }
 
-            pool.shutdown = 1;
+    static void finishJob(job_t* job)
+    {
+        // Slot can be reused right after unfinished reaches zero, read links first
+        job_t*   parent = job->parent;
+        event_t* event  = job->event;
 
-            /* Wake up all worker threads */
-            if (SDL_CondBroadcast(pool.notify) != 0 ||
-                SDL_UnlockMutex(pool.lock) != 0)
+        if (SDL_AtomicAdd(&job->unfinished, -1) == 1)
+        {
+            if (parent)
             {
-                break;
+                finishJob(parent);
             }
 
-            /* Join all worker thread */
-            for(int i = 0; i < pool.thread_count; i++)
+            if (event)
             {
-                SDL_WaitThread(pool.threads[i], NULL);
+                eventSignal(event);
             }
         }
-        while(0);
+    }
 
-        SDL_UnlockMutex(pool.lock);
-    
-        releaseMTResources();
+    static void executeJob(job_t* job)
+    {
+        (*(job->function))(job->argument);
+        finishJob(job);
     }
 
-    int addAsyncTask(void (*taskFunc)(void *), void *arg, uint32_t* handle)
+    static job_t* jobRingAlloc(job_ring_t* ring)
     {
-        int err = 0;
-        int next;
+        job_t* job = &ring->jobs[ring->next & sched.mask];
 
-        if(taskFunc == NULL)
+        if (SDL_AtomicGet(&job->unfinished) != 0)
+        {
+            return 0;
+        }
+
+        // New generation is visible before unfinished is set, see isJobComplete
+        SDL_AtomicIncRef(&job->generation);
+        ++ring->next;
+
+        return job;
+    }
+
+    static job_t* allocJob()
+    {
+        worker_t* self = getCurrentWorker();
+        if (self)
+        {
+            return jobRingAlloc(&self->ring);
+        }
+
+        SDL_AtomicLock(&sched.injectLock);
+        job_t* job = jobRingAlloc(&sched.sharedRing);
+        SDL_AtomicUnlock(&sched.injectLock);
+
+        return job;
+    }
+
+    job_t* createChildJob(job_t* parent, task_func_t taskFunc, void* arg)
+    {
+        if (taskFunc == NULL || sched.mask == 0)
+        {
+            return 0;
+        }
+
+        job_t* job = allocJob();
+        if (!job)
+        {
+            return 0;
+        }
+
+        if (parent)
+        {
+            SDL_AtomicAdd(&parent->unfinished, 1);
+        }
+
+        job->function = taskFunc;
+        job->argument = arg;
+        job->parent   = parent;
+        job->event    = 0;
+        SDL_AtomicSet(&job->unfinished, 1);
+
+        return job;
+    }
+
+    job_t* createJob(task_func_t taskFunc, void* arg)
+    {
+        return createChildJob(0, taskFunc, arg);
+    }
+
+    job_t* createJobWithData(job_t* parent, task_func_t taskFunc, const void* data, size_t size)
+    {
+        if (size > JOB_DATA_SIZE)
+        {
+            return 0;
+        }
+
+        job_t* job = createChildJob(parent, taskFunc, 0);
+        if (job)
+        {
+            mem_copy(job->data, data, size);
+            job->argument = job->data;
+        }
+
+        return job;
+    }
+
+    int runJob(job_t* job)
+    {
+        if (job == NULL)
         {
             return invalidValue;
         }
 
-        if(SDL_LockMutex(pool.lock) != 0)
+        if (SDL_AtomicGet(&sched.shutdown))
+        {
+            // Job is not run, but slot is released and waiters are signaled
+            finishJob(job);
+            return shutdown;
+        }
+
+        worker_t* self   = getCurrentWorker();
+        bool      queued = self ? dequePush(self, job) : injectPush(job);
+
+        if (!queued)
+        {
+            // Queue is full, do not lose the job
+            executeJob(job);
+            return noError;
+        }
+
+        if (SDL_AtomicGet(&sched.numSleeping) > 0)
         {
-            return lockFailure;
+            SDL_SemPost(sched.wakeup);
         }
 
-        next = pool.tail + 1;
-        next = (next == pool.queue_size) ? 0 : next;
+        return noError;
+    }
+
+    job_handle_t getJobHandle(const job_t* job)
+    {
+        job_handle_t handle = {job, (uint32_t)SDL_AtomicGet((SDL_atomic_t*)&job->generation)};
+        return handle;
+    }
+
+    bool isJobComplete(job_handle_t handle)
+    {
+        SDL_atomic_t* unfinished = (SDL_atomic_t*)&handle.job->unfinished;
+        SDL_atomic_t* generation = (SDL_atomic_t*)&handle.job->generation;
 
-        do
+        // Unfinished is read first: if it belongs to job in reused slot, new generation is visible too
+        return SDL_AtomicGet(unfinished) == 0 || (uint32_t)SDL_AtomicGet(generation) != handle.generation;
+    }
+
+    bool runPendingJob()
+    {
+        job_t* job = getJob(getCurrentWorker());
+        if (job)
         {
-            /* Are we full? */
-            if(pool.count == pool.queue_size)
+            executeJob(job);
+            return true;
+        }
+
+        return false;
+    }
+
+    void waitJob(job_handle_t job)
+    {
+        while (!isJobComplete(job))
+        {
+            if (!runPendingJob())
             {
-                err = queueFull;
-                break;
+                SDL_Delay(0);
+            }
+        }
+    }
+
+    struct task_node_t
+    {
+        task_func_t    function;
+        void*          argument;
+        task_graph_t*  graph;
+        uint32_t       numPredecessors;
+        uint32_t       firstSuccessor;
+        uint32_t       numSuccessors;
+        SDL_atomic_t   pending;
+    };
+
+    struct task_graph_t
+    {
+        task_node_t*   nodes;
+        uint32_t       numNodes;
+        uint32_t       maxNodes;
+
+        // Dependencies as (predecessor, successor) pairs, successors are rebuilt from them on submit
+        task_id_t*     edges;
+        task_id_t*     successors;
+        uint32_t       numEdges;
+        uint32_t       maxEdges;
+        bool           dirty;
+
+        SDL_atomic_t   remaining;
+    };
+
+    task_graph_t* createTaskGraph(size_t maxTasks, size_t maxDependencies)
+    {
+        assert(maxTasks < INVALID_TASK_ID);
+
+        size_t size = sizeof(task_graph_t) +
+                      sizeof(task_node_t) * maxTasks +
+                      sizeof(task_id_t) * maxDependencies * 3;
+
+        task_graph_t* graph = (task_graph_t*)malloc(size);
+        if (!graph)
+        {
+            return 0;
+        }
+
+        memset(graph, 0, sizeof(task_graph_t));
+
+        graph->nodes      = (task_node_t*)(graph + 1);
+        graph->maxNodes   = (uint32_t)maxTasks;
+        graph->edges      = (task_id_t*)(graph->nodes + maxTasks);
+        graph->successors = graph->edges + maxDependencies * 2;
+        graph->maxEdges   = (uint32_t)maxDependencies;
+
+        return graph;
+    }
+
+    void destroyTaskGraph(task_graph_t* graph)
+    {
+        if (graph)
+        {
+            taskGraphWait(graph);
+            free(graph);
+        }
+    }
+
+    void taskGraphClear(task_graph_t* graph)
+    {
+        assert(taskGraphIsComplete(graph));
+
+        graph->numNodes = 0;
+        graph->numEdges = 0;
+        graph->dirty    = true;
+    }
+
+    task_id_t taskGraphAdd(task_graph_t* graph, task_func_t taskFunc, void* arg, const task_id_t* deps, size_t numDeps)
+    {
+        assert(taskGraphIsComplete(graph));
+
+        if (taskFunc == NULL || graph->numNodes == graph->maxNodes || graph->numEdges + numDeps > graph->maxEdges)
+        {
+            return INVALID_TASK_ID;
+        }
+
+        task_id_t    id   = (task_id_t)graph->numNodes++;
+        task_node_t* node = &graph->nodes[id];
+
+        node->function        = taskFunc;
+        node->argument        = arg;
+        node->graph           = graph;
+        node->numPredecessors = (uint32_t)numDeps;
+        node->firstSuccessor  = 0;
+        node->numSuccessors   = 0;
+        SDL_AtomicSet(&node->pending, 0);
+
+        for (size_t i = 0; i < numDeps; ++i)
+        {
+            // Only earlier tasks can be dependencies, so graph can't have cycles
+            assert(deps[i] < id);
+
+            graph->edges[2*graph->numEdges + 0] = deps[i];
+            graph->edges[2*graph->numEdges + 1] = id;
+            ++graph->numEdges;
+        }
+
+        graph->dirty = true;
+
+        return id;
+    }
+
+    static void taskGraphBuildSuccessors(task_graph_t* graph)
+    {
+        for (uint32_t i = 0; i < graph->numNodes; ++i)
+        {
+            graph->nodes[i].numSuccessors = 0;
+        }
+
+        for (uint32_t i = 0; i < graph->numEdges; ++i)
+        {
+            ++graph->nodes[graph->edges[2*i]].numSuccessors;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < graph->numNodes; ++i)
+        {
+            graph->nodes[i].firstSuccessor = offset;
+            offset += graph->nodes[i].numSuccessors;
+            graph->nodes[i].numSuccessors = 0;
+        }
+
+        for (uint32_t i = 0; i < graph->numEdges; ++i)
+        {
+            task_node_t* node = &graph->nodes[graph->edges[2*i]];
+            graph->successors[node->firstSuccessor + node->numSuccessors++] = graph->edges[2*i + 1];
+        }
+
+        graph->dirty = false;
+    }
+
+    static void taskNodeExecute(void* nodePtr);
+
+    static void taskNodeSchedule(task_node_t* node)
+    {
+        job_t* job = createJob(taskNodeExecute, node);
+        if (!job || runJob(job) != noError)
+        {
+            // No free job slot, run continuation in place
+            taskNodeExecute(node);
+        }
+    }
+
+    static void taskNodeExecute(void* nodePtr)
+    {
+        task_node_t*  node  = (task_node_t*)nodePtr;
+        task_graph_t* graph = node->graph;
+
+        (*(node->function))(node->argument);
+
+        for (uint32_t i = 0; i < node->numSuccessors; ++i)
+        {
+            task_node_t* succ = &graph->nodes[graph->successors[node->firstSuccessor + i]];
+            if (SDL_AtomicAdd(&succ->pending, -1) == 1)
+            {
+                taskNodeSchedule(succ);
             }
+        }
+
+        // Must be last: graph can be resubmitted once remaining reaches zero
+        SDL_AtomicAdd(&graph->remaining, -1);
+    }
+
+    int taskGraphSubmit(task_graph_t* graph)
+    {
+        if (graph == NULL)
+        {
+            return invalidValue;
+        }
+
+        if (!taskGraphIsComplete(graph))
+        {
+            return queueFull;
+        }
 
-            /* Are we shutting down? */
-            if(pool.shutdown)
+        if (graph->dirty)
+        {
+            taskGraphBuildSuccessors(graph);
+        }
+
+        for (uint32_t i = 0; i < graph->numNodes; ++i)
+        {
+            SDL_AtomicSet(&graph->nodes[i].pending, graph->nodes[i].numPredecessors);
+        }
+
+        SDL_AtomicSet(&graph->remaining, graph->numNodes);
+
+        for (uint32_t i = 0; i < graph->numNodes; ++i)
+        {
+            task_node_t* node = &graph->nodes[i];
+            if (node->numPredecessors == 0)
             {
-                err = shutdown;
-                break;
+                taskNodeSchedule(node);
             }
+        }
+
+        return noError;
+    }
+
+    bool taskGraphIsComplete(task_graph_t* graph)
+    {
+        return SDL_AtomicGet(&graph->remaining) == 0;
+    }
 
-            event_t* event = 0;
-            if (handle)
+    void taskGraphWait(task_graph_t* graph)
+    {
+        while (!taskGraphIsComplete(graph))
+        {
+            if (!runPendingJob())
             {
-                *handle = eventPoolAllocEvent();
-                event = getEventByHandle(*handle);
+                SDL_Delay(0);
             }
+        }
+    }
+
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    // Minimal number of subranges per worker when grain is selected automatically
+    static const size_t AUTO_GRAIN_SPLITS = 4;
+
+    struct range_ctx_t
+    {
+        range_func_t   func;
+        reduce_func_t  reduce;
+        void*          arg;
+        job_t*         root;
+        size_t         grain;
+
+        // One partial per worker plus one for non worker threads
+        uint8_t*       partials;
+        size_t         partialStride;
+        SDL_SpinLock   foreignLock;
+    };
+
+    struct range_t
+    {
+        range_ctx_t*   ctx;
+        size_t         begin;
+        size_t         end;
+    };
+
+    static void rangeExecute(range_ctx_t* ctx, size_t begin, size_t end)
+    {
+        if (ctx->func)
+        {
+            (*(ctx->func))(ctx->arg, begin, end);
+            return;
+        }
+
+        if (workerIndex >= 0)
+        {
+            (*(ctx->reduce))(ctx->arg, ctx->partials + ctx->partialStride * workerIndex, begin, end);
+            return;
+        }
+
+        SDL_AtomicLock(&ctx->foreignLock);
+        (*(ctx->reduce))(ctx->arg, ctx->partials + ctx->partialStride * sched.numWorkers, begin, end);
+        SDL_AtomicUnlock(&ctx->foreignLock);
+    }
 
-            /* Add task to queue */
-            pool.queue[pool.tail].function = taskFunc;
-            pool.queue[pool.tail].argument = arg;
-            pool.queue[pool.tail].event    = event;
-            pool.tail = next;
-            pool.count += 1;
+    static void rangeTask(void* data);
 
-            /* pthread_cond_broadcast */
-            if (SDL_CondSignal(pool.notify) != 0)
+    static void rangeSplit(range_ctx_t* ctx, size_t begin, size_t end)
+    {
+        // Keep lower half, upper half goes to the deque where thieves can split it further
+        while (end - begin > ctx->grain)
+        {
+            size_t  mid   = begin + (end - begin) / 2;
+            range_t upper = {ctx, mid, end};
+
+            job_t* job = createJobWithData(ctx->root, rangeTask, &upper, sizeof(range_t));
+            if (!job)
             {
-                err = lockFailure;
                 break;
             }
+
+            runJob(job);
+            end = mid;
+        }
+
+        rangeExecute(ctx, begin, end);
+    }
+
+    static void rangeTask(void* data)
+    {
+        range_t range = *(range_t*)data;
+        rangeSplit(range.ctx, range.begin, range.end);
+    }
+
+    static void rangeRootTask(void*) {}
+
+    static void rangeRun(range_ctx_t* ctx, size_t begin, size_t end, size_t grain)
+    {
+        size_t count = end - begin;
+
+        if (grain == 0)
+        {
+            grain = core::max<size_t>(1, count / (core::max(sched.numWorkers, 1) * AUTO_GRAIN_SPLITS));
+        }
+
+        ctx->grain = grain;
+        ctx->root  = 0;
+
+        if (count > grain && sched.numWorkers > 1)
+        {
+            ctx->root = createJob(rangeRootTask, 0);
         }
-        while(0);
 
-        if(SDL_UnlockMutex(pool.lock) != 0)
+        if (!ctx->root)
+        {
+            // Serial fallback: small range, no workers or no free job slots
+            rangeExecute(ctx, begin, end);
+            return;
+        }
+
+        job_handle_t root = getJobHandle(ctx->root);
+
+        rangeSplit(ctx, begin, end);
+
+        executeJob(ctx->root);
+        waitJob(root);
+    }
+
+    void parallel_for(size_t begin, size_t end, size_t grain, range_func_t func, void* arg)
+    {
+        if (func == NULL || begin >= end)
         {
-            err = lockFailure;
+            return;
         }
 
-        return err;
+        range_ctx_t ctx;
+        memset(&ctx, 0, sizeof(range_ctx_t));
+
+        ctx.func = func;
+        ctx.arg  = arg;
+
+        rangeRun(&ctx, begin, end, grain);
+    }
+
+    void parallel_reduce(size_t begin, size_t end, size_t grain,
+                         void* result, const void* identity, size_t partialSize,
+                         reduce_func_t reduce, join_func_t join, void* arg)
+    {
+        if (reduce == NULL || join == NULL || begin >= end)
+        {
+            return;
+        }
+
+        int    numPartials = sched.numWorkers + 1;
+        size_t stride      = core::align_up(partialSize, CACHE_LINE_SIZE);
+
+        range_ctx_t ctx;
+        memset(&ctx, 0, sizeof(range_ctx_t));
+
+        ctx.reduce        = reduce;
+        ctx.arg           = arg;
+        ctx.partialStride = stride;
+        ctx.partials      = (uint8_t*)malloc(stride * numPartials);
+
+        if (!ctx.partials)
+        {
+            return;
+        }
+
+        for (int i = 0; i < numPartials; ++i)
+        {
+            mem_copy(ctx.partials + stride * i, identity, partialSize);
+        }
+
+        rangeRun(&ctx, begin, end, grain);
+
+        for (int i = 0; i < numPartials; ++i)
+        {
+            (*join)(arg, result, ctx.partials + stride * i);
+        }
+
+        free(ctx.partials);
+    }
+
+    int getWorkerCount()
+    {
+        return sched.numWorkers;
+    }
+
+    int getWorkerIndex()
+    {
+        return workerIndex;
     }
 
     static void releaseMTResources()
     {
-        assert(pool.started <= 0);
+        for (int i = 0; i < MAX_WORKERS; ++i)
+        {
+            free(sched.workers[i].deque);
+            free(sched.workers[i].ring.jobs);
+        }
 
-        free(pool.queue);
- 
-        SDL_LockMutex(pool.lock);
-        SDL_DestroyMutex(pool.lock);
-        SDL_DestroyCond(pool.notify);
+        free(sched.injectQueue);
+        free(sched.sharedRing.jobs);
 
-        memset(&pool, 0, sizeof(threadpool_t));
+        if (sched.wakeup)
+        {
+            SDL_DestroySemaphore(sched.wakeup);
+        }
+
+        eventPoolDestroy();
+
+        memset(&sched, 0, sizeof(scheduler_t));
+
+        workerIndex = -1;
     }
 
-    static int SDLCALL threadpoolThread(void* poolPtr)
+    void init(int threadCount, int queueSize)
     {
-        threadpool_t*   pool = (threadpool_t*)poolPtr;
-        task_t          task;
+        char threadName[16] = "Worker";
+
+        if (threadCount < 0)
+        {
+            threadCount = SDL_GetCPUCount() - 1;
+        }
+        threadCount = core::min(core::max(threadCount, 0), MAX_WORKERS - 1);
+
+        memset(&sched, 0, sizeof(scheduler_t));
+
+        eventPoolCreate();
+
+        uint32_t capacity = roundUpPow2(core::max(queueSize, 2));
+        sched.mask        = capacity - 1;
+
+        sched.wakeup          = SDL_CreateSemaphore(0);
+        sched.injectQueue     = (job_t**)malloc(sizeof(job_t*) * capacity);
+        sched.sharedRing.jobs = (job_t*)malloc(sizeof(job_t) * capacity);
+
+        if (sched.wakeup == NULL || sched.injectQueue == NULL || sched.sharedRing.jobs == NULL)
+        {
+            goto err;
+        }
 
-        for(;;)
+        memset(sched.sharedRing.jobs, 0, sizeof(job_t) * capacity);
+
+        // Calling thread becomes worker 0
+        for (int i = 0; i < threadCount + 1; ++i)
         {
-            /* Lock must be taken to wait on conditional variable */
-            SDL_LockMutex(pool->lock);
+            worker_t* worker = &sched.workers[i];
+
+            worker->deque     = (job_t**)malloc(sizeof(job_t*) * capacity);
+            worker->ring.jobs = (job_t*)malloc(sizeof(job_t) * capacity);
+            worker->rng       = 0x9E3779B9 * (i + 1);
 
-            /* Wait on condition variable, check for spurious wakeups.
-               When returning from pthread_cond_wait(), we own the lock. */
-            while((pool->count == 0) && (!pool->shutdown))
+            if (worker->deque == NULL || worker->ring.jobs == NULL)
             {
-                SDL_CondWait(pool->notify, pool->lock);
+                goto err;
             }
 
-            if(pool->shutdown)
+            memset(worker->ring.jobs, 0, sizeof(job_t) * capacity);
+        }
+
+        sched.numWorkers = threadCount + 1;
+        workerIndex      = 0;
+
+        sched.queueDepthGauge = profilerAddGaugeSampler("mt queue depth", sampleQueueDepth, 0);
+
+        for (int i = 1; i < sched.numWorkers; i++)
+        {
+            SDL_snprintf(threadName, sizeof(threadName), "Worker%d", i);
+
+            sched.workers[i].thread = SDL_CreateThread(workerThread, threadName, &sched.workers[i]);
+            if (sched.workers[i].thread == 0)
             {
+                sched.numWorkers = i;
                 break;
             }
+        }
+
+        return;
 
-            /* Grab our task */
-            task.function = pool->queue[pool->head].function;
-            task.argument = pool->queue[pool->head].argument;
-            task.event    = pool->queue[pool->head].event;
+    err:
+        releaseMTResources();
+    }
+
+    void fini()
+    {
+        if (sched.numWorkers == 0 || SDL_AtomicGet(&sched.shutdown))
+        {
+            return;
+        }
 
-            pool->head += 1;
-            pool->head = (pool->head == pool->queue_size) ? 0 : pool->head;
-            pool->count -= 1;
+        // Drain what is already queued
+        worker_t* self = getCurrentWorker();
+        while (job_t* job = getJob(self))
+        {
+            executeJob(job);
+        }
 
-            /* Unlock */
-            SDL_UnlockMutex(pool->lock);
+        SDL_AtomicSet(&sched.shutdown, 1);
 
-            (*(task.function))(task.argument);
+        /* Wake up all worker threads */
+        for (int i = 1; i < sched.numWorkers; i++)
+        {
+            SDL_SemPost(sched.wakeup);
+        }
 
-            if (task.event)
+        /* Join all worker thread */
+        for (int i = 1; i < sched.numWorkers; i++)
+        {
+            SDL_WaitThread(sched.workers[i].thread, NULL);
+        }
+
+        profilerRemoveGaugeSampler(sched.queueDepthGauge);
+
+        releaseMTResources();
+    }
+
+    static int SDLCALL workerThread(void* workerPtr)
+    {
+        worker_t* self = (worker_t*)workerPtr;
+
+        workerIndex = (int)(self - sched.workers);
+
+        char threadName[16];
+        SDL_snprintf(threadName, sizeof(threadName), "Worker%d", workerIndex);
+        profilerRegisterThread(threadName);
+
+        while (!SDL_AtomicGet(&sched.shutdown))
+        {
+            job_t* job = getJob(self);
+            if (job)
             {
-                SDL_LockMutex(task.event->mutex);
-                task.event->signaled = true;
-                SDL_CondBroadcast(task.event->cond);
-                SDL_UnlockMutex(task.event->mutex);
+                executeJob(job);
+                continue;
             }
-        }
 
-        pool->started--;
+            SDL_AtomicAdd(&sched.numSleeping, 1);
+            // Recheck after announcing sleep, runJob could miss us otherwise
+            if (!hasPendingJobs() && !SDL_AtomicGet(&sched.shutdown))
+            {
+                SDL_SemWaitTimeout(sched.wakeup, IDLE_WAIT_MS);
+            }
+            SDL_AtomicAdd(&sched.numSleeping, -1);
+        }
 
-        SDL_UnlockMutex(pool->lock);
+        profilerUnregisterThread();
 
         return 0;
     }
+
+    int addAsyncTask(void (*taskFunc)(void *), void *arg, uint32_t* handle)
+    {
+        if (!taskFunc)
+        {
+            return invalidValue;
+        }
+
+        uint32_t event = INVALID_HANDLE;
+
+        if (handle)
+        {
+            *handle = INVALID_HANDLE;
+
+            event = eventPoolAllocEvent();
+            if (event == INVALID_HANDLE)
+            {
+                return queueFull;
+            }
+        }
+
+        job_t* job = createJob(taskFunc, arg);
+        if (!job)
+        {
+            if (handle) eventPoolReleaseEvent(event);
+            return queueFull;
+        }
+
+        if (handle) job->event = getEventByHandle(event);
+
+        int result = runJob(job);
+
+        if (result != noError)
+        {
+            if (handle) eventPoolReleaseEvent(event);
+            return result;
+        }
+
+        if (handle) *handle = event;
+
+        return noError;
+    }
+
+    void syncAndReleaseEvent(uint32_t handle)
+    {
+        event_t* event = getEventByHandle(handle);
+        assert(event);
+
+        // Help with other jobs instead of blocking the worker
+        while (!SDL_AtomicGet(&event->signaled))
+        {
+            if (runPendingJob())
+            {
+                continue;
+            }
+
+            SDL_LockMutex(event->mutex);
+            if (!SDL_AtomicGet(&event->signaled))
+            {
+                SDL_CondWaitTimeout(event->cond, event->mutex, 1);
+            }
+            SDL_UnlockMutex(event->mutex);
+        }
+
+        eventPoolReleaseEvent(handle);
+    }
 }
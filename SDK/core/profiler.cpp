@@ -1,73 +1,534 @@
 #include <SDL2/SDL.h>
 #include <core/profiler.h>
+#include <Remotery.h>
 
-#define LOG2_RES 21
-#define MAX_PROFILER_IDS        2048
-
-static_assert(MAX_PROFILER_IDS<=0x10000, "Maximum id should not exceed capacity of uint16_t");
-
-static atomic_t          lastId        = 0;
-static atomic_t          doCapture     = 0;
-static atomic_t          captureActive = 0;
+static atomic_t          lastId          = 0;
+static atomic_t          captureActive   = 0;
+static atomic_t          snapshotPending = 0;
+static uint64_t          captureStart;
+static uint64_t          captureEnd;
 static const char*       idNames[MAX_PROFILER_IDS];
 
 static event_capture_t capture;
 
-void event_capture_init(event_capture_t* capture, uint64_t freq, uint32_t log2res)
+struct profiler_thread_event_t
+{
+    uint64_t timestamp;
+    uint16_t id;
+    uint16_t phase;
+    int32_t  value;
+};
+
+static_assert(sizeof(profiler_thread_event_t)==16, "Fix packing in profiler_thread_event_t in order ro maintain smaller event size");
+
+// Single producer (owning thread) ring, consumers (snapshots) copy events
+// and validate afterwards that producer did not overwrite them during copy.
+struct profiler_thread_t
+{
+    volatile uint32_t         writeIndex;   //Total number of events written, wraps
+    volatile uint32_t         startIndex;   //Events before it belong to previous owner of slot
+    volatile bool             wrapped;      //Ring was filled at least once
+    uint32_t                  numDropped;
+    uint16_t                  index;
+    bool                      used;
+    uint32_t                  remoteGeneration; //Last seen remoteGeneration
+    uint32_t                  scopeDepth;
+    uint64_t                  remoteScopes;     //Bit per depth, scope was begun in Remotery
+    char                      name[MAX_PROFILER_THREAD_NAME];
+    profiler_thread_event_t*  events;
+};
+
+static const uint32_t THREAD_EVENTS_MASK = MAX_PROFILER_THREAD_EVENTS - 1;
+static const uint32_t FRAMES_MASK        = MAX_PROFILER_FRAMES - 1;
+
+static profiler_thread_t  threads[MAX_PROFILER_THREADS];
+static uint16_t           numThreads;
+static SDL_SpinLock       threadsLock;
+
+// Merge buffer of snapshots, grows to fill level of rings and is kept until profilerFini
+static profiler_thread_event_t*  snapshotScratch;
+static uint32_t                  snapshotScratchSize;
+
+// Start times of last frames, written by thread calling sync points
+static uint64_t           frameStarts[MAX_PROFILER_FRAMES];
+static uint32_t           frameCount;
+static uint16_t           frameMarkerId;
+
+struct profiler_frame_counter_t
+{
+    uint16_t      id;
+    SDL_atomic_t  value;
+};
+
+struct profiler_gauge_sampler_desc_t
+{
+    uint16_t                  id;
+    profiler_gauge_sampler_t  sampler;
+    void*                     arg;
+};
+
+// Slot index + 1 of frame counter for every id, 0 if counter is not registered yet
+static volatile uint8_t          frameCounterSlots[MAX_PROFILER_IDS];
+static profiler_frame_counter_t  frameCounters[MAX_PROFILER_FRAME_COUNTERS];
+static volatile uint32_t         numFrameCounters;
+static SDL_SpinLock              frameCountersLock;
+
+static profiler_gauge_sampler_desc_t  gaugeSamplers[MAX_PROFILER_GAUGE_SAMPLERS];
+static uint32_t                       numGaugeSamplers;
+static SDL_SpinLock                   gaugeSamplersLock;
+
+// Remotery instance is created on first enable and lives until profilerFini, so
+// threads never race with its destruction. Odd generation means forwarding is enabled,
+// threads notice generation change on next scope and close samples begun before it.
+static Remotery*          remoteInstance;
+static volatile uint32_t  remoteGeneration;
+static SDL_SpinLock       remoteLock;
+static rmtU32             remoteNameHashes[MAX_PROFILER_IDS];
+
+static CORE_THREAD_LOCAL profiler_thread_t* currentThread;
+
+void event_capture_init(event_capture_t* capture, uint64_t freq)
 {
     assert(capture);
     assert(freq);
 
-    uint32_t log2 = bit_fls(freq);
-    uint32_t quantShift = log2 > log2res ? log2-log2res : 0;
-
-    capture->freq       = freq;
-    capture->quantShift = quantShift;
-    capture->maxPeriod  = (1ul<<TIME_BITS)<<quantShift;
+    capture->freq = freq;
 }
 
 void event_capture_start(event_capture_t* capture, uint64_t startTime)
 {
-    capture->numEvents = 0;
-    capture->startTime = startTime;
+    capture->numEvents  = 0;
+    capture->numDropped = 0;
+    capture->numFrames  = 0;
+    capture->startTime  = startTime;
 }
 
 void event_capture_stop(event_capture_t* capture, uint64_t endTime)
 {
-    capture->endTime = (uint32_t)core::min((endTime-capture->startTime) >> capture->quantShift, (1ull<<TIME_BITS)-1);
+    capture->endTime = endTime > capture->startTime ? endTime - capture->startTime : 0;
 }
-void event_capture_add(event_capture_t* capture, uint16_t trackID, uint16_t eventID, EventPhase eventPhase, uint64_t ts)
+
+// Capture has single writer (snapshot step), so no interlocked operations are needed.
+// Counter takes two events, high part of value is never dropped alone.
+void event_capture_add(event_capture_t* capture, uint16_t trackID, uint16_t eventID, EventPhase eventPhase, uint64_t ts, int64_t value)
 {
-    atomic_t count = _InterlockedIncrement(&capture->numEvents);
-    if (count<=capture->numEvents)
+    atomic_t count    = capture->numEvents;
+    uint32_t numSlots = eventPhase == PROF_EVENT_PHASE_COUNTER ? 2 : 1;
+
+    assert(eventPhase != PROF_EVENT_PHASE_COUNTER_HIGH);
+
+    if ((uint32_t)count + numSlots <= capture->maxEvents)
     {
-        profiler_event_t&  evt = capture->events[count-1];
+        profiler_event_t&  evt = capture->events[count];
         evt.id        = eventID;
-        evt.phase     = eventPhase;
-        evt.tid       = trackID;
-        evt.timestamp = core::min((ts-capture->startTime) >> capture->quantShift, (1ull<<TIME_BITS)-1);
+        evt.phase     = (uint8_t)eventPhase;
+        evt.tid       = (uint8_t)trackID;
+        evt.timestamp = ts > capture->startTime ? ts - capture->startTime : 0;
+        evt.value     = (int32_t)(uint32_t)value;
+
+        if (numSlots == 2)
+        {
+            profiler_event_t& high = capture->events[count + 1];
+            high       = evt;
+            high.phase = PROF_EVENT_PHASE_COUNTER_HIGH;
+            high.value = (int32_t)(value >> 32);
+        }
+
+        capture->numEvents = count + numSlots;
     }
     else
     {
-        _InterlockedDecrement(&capture->numEvents);
+        ++capture->numDropped;
     }
 }
 
 void profilerInit()
 {
-    event_capture_init(&capture, SDL_GetPerformanceFrequency(), LOG2_RES);
+    event_capture_init(&capture, SDL_GetPerformanceFrequency());
+    capture.maxEvents = MAX_PROFILER_EVENTS;
+
+    frameMarkerId = profilerGenerateId();
+    profilerAddDesc(frameMarkerId, "Frame marker");
+
+    profilerRegisterThread("Main");
+}
+
+void profilerFini()
+{
+    SDL_AtomicLock(&remoteLock);
+    if (remoteInstance)
+    {
+        remoteGeneration += remoteGeneration & 1;
+        rmt_DestroyGlobalInstance(remoteInstance);
+        remoteInstance = 0;
+    }
+    SDL_AtomicUnlock(&remoteLock);
+
+    free(snapshotScratch);
+    snapshotScratch     = 0;
+    snapshotScratchSize = 0;
+}
+
+bool profilerSetRemoteEnabled(bool enable)
+{
+    SDL_AtomicLock(&remoteLock);
+
+    if (enable && !remoteInstance && rmt_CreateGlobalInstance(&remoteInstance) != RMT_ERROR_NONE)
+    {
+        remoteInstance = 0;
+    }
+
+    bool enabled = enable && remoteInstance;
+    if (enabled != ((remoteGeneration & 1) != 0))
+    {
+        // Instance is published before threads see odd generation
+        SDL_MemoryBarrierRelease();
+        ++remoteGeneration;
+    }
+
+    SDL_AtomicUnlock(&remoteLock);
+
+    return enabled;
+}
+
+bool profilerIsRemoteEnabled()
+{
+    return (remoteGeneration & 1) != 0;
+}
+
+static profiler_thread_t* profilerAcquireThread(const char* name)
+{
+    profiler_thread_t* thread = 0;
+
+    SDL_AtomicLock(&threadsLock);
+
+    // Reuse slot of exited thread, buffer stays allocated
+    for (uint16_t i = 0; i < numThreads && !thread; ++i)
+    {
+        if (!threads[i].used)
+        {
+            thread = &threads[i];
+        }
+    }
+
+    if (!thread && numThreads < MAX_PROFILER_THREADS)
+    {
+        thread = &threads[numThreads];
+        thread->index  = numThreads;
+        thread->events = (profiler_thread_event_t*)malloc(sizeof(profiler_thread_event_t)*MAX_PROFILER_THREAD_EVENTS);
+        if (thread->events)
+        {
+            ++numThreads;
+        }
+        else
+        {
+            thread = 0;
+        }
+    }
+
+    if (thread)
+    {
+        // Events of previous owner are not reported under new name
+        thread->startIndex       = thread->writeIndex;
+        thread->used             = true;
+        thread->remoteGeneration = 0;
+        thread->scopeDepth       = 0;
+        thread->remoteScopes     = 0;
+        if (name)
+        {
+            SDL_snprintf(thread->name, MAX_PROFILER_THREAD_NAME, "%s", name);
+        }
+        else
+        {
+            SDL_snprintf(thread->name, MAX_PROFILER_THREAD_NAME, "Thread %u", thread->index);
+        }
+    }
+
+    SDL_AtomicUnlock(&threadsLock);
+
+    return thread;
+}
+
+uint16_t profilerRegisterThread(const char* name)
+{
+    if (!currentThread)
+    {
+        currentThread = profilerAcquireThread(name);
+    }
+    else if (name)
+    {
+        SDL_snprintf(currentThread->name, MAX_PROFILER_THREAD_NAME, "%s", name);
+
+        if (currentThread->remoteGeneration & 1)
+        {
+            rmt_SetCurrentThreadName(currentThread->name);
+        }
+    }
+
+    assert(currentThread);
+
+    return currentThread->index;
+}
+
+void profilerUnregisterThread()
+{
+    if (currentThread)
+    {
+        SDL_AtomicLock(&threadsLock);
+        currentThread->used = false;
+        SDL_AtomicUnlock(&threadsLock);
+
+        currentThread = 0;
+    }
+}
+
+uint16_t profilerGetThreadCount()
+{
+    return numThreads;
+}
+
+const char* profilerGetThreadName(uint16_t threadIndex)
+{
+    assert(threadIndex < numThreads);
+    return threads[threadIndex].name;
+}
+
+uint32_t profilerGetThreadDropped(uint16_t threadIndex)
+{
+    assert(threadIndex < numThreads);
+    return threads[threadIndex].numDropped;
+}
+
+static void profilerPushEvent(profiler_thread_t* thread, uint16_t id, EventPhase eventPhase, uint64_t ts, int32_t value = 0)
+{
+    uint32_t idx = thread->writeIndex;
+
+    profiler_thread_event_t& evt = thread->events[idx & THREAD_EVENTS_MASK];
+    evt.timestamp = ts;
+    evt.value     = value;
+    evt.id        = id;
+    evt.phase     = (uint16_t)eventPhase;
+
+    // Publish event to snapshots
+    SDL_CompilerBarrier();
+    thread->writeIndex = idx + 1;
+    if (idx == THREAD_EVENTS_MASK)
+    {
+        thread->wrapped = true;
+    }
+}
+
+// Halves of counter are published one by one, so snapshot validates overwritten slots
+// as for other events. Counter without high part is incomplete and skipped by snapshot.
+static void profilerPushCounter(profiler_thread_t* thread, uint16_t id, uint64_t ts, int64_t value)
+{
+    profilerPushEvent(thread, id, PROF_EVENT_PHASE_COUNTER,      ts, (int32_t)(uint32_t)value);
+    profilerPushEvent(thread, id, PROF_EVENT_PHASE_COUNTER_HIGH, ts, (int32_t)(value >> 32));
+}
+
+struct profiler_segment_t
+{
+    profiler_thread_event_t* events;
+    uint32_t                 count;
+    uint32_t                 cursor;
+};
+
+// Copy events of thread ring within [from, to] into dst, events overwritten
+// during copy are removed from the front of the segment.
+static uint32_t profilerCopyThreadEvents(profiler_thread_t* thread, profiler_thread_event_t* dst, uint32_t maxEvents, uint64_t from, uint64_t to, uint32_t* dropped)
+{
+    // Flag is set after index is published, read it first
+    bool     wrapped = thread->wrapped;
+    SDL_CompilerBarrier();
+    uint32_t end     = thread->writeIndex;
+    uint32_t owned   = end - thread->startIndex;
+    // Oldest slot of full ring is the next one producer writes to, it is never read
+    uint32_t avail   = wrapped ? THREAD_EVENTS_MASK : core::min(end, THREAD_EVENTS_MASK);
+    // Slot acquired after writeIndex was read owns no events yet
+    avail            = (int32_t)owned > 0 ? core::min(avail, owned) : 0;
+    uint32_t begin   = end - avail;
+
+    // Events below published index are complete
+    SDL_CompilerBarrier();
+
+    // Rings are ordered by time, skip events before window with binary search
+    uint32_t lo = 0, hi = avail;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (thread->events[(begin + mid) & THREAD_EVENTS_MASK].timestamp < from)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    uint32_t first = begin + lo;
+    uint32_t count = 0;
+    for (uint32_t i = lo; i < avail && count < maxEvents; ++i)
+    {
+        const profiler_thread_event_t& evt = thread->events[(begin + i) & THREAD_EVENTS_MASK];
+        if (evt.timestamp > to) break;
+        dst[count++] = evt;
+    }
+
+    SDL_CompilerBarrier();
+
+    // Slot of event i is reused once producer starts writing event i+ring size
+    uint32_t valid   = thread->writeIndex + 1 - MAX_PROFILER_THREAD_EVENTS;
+    uint32_t invalid = (int32_t)(valid - first) > 0 ? core::min(valid - first, count) : 0;
+
+    if (invalid)
+    {
+        memmove(dst, dst + invalid, (count - invalid) * sizeof(profiler_thread_event_t));
+        count -= invalid;
+
+        thread->numDropped += invalid;
+        *dropped           += invalid;
+    }
+
+    return count;
+}
+
+// Per thread rings are ordered by time, k-way merge keeps capture ordered as well
+static void profilerSnapshot(uint64_t from, uint64_t to)
+{
+    profiler_segment_t segments[MAX_PROFILER_THREADS];
+    uint16_t           count   = numThreads;
+    uint32_t           dropped = 0;
+    uint32_t           total   = 0;
+
+    event_capture_start(&capture, from);
+
+    // Events written during copy are outside of window, fill level is upper bound
+    uint32_t required = 0;
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        required += threads[i].wrapped ? THREAD_EVENTS_MASK : core::min(threads[i].writeIndex, THREAD_EVENTS_MASK);
+    }
+    required = core::min(required, (uint32_t)MAX_PROFILER_EVENTS);
+
+    if (required > snapshotScratchSize)
+    {
+        free(snapshotScratch);
+        snapshotScratch     = (profiler_thread_event_t*)malloc(sizeof(profiler_thread_event_t)*required);
+        snapshotScratchSize = snapshotScratch ? required : 0;
+    }
+
+    if (!snapshotScratch)
+    {
+        event_capture_stop(&capture, to);
+        return;
+    }
+
+    profiler_thread_event_t* scratch = snapshotScratch;
+
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        segments[i].events = scratch + total;
+        segments[i].count  = profilerCopyThreadEvents(&threads[i], scratch + total, required - total, from, to, &dropped);
+        segments[i].cursor = 0;
+
+        total += segments[i].count;
+    }
+
+    for (;;)
+    {
+        int      next   = -1;
+        uint64_t nextTs = 0;
+
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            if (segments[i].cursor < segments[i].count)
+            {
+                uint64_t ts = segments[i].events[segments[i].cursor].timestamp;
+                if (next < 0 || ts < nextTs)
+                {
+                    next   = i;
+                    nextTs = ts;
+                }
+            }
+        }
+
+        if (next < 0)
+        {
+            break;
+        }
+
+        profiler_segment_t&            segment = segments[next];
+        const profiler_thread_event_t& evt     = segment.events[segment.cursor++];
+        int64_t                        value   = 0;
+
+        // Low part was overwritten in ring or is outside of window
+        if (evt.phase == PROF_EVENT_PHASE_COUNTER_HIGH)
+        {
+            continue;
+        }
+
+        if (evt.phase == PROF_EVENT_PHASE_COUNTER)
+        {
+            // High part is not published yet or was not copied
+            if (segment.cursor == segment.count || segment.events[segment.cursor].phase != PROF_EVENT_PHASE_COUNTER_HIGH)
+            {
+                continue;
+            }
+
+            const profiler_thread_event_t& high = segment.events[segment.cursor++];
+            value = (int64_t)(((uint64_t)(uint32_t)high.value << 32) | (uint32_t)evt.value);
+        }
+
+        if (evt.phase == PROF_EVENT_PHASE_MARKER && evt.id == frameMarkerId)
+        {
+            ++capture.numFrames;
+        }
+        event_capture_add(&capture, (uint16_t)next, evt.id, (EventPhase)evt.phase, evt.timestamp, value);
+    }
+
+    capture.numDropped += dropped;
+    event_capture_stop(&capture, to);
+}
+
+uint32_t profilerSnapshotFrames(uint32_t numFrames)
+{
+    assert(!captureActive && !snapshotPending);
+
+    // Last recorded frame is still in progress
+    uint32_t complete = frameCount > 0 ? frameCount - 1 : 0;
+
+    numFrames = core::min(numFrames, complete);
+    numFrames = core::min(numFrames, (uint32_t)MAX_PROFILER_FRAMES - 1);
+
+    if (numFrames == 0)
+    {
+        uint64_t now = SDL_GetPerformanceCounter();
+        event_capture_start(&capture, now);
+        event_capture_stop(&capture, now);
+        return 0;
+    }
+
+    // Marker of frame in progress is excluded from snapshot
+    uint64_t from = frameStarts[(frameCount - 1 - numFrames) & FRAMES_MASK];
+    uint64_t to   = frameStarts[(frameCount - 1) & FRAMES_MASK] - 1;
+
+    profilerSnapshot(from, to);
+
+    return numFrames;
 }
 
 void profilerStartCapture()
 {
     captureActive = TRUE;
-    event_capture_start(&capture, SDL_GetPerformanceCounter());
+    captureStart  = SDL_GetPerformanceCounter();
 }
 
 void profilerStopCapture()
 {
-    captureActive = FALSE;
-    event_capture_stop(&capture, SDL_GetPerformanceCounter());
+    captureActive   = FALSE;
+    snapshotPending = TRUE;
+    captureEnd      = SDL_GetPerformanceCounter();
 }
 
 int profilerIsCaptureActive()
@@ -77,27 +538,183 @@ int profilerIsCaptureActive()
 
 void profilerStartSyncPoint()
 {
-    doCapture = captureActive;
+    uint64_t ts = SDL_GetPerformanceCounter();
+
+    profilerRegisterThread(0);
+
+    // Totals and samples belong to previous frame, they are recorded before its end
+    uint32_t count = numFrameCounters;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        int32_t total = SDL_AtomicSet(&frameCounters[i].value, 0);
+        profilerPushCounter(currentThread, frameCounters[i].id, ts, total);
+    }
+
+    SDL_AtomicLock(&gaugeSamplersLock);
+    for (uint32_t i = 0; i < numGaugeSamplers; ++i)
+    {
+        const profiler_gauge_sampler_desc_t& desc = gaugeSamplers[i];
+        profilerPushCounter(currentThread, desc.id, ts, desc.sampler(desc.arg));
+    }
+    SDL_AtomicUnlock(&gaugeSamplersLock);
+
+    uint64_t frameStart = core::max(SDL_GetPerformanceCounter(), ts + 1);
+
+    frameStarts[frameCount & FRAMES_MASK] = frameStart;
+    ++frameCount;
+
+    profilerPushEvent(currentThread, frameMarkerId, PROF_EVENT_PHASE_MARKER, frameStart);
 }
 
 void profilerStopSyncPoint()
 {
-    if (!captureActive)
+    if (snapshotPending)
     {
-        doCapture = FALSE;
+        snapshotPending = FALSE;
+        profilerSnapshot(captureStart, captureEnd);
+    }
+}
+
+// Called by owning thread only
+static void profilerForwardRemote(profiler_thread_t* thread, uint16_t id, EventPhase eventPhase)
+{
+    uint32_t generation = remoteGeneration;
+
+    if (generation != thread->remoteGeneration)
+    {
+        SDL_MemoryBarrierAcquire();
+
+        // Close samples of previous generation, so Remotery sample stack stays balanced
+        for (uint64_t scopes = thread->remoteScopes; scopes; scopes &= scopes - 1)
+        {
+            rmt_EndCPUSample();
+        }
+
+        thread->remoteGeneration = generation;
+        thread->remoteScopes     = 0;
+
+        if (generation & 1)
+        {
+            rmt_SetCurrentThreadName(thread->name);
+        }
+    }
+
+    if (eventPhase == PROF_EVENT_PHASE_BEGIN)
+    {
+        uint32_t depth = thread->scopeDepth++;
+        if ((generation & 1) && depth < 64 && idNames[id])
+        {
+            _rmt_BeginCPUSample(idNames[id], &remoteNameHashes[id]);
+            thread->remoteScopes |= 1ull << depth;
+        }
+    }
+    // Scopes opened before thread registration have no begin
+    else if (eventPhase == PROF_EVENT_PHASE_END && thread->scopeDepth > 0)
+    {
+        uint32_t depth = --thread->scopeDepth;
+        if (depth < 64 && (thread->remoteScopes & (1ull << depth)))
+        {
+            thread->remoteScopes &= ~(1ull << depth);
+            rmt_EndCPUSample();
+        }
     }
 }
 
 void profilerAddCPUEvent(uint16_t id, EventPhase eventPhase)
 {
     assert(id < lastId);
-    if (!doCapture) return;
 
-    SDL_threadID  tid = SDL_ThreadID();
-    //TODO: Quick hack! Works on win32
-    assert(tid<=65535);
+    profiler_thread_t* thread = currentThread;
+    if (!thread)
+    {
+        profilerRegisterThread(0);
+        thread = currentThread;
+        if (!thread) return;
+    }
 
-    event_capture_add(&capture, (uint16_t)tid, id, eventPhase, SDL_GetPerformanceCounter());
+    profilerPushEvent(thread, id, eventPhase, SDL_GetPerformanceCounter());
+    profilerForwardRemote(thread, id, eventPhase);
+}
+
+void profilerAddGauge(uint16_t id, int64_t value)
+{
+    assert(id < lastId);
+
+    profiler_thread_t* thread = currentThread;
+    if (!thread)
+    {
+        profilerRegisterThread(0);
+        thread = currentThread;
+        if (!thread) return;
+    }
+
+    profilerPushCounter(thread, id, SDL_GetPerformanceCounter(), value);
+}
+
+void profilerAddFrameCounter(uint16_t id, int32_t delta)
+{
+    assert(id < lastId);
+
+    uint32_t slot = frameCounterSlots[id];
+    if (!slot)
+    {
+        SDL_AtomicLock(&frameCountersLock);
+        slot = frameCounterSlots[id];
+        if (!slot && numFrameCounters < MAX_PROFILER_FRAME_COUNTERS)
+        {
+            frameCounters[numFrameCounters].id = id;
+            SDL_AtomicSet(&frameCounters[numFrameCounters].value, 0);
+
+            slot = numFrameCounters + 1;
+            frameCounterSlots[id] = (uint8_t)slot;
+
+            // Publish counter to sync point after it is initialized
+            SDL_CompilerBarrier();
+            ++numFrameCounters;
+        }
+        SDL_AtomicUnlock(&frameCountersLock);
+
+        assert(slot && "Increase MAX_PROFILER_FRAME_COUNTERS");
+        if (!slot) return;
+    }
+
+    SDL_AtomicAdd(&frameCounters[slot - 1].value, delta);
+}
+
+uint16_t profilerAddGaugeSampler(const char* name, profiler_gauge_sampler_t sampler, void* arg)
+{
+    assert(sampler);
+
+    uint16_t id = 0xFFFF;
+
+    SDL_AtomicLock(&gaugeSamplersLock);
+    if (numGaugeSamplers < MAX_PROFILER_GAUGE_SAMPLERS)
+    {
+        id = profilerGenerateId();
+        profilerAddDesc(id, name);
+
+        profiler_gauge_sampler_desc_t& desc = gaugeSamplers[numGaugeSamplers++];
+        desc.id      = id;
+        desc.sampler = sampler;
+        desc.arg     = arg;
+    }
+    SDL_AtomicUnlock(&gaugeSamplersLock);
+
+    return id;
+}
+
+void profilerRemoveGaugeSampler(uint16_t id)
+{
+    SDL_AtomicLock(&gaugeSamplersLock);
+    for (uint32_t i = 0; i < numGaugeSamplers; ++i)
+    {
+        if (gaugeSamplers[i].id == id)
+        {
+            gaugeSamplers[i] = gaugeSamplers[--numGaugeSamplers];
+            break;
+        }
+    }
+    SDL_AtomicUnlock(&gaugeSamplersLock);
 }
 
 uint16_t profilerGenerateId()
@@ -115,12 +732,289 @@ void profilerAddDesc(uint16_t id, const char* name)
 
 event_capture_t* profilerGetData()
 {
-    assert(!captureActive && !doCapture);
+    assert(!captureActive && !snapshotPending);
     return &capture;
 }
 
 const char** profilerGetNames()
 {
-    assert(!captureActive && !doCapture);
+    assert(!captureActive && !snapshotPending);
     return idNames;
 }
+
+uint16_t profilerGetIdCount()
+{
+    return (uint16_t)lastId;
+}
+
+// Buffered writer, SDL_RWops do not buffer writes
+struct profiler_writer_t
+{
+    SDL_RWops* rw;
+    uint8_t*   buffer;
+    size_t     used;
+    bool       ok;
+};
+
+static const size_t PROFILER_WRITER_BUFFER_SIZE = 64*1024;
+
+static bool writerOpen(profiler_writer_t* writer, const char* path)
+{
+    writer->rw     = SDL_RWFromFile(path, "wb");
+    writer->buffer = (uint8_t*)malloc(PROFILER_WRITER_BUFFER_SIZE);
+    writer->used   = 0;
+    writer->ok     = writer->rw && writer->buffer;
+
+    return writer->ok;
+}
+
+static void writerFlush(profiler_writer_t* writer)
+{
+    if (writer->ok && writer->used)
+    {
+        writer->ok   = SDL_RWwrite(writer->rw, writer->buffer, writer->used, 1) == 1;
+        writer->used = 0;
+    }
+}
+
+static bool writerClose(profiler_writer_t* writer)
+{
+    writerFlush(writer);
+
+    if (writer->rw)     SDL_RWclose(writer->rw);
+    if (writer->buffer) free(writer->buffer);
+
+    return writer->ok;
+}
+
+static void writerPut(profiler_writer_t* writer, const void* data, size_t size)
+{
+    if (writer->used + size > PROFILER_WRITER_BUFFER_SIZE)
+    {
+        writerFlush(writer);
+    }
+
+    if (writer->ok)
+    {
+        assert(size <= PROFILER_WRITER_BUFFER_SIZE);
+        memcpy(writer->buffer + writer->used, data, size);
+        writer->used += size;
+    }
+}
+
+static void writerPrint(profiler_writer_t* writer, const char* fmt, ...)
+{
+    char    str[256];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = SDL_vsnprintf(str, sizeof(str), fmt, args);
+    va_end(args);
+
+    if (len > 0)
+    {
+        writerPut(writer, str, core::min((size_t)len, sizeof(str) - 1));
+    }
+}
+
+static void writerPutJsonString(profiler_writer_t* writer, const char* str)
+{
+    writerPut(writer, "\"", 1);
+    for (; str && *str; ++str)
+    {
+        char c = *str;
+        if (c == '"' || c == '\\')
+        {
+            char escaped[2] = {'\\', c};
+            writerPut(writer, escaped, 2);
+        }
+        else if ((uint8_t)c < 0x20)
+        {
+            writerPrint(writer, "\\u%04x", (uint32_t)(uint8_t)c);
+        }
+        else
+        {
+            writerPut(writer, &c, 1);
+        }
+    }
+    writerPut(writer, "\"", 1);
+}
+
+static void writerPutU16(profiler_writer_t* writer, uint16_t value)
+{
+    uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    writerPut(writer, bytes, 2);
+}
+
+static void writerPutU32(profiler_writer_t* writer, uint32_t value)
+{
+    writerPutU16(writer, (uint16_t)value);
+    writerPutU16(writer, (uint16_t)(value >> 16));
+}
+
+static void writerPutU64(profiler_writer_t* writer, uint64_t value)
+{
+    writerPutU32(writer, (uint32_t)value);
+    writerPutU32(writer, (uint32_t)(value >> 32));
+}
+
+// LEB128, 7 bits per byte, high bit marks continuation
+static void writerPutVarint(profiler_writer_t* writer, uint64_t value)
+{
+    uint8_t bytes[10];
+    size_t  count = 0;
+
+    do
+    {
+        bytes[count] = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        bytes[count] |= value ? 0x80 : 0x00;
+        ++count;
+    }
+    while (value);
+
+    writerPut(writer, bytes, count);
+}
+
+static void writerPutBinaryString(profiler_writer_t* writer, const char* str)
+{
+    size_t len = str ? core::min(strlen(str), (size_t)0xFFFF) : 0;
+    writerPutU16(writer, (uint16_t)len);
+    writerPut(writer, str, len);
+}
+
+static const char* profilerTrackName(uint16_t tid)
+{
+    return tid < numThreads ? threads[tid].name : "";
+}
+
+bool event_capture_export_json(const event_capture_t* capture, const char** names, uint16_t numNames, const char* path)
+{
+    profiler_writer_t writer;
+
+    if (!writerOpen(&writer, path))
+    {
+        writerClose(&writer);
+        return false;
+    }
+
+    uint16_t numTracks = 0;
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        numTracks = core::max(numTracks, (uint16_t)(capture->events[i].tid + 1));
+    }
+
+    writerPrint(&writer, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"freq\":%llu,\"droppedEvents\":%u,\"frames\":%u},\n\"traceEvents\":[\n",
+                (unsigned long long)capture->freq, capture->numDropped, capture->numFrames);
+
+    for (uint16_t tid = 0; tid < numTracks; ++tid)
+    {
+        writerPrint(&writer, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", (uint32_t)tid);
+        writerPutJsonString(&writer, profilerTrackName(tid));
+        writerPrint(&writer, "}},\n");
+    }
+
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        const profiler_event_t& evt = capture->events[i];
+
+        // Value is joined with counter event
+        if (evt.phase == PROF_EVENT_PHASE_COUNTER_HIGH) continue;
+
+        double us = (double)evt.timestamp * 1000000.0 / capture->freq;
+
+        writerPrint(&writer, "{\"name\":");
+        writerPutJsonString(&writer, evt.id < numNames ? names[evt.id] : 0);
+
+        switch (evt.phase)
+        {
+            case PROF_EVENT_PHASE_BEGIN:
+            case PROF_EVENT_PHASE_END:
+                writerPrint(&writer, ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":0,\"tid\":%u},\n",
+                            evt.phase == PROF_EVENT_PHASE_BEGIN ? "B" : "E", us, (uint32_t)evt.tid);
+                break;
+            case PROF_EVENT_PHASE_COUNTER:
+                writerPrint(&writer, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"value\":%lld}},\n",
+                            us, (uint32_t)evt.tid, (long long)event_capture_counter_value(capture, i));
+                break;
+            default:
+                writerPrint(&writer, ",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,\"tid\":%u},\n",
+                            us, (uint32_t)evt.tid);
+                break;
+        }
+    }
+
+    // Closing event keeps array free of trailing comma
+    writerPrint(&writer, "{\"name\":\"capture end\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,\"tid\":0}\n]}\n",
+                (double)capture->endTime * 1000000.0 / capture->freq);
+
+    return writerClose(&writer);
+}
+
+bool event_capture_export_binary(const event_capture_t* capture, const char** names, uint16_t numNames, const char* path)
+{
+    profiler_writer_t writer;
+
+    if (!writerOpen(&writer, path))
+    {
+        writerClose(&writer);
+        return false;
+    }
+
+    uint16_t numTracks = 0;
+    uint32_t numEvents = 0;
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        numTracks  = core::max(numTracks, (uint16_t)(capture->events[i].tid + 1));
+        numEvents += capture->events[i].phase != PROF_EVENT_PHASE_COUNTER_HIGH ? 1 : 0;
+    }
+
+    writerPut   (&writer, PROFILER_BINARY_MAGIC, 4);
+    writerPutU32(&writer, PROFILER_BINARY_VERSION);
+    writerPutU64(&writer, capture->freq);
+    writerPutU64(&writer, capture->startTime);
+    writerPutU64(&writer, capture->endTime);
+    writerPutU32(&writer, numEvents);
+    writerPutU32(&writer, capture->numDropped);
+    writerPutU32(&writer, capture->numFrames);
+    writerPutU16(&writer, numNames);
+    writerPutU16(&writer, numTracks);
+
+    for (uint16_t id = 0; id < numNames; ++id)
+    {
+        writerPutBinaryString(&writer, names[id]);
+    }
+
+    for (uint16_t tid = 0; tid < numTracks; ++tid)
+    {
+        writerPutBinaryString(&writer, profilerTrackName(tid));
+    }
+
+    uint64_t prevTs = 0;
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        const profiler_event_t& evt = capture->events[i];
+
+        // Counter value is written whole with counter event
+        if (evt.phase == PROF_EVENT_PHASE_COUNTER_HIGH) continue;
+
+        uint8_t trackAndPhase[2] = {evt.tid, evt.phase};
+
+        // Capture is ordered by time, deltas are small
+        writerPutVarint(&writer, evt.timestamp - prevTs);
+        writerPutVarint(&writer, evt.id);
+        writerPut(&writer, trackAndPhase, 2);
+
+        if (evt.phase == PROF_EVENT_PHASE_COUNTER)
+        {
+            int64_t value = event_capture_counter_value(capture, i);
+
+            // Zigzag keeps small negative values short
+            writerPutVarint(&writer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+        }
+
+        prevTs = evt.timestamp;
+    }
+
+    return writerClose(&writer);
+}
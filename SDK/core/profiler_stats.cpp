@@ -0,0 +1,322 @@
+#include <core/profiler.h>
+#include <core/profiler_stats.h>
+
+// Log-linear histogram: values below HISTOGRAM_SUB_COUNT have own buckets,
+// every following power of 2 is split into HISTOGRAM_SUB_COUNT buckets.
+static const uint32_t HISTOGRAM_SUB_BITS  = 4;
+static const uint32_t HISTOGRAM_SUB_COUNT = 1 << HISTOGRAM_SUB_BITS;
+static const uint32_t HISTOGRAM_SIZE      = (64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT;
+
+struct profiler_stats_frame_t
+{
+    uint64_t start;
+    uint64_t childTicks;
+    uint32_t node;
+    uint16_t id;
+};
+
+struct profiler_stats_thread_t
+{
+    int                     top;
+    uint32_t                overflow;   //Begin events deeper than stack
+    profiler_stats_frame_t  stack[PROFILER_STATS_MAX_DEPTH];
+};
+
+struct profiler_stats_t
+{
+    uint64_t                 freq;
+    uint32_t                 numCaptures;
+    uint64_t                 numDropped;
+
+    uint32_t                 maxNodes;
+    uint32_t                 numNodes;
+    profiler_tree_node_t*    nodes;
+    uint32_t                 roots[MAX_PROFILER_THREADS];
+
+    profiler_scope_stats_t   scopes[MAX_PROFILER_IDS];
+    uint32_t*                histograms[MAX_PROFILER_IDS];
+
+    profiler_stats_thread_t  threads[MAX_PROFILER_THREADS];
+};
+
+static uint32_t histogramBucket(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_COUNT)
+    {
+        return (uint32_t)value;
+    }
+
+    uint32_t hi  = (uint32_t)(value >> 32);
+    uint32_t msb = hi ? 32 + bit_fls(hi) : bit_fls((uint32_t)value);
+    uint32_t sub = (uint32_t)(value >> (msb - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1);
+
+    return (msb - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+// Middle of the values range covered by bucket
+static uint64_t histogramValue(uint32_t bucket)
+{
+    if (bucket < HISTOGRAM_SUB_COUNT)
+    {
+        return bucket;
+    }
+
+    uint32_t msb   = bucket / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS - 1;
+    uint32_t sub   = bucket % HISTOGRAM_SUB_COUNT;
+    uint32_t shift = msb - HISTOGRAM_SUB_BITS;
+    uint64_t lower = (uint64_t)(HISTOGRAM_SUB_COUNT + sub) << shift;
+
+    return lower + ((1ull << shift) >> 1);
+}
+
+profiler_stats_t* profilerStatsCreate(uint32_t maxNodes)
+{
+    profiler_stats_t* stats = (profiler_stats_t*)malloc(sizeof(profiler_stats_t));
+    if (!stats) return 0;
+
+    stats->nodes    = (profiler_tree_node_t*)malloc(sizeof(profiler_tree_node_t)*maxNodes);
+    stats->maxNodes = stats->nodes ? maxNodes : 0;
+
+    memset(stats->histograms, 0, sizeof(stats->histograms));
+
+    profilerStatsReset(stats);
+
+    return stats;
+}
+
+void profilerStatsDestroy(profiler_stats_t* stats)
+{
+    if (!stats) return;
+
+    for (size_t i = 0; i < MAX_PROFILER_IDS; ++i)
+    {
+        free(stats->histograms[i]);
+    }
+
+    free(stats->nodes);
+    free(stats);
+}
+
+void profilerStatsReset(profiler_stats_t* stats)
+{
+    assert(stats);
+
+    stats->freq        = 0;
+    stats->numCaptures = 0;
+    stats->numDropped  = 0;
+    stats->numNodes    = 0;
+
+    for (size_t i = 0; i < MAX_PROFILER_THREADS; ++i)
+    {
+        stats->roots[i] = PROFILER_STATS_INVALID_NODE;
+    }
+
+    memset(stats->scopes, 0, sizeof(stats->scopes));
+
+    // Histograms stay allocated for next captures
+    for (size_t i = 0; i < MAX_PROFILER_IDS; ++i)
+    {
+        if (stats->histograms[i])
+        {
+            memset(stats->histograms[i], 0, sizeof(uint32_t)*HISTOGRAM_SIZE);
+        }
+    }
+}
+
+static uint32_t profilerStatsFindNode(profiler_stats_t* stats, uint16_t tid, uint32_t parent, uint16_t id, uint16_t depth)
+{
+    uint32_t* first = parent == PROFILER_STATS_INVALID_NODE ? &stats->roots[tid] : &stats->nodes[parent].firstChild;
+
+    for (uint32_t node = *first; node != PROFILER_STATS_INVALID_NODE; node = stats->nodes[node].nextSibling)
+    {
+        if (stats->nodes[node].id == id)
+        {
+            return node;
+        }
+    }
+
+    if (stats->numNodes == stats->maxNodes)
+    {
+        return PROFILER_STATS_INVALID_NODE;
+    }
+
+    uint32_t              node = stats->numNodes++;
+    profiler_tree_node_t& n    = stats->nodes[node];
+
+    n.id          = id;
+    n.depth       = depth;
+    n.parent      = parent;
+    n.firstChild  = PROFILER_STATS_INVALID_NODE;
+    n.nextSibling = *first;
+    n.count       = 0;
+    n.totalTicks  = 0;
+    n.selfTicks   = 0;
+
+    *first = node;
+
+    return node;
+}
+
+static void profilerStatsAddInterval(profiler_stats_t* stats, uint16_t id, uint64_t duration, uint64_t self)
+{
+    profiler_scope_stats_t& scope = stats->scopes[id];
+
+    scope.minTicks    = scope.count ? core::min(scope.minTicks, duration) : duration;
+    scope.maxTicks    = core::max(scope.maxTicks, duration);
+    scope.totalTicks += duration;
+    scope.selfTicks  += self;
+    ++scope.count;
+
+    uint32_t*& histogram = stats->histograms[id];
+    if (!histogram)
+    {
+        histogram = (uint32_t*)malloc(sizeof(uint32_t)*HISTOGRAM_SIZE);
+        if (!histogram) return;
+        memset(histogram, 0, sizeof(uint32_t)*HISTOGRAM_SIZE);
+    }
+
+    ++histogram[histogramBucket(duration)];
+}
+
+void profilerStatsAddCapture(profiler_stats_t* stats, const event_capture_t* capture)
+{
+    assert(stats && capture);
+    assert(stats->freq == 0 || stats->freq == capture->freq);
+
+    stats->freq = capture->freq;
+    ++stats->numCaptures;
+
+    for (size_t i = 0; i < MAX_PROFILER_THREADS; ++i)
+    {
+        stats->threads[i].top      = -1;
+        stats->threads[i].overflow = 0;
+    }
+
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        const profiler_event_t& evt = capture->events[i];
+
+        if (evt.tid >= MAX_PROFILER_THREADS || evt.id >= MAX_PROFILER_IDS) continue;
+
+        profiler_stats_thread_t& thread = stats->threads[evt.tid];
+
+        if (evt.phase == PROF_EVENT_PHASE_BEGIN)
+        {
+            if (thread.top + 1 >= PROFILER_STATS_MAX_DEPTH || thread.overflow)
+            {
+                ++thread.overflow;
+                continue;
+            }
+
+            uint32_t parent = thread.top >= 0 ? thread.stack[thread.top].node : PROFILER_STATS_INVALID_NODE;
+            uint32_t node   = PROFILER_STATS_INVALID_NODE;
+
+            // Children of scope without node are not in the tree either
+            if (thread.top < 0 || parent != PROFILER_STATS_INVALID_NODE)
+            {
+                node = profilerStatsFindNode(stats, evt.tid, parent, evt.id, (uint16_t)(thread.top + 1));
+            }
+
+            profiler_stats_frame_t& frame = thread.stack[++thread.top];
+            frame.start      = evt.timestamp;
+            frame.childTicks = 0;
+            frame.node       = node;
+            frame.id         = evt.id;
+        }
+        else if (evt.phase == PROF_EVENT_PHASE_END)
+        {
+            if (thread.overflow)
+            {
+                --thread.overflow;
+                ++stats->numDropped;
+                continue;
+            }
+
+            //ignore not opened interval
+            if (thread.top < 0 || thread.stack[thread.top].id != evt.id) continue;
+
+            profiler_stats_frame_t& frame = thread.stack[thread.top--];
+
+            uint64_t duration = evt.timestamp - frame.start;
+            uint64_t self     = duration - core::min(frame.childTicks, duration);
+
+            profilerStatsAddInterval(stats, evt.id, duration, self);
+
+            if (frame.node != PROFILER_STATS_INVALID_NODE)
+            {
+                profiler_tree_node_t& node = stats->nodes[frame.node];
+                ++node.count;
+                node.totalTicks += duration;
+                node.selfTicks  += self;
+            }
+            else
+            {
+                ++stats->numDropped;
+            }
+
+            if (thread.top >= 0)
+            {
+                thread.stack[thread.top].childTicks += duration;
+            }
+        }
+    }
+}
+
+uint64_t profilerStatsGetFreq(const profiler_stats_t* stats)
+{
+    return stats->freq;
+}
+
+uint32_t profilerStatsGetCaptureCount(const profiler_stats_t* stats)
+{
+    return stats->numCaptures;
+}
+
+uint64_t profilerStatsGetDroppedCount(const profiler_stats_t* stats)
+{
+    return stats->numDropped;
+}
+
+const profiler_scope_stats_t* profilerStatsGetScope(const profiler_stats_t* stats, uint16_t id)
+{
+    assert(id < MAX_PROFILER_IDS);
+    return stats->scopes[id].count ? &stats->scopes[id] : 0;
+}
+
+uint64_t profilerStatsGetPercentile(const profiler_stats_t* stats, uint16_t id, float percentile)
+{
+    assert(id < MAX_PROFILER_IDS);
+
+    const profiler_scope_stats_t& scope     = stats->scopes[id];
+    const uint32_t*               histogram = stats->histograms[id];
+
+    if (!scope.count || !histogram) return 0;
+
+    // Nearest rank
+    uint64_t rank = (uint64_t)(ml::clamp(percentile, 0.0f, 100.0f) / 100.0f * scope.count + 0.5f);
+    rank = ml::clamp(rank, (uint64_t)1, scope.count);
+
+    uint64_t cumulative = 0;
+    for (uint32_t bucket = 0; bucket < HISTOGRAM_SIZE; ++bucket)
+    {
+        cumulative += histogram[bucket];
+        if (cumulative >= rank)
+        {
+            return ml::clamp(histogramValue(bucket), scope.minTicks, scope.maxTicks);
+        }
+    }
+
+    return scope.maxTicks;
+}
+
+uint32_t profilerStatsGetRoot(const profiler_stats_t* stats, uint16_t tid)
+{
+    assert(tid < MAX_PROFILER_THREADS);
+    return stats->roots[tid];
+}
+
+const profiler_tree_node_t* profilerStatsGetNode(const profiler_stats_t* stats, uint32_t node)
+{
+    assert(node < stats->numNodes);
+    return &stats->nodes[node];
+}
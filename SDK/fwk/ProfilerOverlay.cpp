@@ -15,6 +15,7 @@ static const int    firstThreadRow = 3;
 static const float  overlayPadding = 25.0f;
 static const float  viewMargin = 5.0f;
 static const float  tickSize = 3;
+static const uint32_t MAX_STATS_NODES = 16*1024;
 
 void ProfilerOverlay::init()
 {
@@ -22,6 +23,8 @@ void ProfilerOverlay::init()
     dx = 0.0f;
     mDoDrag = false;
     ui::mouseAbsOffset(&mbx, &mby);
+
+    stats = profilerStatsCreate(MAX_STATS_NODES);
 }
 
 void ProfilerOverlay::resize(int w, int h)
@@ -40,11 +43,12 @@ void ProfilerOverlay::layoutUI(int w, int h)
 
 void ProfilerOverlay::fini()
 {
+    profilerStatsDestroy(stats);
     glDeleteProgram(prgQuad);
 }
 
 void ProfilerOverlay::addInterval(
-    const char* name, uint32_t colorID, 
+    const char* name, uint16_t id, uint32_t colorID, 
     uint16_t trackID, uint32_t start, 
     uint32_t duration, int depth
 )
@@ -60,6 +64,7 @@ void ProfilerOverlay::addInterval(
     Interval inter = 
     {
         name,
+        id,
         xstart / 1000.0f,
         duration / 1000.0f
     };
@@ -67,9 +72,10 @@ void ProfilerOverlay::addInterval(
     intervals.push_back(inter);
 }
 
-inline uint32_t convertToMs(uint64_t ms, uint64_t freq, int quantShift)
+// Ticks are relative to capture start, split conversion to avoid overflow of long captures
+inline uint32_t convertToMs(uint64_t ticks, uint64_t freq)
 {
-    return (uint32_t)(ms * (1ull<<quantShift) * 1000000 / freq);
+    return (uint32_t)(ticks / freq * 1000000 + ticks % freq * 1000000 / freq);
 }
 
 void ProfilerOverlay::loadProfilerData()
@@ -80,6 +86,10 @@ void ProfilerOverlay::loadProfilerData()
     size_t                  numEvents = capture->numEvents;
     const profiler_event_t* events = capture->events;
 
+    // Statistics aggregate every capture loaded since init,
+    // they are not limited by overlay rows and stack depth
+    profilerStatsAddCapture(stats, capture);
+
     rectData.resize(numEvents * 4);
 
     int     stackTop[MAX_THREAD_COUNT] = {-1, -1, -1, -1, -1, -1, -1, -1};
@@ -90,7 +100,7 @@ void ProfilerOverlay::loadProfilerData()
     } stack[MAX_THREAD_COUNT][MAX_STACK_DEPTH];
 
     core::index_t<uint16_t, ui::RAINBOW_TABLE_L_SIZE> colorMap  = {0};
-    core::index_t<uint16_t, 32>                       threadMap = {0};
+    core::index_t<uint16_t, MAX_PROFILER_THREADS>     threadMap = {0};
 
     rectData.clear();
     intervals.clear();
@@ -98,15 +108,18 @@ void ProfilerOverlay::loadProfilerData()
 
     numThreads = 0;
 
-    minTime = convertToMs(events[0].timestamp, capture->freq, capture->quantShift);
-    maxTime = convertToMs(events[0].timestamp, capture->freq, capture->quantShift);
+    minTime = convertToMs(events[0].timestamp, capture->freq);
+    maxTime = convertToMs(events[0].timestamp, capture->freq);
 
     for (size_t i=0; i<numEvents; ++i)
     {
         profiler_event_t event = events[i];
         uint32_t         threadIdx;
-        uint32_t         ts = convertToMs(events[i].timestamp, capture->freq, capture->quantShift);
-        threadIdx = core::index_lookup_or_add(&threadMap, event.tid);
+        uint32_t         ts = convertToMs(events[i].timestamp, capture->freq);
+        threadIdx = core::index_lookup_or_add(&threadMap, (uint16_t)event.tid);
+
+        //ignore threads exceeding overlay rows
+        if (threadIdx >= MAX_THREAD_COUNT) continue;
 
         minTime = core::min(minTime, ts);
         maxTime = core::max(maxTime, ts);
@@ -134,14 +147,14 @@ void ProfilerOverlay::loadProfilerData()
             //remove item from stack and add entry
             uint32_t colorID = core::index_lookup_or_add(&colorMap, event.id);
             uint32_t start   = stack[threadIdx][top].sliceBegin;
-            addInterval(names[event.id], colorID, threadIdx, start, ts - start, top);
+            addInterval(names[event.id], event.id, colorID, threadIdx, start, ts - start, top);
 
             --top;
         }
     }
 
     //TODO: close all opened intervals
-    uint32_t endTime = capture->endTime;
+    uint32_t endTime = convertToMs(capture->endTime, capture->freq);
     for (size_t i = 0; i < MAX_THREAD_COUNT; ++i)
     {
         int top = stackTop[i];
@@ -150,7 +163,7 @@ void ProfilerOverlay::loadProfilerData()
             uint16_t id      = stack[i][top].id;
             uint32_t colorID = core::index_lookup_or_add(&colorMap, id);
             uint32_t start   = stack[i][top].sliceBegin;
-            addInterval(names[id], colorID, i, start, endTime - start, top);
+            addInterval(names[id], id, colorID, i, start, endTime - start, top);
         }
     }
 
@@ -487,16 +500,32 @@ void ProfilerOverlay::renderFullscreen()
         uint32_t  idx = selection[i];
         Interval& interval = intervals[idx];
 
+        const profiler_scope_stats_t* scope = profilerStatsGetScope(stats, interval.id);
+        float toMs = 1000.0f / profilerStatsGetFreq(stats);
+
         sprintf_s(
             buffer,
             "name     : %s\n"
             "duration : %.4f\n"
             "start    : %.4f\n"
-            "end      : %.4f",
+            "end      : %.4f\n"
+            "\n"
+            "count    : %u\n"
+            "total    : %.4f\n"
+            "self     : %.4f\n"
+            "p50      : %.4f\n"
+            "p95      : %.4f\n"
+            "p99      : %.4f",
             interval.name,
             interval.duration,
             interval.start,
-            interval.start+interval.duration
+            interval.start+interval.duration,
+            scope ? (uint32_t)scope->count : 0,
+            scope ? scope->totalTicks * toMs : 0.0f,
+            scope ? scope->selfTicks  * toMs : 0.0f,
+            profilerStatsGetPercentile(stats, interval.id, 50.0f) * toMs,
+            profilerStatsGetPercentile(stats, interval.id, 95.0f) * toMs,
+            profilerStatsGetPercentile(stats, interval.id, 99.0f) * toMs
         );
 
         nvgTextBox(vg::ctx, statArea.x+20, y, FLT_MAX, buffer, buffer+cstr_len(buffer));
@@ -5,9 +5,12 @@
 #include <SDL2/SDL.h>
 #include <opengl.h>
 
+struct profiler_stats_t;
+
 struct Interval
 {
     const char* name;
+    uint16_t    id;
     float       start;
     float       duration;
 };
@@ -29,7 +32,7 @@ private:
     void   layoutUI(int w, int h);
     size_t elementUnderCursor(int x, int y);
     void   addInterval(
-        const char* name, uint32_t color,
+        const char* name, uint16_t id, uint32_t color,
         uint16_t trackID, uint32_t start,
         uint32_t duration, int depth
     );
@@ -42,6 +45,8 @@ private:
 
     std::vector<uint32_t> selection;
 
+    profiler_stats_t*     stats;
+
     int width;
     int height;
     
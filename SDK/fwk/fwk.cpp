@@ -1,5 +1,4 @@
 #include <fwk/fwk.h>
-#include <Remotery.h>
 
 namespace gfx
 {
@@ -16,8 +15,6 @@ namespace fwk
     SDL_Window*      window;
     SDL_GLContext    context;
 
-    Remotery* rmt;
-
     uint64_t prevTime;
     bool     runLoop;
     bool     recompileGLPrograms;
@@ -26,8 +23,6 @@ namespace fwk
 
     void init(const char* argv0)
     {
-        rmt_CreateGlobalInstance(&rmt);
-
         PHYSFS_init(argv0);
 
         PHYSFS_mount("AppData",       0, 1);
@@ -158,8 +153,6 @@ namespace fwk
         SDL_Quit();
 
         PHYSFS_deinit();
-
-        rmt_DestroyGlobalInstance(rmt);
     }
 
     void notifyResize(int w, int h)
@@ -189,6 +182,14 @@ int main(int argc, char** argv)
 {
     fwk::init(argv[0]);
 
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-remotery") == 0)
+        {
+            profilerSetRemoteEnabled(true);
+        }
+    }
+
     fwk::run();
  
     fwk::fini();
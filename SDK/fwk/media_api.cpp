@@ -10,6 +10,7 @@ extern "C"
 }
 
 #include <gfx/gfx.h>
+#include <fwk/media_api.h>
 
 #define PACKET_BUFFER_SIZE    64
 
@@ -60,16 +61,18 @@ struct media_player_data_t
     bool     taskStarted;
 };
 
-typedef struct media_player_data_t* media_player_t;
+#define MAX_MEDIA_PLAYERS     16
+
+static core::handle_pool_t<media_player_data_t, MAX_MEDIA_PLAYERS> playerPool;
 
 static int extAudioFormatsPresent;
 
 GLuint progYUV2RGB;
 
-static void closeAudioStream(media_player_t player);
-static void closeVideoStream(media_player_t player);
+static void closeAudioStream(media_player_data_t* player);
+static void closeVideoStream(media_player_data_t* player);
 
-static int openAudioStream(media_player_t player, AVCodecContext* audioContext)
+static int openAudioStream(media_player_data_t* player, AVCodecContext* audioContext)
 {
     AVCodec* pAudioCodec;
 
@@ -109,7 +112,7 @@ static int openAudioStream(media_player_t player, AVCodecContext* audioContext)
     return 1;
 }
 
-static void closeAudioStream(media_player_t player)
+static void closeAudioStream(media_player_data_t* player)
 {
     if (player->audioContext)
     {
@@ -136,7 +139,7 @@ static void initTexture(GLuint tex, GLuint width, GLuint height)
     glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 }
 
-static int openVideoStream(media_player_t player, AVCodecContext* videoContext)
+static int openVideoStream(media_player_data_t* player, AVCodecContext* videoContext)
 {
     closeVideoStream(player);
 
@@ -172,7 +175,7 @@ static int openVideoStream(media_player_t player, AVCodecContext* videoContext)
     return 1;
 }
 
-static void closeVideoStream(media_player_t player)
+static void closeVideoStream(media_player_data_t* player)
 {
     if (player->videoContext)
     {
@@ -189,7 +192,7 @@ static void closeVideoStream(media_player_t player)
     }
 }
 
-static void streamMediaData(media_player_t player)
+static void streamMediaData(media_player_data_t* player)
 {
     PROFILER_CPU_TIMESLICE("streamMediaData");
 
@@ -215,7 +218,7 @@ static void streamMediaData(media_player_t player)
     }
 }
 
-static void decodeAudio(media_player_t player)
+static void decodeAudio(media_player_data_t* player)
 {
     PROFILER_CPU_TIMESLICE("decodeAudio");
 
@@ -260,7 +263,7 @@ static void decodeAudio(media_player_t player)
     }
 }
 
-static void decodeVideo(media_player_t player)
+static void decodeVideo(media_player_data_t* player)
 {
     PROFILER_CPU_TIMESLICE("decodeVideo");
 
@@ -291,7 +294,7 @@ static void decodeVideo(media_player_t player)
     }
 }
 
-static void uploadAudioData(media_player_t player, ALuint buffer)
+static void uploadAudioData(media_player_data_t* player, ALuint buffer)
 {
     PROFILER_CPU_TIMESLICE("uploadAudioData");
 
@@ -299,7 +302,7 @@ static void uploadAudioData(media_player_t player, ALuint buffer)
     alSourceQueueBuffers(player->audioSource, 1, &buffer);
 }
 
-static void uploadVideoData(media_player_t player, GLuint texY, GLuint texU, GLuint texV)
+static void uploadVideoData(media_player_data_t* player, GLuint texY, GLuint texU, GLuint texV)
 {
     PROFILER_CPU_TIMESLICE("uploadVideoData");
 
@@ -340,15 +343,28 @@ void mediaShutdown()
 
 media_player_t mediaCreatePlayer(const char* source)
 {
-    media_player_t player = (media_player_t)_aligned_malloc(sizeof(media_player_data_t), _alignof(media_player_data_t));
+    media_player_t       handle = core::handle_pool_alloc(playerPool);
+    media_player_data_t* player = core::handle_pool_get(playerPool, handle);
+
+    assert(player && "Too many media players");
+
+    if (!player)
+        return handle;
 
     mem_zero(player);
 
     if (avformat_open_input(&player->formatContext, source, NULL, 0)!=0)
-        return 0;
+    {
+        core::handle_pool_free(playerPool, handle);
+        return media_player_t();
+    }
 
     if (avformat_find_stream_info(player->formatContext, NULL)<0)
-        return 0 ;
+    {
+        avformat_close_input(&player->formatContext);
+        core::handle_pool_free(playerPool, handle);
+        return media_player_t();
+    }
 
     av_dump_format(player->formatContext, 0, source, false); // Dump information about file onto standard error
 
@@ -384,11 +400,25 @@ media_player_t mediaCreatePlayer(const char* source)
     core::ring_buffer_reset(player->aPackets);
     core::ring_buffer_reset(player->vPackets);
 
+    return handle;
+}
+
+// Player of live handle, decode tasks keep pointer, pool slots do not move
+static media_player_data_t* getPlayer(media_player_t handle)
+{
+    media_player_data_t* player = core::handle_pool_get(playerPool, handle);
+    assert(player && "Media player is destroyed");
+
     return player;
 }
 
-void mediaDestroyPlayer(media_player_t player)
+void mediaDestroyPlayer(media_player_t handle)
 {
+    media_player_data_t* player = getPlayer(handle);
+
+    if (!player)
+        return;
+
     if (player->taskStarted)
     {
         mt::syncAndReleaseEvent(player->eventID);
@@ -401,7 +431,7 @@ void mediaDestroyPlayer(media_player_t player)
     closeVideoStream(player);
 
     avformat_close_input(&player->formatContext);
-    _aligned_free(player);
+    core::handle_pool_free(playerPool, handle);
 }
 
 enum 
@@ -410,7 +440,7 @@ enum
     MEDIA_DECODE_AUDIO = 2,
 };
 
-static void doDecode(media_player_t player)
+static void doDecode(media_player_data_t* player)
 {
     PROFILER_CPU_TIMESLICE("mediaPlayerUpdateTask");
 
@@ -426,13 +456,15 @@ static void doDecode(media_player_t player)
 
 static void decodeTask(void* arg)
 {
-    media_player_t player = (media_player_t)arg;
+    media_player_data_t* player = (media_player_data_t*)arg;
 
     doDecode(player);
 }
 
-void mediaStartPlayback(media_player_t player)
+void mediaStartPlayback(media_player_t handle)
 {
+    media_player_data_t* player = getPlayer(handle);
+
     player->timeOfNextFrame = 0;
     player->streamEnd       = FALSE;
 
@@ -453,8 +485,10 @@ void mediaStartPlayback(media_player_t player)
     alSourcePlay(player->audioSource);
 }
 
-void mediaPlayerUpdate(media_player_t player)
+void mediaPlayerUpdate(media_player_t handle)
 {
+    media_player_data_t* player = getPlayer(handle);
+
     PROFILER_CPU_TIMESLICE("mediaPlayerUpdate");
 
     if (!player->playback)
@@ -518,8 +552,10 @@ void mediaPlayerUpdate(media_player_t player)
     }
 }
 
-void mediaPlayerPrepareRender(media_player_t player)
+void mediaPlayerPrepareRender(media_player_t handle)
 {
+    media_player_data_t* player = getPlayer(handle);
+
     glUseProgram(progYUV2RGB);
 
     GLuint textures[] = {player->texY[0], player->texU[0], player->texV[0]};
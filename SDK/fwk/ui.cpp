@@ -19,6 +19,8 @@ namespace ui
     static const uint32_t ID_CHECKBOX = 0x01000000;
     static const uint32_t ID_MASK     = 0xFF000000;
 
+    static const uint32_t PROFILER_HISTORY_FRAMES = 8;
+
     int width;
     int height;
     int fullscreen;
@@ -186,6 +188,16 @@ namespace ui
             profilerState = PROF_STATE_FRAME_CAPTURE;
             profilerStartCapture();
         }
+        else if (
+            profilerState==PROF_STATE_NO_CAPTURE &&
+            ui::keyIsPressed(SDL_SCANCODE_GRAVE) &&
+            ui::keyWasReleased(SDL_SCANCODE_H)
+        )
+        {
+            // Profiler always records, show last frames from history
+            profilerState = PROF_STATE_DATA_RETRIEVAL;
+            profilerSnapshotFrames(PROFILER_HISTORY_FRAMES);
+        }
         else if (
             profilerState!=PROF_STATE_NO_CAPTURE &&
             profilerState!=PROF_STATE_TIMESLICE_CAPTURE
@@ -194,6 +206,13 @@ namespace ui
             assert(!"Invalid state");
         }
 
+        // Live profiling in browser is independent of overlay captures
+        if (ui::keyIsPressed(SDL_SCANCODE_GRAVE) && ui::keyWasReleased(SDL_SCANCODE_R))
+        {
+            bool enabled = profilerSetRemoteEnabled(!profilerIsRemoteEnabled());
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Remotery profiling %s", enabled ? "enabled" : "disabled");
+        }
+
         if (uiState==STATE_PROFILER)
         {
             PROFILER_CPU_TIMESLICE("mProfilerOverlay->updateUI");
@@ -110,6 +110,8 @@ namespace vg
 
         if (NULL==tempGlyph)
         {
+            PROFILER_FRAME_COUNTER("vg glyph cache misses", 1);
+
             FT_Error     err = FT_Load_Glyph(font->ftFace, glyphIndex, FT_LOAD_NO_HINTING);
             FT_GlyphSlot ftGlyph = font->ftFace->glyph;
 
@@ -4,6 +4,18 @@
 
 namespace vg
 {
+    static core::handle_dynpool_t<PaintOpaque> paintPool;
+
+    PaintOpaque* getPaintData(Paint paint)
+    {
+        return core::handle_pool_get(paintPool, paint);
+    }
+
+    void shutdownPaints()
+    {
+        core::handle_pool_fini(paintPool);
+    }
+
     struct uPaintLinGradient
     {
         ml::vec4   uStops [8];
@@ -15,7 +27,10 @@ namespace vg
 
     Paint createSolidPaint(float* color4f)
     {
-        Paint  newPaint = mem::alloc<PaintOpaque>(gfx::memArena);
+        Paint        handle   = core::handle_pool_alloc(paintPool);
+        PaintOpaque* newPaint = getPaintData(handle);
+
+        if (!newPaint) return handle;
 
         newPaint->program       = gfx_res::prgPaintSolid;
         newPaint->allocUniforms = etlsf_alloc_range(gfx_res::vgGArena, sizeof(v128));
@@ -29,7 +44,7 @@ namespace vg
         memcpy(udata, color4f, sizeof(v128));
         glUnmapNamedBuffer(gfx_res::buffer);
 
-        return newPaint;
+        return handle;
     }
 
     Paint createSolidPaint(unsigned int color)
@@ -41,7 +56,10 @@ namespace vg
 
     Paint createLinearGradientPaint(float x0, float y0, float x1, float y1, size_t stopCount, float stops[], unsigned int colorRamp[])
     {
-        Paint  newPaint = mem::alloc<PaintOpaque>(gfx::memArena);
+        Paint        handle   = core::handle_pool_alloc(paintPool);
+        PaintOpaque* newPaint = getPaintData(handle);
+
+        if (!newPaint) return handle;
 
         glCreateTextures(GL_TEXTURE_1D, 1, &newPaint->texture);
         glTextureStorage1D(newPaint->texture, 1, GL_RGBA8, stopCount);
@@ -89,11 +107,16 @@ namespace vg
 
         glUnmapNamedBuffer(gfx_res::buffer);
 
-        return newPaint;
+        return handle;
     }
 
-    void applyPaintAsGLProgram(Paint paint)
+    void applyPaintAsGLProgram(Paint handle)
     {
+        PaintOpaque* paint = getPaintData(handle);
+        assert((paint || core::handle_is_null(handle)) && "Paint is destroyed");
+
+        if (!paint) return;
+
         glUseProgram(paint->program);
         gfx::setMVP();
         glBindBufferRange(GL_UNIFORM_BUFFER, 1, gfx_res::buffer, paint->offset, paint->size);
@@ -103,11 +126,16 @@ namespace vg
         }
     }
 
-    void destroyPaint(Paint paint)
+    void destroyPaint(Paint handle)
     {
+        PaintOpaque* paint = getPaintData(handle);
+        assert((paint || core::handle_is_null(handle)) && "Paint is already destroyed");
+
+        if (!paint) return;
+
         if (paint->texture) glDeleteTextures(1, &paint->texture);
-        etlsf_free_range(gfx_res::vgGArena, paint->allocUniforms);
+        etlsf_free_range_deferred(gfx_res::vgGArena, paint->allocUniforms);
 
-        mem::free(gfx::memArena, paint);
+        core::handle_pool_free(paintPool, handle);
     }
 }
@@ -12,4 +12,7 @@ namespace vg
         GLsizei       offset;
         GLuint        texture;
     };
+
+    // Data of live paint, 0 for destroyed paints
+    PaintOpaque* getPaintData(Paint paint);
 }
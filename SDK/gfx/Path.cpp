@@ -4,6 +4,18 @@
 
 namespace vg
 {
+    static core::handle_dynpool_t<path_data_t> pathPool;
+
+    path_data_t* getPathData(Path path)
+    {
+        return core::handle_pool_get(pathPool, path);
+    }
+
+    void shutdownPaths()
+    {
+        core::handle_pool_fini(pathPool);
+    }
+
     uint16_t geomAddVertex(geometry_t* geom, const ml::vec2& v)
     {
         size_t idx = geom->numVertices;
@@ -37,12 +49,15 @@ namespace vg
         geom->numB3Vertices = idx;
     }
 
-    path_data_t* geomToPath(geometry_t* geom)
+    Path geomToPath(geometry_t* geom)
     {
         assert(geom->numB3Vertices % 4 == 0);
         assert(geom->numB3Vertices <= USHRT_MAX);
 
-        path_data_t* path = mem::alloc<path_data_t>(gfx::memArena);
+        Path         handle = core::handle_pool_alloc(pathPool);
+        path_data_t* path   = getPathData(handle);
+
+        if (!path) return handle;
 
         memset(path, 0, sizeof(path_data_t));
 
@@ -60,7 +75,7 @@ namespace vg
         else
         {
             path->xmin = path->ymin = path->xmax = path->ymax = 0;
-            return path;
+            return handle;
         }
 
         for(size_t i = 0; i < geom->numVertices; ++i)
@@ -140,7 +155,7 @@ namespace vg
 
         glUnmapNamedBuffer(gfx_res::buffer);
 
-        return path;
+        return handle;
     }
 
     void subdivide(v128 cubic[4], float t, v128 subCubic1[4], v128 subCubic2[4])
@@ -461,24 +476,37 @@ namespace vg
         glBindVertexArray(0);
     }
 
-    void getPathBounds(Path path, float& x1, float& y1, float& x2, float& y2)
+    void getPathBounds(Path handle, float& x1, float& y1, float& x2, float& y2)
     {
+        path_data_t* path = getPathData(handle);
+        assert((path || core::handle_is_null(handle)) && "Path is destroyed");
+
+        if (!path)
+        {
+            x1 = y1 = x2 = y2 = 0.0f;
+            return;
+        }
+
         x1 = path->xmin; y1 = path->ymin;
         x2 = path->xmax; y2 = path->ymax;
     }
 
-    Path createPath(size_t numCmd, const VGubyte* cmd, size_t numData, const VGfloat* data)
+    // CPU only part of path creation, scratch memory comes from the calling thread stack,
+    // so it can run on any worker. Returns false if thread has no stack.
+    static bool tessellatePath(geometry_t* pathGeom, size_t numCmd, const VGubyte* cmd, size_t numData, const VGfloat* data)
     {
         const size_t maxIndices    = numCmd * 9;
         const size_t maxVertices   = numCmd * 5;
         const size_t maxB3Vertices = numCmd * 10;
 
-        geometry_t pathGeom = {
-            (uint16_t*)core::thread_stack_alloc(sizeof(uint16_t)*maxIndices),
-            (vf::p2_vertex_t*) core::thread_stack_alloc(sizeof(vf::p2_vertex_t)*maxVertices),
-            (vf::p2uv3_vertex_t*) core::thread_stack_alloc(sizeof(vf::p2uv3_vertex_t)*maxB3Vertices),
-            0, 0, 0
-        };
+        pathGeom->indices       = (uint16_t*)core::thread_stack_alloc(sizeof(uint16_t)*maxIndices);
+        pathGeom->vertices      = (vf::p2_vertex_t*) core::thread_stack_alloc(sizeof(vf::p2_vertex_t)*maxVertices);
+        pathGeom->b3vertices    = (vf::p2uv3_vertex_t*) core::thread_stack_alloc(sizeof(vf::p2uv3_vertex_t)*maxB3Vertices);
+        pathGeom->numIndices    = 0;
+        pathGeom->numVertices   = 0;
+        pathGeom->numB3Vertices = 0;
+
+        if (!pathGeom->indices || !pathGeom->vertices || !pathGeom->b3vertices) return false;
 
         ml::vec2  cp0 = {0.0f, 0.0f},
                   cp1 = {0.0f, 0.0f},
@@ -509,7 +537,7 @@ namespace vg
                 if (!isContourStarted)
                 {
                     isContourStarted = true;
-                    startIdx = prevIdx = curIdx = geomAddVertex(&pathGeom, o);
+                    startIdx = prevIdx = curIdx = geomAddVertex(pathGeom, o);
                 }
 
                 switch (segment)
@@ -572,14 +600,14 @@ namespace vg
 
                 assert(isContourStarted);
                 prevIdx = curIdx;
-                curIdx = geomAddVertex(&pathGeom, o);
-                geomAddTri(&pathGeom, startIdx, prevIdx, curIdx);
+                curIdx = geomAddVertex(pathGeom, o);
+                geomAddTri(pathGeom, startIdx, prevIdx, curIdx);
 
                 switch (segment)
                 {
                     case VG_CUBIC_TO:
                     case VG_SCUBIC_TO:
-                        meshAddBezier3(&pathGeom, prevIdx, curIdx, cp0, cp1, p, o);
+                        meshAddBezier3(pathGeom, prevIdx, curIdx, cp0, cp1, p, o);
                         break;
 
                     case VG_QUAD_TO:
@@ -599,20 +627,36 @@ namespace vg
             }
         }
 
-        assert(pathGeom.numIndices    <= maxIndices);
-        assert(pathGeom.numVertices   <= maxVertices);
-        assert(pathGeom.numB3Vertices <= maxB3Vertices);
+        assert(pathGeom->numIndices    <= maxIndices);
+        assert(pathGeom->numVertices   <= maxVertices);
+        assert(pathGeom->numB3Vertices <= maxB3Vertices);
+
+        return true;
+    }
 
-        Path path = geomToPath(&pathGeom);
+    Path createPath(size_t numCmd, const VGubyte* cmd, size_t numData, const VGfloat* data)
+    {
+        THREAD_STACK_SCOPE();
 
-        core::thread_stack_reset(pathGeom.indices);
+        geometry_t pathGeom;
 
-        return path;
+        if (!tessellatePath(&pathGeom, numCmd, cmd, numData, data))
+        {
+            Path none = {0};
+            return none;
+        }
+
+        return geomToPath(&pathGeom);
     }
 
-    void destroyPath(Path path)
+    void destroyPath(Path handle)
     {
-        etlsf_free_range(gfx_res::vgGArena, path->gpuMemHandle);
-        mem::free(gfx::memArena, path);
+        path_data_t* path = getPathData(handle);
+        assert((path || core::handle_is_null(handle)) && "Path is already destroyed");
+
+        if (!path) return;
+
+        etlsf_free_range_deferred(gfx_res::vgGArena, path->gpuMemHandle);
+        core::handle_pool_free(pathPool, handle);
     }
 }
\ No newline at end of file
@@ -34,7 +34,10 @@ namespace vg
     uint16_t     geomAddVertex    (geometry_t* geom, const ml::vec2& v);
     void         geomAddTri       (geometry_t* geom, uint16_t i0, uint16_t i1, uint16_t i2);
     void         geomAddB3Vertices(geometry_t* geom, ml::vec2 pos[4], ml::vec3 klm[4]);
-    path_data_t* geomToPath       (geometry_t* geom);
+    Path         geomToPath       (geometry_t* geom);
+
+    // Data of live path, 0 for destroyed paths
+    path_data_t* getPathData(Path path);
 
     void stencilPath(path_data_t* path, int useAA);
 }
@@ -1,6 +1,7 @@
 #include <gfx/gfx.h>
 #include "gfx_res.h"
 #include "Path.h"
+#include "Paint.h"
 
 //TODO: API change: vgBeginDraw vgEndDraw for common state setting
 //TODO: make stencil configurable - make it possible to allocate bits using mask
@@ -14,6 +15,8 @@ namespace vg
 
     void initFontSubsystem();
     void shutdownFontSubsystem();
+    void shutdownPaths();
+    void shutdownPaints();
 
     void init()
     {
@@ -24,6 +27,8 @@ namespace vg
     void fini()
     {
         shutdownFontSubsystem();
+        shutdownPaths();
+        shutdownPaints();
         nvgDeleteGL3(ctx);
     }
 
@@ -69,8 +74,13 @@ namespace vg
         glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
     }
 
-    void drawPath(Path path, uint32_t color, bool useNonZero)
+    void drawPath(Path handle, uint32_t color, bool useNonZero)
     {
+        path_data_t* path = getPathData(handle);
+        assert((path || core::handle_is_null(handle)) && "Path is destroyed");
+
+        if (!path) return;
+
         glEnable(GL_STENCIL_TEST);
 
         setStencilRasterStates(useNonZero);
@@ -90,8 +100,13 @@ namespace vg
         glDisable(GL_STENCIL_TEST);
     }
 
-    void drawPath(Path path, Paint paint, bool useNonZero, bool useAA)
+    void drawPath(Path handle, Paint paint, bool useNonZero, bool useAA)
     {
+        path_data_t* path = getPathData(handle);
+        assert((path || core::handle_is_null(handle)) && "Path is destroyed");
+
+        if (!path || !getPaintData(paint)) return;
+
         glEnable(GL_STENCIL_TEST);
 
         setStencilRasterStates(useNonZero);
@@ -106,8 +121,13 @@ namespace vg
         glDisable(GL_STENCIL_TEST);
     }
 
-    void drawPathAA(Path path, Paint paint)
+    void drawPathAA(Path handle, Paint paint)
     {
+        path_data_t* path = getPathData(handle);
+        assert((path || core::handle_is_null(handle)) && "Path is destroyed");
+
+        if (!path || !getPaintData(paint)) return;
+
         //Clear alpha
         glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
         glDisable(GL_BLEND);
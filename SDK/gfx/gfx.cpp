@@ -167,6 +167,14 @@ namespace gfx
         dynBufferOffset = frameID * DYNAMIC_BUFFER_FRAME_SIZE;
         dynBufAllocated = 0;
 
+        // CPU scratch of this frame
+        core::frame_mem_begin();
+        mem_tags_frame_begin();
+
+        // Vector graphics ranges are reused only after NUM_FRAMES_DELAY frames,
+        // GPU may still read ranges freed during frames in flight
+        etlsf_flush_deferred_frames(gfx_res::vgGArena, NUM_FRAMES_DELAY);
+
         ml::make_identity_mat4(autoVars.matMV);
         ml::make_identity_mat4(autoVars.matP);
         ml::make_identity_mat4(autoVars.matMVP);
@@ -189,6 +197,8 @@ namespace gfx
         assert(frameID >= 0);
         assert(frameID < NUM_FRAMES_DELAY);
 
+        PROFILER_GAUGE("gfx dynbuf bytes", dynBufAllocated);
+
         frameSync[frameID] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
         
         frameID = (frameID + 1) % NUM_FRAMES_DELAY;
@@ -473,6 +483,8 @@ namespace gfx
         };
         static const GLenum reqUniProps[5]   = {GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_ARRAY_STRIDE, GL_OFFSET};
 
+        if (!stalloc) return 0;
+
         GLuint block = glGetProgramResourceIndex(prg, GL_UNIFORM_BLOCK, name);
 
         if (block == GL_INVALID_INDEX) return 0;
@@ -549,7 +561,7 @@ namespace gfx
         };
         static const GLenum reqUniProps[5]   = {GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_ARRAY_STRIDE, GL_OFFSET};
 
-        if (numVars<=0 || !desc) return MATCH_INVALID_PARAMS;
+        if (numVars<=0 || !desc || !stalloc) return MATCH_INVALID_PARAMS;
 
         GLuint block = glGetProgramResourceIndex(prg, type, name);
 
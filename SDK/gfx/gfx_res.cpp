@@ -149,6 +149,17 @@ namespace gfx_res
     etlsf_t vgGArena;
     GLuint  buffer;
 
+    uint16_t vgGArenaGauge;
+
+    // Share of free space that is not in the largest free range, percents
+    static int64_t sampleArenaFragmentation(void* arena)
+    {
+        etlsf_free_stats_t stats;
+        etlsf_free_stats((etlsf_t)arena, &stats);
+
+        return stats.free_size ? 100 - (int64_t)stats.largest_free_size * 100 / stats.free_size : 0;
+    }
+
     GLuint stdPrograms[STD_PROGRAM_COUNT];
 
     GLuint prgUI;
@@ -225,6 +236,7 @@ namespace gfx_res
         vaoRect = gfx::createVAO(2, ve, 2, divs);
 
         vgGArena = etlsf_create(VG_BUFFER_SIZE, GFX_MAX_ALLOCS);
+        vgGArenaGauge = profilerAddGaugeSampler("vg arena fragmentation, %", sampleArenaFragmentation, vgGArena);
         glCreateBuffers(1, &buffer);
         glNamedBufferStorage(buffer, VG_BUFFER_SIZE, 0, GL_MAP_WRITE_BIT);
 
@@ -236,6 +248,7 @@ namespace gfx_res
     {
         vg::destroyFont(vg::defaultFont);
 
+        profilerRemoveGaugeSampler(vgGArenaGauge);
         etlsf_destroy(vgGArena);
         glDeleteBuffers(1, &buffer);
 
@@ -42,7 +42,7 @@ namespace res
 
         strcat_s(path, filePath);
 
-        if (mem_file(&source, path))
+        if (mem_map(&source, path, MEM_MAP_SEQUENTIAL))
         {
             GLint lens   [MAX_DEFINES_TO_PROCESS+1];
             char* sources[MAX_DEFINES_TO_PROCESS+1];
@@ -246,7 +246,7 @@ namespace res
 
         GLuint texture;
 
-        if (mem_file(&texData, name))
+        if (mem_map(&texData, name, MEM_MAP_SEQUENTIAL))
         {
             int imgWidth, imgHeight;
 
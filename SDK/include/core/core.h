@@ -4,20 +4,36 @@
 #include <stdarg.h>
 
 #include <physfs/physfs.h>
+#include <mjson.h>
 
 #ifndef _NDEBUG
 #   define CORE_ENABLE_ASSERT
 #endif
 
+// Allocation tags of mspaces, define CORE_ENABLE_MEM_TAGS project wide to track in release.
+// Release projects define NDEBUG, not _NDEBUG, so both are checked.
+#if !defined(NDEBUG) && !defined(_NDEBUG) && !defined(CORE_DISABLE_MEM_TAGS)
+#   define CORE_ENABLE_MEM_TAGS
+#endif
+
 typedef volatile long atomic_t;
 
+#if defined(_MSC_VER)
+#   define CORE_THREAD_LOCAL __declspec(thread)
+#else
+#   define CORE_THREAD_LOCAL __thread
+#endif
+
 #include <core/debug.h>
 #include <core/bits.h>
 #include <core/mt.h>
 #include <core/ml.h>
 #include <core/profiler.h>
+#include <core/profiler_stats.h>
 #include <core/timer.h>
 #include <core/memory.h>
+#include <core/handle_pool.h>
+#include <core/io.h>
 #include <core/str.h>
 
 #define UNUSED(var)         ((void)(var))
@@ -61,8 +77,8 @@ inline void atomicUnlock(atomic_t* lock) { _InterlockedExchange(lock, 0); }
 // NOTE: hack for fast profiling and quick integration;
 //       profiler_scope_initialized and profiler_scope_initialized
 //       add around 8-16Kb per 1K events + a lot of code;
-#define PROFILER_CPU_TIMESLICE(name)                                \
-    static uint16_t scope_id = 0;                                   \
+#define PROFILER_STATIC_ID(var, name)                               \
+    static uint16_t var = 0;                                        \
     {                                                               \
         static volatile atomic_t profiler_scope_initialized = 0;    \
         static volatile atomic_t profiler_scope_spinlock = 0;       \
@@ -71,15 +87,34 @@ inline void atomicUnlock(atomic_t* lock) { _InterlockedExchange(lock, 0); }
             atomicLock(&profiler_scope_spinlock);                   \
             if (profiler_scope_initialized == 0)                    \
             {                                                       \
-                scope_id = profilerGenerateId();                    \
-                profilerAddDesc(scope_id, name);                    \
+                var = profilerGenerateId();                         \
+                profilerAddDesc(var, name);                         \
                 profiler_scope_initialized = 1;                     \
             }                                                       \
             atomicUnlock(&profiler_scope_spinlock);                 \
         }                                                           \
     }                                                               \
+
+#define PROFILER_CPU_TIMESLICE(name)                                \
+    PROFILER_STATIC_ID(scope_id, name)                              \
     ProfilerCPUAutoTimeslice profiler_autoscope(scope_id)           \
 
+// 64-bit absolute value recorded immediately
+#define PROFILER_GAUGE(name, value)                                 \
+    do                                                              \
+    {                                                               \
+        PROFILER_STATIC_ID(counter_id, name)                        \
+        profilerAddGauge(counter_id, (int64_t)(value));             \
+    } while (0)                                                     \
+
+// 32-bit increment accumulated until the end of frame
+#define PROFILER_FRAME_COUNTER(name, delta)                         \
+    do                                                              \
+    {                                                               \
+        PROFILER_STATIC_ID(counter_id, name)                        \
+        profilerAddFrameCounter(counter_id, (int32_t)(delta));      \
+    } while (0)                                                     \
+
 
 char* cpToUTF8(int cp, char* str);
 
@@ -115,12 +150,29 @@ struct memory_t
     uint8_t* buffer;
     size_t   size;
     size_t   allocated;
+    bool     mapped;    //Buffer is read-only view of file
+};
+
+enum MemMapHint
+{
+    MEM_MAP_NORMAL     = 0,
+    MEM_MAP_SEQUENTIAL = 1,     //File is read once from start to end
+    MEM_MAP_WILLNEED   = 2,     //File is read soon, pages are prefetched
 };
 
 bool mem_area(memory_t* mem, size_t size);
 bool mem_file(memory_t* mem, const char* name);
+// Maps file read-only without copy if file is in directory on disk,
+// files in archives are copied as in mem_file. Buffer should not be modified.
+bool mem_map (memory_t* mem, const char* name, int hints = MEM_MAP_NORMAL);
 void mem_free(memory_t* mem);
 
+// Parses mjson file, parsed BJSON is cached next to file as "<name>.bjson".
+// Cache is mapped on later loads while size and time or content hash of file match.
+// Dictionaries are indexed as in mjson_build_index.
+// Root points into mem, buffer should not be modified.
+bool mem_mjson(memory_t* mem, const char* name, mjson_element_t* root);
+
 bool mem_thread_stack_init(memory_t* mem, size_t size);
 
 template <typename type>
@@ -375,22 +427,63 @@ void  stack_mem_init(stack_mem_t* stack, void* mem, size_t size);
 void* stack_mem_alloc(stack_mem_t stack, size_t size, size_t align = 0);
 void  stack_mem_reset(stack_mem_t stack, void* ptr);
 
+// Marker is the number of allocated bytes, rewinding to it frees everything allocated after
+size_t stack_mem_marker(stack_mem_t stack);
+void   stack_mem_rewind(stack_mem_t stack, size_t marker);
+// High-water mark in bytes
+size_t stack_mem_peak  (stack_mem_t stack);
+
 template<typename T>
 T* stack_mem_alloc(stack_mem_t stack, size_t count, size_t align = 0)
 {
     return (T*)stack_mem_alloc(stack, count*sizeof(T), align);
 }
 
+struct StackMemAutoScope
+{
+    stack_mem_t stack;
+    size_t      marker;
+
+     StackMemAutoScope(stack_mem_t s): stack(s), marker(s ? stack_mem_marker(s) : 0) {}
+    ~StackMemAutoScope() { if (stack) stack_mem_rewind(stack, marker); }
+};
+
+// Everything allocated from the thread stack after this line is released at the end of the scope
+#define THREAD_STACK_SCOPE() StackMemAutoScope CORE_UNIQUE_NAME(thread_stack_scope)(core::get_thread_data_stack())
+
 namespace core
 {
     void init();
     void fini();
 
-    //TODO: make mt!!!!!
+    // Every thread gets own linear stack on first use, stacks of exited SDL threads are reused.
+    // Stack is 0 and thread_stack_alloc returns 0 when all stacks are in use or out of memory.
     stack_mem_t get_thread_data_stack();
     void* thread_stack_alloc(size_t size, size_t align = 0);
     void  thread_stack_reset(void* ptr);
 
+    // High-water mark of the calling thread stack and maximum over all thread stacks
+    size_t thread_stack_peak();
+    size_t thread_stacks_peak();
+
+    // Frame memory: linear allocations that stay valid until frame_mem_begin is called
+    // FRAME_MEM_BUFFERS times. Every thread allocates from own page without locks.
+    // Allocations that do not fit fall back to heap and are counted as overflows.
+    // frame_mem_begin is called by gfx::beginFrame, it must not run along with frame_alloc.
+    void   frame_mem_begin();
+    void*  frame_alloc(size_t size, size_t align = 0);
+
+    // Bytes taken from current frame buffer by all threads
+    size_t frame_mem_used();
+    // Allocations that fell back to heap since core::init
+    size_t frame_mem_overflows();
+
+    template<typename T>
+    T* frame_alloc_array(size_t count)
+    {
+        return (T*)frame_alloc(sizeof(T)*count, _alignof(T));
+    }
+
     template<typename T>
     inline T min(T x, T y)
     {
@@ -492,6 +585,23 @@ void mem_copy(void *dest, const void *src, size_t len);
 void mem_copy8(uint8_t *dp, const uint8_t *sp, size_t len);
 void mem_copy16(uint16_t *dp, const uint16_t *sp, size_t len);
 void mem_copy32(uint32_t *dp, const uint32_t *sp, size_t len);
+
+// Copy into write-only memory (mapped GPU buffers), large copies use
+// non-temporal stores and do not pollute cache. Regions must not overlap.
+void mem_copy_stream(void *dest, const void *src, size_t len);
+
+enum
+{
+    MEM_ISA_SCALAR,
+    MEM_ISA_SSE2,
+    MEM_ISA_AVX2
+};
+
+// Instruction set of mem_* functions, best supported one is selected on first use.
+int mem_utils_isa();
+// Force instruction set for tests and benchmarks, negative value selects the best
+// supported, returns selected one (never above supported).
+int mem_utils_select_isa(int isa);
 #ifdef __cplusplus
 }
 
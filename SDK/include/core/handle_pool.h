@@ -0,0 +1,345 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// Pools of objects addressed by generational handles instead of pointers:
+// use of freed object is detected, handles stay small and objects of the
+// same type live next to each other without per-object heap calls.
+
+namespace core
+{
+    // Generational handle: pool slot index in low bits, slot generation in high bits.
+    // Generation is incremented when object is freed, so stale handles do not match.
+    // Zero value is null handle, generation of live object is never zero.
+    template<typename T>
+    struct handle_t
+    {
+        uint32_t value;
+    };
+
+    static const uint32_t HANDLE_INDEX_BITS = 20;
+    static const uint32_t HANDLE_GEN_BITS   = 12;
+
+    static const uint32_t HANDLE_INDEX_MASK = (1 << HANDLE_INDEX_BITS) - 1;
+    static const uint32_t HANDLE_GEN_MASK   = (1 << HANDLE_GEN_BITS) - 1;
+
+    template<typename T>
+    inline bool handle_is_null(handle_t<T> handle)
+    {
+        return handle.value == 0;
+    }
+
+    // Pool of up to N objects with fixed addresses, zero initialized pool is empty and ready to use.
+    // Slot metadata is kept in separate arrays, live slot indices are packed in live[],
+    // so iteration touches only live objects: handle_pool_at(pool, 0..count-1).
+    // Freed slots are reused first (LIFO), so live objects stay close to each other.
+    // Pool is not thread safe.
+    template<typename T, size_t N>
+    struct handle_pool_t
+    {
+        uint32_t count;         // Live objects
+        uint32_t used;          // Slots ever allocated, slots above are not initialized
+        uint32_t freeHead;      // First free slot + 1, 0 if free list is empty
+
+        uint32_t generation[N];
+        uint32_t live[N];       // Slots of live objects, packed
+        uint32_t links[N];      // Position of slot in live[] or next free slot + 1
+
+        T        data[N];
+    };
+
+    // Pool of objects that grows by pages of P objects up to HANDLE_INDEX_MASK objects.
+    // Pages are never moved or freed before handle_pool_fini, so object addresses are stable.
+    // Zero initialized pool is empty and ready to use, otherwise same as handle_pool_t.
+    template<typename T, size_t P = 256>
+    struct handle_dynpool_t
+    {
+        uint32_t  count;
+        uint32_t  used;
+        uint32_t  freeHead;
+        uint32_t  capacity;     // Slots in allocated pages
+
+        uint32_t* generation;
+        uint32_t* live;
+        uint32_t* links;
+
+        T**       pages;
+    };
+
+    // Slot bookkeeping shared by both pools, Pool has count, used, freeHead and
+    // generation, live, links indexable by slot.
+    namespace handle_slots
+    {
+        static const uint32_t INVALID = 0xFFFFFFFF;
+
+        template<typename Pool>
+        uint32_t find(const Pool& pool, uint32_t value)
+        {
+            uint32_t slot = value & HANDLE_INDEX_MASK;
+            uint32_t gen  = value >> HANDLE_INDEX_BITS;
+
+            return gen && slot < pool.used && pool.generation[slot] == gen ? slot : INVALID;
+        }
+
+        // Returns INVALID if there is no free slot below capacity
+        template<typename Pool>
+        uint32_t alloc(Pool& pool, uint32_t capacity)
+        {
+            uint32_t slot;
+
+            if (pool.freeHead)
+            {
+                slot          = pool.freeHead - 1;
+                pool.freeHead = pool.links[slot];
+            }
+            else if (pool.used < capacity)
+            {
+                slot = pool.used++;
+                pool.generation[slot] = 0;
+            }
+            else
+            {
+                return INVALID;
+            }
+
+            // Skip zero generation, so live handles are never null
+            if (!pool.generation[slot])
+            {
+                pool.generation[slot] = 1;
+            }
+
+            pool.live[pool.count] = slot;
+            pool.links[slot]      = pool.count++;
+
+            return (pool.generation[slot] << HANDLE_INDEX_BITS) | slot;
+        }
+
+        template<typename Pool>
+        void release(Pool& pool, uint32_t slot)
+        {
+            // Last live slot takes place of freed one
+            uint32_t pos  = pool.links[slot];
+            uint32_t last = pool.live[--pool.count];
+
+            pool.live[pos]   = last;
+            pool.links[last] = pos;
+
+            pool.generation[slot] = (pool.generation[slot] + 1) & HANDLE_GEN_MASK;
+            pool.links[slot]      = pool.freeHead;
+            pool.freeHead         = slot + 1;
+        }
+
+        template<typename Pool>
+        void reset(Pool& pool)
+        {
+            // Generations are kept, so handles issued before reset stay stale
+            for (uint32_t i = 0; i < pool.count; ++i)
+            {
+                uint32_t slot = pool.live[i];
+                pool.generation[slot] = (pool.generation[slot] + 1) & HANDLE_GEN_MASK;
+            }
+
+            pool.count    = 0;
+            pool.freeHead = 0;
+
+            for (uint32_t slot = 0; slot < pool.used; ++slot)
+            {
+                pool.links[slot] = pool.freeHead;
+                pool.freeHead    = slot + 1;
+            }
+        }
+
+        template<typename Pool>
+        uint32_t handle_at(const Pool& pool, uint32_t i)
+        {
+            assert(i < pool.count);
+
+            uint32_t slot = pool.live[i];
+            return (pool.generation[slot] << HANDLE_INDEX_BITS) | slot;
+        }
+    }
+
+    template<typename T, size_t N>
+    void handle_pool_reset(handle_pool_t<T, N>& pool)
+    {
+        static_assert(N <= HANDLE_INDEX_MASK, "Pool is too large for handle index");
+
+        handle_slots::reset(pool);
+    }
+
+    // Slot of live object or N for null, stale and out of range handles
+    template<typename T, size_t N>
+    uint32_t handle_pool_slot(const handle_pool_t<T, N>& pool, handle_t<T> handle)
+    {
+        uint32_t slot = handle_slots::find(pool, handle.value);
+        return slot != handle_slots::INVALID ? slot : (uint32_t)N;
+    }
+
+    template<typename T, size_t N>
+    bool handle_pool_is_valid(const handle_pool_t<T, N>& pool, handle_t<T> handle)
+    {
+        return handle_pool_slot(pool, handle) < N;
+    }
+
+    // Returns null handle if pool is full, object memory is not initialized
+    template<typename T, size_t N>
+    handle_t<T> handle_pool_alloc(handle_pool_t<T, N>& pool)
+    {
+        uint32_t    value  = handle_slots::alloc(pool, (uint32_t)N);
+        handle_t<T> handle = {value != handle_slots::INVALID ? value : 0};
+
+        return handle;
+    }
+
+    // Returns false for null and stale handles
+    template<typename T, size_t N>
+    bool handle_pool_free(handle_pool_t<T, N>& pool, handle_t<T> handle)
+    {
+        uint32_t slot = handle_pool_slot(pool, handle);
+        if (slot == N) return false;
+
+        handle_slots::release(pool, slot);
+
+        return true;
+    }
+
+    // Object of live handle, 0 for null and stale handles
+    template<typename T, size_t N>
+    T* handle_pool_get(handle_pool_t<T, N>& pool, handle_t<T> handle)
+    {
+        uint32_t slot = handle_pool_slot(pool, handle);
+        return slot < N ? &pool.data[slot] : 0;
+    }
+
+    template<typename T, size_t N>
+    uint32_t handle_pool_count(const handle_pool_t<T, N>& pool)
+    {
+        return pool.count;
+    }
+
+    // Live objects in no particular order, freeing object changes order
+    template<typename T, size_t N>
+    T* handle_pool_at(handle_pool_t<T, N>& pool, uint32_t i)
+    {
+        assert(i < pool.count);
+        return &pool.data[pool.live[i]];
+    }
+
+    template<typename T, size_t N>
+    handle_t<T> handle_pool_handle_at(const handle_pool_t<T, N>& pool, uint32_t i)
+    {
+        handle_t<T> handle = {handle_slots::handle_at(pool, i)};
+        return handle;
+    }
+
+    // Growable pool, same semantics as fixed one
+
+    template<typename T, size_t P>
+    void handle_pool_reset(handle_dynpool_t<T, P>& pool)
+    {
+        handle_slots::reset(pool);
+    }
+
+    // Frees all pages, all handles become stale, pool is empty and can be used again
+    template<typename T, size_t P>
+    void handle_pool_fini(handle_dynpool_t<T, P>& pool)
+    {
+        for (uint32_t i = 0; i < pool.capacity / P; ++i)
+        {
+            ::free(pool.pages[i]);
+        }
+
+        ::free(pool.generation);
+        ::free(pool.live);
+        ::free(pool.links);
+        ::free(pool.pages);
+
+        handle_dynpool_t<T, P> empty = {};
+        pool = empty;
+    }
+
+    template<typename T, size_t P>
+    bool handle_pool_is_valid(const handle_dynpool_t<T, P>& pool, handle_t<T> handle)
+    {
+        return handle_slots::find(pool, handle.value) != handle_slots::INVALID;
+    }
+
+    // Returns null handle if pool has HANDLE_INDEX_MASK objects or out of memory,
+    // object memory is not initialized
+    template<typename T, size_t P>
+    handle_t<T> handle_pool_alloc(handle_dynpool_t<T, P>& pool)
+    {
+        static_assert(P > 0 && HANDLE_INDEX_MASK % P == P - 1, "Page size must be power of two");
+
+        handle_t<T> handle = {0};
+
+        if (!pool.freeHead && pool.used == pool.capacity)
+        {
+            uint32_t capacity = pool.capacity + (uint32_t)P;
+            if (capacity > HANDLE_INDEX_MASK) return handle;
+
+            uint32_t* generation = (uint32_t*)realloc(pool.generation, capacity * sizeof(uint32_t));
+            if (generation) pool.generation = generation;
+            uint32_t* live = (uint32_t*)realloc(pool.live, capacity * sizeof(uint32_t));
+            if (live) pool.live = live;
+            uint32_t* links = (uint32_t*)realloc(pool.links, capacity * sizeof(uint32_t));
+            if (links) pool.links = links;
+            T** pages = (T**)realloc(pool.pages, capacity / P * sizeof(T*));
+            if (pages) pool.pages = pages;
+
+            T* page = generation && live && links && pages ? (T*)malloc(P * sizeof(T)) : 0;
+            if (!page) return handle;
+
+            pool.pages[pool.capacity / P] = page;
+            pool.capacity = capacity;
+        }
+
+        uint32_t value = handle_slots::alloc(pool, pool.capacity);
+        handle.value = value != handle_slots::INVALID ? value : 0;
+
+        return handle;
+    }
+
+    template<typename T, size_t P>
+    bool handle_pool_free(handle_dynpool_t<T, P>& pool, handle_t<T> handle)
+    {
+        uint32_t slot = handle_slots::find(pool, handle.value);
+        if (slot == handle_slots::INVALID) return false;
+
+        handle_slots::release(pool, slot);
+
+        return true;
+    }
+
+    template<typename T, size_t P>
+    T* handle_pool_get(handle_dynpool_t<T, P>& pool, handle_t<T> handle)
+    {
+        uint32_t slot = handle_slots::find(pool, handle.value);
+        return slot != handle_slots::INVALID ? &pool.pages[slot / P][slot % P] : 0;
+    }
+
+    template<typename T, size_t P>
+    uint32_t handle_pool_count(const handle_dynpool_t<T, P>& pool)
+    {
+        return pool.count;
+    }
+
+    template<typename T, size_t P>
+    T* handle_pool_at(handle_dynpool_t<T, P>& pool, uint32_t i)
+    {
+        assert(i < pool.count);
+
+        uint32_t slot = pool.live[i];
+        return &pool.pages[slot / P][slot % P];
+    }
+
+    template<typename T, size_t P>
+    handle_t<T> handle_pool_handle_at(const handle_dynpool_t<T, P>& pool, uint32_t i)
+    {
+        handle_t<T> handle = {handle_slots::handle_at(pool, i)};
+        return handle;
+    }
+}
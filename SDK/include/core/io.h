@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <core/handle_pool.h>
+
+struct memory_t;
+
+// Asynchronous file reads. Requests are queued by priority and read by dedicated I/O threads,
+// every thread takes up to MAX_BATCH requests at once and completions of the batch are run
+// by one job of the job system. Bytes that are read but not yet completed are limited,
+// I/O threads wait for completions before reading more. Limit bounds reads only: data is
+// released from bytes in flight when completion returns, memory kept by completions
+// is not counted.
+
+namespace io
+{
+    struct request_data_t;
+
+    // Handle is valid until completion returns
+    typedef core::handle_t<request_data_t> request_t;
+
+    enum Priority
+    {
+        PRIORITY_LOW,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH,
+        PRIORITY_COUNT
+    };
+
+    enum Status
+    {
+        STATUS_COMPLETE,
+        STATUS_FAILED,
+        STATUS_CANCELLED
+    };
+
+    // Data is owned by completion and should be released with mem_free,
+    // data is empty if read failed or was cancelled. Files in directories are
+    // mapped as in mem_map, buffer should not be modified.
+    typedef void (*completion_func_t)(void* arg, int status, memory_t* data);
+
+    static const uint32_t MAX_REQUESTS = 1024;
+    static const uint32_t MAX_BATCH    = 8;
+    static const uint32_t MAX_THREADS  = 8;
+    static const size_t   MAX_NAME     = 260;
+
+    /**
+     * @param threadCount      Number of I/O threads.
+     * @param maxBytesInFlight Limit of bytes read and not completed, file bigger than limit
+     *                         is read when nothing else is in flight. Data passed to
+     *                         completions is not counted after completion returns.
+     */
+    void init(int threadCount, size_t maxBytesInFlight);
+    // Completes queued requests with STATUS_CANCELLED, waits for reads in progress
+    void fini();
+
+    /**
+     * @brief Queue read of whole file, name is copied.
+     * @return null handle if queue is full, name is null or too long.
+     */
+    request_t read(const char* name, int priority, completion_func_t completion, void* arg);
+
+    /**
+     * @brief Request that was not started is completed with STATUS_CANCELLED,
+     *        read in progress is not interrupted.
+     * @return true if request will be completed with STATUS_CANCELLED.
+     */
+    bool cancel(request_t request);
+
+    // Completion of request has returned
+    bool isComplete(request_t request);
+    // Execute pending jobs while waiting for completion of request
+    void wait(request_t request);
+
+    size_t getBytesInFlight();
+}
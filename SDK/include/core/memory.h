@@ -14,6 +14,83 @@ extern "C"
     void* mem_realloc(mspace_t mspace, void* ptr, size_t size, size_t alignment);
 
     void  mem_free(mspace_t mspace, void* ptr);
+
+    // Bytes allocated from mspace including allocator overhead
+    size_t mem_space_used(mspace_t mspace);
+
+    // Allocation tags: live bytes, count, peak and bytes per frame of every subsystem,
+    // tracked across all mspaces. Blocks allocated with mem_alloc are untagged.
+    // Tags are enabled in debug builds, define CORE_ENABLE_MEM_TAGS project wide to
+    // track in release. Without it tagged functions forward to untagged ones.
+    #define MEM_MAX_TAGS        32
+    #define MEM_TAG_UNTAGGED    0
+
+    typedef uint32_t mem_tag_t;
+
+    typedef struct mem_tag_stats_t
+    {
+        const char* name;
+        int64_t     liveBytes;
+        int64_t     peakBytes;
+        uint32_t    liveCount;
+        uint32_t    frameAllocs;    // Allocations during last complete frame
+        int64_t     frameBytes;     // Bytes allocated during last complete frame
+    } mem_tag_stats_t;
+
+#ifdef CORE_ENABLE_MEM_TAGS
+    // Name should have program lifetime, same name returns same tag.
+    // Returns MEM_TAG_UNTAGGED if there are no free tags.
+    mem_tag_t mem_register_tag(const char* name);
+
+    // Realloc keeps tag of block
+    void* mem_alloc_tagged(mspace_t mspace, size_t size, size_t alignment, mem_tag_t tag);
+
+    // Closes frame statistics and records live bytes and bytes per frame
+    // of every tag as profiler gauges
+    void mem_tags_frame_begin();
+
+    // Stats of registered tags, frame values are from last complete frame
+    uint32_t mem_tags_snapshot(mem_tag_stats_t* stats, uint32_t maxStats);
+
+    // Logs tags with live blocks, blocks released by mem_destroy_space are not leaks.
+    // Returns number of live blocks.
+    uint32_t mem_tags_report_leaks();
+#else
+    static inline mem_tag_t mem_register_tag(const char*) { return MEM_TAG_UNTAGGED; }
+
+    static inline void* mem_alloc_tagged(mspace_t mspace, size_t size, size_t alignment, mem_tag_t)
+    {
+        return mem_alloc(mspace, size, alignment);
+    }
+
+    static inline void     mem_tags_frame_begin() {}
+    static inline uint32_t mem_tags_snapshot(mem_tag_stats_t*, uint32_t) { return 0; }
+    static inline uint32_t mem_tags_report_leaks() { return 0; }
+#endif
+
+    // Thread caching front end of mspace. Blocks up to MEM_CACHE_MAX_SIZE come from
+    // per-thread size class bins without mspace lock, bins are refilled from and returned
+    // to shared bins in batches. Blocks freed by other thread are queued to thread that
+    // carved them. Larger blocks are allocated from mspace. Blocks are 16 bytes aligned.
+    #define MEM_CACHE_MAX_SIZE      1024
+    #define MEM_CACHE_MAX_THREADS   64
+
+    struct mem_cache_internal_t;
+    typedef struct mem_cache_internal_t* mem_cache_t;
+
+    // Small blocks are accounted to tag in spans of 64Kb
+    mem_cache_t mem_create_cache (mspace_t mspace, mem_tag_t tag);
+    // Returns all memory of cache to mspace, other threads should not use cache
+    void        mem_destroy_cache(mem_cache_t cache);
+
+    void* mem_cache_alloc(mem_cache_t cache, size_t size);
+    // Size should be equal to requested size of allocation
+    void  mem_cache_free (mem_cache_t cache, void* ptr, size_t size);
+
+    // Returns blocks cached by calling thread to shared bins and releases thread slot,
+    // should be called before thread exits. Blocks of thread freed later by other threads
+    // go to shared bins too. Threads above MEM_CACHE_MAX_THREADS use shared bins directly.
+    void  mem_cache_flush(mem_cache_t cache);
 #ifdef __cplusplus
 }
 
@@ -31,6 +108,18 @@ namespace mem
         return (T*)mem_alloc(mspace, sizeof(T)*count, _alignof(T));
     }
 
+    template<typename T>
+    T* alloc(mspace_t mspace, mem_tag_t tag)
+    {
+        return (T*)mem_alloc_tagged(mspace, sizeof(T), _alignof(T), tag);
+    }
+
+    template<typename T>
+    T* alloc_array(mspace_t mspace, size_t count, mem_tag_t tag)
+    {
+        return (T*)mem_alloc_tagged(mspace, sizeof(T)*count, _alignof(T), tag);
+    }
+
     inline void free(mspace_t space, void* ptr)
     {
         mem_free(space, ptr);
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
-// Implementation is based on Mathias Brossard threadpool (https://github.com/mbrossard/threadpool).
+// Job system is a work-stealing scheduler: every worker owns a bounded deque
+// (Chase-Lev), pushes and pops jobs at the bottom, idle workers steal from the top.
+// Threads that are not workers submit through a shared injection queue.
 
 namespace mt
 {
@@ -17,21 +20,183 @@ namespace mt
         threadFailure = -5
     } error_t;
 
+    struct job_t;
+
+    typedef void (*task_func_t)(void*);
+
+    // Size of the inline payload accepted by createJobWithData (job is one cache line).
+    static const size_t JOB_DATA_SIZE = 64 - 4 * sizeof(void*) - 2 * sizeof(int32_t);
+
+    // Job slots are reused as soon as job is finished, handle keeps generation of the slot,
+    // so waiting on handle of finished job never picks up a newer job in the same slot.
+    struct job_handle_t
+    {
+        const job_t* job;
+        uint32_t     generation;
+    };
+
     /**
-     * @param thread_count Number of worker threads.
-     * @param queue_size   Size of the queue.
-     * @param flags        Unused parameter.
+     * @param threadCount Number of worker threads in addition to the calling thread,
+     *                    negative value uses SDL_GetCPUCount()-1.
+     * @param queueSize   Capacity of each worker deque and job ring (rounded up to power of 2).
      */
     void init(int threadCount, int queueSize);
     void fini();
 
     /**
-     * @brief add a new task in the queue of a thread pool
+     * @brief Allocate a job from the ring of the calling thread.
      * @param taskFunc Pointer to the function that will perform the task.
      * @param arg      Argument to be passed to the function.
-     * @param flags    Unused parameter.
+     * @return job or 0 if ring slot is still in flight.
+     */
+    job_t* createJob(task_func_t taskFunc, void* arg);
+
+    /**
+     * @brief Same as createJob, but parent is not complete until the child finishes.
+     *        Child must be created before parent job is run or from within parent job.
+     */
+    job_t* createChildJob(job_t* parent, task_func_t taskFunc, void* arg);
+
+    /**
+     * @brief Copy up to JOB_DATA_SIZE bytes into the job, taskFunc receives pointer to the copy.
+     */
+    job_t* createJobWithData(job_t* parent, task_func_t taskFunc, const void* data, size_t size);
+
+    /**
+     * @brief Push job to the deque of the calling worker (or injection queue for other threads).
+     *        If the queue is full the job is executed inline.
+     *        After shutdown started job is released without running and shutdown is returned.
+     * @return 0 if all goes well, negative values in case of error (@see error_t for codes).
+     */
+    int  runJob(job_t* job);
+
+    /**
+     * @brief Take handle before job is run, job pointer can refer to another job after that.
+     */
+    job_handle_t getJobHandle(const job_t* job);
+
+    /**
+     * @brief Execute other jobs while waiting for job and all its children to finish.
+     */
+    void waitJob(job_handle_t job);
+    bool isJobComplete(job_handle_t job);
+
+    /**
+     * @brief Execute one pending job on the calling thread, for threads waiting on other systems.
+     * @return false if there are no pending jobs.
+     */
+    bool runPendingJob();
+
+    // Task graph: tasks declare predecessors, continuations are scheduled on the job system
+    // as soon as all predecessors are finished. Graph is built once and can be resubmitted
+    // every frame after previous submission is complete.
+    struct task_graph_t;
+
+    typedef uint16_t task_id_t;
+
+    static const task_id_t INVALID_TASK_ID = 0xFFFF;
+
+    task_graph_t* createTaskGraph(size_t maxTasks, size_t maxDependencies);
+    void          destroyTaskGraph(task_graph_t* graph);
+
+    /**
+     * @brief Add task to the graph.
+     * @param deps    Tasks that must finish before this one, only previously added tasks are allowed.
+     * @param numDeps Number of elements in deps.
+     * @return task id or INVALID_TASK_ID if graph storage is exhausted.
+     */
+    task_id_t taskGraphAdd(task_graph_t* graph, task_func_t taskFunc, void* arg, const task_id_t* deps, size_t numDeps);
+    void      taskGraphClear(task_graph_t* graph);
+
+    /**
+     * @brief Schedule tasks without predecessors, call does not block.
      * @return 0 if all goes well, negative values in case of error (@see error_t for codes).
      */
+    int  taskGraphSubmit(task_graph_t* graph);
+    // Execute pending jobs until every task of the last submission is finished.
+    void taskGraphWait(task_graph_t* graph);
+    bool taskGraphIsComplete(task_graph_t* graph);
+
+    // Range function processes elements in [begin, end).
+    typedef void (*range_func_t)(void* arg, size_t begin, size_t end);
+    // Reduce function accumulates [begin, end) into partial, join merges partial into result.
+    typedef void (*reduce_func_t)(void* arg, void* partial, size_t begin, size_t end);
+    typedef void (*join_func_t)(void* arg, void* result, const void* partial);
+
+    /**
+     * @brief Split [begin, end) recursively into subranges no larger than grain and run them on workers.
+     *        Runs serially if range is not bigger than grain. Blocks until all subranges are done,
+     *        calling thread executes jobs while waiting.
+     * @param grain Minimal subrange size, 0 selects chunk size based on worker count.
+     */
+    void parallel_for(size_t begin, size_t end, size_t grain, range_func_t func, void* arg);
+
+    /**
+     * @brief Same splitting as parallel_for, every worker accumulates into own partial
+     *        (initialized from identity), partials are joined into result by the calling thread.
+     */
+    void parallel_reduce(size_t begin, size_t end, size_t grain,
+                         void* result, const void* identity, size_t partialSize,
+                         reduce_func_t reduce, join_func_t join, void* arg);
+
+    template <typename F>
+    void rangeFuncStub(void* fn, size_t begin, size_t end)
+    {
+        (*static_cast<const F*>(fn))(begin, end);
+    }
+
+    // fn(size_t begin, size_t end)
+    template <typename F>
+    void parallel_for(size_t begin, size_t end, size_t grain, const F& fn)
+    {
+        parallel_for(begin, end, grain, &rangeFuncStub<F>, (void*)&fn);
+    }
+
+    template <typename T, typename F, typename J>
+    struct reduce_ctx_t
+    {
+        const F* fn;
+        const J* join;
+    };
+
+    template <typename T, typename F, typename J>
+    void reduceFuncStub(void* ctx, void* partial, size_t begin, size_t end)
+    {
+        (*static_cast<reduce_ctx_t<T, F, J>*>(ctx)->fn)(*static_cast<T*>(partial), begin, end);
+    }
+
+    template <typename T, typename F, typename J>
+    void joinFuncStub(void* ctx, void* result, const void* partial)
+    {
+        (*static_cast<reduce_ctx_t<T, F, J>*>(ctx)->join)(*static_cast<T*>(result), *static_cast<const T*>(partial));
+    }
+
+    // fn(T& partial, size_t begin, size_t end), join(T& result, const T& partial)
+    template <typename T, typename F, typename J>
+    T parallel_reduce(size_t begin, size_t end, size_t grain, const T& identity, const F& fn, const J& join)
+    {
+        reduce_ctx_t<T, F, J> ctx = {&fn, &join};
+        T result = identity;
+
+        parallel_reduce(begin, end, grain, &result, &identity, sizeof(T),
+                        &reduceFuncStub<T, F, J>, &joinFuncStub<T, F, J>, &ctx);
+
+        return result;
+    }
+
+    // Number of workers including the thread that called init.
+    int  getWorkerCount();
+    // Index of the calling worker in [0, getWorkerCount()), -1 for non worker threads.
+    int  getWorkerIndex();
+
+    /**
+     * @brief add a new task in the queue of a thread pool
+     * @param taskFunc Pointer to the function that will perform the task.
+     * @param arg      Argument to be passed to the function.
+     * @param handle   Optional event handle to wait on with syncAndReleaseEvent.
+     * @return 0 if all goes well, negative values in case of error (@see error_t for codes),
+     *         queueFull if no job slots or events are left. Handle is INVALID_HANDLE on error.
+     */
     int addAsyncTask(void (*taskFunc)(void *), void *arg, uint32_t* handle);
 
     void syncAndReleaseEvent(uint32_t handle);
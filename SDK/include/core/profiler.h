@@ -5,61 +5,154 @@ enum EventPhase
     PROF_EVENT_PHASE_BEGIN,
     PROF_EVENT_PHASE_END,
     PROF_EVENT_PHASE_MARKER,
+    PROF_EVENT_PHASE_COUNTER,
+    PROF_EVENT_PHASE_COUNTER_HIGH,  // Follows every counter event, keeps high 32 bits of value
     PROF_EVENT_PHASE_COUNT
 };
 
-#define TIME_BITS  30
-#define PHASE_BITS  2
 #define MAX_PROFILER_EVENTS     1*1024*1024
+#define MAX_PROFILER_IDS        2048
 
-static_assert(TIME_BITS+PHASE_BITS <= 32, "Check that phase and timestamps use up to 32 bits");
+static_assert(MAX_PROFILER_IDS<=0x10000, "Maximum id should not exceed capacity of uint16_t");
 
+// Timestamps are 64-bit ticks relative to capture start, no quantization.
+// Value is used only by counter events: counter event keeps low 32 bits and is followed
+// by PROF_EVENT_PHASE_COUNTER_HIGH event with the same timestamp, id and tid.
 struct profiler_event_t
 {
-    uint16_t id;       //TODO: make it uint16_t
-    uint16_t tid;
-    uint32_t phase     : PHASE_BITS;
-    uint32_t timestamp : TIME_BITS;
+    uint64_t timestamp;
+    uint16_t id;
+    uint8_t  tid;
+    uint8_t  phase;
+    int32_t  value;
 };
 
-static_assert(sizeof(profiler_event_t)==8, "Fix packing in profiler_event_t in order ro maintain smaller event size");
+static_assert(sizeof(profiler_event_t)==16, "Fix packing in profiler_event_t in order ro maintain smaller event size");
 
 struct event_capture_t
 {
-    uint64_t  maxPeriod;      //Max timespan for capture
     uint64_t  freq;
-    uint64_t  startTime;
+    uint64_t  startTime;      //Absolute ticks
+    uint64_t  endTime;        //Ticks relative to startTime
     atomic_t  numEvents;
-    uint32_t  endTime;
-    uint32_t  quantShift;     //Precision shift for timestamp
     uint32_t  maxEvents;
+    uint32_t  numDropped;     //Events lost to ring overwrite or capture overflow
+    uint32_t  numFrames;      //Frame markers in capture
     profiler_event_t  events[MAX_PROFILER_EVENTS];
 };
 
-void event_capture_init(event_capture_t* capture, uint64_t freq, uint32_t log2res);
+void event_capture_init(event_capture_t* capture, uint64_t freq);
 void event_capture_start(event_capture_t* capture, uint64_t startTime);
 void event_capture_stop(event_capture_t* capture, uint64_t endTime);
 void event_capture_add(
     event_capture_t* capture,
     uint16_t trackID, uint16_t eventID,
-    EventPhase eventPhase, uint64_t ts
+    EventPhase eventPhase, uint64_t ts,
+    int64_t value = 0
 );
 
+// Value of counter event at index, joined with following high part
+inline int64_t event_capture_counter_value(const event_capture_t* capture, atomic_t index)
+{
+    const profiler_event_t* evt = &capture->events[index];
+
+    assert(evt[0].phase == PROF_EVENT_PHASE_COUNTER && index + 1 < capture->numEvents);
+    assert(evt[1].phase == PROF_EVENT_PHASE_COUNTER_HIGH);
+
+    return (int64_t)(((uint64_t)(uint32_t)evt[1].value << 32) | (uint32_t)evt[0].value);
+}
+
 // CPU capture interface
 void profilerInit();
+void profilerFini();
+
+/**
+ * @brief Forward CPU scopes and thread names to Remotery while enabled, for live
+ *        per-frame timing in browser (Remotery vis/index.html, localhost port 0x4597).
+ *        Recording into thread rings and captures is not affected. Remotery server
+ *        is started on first enable and is kept until profilerFini.
+ * @return true if forwarding is enabled.
+ */
+bool profilerSetRemoteEnabled(bool enable);
+bool profilerIsRemoteEnabled ();
 
 void profilerStartCapture   ();
 void profilerStopCapture    ();
 int  profilerIsCaptureActive();
 
+// Sync points delimit frames, start of every frame is recorded as marker event
 void profilerStartSyncPoint();
 void profilerStopSyncPoint ();
 
 void profilerAddCPUEvent(uint16_t id, EventPhase eventPhase);
 
+// Counter tracks share timeline with scopes and are recorded as PROF_EVENT_PHASE_COUNTER events.
+// Gauge records absolute value on calling thread immediately (memory in use, queue depth).
+void profilerAddGauge(uint16_t id, int64_t value);
+// Frame counter accumulates increments from any thread, frame total is recorded and
+// reset by profilerStartSyncPoint on thread calling sync points (bytes per frame, misses).
+void profilerAddFrameCounter(uint16_t id, int32_t delta);
+
+#define MAX_PROFILER_FRAME_COUNTERS 64
+#define MAX_PROFILER_GAUGE_SAMPLERS 32
+
+typedef int64_t (*profiler_gauge_sampler_t)(void* arg);
+
+/**
+ * @brief Sample gauge on every profilerStartSyncPoint, for levels that are not
+ *        convenient to report at the place of change.
+ * @return gauge id or 0xFFFF if there are no free sampler slots.
+ */
+uint16_t profilerAddGaugeSampler   (const char* name, profiler_gauge_sampler_t sampler, void* arg);
+void     profilerRemoveGaugeSampler(uint16_t id);
+
+// Threads always record events into own rings, capture is a snapshot of the rings
+// taken for time window of capture or for last frames. Thread index is used as
+// track id of events, thread is registered on first event if needed.
+#define MAX_PROFILER_THREADS        64
+#define MAX_PROFILER_THREAD_EVENTS  64*1024
+#define MAX_PROFILER_THREAD_NAME    32
+#define MAX_PROFILER_FRAMES         256
+
+static_assert((MAX_PROFILER_THREAD_EVENTS&(MAX_PROFILER_THREAD_EVENTS-1))==0, "Thread ring size should be power of 2");
+static_assert(MAX_PROFILER_THREADS<=0x100, "Maximum number of threads should not exceed capacity of uint8_t track id");
+static_assert((MAX_PROFILER_FRAMES&(MAX_PROFILER_FRAMES-1))==0, "Frame ring size should be power of 2");
+
+uint16_t    profilerRegisterThread  (const char* name);
+void        profilerUnregisterThread();
+uint16_t    profilerGetThreadCount  ();
+const char* profilerGetThreadName   (uint16_t threadIndex);
+// Events overwritten by owning thread while snapshot was reading them
+uint32_t    profilerGetThreadDropped(uint16_t threadIndex);
+
+/**
+ * @brief Copy last numFrames complete frames from thread rings into capture data.
+ *        Should be called outside of active capture, frames that are no longer
+ *        in thread rings are truncated.
+ * @return number of frames in snapshot.
+ */
+uint32_t profilerSnapshotFrames(uint32_t numFrames);
+
 uint16_t profilerGenerateId();
 
 // NOTE: name should be compile time(preferred) or has entire program lifetime
 void profilerAddDesc(uint16_t id, const char* name);
 event_capture_t* profilerGetData();
 const char** profilerGetNames();
+// Number of generated ids, size of names array
+uint16_t profilerGetIdCount();
+
+// Headless export of capture, track names are taken from registered profiler threads.
+// JSON is Chrome trace-event format (chrome://tracing, Perfetto UI), binary format
+// is read by Tools/profiler_report.py. Binary layout, little endian:
+//   header  : magic, uint32 version, uint64 freq, startTime, endTime,
+//             uint32 numEvents, numDropped, numFrames, uint16 numNames, numTracks
+//   names   : numNames x (uint16 length, chars), index is event id
+//   tracks  : numTracks x (uint16 length, chars)
+//   events  : numEvents x (varint timestamp delta, varint id, uint8 tid, uint8 phase),
+//             counter events are followed by zigzag varint value
+#define PROFILER_BINARY_MAGIC   "IPRF"
+#define PROFILER_BINARY_VERSION 2
+
+bool event_capture_export_json  (const event_capture_t* capture, const char** names, uint16_t numNames, const char* path);
+bool event_capture_export_binary(const event_capture_t* capture, const char** names, uint16_t numNames, const char* path);
@@ -0,0 +1,65 @@
+#pragma once
+
+// Aggregates captured events (profiler_event_t) into per-thread call trees and
+// per-scope statistics. Captures can be accumulated over many frames, durations
+// of every scope are kept in streaming log-linear histograms for percentiles.
+// Durations are in ticks of capture frequency.
+
+#define PROFILER_STATS_MAX_DEPTH      64
+#define PROFILER_STATS_INVALID_NODE   0xFFFFFFFF
+
+struct profiler_stats_t;
+
+struct profiler_scope_stats_t
+{
+    uint64_t count;       //Number of completed intervals
+    uint64_t totalTicks;  //Including children
+    uint64_t selfTicks;   //Excluding children
+    uint64_t minTicks;
+    uint64_t maxTicks;
+};
+
+// Call tree node, scope is identified by id and path from the root of thread
+struct profiler_tree_node_t
+{
+    uint16_t id;
+    uint16_t depth;
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint64_t count;
+    uint64_t totalTicks;
+    uint64_t selfTicks;
+};
+
+/**
+ * @param maxNodes Capacity of call tree storage for all threads, scopes that do not fit
+ *                 are still accounted in per-scope statistics.
+ */
+profiler_stats_t* profilerStatsCreate (uint32_t maxNodes);
+void              profilerStatsDestroy(profiler_stats_t* stats);
+void              profilerStatsReset  (profiler_stats_t* stats);
+
+/**
+ * @brief Accumulate events of capture, intervals not opened or not closed within
+ *        the capture are ignored.
+ */
+void profilerStatsAddCapture(profiler_stats_t* stats, const event_capture_t* capture);
+
+uint64_t profilerStatsGetFreq        (const profiler_stats_t* stats);
+uint32_t profilerStatsGetCaptureCount(const profiler_stats_t* stats);
+// Intervals not accounted in call tree because of node capacity or stack depth
+uint64_t profilerStatsGetDroppedCount(const profiler_stats_t* stats);
+
+// Returns 0 if scope was never completed
+const profiler_scope_stats_t* profilerStatsGetScope(const profiler_stats_t* stats, uint16_t id);
+
+/**
+ * @brief Approximate percentile of scope interval duration (relative error below 1/16).
+ * @param percentile Value in [0, 100].
+ */
+uint64_t profilerStatsGetPercentile(const profiler_stats_t* stats, uint16_t id, float percentile);
+
+// Root of thread call tree or PROFILER_STATS_INVALID_NODE, nodes are linked by firstChild/nextSibling
+uint32_t                    profilerStatsGetRoot(const profiler_stats_t* stats, uint16_t tid);
+const profiler_tree_node_t* profilerStatsGetNode(const profiler_stats_t* stats, uint32_t node);
@@ -5,36 +5,125 @@
 **  from http://tlsf.baisoku.org
 */
 
+#include <stddef.h>
 #include <stdint.h>
 
-//Allocator is not threadsafe
-//Supports spaces up to 2^30
-//Supports arbitrary alignments up to 256
-//Supports up to 65535 allocation max
-//Uses 16 bytes per possible allocation
+//Allocator is not threadsafe, unless created with etlsf_create_concurrent
+//Supports spaces up to 2^32 - granularity
+//Supports granularity (and alignment) of 16, 32, 64, 128 or 256 bytes, 256 by default
+//Supports up to ETLSF_MAX_ALLOCS (1048575) allocations
+//Uses 24 bytes per possible allocation plus ~1.7Kb per arena,
+//concurrent arenas use ~43Kb more for thread caches (see etlsf_metadata_size)
+//Handles are 32-bit: range index and 12-bit generation, stale handles are detected
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define ETLSF_INDEX_BITS 20
+#define ETLSF_MAX_ALLOCS ((1 << ETLSF_INDEX_BITS) - 1)
+#define ETLSF_MAX_FRAMES_DELAY 4
+
+enum etlsf_flags
+{
+    ETLSF_CONCURRENT = 1, // Same as etlsf_create_concurrent
+};
+
 struct etlsf_private_t;
 typedef struct etlsf_private_t*  etlsf_t;
-typedef struct { uint16_t value; } etlsf_alloc_t;
+typedef struct { uint32_t value; } etlsf_alloc_t;
 
 
-etlsf_t  etlsf_create (uint32_t size, uint16_t max_allocs);
+etlsf_t  etlsf_create (uint32_t size, uint32_t max_allocs);
 void     etlsf_destroy(etlsf_t arena);
 
-// All allocations are always aligned up to 256 bytes
+/*
+** Arena with custom granularity: 16 fits small allocations (e.g. 16 byte uniforms)
+** without waste, but adds first level lists, so free list search is
+** slightly longer, still O(1).
+*/
+etlsf_t  etlsf_create_ex(uint32_t size, uint32_t max_allocs, uint32_t granularity, uint32_t flags);
+
+/* Bytes of system memory used by arena bookkeeping */
+size_t   etlsf_metadata_size(uint32_t max_allocs, uint32_t flags);
+
+/*
+** Arena that can be used from any thread. Every thread caches ranges of small
+** sizes (up to 16 * granularity, 4Kb by default) and batches frees, so common allocations do not take arena
+** lock. Larger ranges are freed to arena immediately. Every thread caches at most
+** 256 granules (less in arenas under 16384 granules), allocation that fails returns
+** caches of all threads to arena and tries again.
+** Up to 64 threads get caches, others always take arena lock.
+*/
+etlsf_t  etlsf_create_concurrent(uint32_t size, uint32_t max_allocs);
+
+// All allocations are always aligned up to arena granularity
 etlsf_alloc_t etlsf_alloc_range(etlsf_t arena, uint32_t size);
 void          etlsf_free_range (etlsf_t arena, etlsf_alloc_t id);
 
+/*
+** Queue range to be freed by next etlsf_flush_deferred (e.g. GPU may still use it),
+** can be called from any thread for any arena, does not take locks.
+*/
+void etlsf_free_range_deferred(etlsf_t arena, etlsf_alloc_t id);
+/* Free all deferred ranges and batched frees of thread caches */
+void etlsf_flush_deferred(etlsf_t arena);
+/*
+** Call at frame boundary when GPU runs frames behind: ranges deferred since
+** previous call are kept for frames_delay more calls, older ones are freed.
+** frames_delay should be the same for every call, up to ETLSF_MAX_FRAMES_DELAY.
+*/
+void etlsf_flush_deferred_frames(etlsf_t arena, uint32_t frames_delay);
+/* Same as etlsf_flush_deferred, also returns ranges cached by threads to arena */
+void etlsf_trim(etlsf_t arena);
+
 /* Returns internal block size, not original request size */
 uint32_t etlsf_alloc_size  (etlsf_t arena, etlsf_alloc_t id);
 uint32_t etlsf_alloc_offset(etlsf_t arena, etlsf_alloc_t id);
 
+/* 0 for null, freed and stale handles (range was freed and reused since) */
 int etlsf_alloc_is_valid(etlsf_t arena, etlsf_alloc_t id);
 
+typedef struct
+{
+    uint32_t free_size;
+    uint32_t largest_free_size;
+    uint32_t num_free_ranges;
+    /* 1 - largest_free_size / free_size: 0 when free space is contiguous */
+    float    fragmentation;
+} etlsf_free_stats_t;
+
+/* Walks free lists, cost is linear in number of free ranges.
+** Ranges in thread caches and deferred queue are not counted as free. */
+void etlsf_free_stats(etlsf_t arena, etlsf_free_stats_t* stats);
+
+/*
+** Incremental compaction: etlsf_compact_plan picks allocations from the end
+** of arena that fit into free ranges at lower offsets, up to max_bytes in
+** total, and reserves destination ranges. Caller copies size bytes from
+** src_offset to dst_offset and calls etlsf_compact_commit: handle keeps its
+** value and etlsf_alloc_offset returns dst_offset after that. Source range is
+** freed with deferred ranges by next etlsf_flush_deferred, as it may be
+** still in use. Moves of allocations freed after planning are dropped by
+** commit, etlsf_compact_cancel drops move without copying.
+** Planning cost is linear in number of ranges for every move. In concurrent arenas
+** compaction must not run along with frees or offset queries of other
+** threads, e.g. call it at frame boundary.
+*/
+typedef struct
+{
+    etlsf_alloc_t id;
+    uint32_t      src_offset;
+    uint32_t      dst_offset;
+    uint32_t      size;
+    uint32_t      dst_index; /* Reserved destination range, internal */
+} etlsf_move_t;
+
+uint32_t etlsf_compact_plan  (etlsf_t arena, uint32_t max_bytes, etlsf_move_t* moves, uint32_t max_moves);
+/* Returns 0 if allocation was freed since planning and nothing was moved */
+int      etlsf_compact_commit(etlsf_t arena, const etlsf_move_t* move);
+void     etlsf_compact_cancel(etlsf_t arena, const etlsf_move_t* move);
+
 #ifdef __cplusplus
 }
 #endif
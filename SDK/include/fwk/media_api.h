@@ -1,9 +1,12 @@
 #ifndef __VIDEOPLAYBACKENGINE_H_INCLUDED__
 #	define __VIDEOPLAYBACKENGINE_H_INCLUDED__
 
+#include <core/core.h>
+
 struct media_player_data_t;
 
-typedef struct media_player_data_t* media_player_t;
+// Players live in pool, handles of destroyed players are detected
+typedef core::handle_t<media_player_data_t> media_player_t;
 
 void mediaInit();
 void mediaShutdown();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <core/core.h>
 #include <opengl.h>
 #include <vg/openvg.h>
 
@@ -17,9 +18,11 @@ namespace vg
     struct PaintOpaque;
     struct path_data_t;
 
-    typedef FontOpaque*   Font;
-    typedef PaintOpaque*  Paint;
-    typedef path_data_t*  Path;
+    // Paths and paints live in growable pools, handles of destroyed objects are detected.
+    // Create functions return null handle on failure, null handles are ignored by other functions.
+    typedef FontOpaque*                     Font;
+    typedef core::handle_t<PaintOpaque>     Paint;
+    typedef core::handle_t<path_data_t>     Path;
 
     extern NVGcontext* ctx;
     extern Font        defaultFont;
@@ -16,6 +16,7 @@
 #define __MJSON_H_INCLUDED__
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -55,13 +56,70 @@ enum mjson_element_id_t
     MJSON_ID_ARRAY64        = 17,
 
     MJSON_ID_DICT32         = 18,
-    MJSON_ID_DICT64         = 19
+    MJSON_ID_DICT64         = 19,
+
+    /* hash index of dictionary keys, written by mjson_build_index as first entry of dictionary */
+    MJSON_ID_INDEX32        = 20
+};
+
+/* dictionaries with fewer members are not indexed, linear search is faster */
+#define MJSON_INDEX_MIN_MEMBERS 8
+
+/* lexers, front ends scan whitespace, comments, strings and numbers in blocks of bytes */
+enum mjson_lexer_id_t
+{
+    MJSON_LEXER_RE2C        =  0,   /* state machine only, byte by byte */
+    MJSON_LEXER_SCALAR      =  1,
+    MJSON_LEXER_SSE2        =  2,
+    MJSON_LEXER_AVX2        =  3
 };
 
+/* storage reallocation, returns NULL on failure, ptr is NULL for the first allocation */
+typedef void* (*mjson_realloc_t)(void* user_data, void* ptr, size_t size);
+
 int mjson_parse(const char *json_data, size_t json_data_size, void* storage_buf, size_t storage_buf_size, mjson_element_t* top_element);
 
+/*
+ * storage_buf is grown with realloc_fn when output does not fit, it could be NULL on input.
+ * *storage_buf and *storage_buf_size are updated even if parsing fails, caller owns the buffer.
+ */
+int mjson_parse_alloc(const char *json_data, size_t json_data_size, mjson_realloc_t realloc_fn, void* user_data, void** storage_buf, size_t* storage_buf_size, mjson_element_t* top_element);
+
+/*
+ * sizing pass: runs lexer only and returns storage_buf_size enough for mjson_parse,
+ * exact unless strings have escapes. returns 0 if input has invalid token.
+ */
+size_t mjson_parse_size(const char *json_data, size_t json_data_size);
+
+/*
+ * best supported lexer is selected on first parse, all lexers produce the same output.
+ * forces lexer for tests and benchmarks, negative value selects the best supported,
+ * returns selected one (never above supported).
+ */
+int mjson_select_lexer(int lexer);
+
+/* storage_buf could start with top element or with fourcc written by mjson_parse */
 mjson_element_t   mjson_get_top_element(void* storage_buf, size_t storage_buf_size);
 
+/*
+ * checks whole tree in storage_buf, e.g. read from disk: every element lies inside of buffer,
+ * strings are terminated and dictionary indices point to keys. returns 0 for corrupted storage,
+ * cost is linear in storage_buf_size.
+ */
+int mjson_validate(void* storage_buf, size_t storage_buf_size);
+
+/*
+ * post-parse pass: copies tree to storage_buf and adds hash index to every dictionary
+ * with at least MJSON_INDEX_MIN_MEMBERS members, mjson_get_member is O(1) for them.
+ * iteration is not affected, buffers without index stay readable.
+ * storage_buf should not overlap source tree, returns 0 if storage_buf is smaller
+ * than mjson_build_index_size.
+ */
+int mjson_build_index(mjson_element_t top_element, void* storage_buf, size_t storage_buf_size, mjson_element_t* indexed_top);
+
+/* sizing pass: returns exact storage_buf_size for mjson_build_index, 0 if top_element is NULL */
+size_t mjson_build_index_size(mjson_element_t top_element);
+
 mjson_element_t   mjson_get_element_first(mjson_element_t array);
 mjson_element_t   mjson_get_element_next (mjson_element_t array, mjson_element_t current_value);
 mjson_element_t   mjson_get_element      (mjson_element_t array, int index);
@@ -92,6 +92,9 @@ namespace Model
 
     static ml::quat rotx = {-0.7071067812f, 0.0f, 0.0f, 0.7071067812f};
 
+    static const size_t VERTEX_GRAIN = 1024;
+    static const size_t FRAME_GRAIN  = 8;
+
     void md5CreateSkeleton(skeleton_t* skel, int numJoints, md5_joint_t* joints)
     {
         skel->numJoints     = numJoints;
@@ -130,44 +133,48 @@ namespace Model
         vertices = (vf::skinned_geom_t*)malloc(verticesSize);
         mem_set(vertices, verticesSize, 0);
 
-        for ( int i = 0; i < md5Mesh->numVertices; ++i )
+        // Vertices are independent, skin them in parallel
+        mt::parallel_for(0, md5Mesh->numVertices, VERTEX_GRAIN, [=](size_t begin, size_t end)
         {
-            vf::skinned_geom_t& vert        = vertices[i];
-            int                 weightCount = md5Mesh->vertices[i].count;
-            int                 startWeight = md5Mesh->vertices[i].start;
+            for ( size_t i = begin; i < end; ++i )
+            {
+                vf::skinned_geom_t& vert        = vertices[i];
+                int                 weightCount = md5Mesh->vertices[i].count;
+                int                 startWeight = md5Mesh->vertices[i].start;
 
-            assert( weightCount <= 4 );
+                assert( weightCount <= 4 );
 
-            v128 pos;
+                v128 pos;
 
-            pos = vi_set_zero();
+                pos = vi_set_zero();
 
-            // Sum the position of the weights
-            for ( int j = 0; j < weightCount; ++j )
-            {
-                md5_weight_t&  weight = md5Mesh->weights[startWeight + j];
-                ml::dual_quat& joint  = skel->bindPose[weight.joint];
+                // Sum the position of the weights
+                for ( int j = 0; j < weightCount; ++j )
+                {
+                    md5_weight_t&  weight = md5Mesh->weights[startWeight + j];
+                    ml::dual_quat& joint  = skel->bindPose[weight.joint];
 
-                v128 r, d, v, t;
+                    v128 r, d, v, t;
 
-                r = vi_loadu_v4(&joint.real);
-                d = vi_loadu_v4(&joint.dual);
-                v = vi_load_v3(&weight.location);
+                    r = vi_loadu_v4(&joint.real);
+                    d = vi_loadu_v4(&joint.dual);
+                    v = vi_load_v3(&weight.location);
 
-                v = ml::rotate_vec3_quat(r, v);
-                t = ml::translation_dual_quat(r, d);
-                t = vi_add(v, t);
+                    v = ml::rotate_vec3_quat(r, v);
+                    t = ml::translation_dual_quat(r, d);
+                    t = vi_add(v, t);
 
-                pos = vi_mad(t, vi_set_all(weight.bias), pos);
+                    pos = vi_mad(t, vi_set_all(weight.bias), pos);
 
-                assert(weight.joint<256);
+                    assert(weight.joint<256);
 
-                vert.b[j] = (uint8_t)weight.joint;
-                vert.w[j] = weight.bias;
-            }
+                    vert.b[j] = (uint8_t)weight.joint;
+                    vert.w[j] = weight.bias;
+                }
 
-            vi_store_v3(&vert.px, pos);
-        }
+                vi_store_v3(&vert.px, pos);
+            }
+        });
 
         // Loop through all triangles and calculate the normal of each triangle
         for ( int i = 0; i < md5Mesh->numIndices/3; ++i )
@@ -195,23 +202,23 @@ namespace Model
             vi_store_v3(&vertices[ md5Mesh->indices[i*3+2] ].nx, n2);
         }
 
-        // Now normalize all the normals
-        for ( int i = 0; i < md5Mesh->numVertices; ++i )
+        // Triangles share vertices, so accumulation above stays serial.
+        // Now normalize all the normals and copy texture coordinates
+        mt::parallel_for(0, md5Mesh->numVertices, VERTEX_GRAIN, [=](size_t begin, size_t end)
         {
-            v128                n;
-            vf::skinned_geom_t& vert = vertices[i];
+            for ( size_t i = begin; i < end; ++i )
+            {
+                v128                n;
+                vf::skinned_geom_t& vert = vertices[i];
 
-            n = vi_load_v3(&vert.nx);
-            n = ml::normalize(n);
-            vi_store_v3(&vert.nx, n);
-        }
+                n = vi_load_v3(&vert.nx);
+                n = ml::normalize(n);
+                vi_store_v3(&vert.nx, n);
 
-        // Copy texture coordinates
-        for ( int i = 0; i < md5Mesh->numVertices; ++i )
-        {
-            vertices[i].u = md5Mesh->vertices[i].u;
-            vertices[i].v = md5Mesh->vertices[i].v;
-        }
+                vert.u = md5Mesh->vertices[i].u;
+                vert.v = md5Mesh->vertices[i].v;
+            }
+        });
 
         GLuint    totalSize;
         uint32_t  vertexOffset;
@@ -228,8 +235,8 @@ namespace Model
         assert(indexOffset % sizeof(uint16_t) == 0);
 
         uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
-        mem_copy(ptr, vertices, verticesSize);
-        mem_copy(ptr+(indexOffset-vertexOffset),  md5Mesh->indices,  indicesSize);
+        mem_copy_stream(ptr, vertices, verticesSize);
+        mem_copy_stream(ptr+(indexOffset-vertexOffset),  md5Mesh->indices,  indicesSize);
         glUnmapNamedBuffer(staticBuffer);
 
         mesh->numIndices  = md5Mesh->numIndices;
@@ -246,32 +253,36 @@ namespace Model
 
         anim->framePoses = (ml::dual_quat*)malloc(md5Anim->numFrames * skel->numJoints * sizeof(ml::dual_quat));
 
-        int              numFrames  = md5Anim->numFrames;
+        int              numJoints  = skel->numJoints;
         int*             hierarchy  = skel->boneHierarchy;
         md5_anim_data_t* animData   = md5Anim->frameData;
         ml::dual_quat*   framePoses = anim->framePoses;
 
-        while(numFrames--)
+        // Frames are independent, joints within a frame depend on parents
+        mt::parallel_for(0, md5Anim->numFrames, FRAME_GRAIN, [=](size_t beginFrame, size_t endFrame)
         {
-            for (int i=0; i<skel->numJoints; ++i)
+            for (size_t frame = beginFrame; frame < endFrame; ++frame)
             {
-                ml::make_dual_quat(&framePoses[i], &animData[i].rotation, &animData[i].location);
+                ml::dual_quat*   poses = framePoses + frame * numJoints;
+                md5_anim_data_t* data  = animData   + frame * numJoints;
 
-                int parent = hierarchy[i];
-                if( parent > -1 )
-                {
-                    ml::mul_dual_quat(&framePoses[i], &framePoses[parent], &framePoses[i]);
-                }
-                else
+                for (int i=0; i<numJoints; ++i)
                 {
-                    ml::mul_quat(&framePoses[i].real, &rotx, &framePoses[i].real);
-                    ml::mul_quat(&framePoses[i].dual, &rotx, &framePoses[i].dual);
+                    ml::make_dual_quat(&poses[i], &data[i].rotation, &data[i].location);
+
+                    int parent = hierarchy[i];
+                    if( parent > -1 )
+                    {
+                        ml::mul_dual_quat(&poses[i], &poses[parent], &poses[i]);
+                    }
+                    else
+                    {
+                        ml::mul_quat(&poses[i].real, &rotx, &poses[i].real);
+                        ml::mul_quat(&poses[i].dual, &rotx, &poses[i].dual);
+                    }
                 }
             }
-
-            framePoses += skel->numJoints;
-            animData   += skel->numJoints;
-        }
+        });
     }
     
     bool loadModel(const char* name, model_t* model, skeleton_t* skel)
@@ -500,7 +511,6 @@ cleanup:
 
     bool loadMaterial(material_t* mat, const char* name)
     {
-        memory_t        inText = {0, 0, 0};
         memory_t        bjson  = {0, 0, 0};
         mjson_element_t root = 0;
         char            path[1024];
@@ -509,12 +519,9 @@ cleanup:
         cstr_copy(path, name);
         cstr_concat(path, ".material");
 
-        if (mem_file(&inText, path))
+        if (mem_mjson(&bjson, path, &root))
         {
-            mem_area(&bjson, 10*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
-            
-            assert(result && mjson_get_type(root) == MJSON_ID_DICT32);
+            assert(mjson_get_type(root) == MJSON_ID_DICT32);
 
             mjson_element_t key, value;
             
@@ -541,7 +548,6 @@ cleanup:
                 key = mjson_get_member_next(root, key, &value);
             }
 
-            mem_free(&inText);
             mem_free(&bjson);
 
             return true;
@@ -98,7 +98,10 @@ namespace app
     void renderModels();
     void convertOBJ();
     void generateLights(int num);
-    static void assignLightsToClustersCpu(v128 modelView[4], v128 proj[4]);
+    static void submitLightGridBuild(v128 modelView[4], v128 proj[4]);
+    static void waitLightGridBuild();
+    static void createLightGridGraph();
+    static void destroyLightGridGraph();
 
     mspace_t appArena;
 
@@ -215,6 +218,7 @@ namespace app
         loadModels();
 
         generateLights(MAX_LIGHTS);
+        createLightGridGraph();
 
         camera.acceleration.x = camera.acceleration.y = camera.acceleration.z = 150;
         camera.maxVelocity.x  = camera.maxVelocity.y  = camera.maxVelocity.z  =  60;
@@ -239,6 +243,7 @@ namespace app
             glDeleteProgram(staticPrograms[i]);
         }
 
+        destroyLightGridGraph();
         destroyModels();
         destroyMaterials();
         gfx::gpu_timer_fini(&gpuTimer);
@@ -264,14 +269,17 @@ namespace app
         v128 m[4];
         camera.getViewMatrix(m);
 
+        // Light grid is built on workers while main thread sets up the frame
+        submitLightGridBuild(m, proj);
+
         gfx::set3DStates();
 
         gfx::setProjectionMatrix(proj);
         gfx::setModelViewMatrix(m);
 
-        assignLightsToClustersCpu(m, proj);
         glEnable(GL_FRAMEBUFFER_SRGB);
 
+        waitLightGridBuild();
         renderModels();
 
         glDisable(GL_FRAMEBUFFER_SRGB);
@@ -315,35 +323,49 @@ namespace app
     material_t       materials    [MAX_MATERIALS];
     const char*      materialNames[MAX_MATERIALS];
 
-    void loadMesh(const char* name);
+    void uploadMesh(memory_t* data);
     material_t* findMaterial(const char* name);
 
+    struct mesh_read_t
+    {
+        io::request_t   request;
+        mjson_element_t matList;
+        memory_t        data;
+        int             status;
+    };
+
+    static void meshReadComplete(void* arg, int status, memory_t* data)
+    {
+        mesh_read_t* read = (mesh_read_t*)arg;
+
+        read->status = status;
+        read->data   = *data;
+    }
+
     void loadModels()
     {
         numModels = 0;
         numMeshes = 0;
 
-        memory_t        inText = {0, 0, 0};
         memory_t        bjson  = {0, 0, 0};
         mjson_element_t root = 0;
 
-        if (mem_file(&inText, "models/sponza/sponza.models"))
+        if (mem_mjson(&bjson, "models/sponza/sponza.models", &root))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
-
-            assert(result && mjson_get_type(root) == MJSON_ID_ARRAY32);
+            assert(mjson_get_type(root) == MJSON_ID_ARRAY32);
 
-            mjson_element_t matList, mat;
+            mesh_read_t     reads[MAX_MODELS];
+            int             numReads = 0;
+            mjson_element_t matList = 0, mat;
 
+            // Queue reads of all meshes first, so I/O threads overlap them with upload
             for (
                 mjson_element_t modelDesc = mjson_get_element_first(root);
-                modelDesc;
+                modelDesc && numReads < MAX_MODELS;
                 modelDesc = mjson_get_element_next(root, modelDesc)
             )
             {
                 const char* model = 0;
-                const char* material = 0;
 
                 assert(mjson_get_type(modelDesc) == MJSON_ID_DICT32);
 
@@ -366,21 +388,38 @@ namespace app
                     }
                 }
 
+                // Entry without model is skipped, materials are not used without mesh
+                if (!model) continue;
+
+                mesh_read_t* read = &reads[numReads++];
+
+                read->matList = matList;
+                read->status  = io::STATUS_FAILED;
+                read->request = io::read(model, io::PRIORITY_HIGH, meshReadComplete, read);
+            }
+
+            for (int r = 0; r < numReads; ++r)
+            {
+                io::wait(reads[r].request);
+
+                if (reads[r].status != io::STATUS_COMPLETE) continue;
+
                 int start, end;
 
                 start = numMeshes;
-                loadMesh(model);
+                uploadMesh(&reads[r].data);
                 end = numMeshes;
 
-                mat = mjson_get_element_first(matList);
+                mem_free(&reads[r].data);
+
+                mat = mjson_get_element_first(reads[r].matList);
                 for (int i = start; i<end; ++i)
                 {
                     materialRefs[i] = findMaterial(mjson_get_string(mat, ""));
-                    mat = mjson_get_element_next(matList, mat);
+                    mat = mjson_get_element_next(reads[r].matList, mat);
                 }
             }
 
-            mem_free(&inText);
             mem_free(&bjson);
         }
     }
@@ -399,16 +438,12 @@ namespace app
     {
         numMaterials = 0;
 
-        memory_t        inText = {0, 0, 0};
         memory_t        bjson  = {0, 0, 0};
         mjson_element_t root = 0;
 
-        if (mem_file(&inText, "models/sponza/sponza.mtllib"))
+        if (mem_mjson(&bjson, "models/sponza/sponza.mtllib", &root))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
-
-            assert(result && mjson_get_type(root) == MJSON_ID_DICT32);
+            assert(mjson_get_type(root) == MJSON_ID_DICT32);
 
             mjson_element_t material, dict, key, value;
 
@@ -533,7 +568,6 @@ namespace app
 
             assert(matOffset<=matBufferSize);
 
-            mem_free(&inText);
             mem_free(&bjson);
         }
     }
@@ -694,74 +728,67 @@ namespace app
         return 0;
     }
 
-    void loadMesh(const char* name)
+    void uploadMesh(memory_t* data)
     {
-        memory_t  data = {0, 0, 0};
-
+        mesh_header_v0*    header    = mem_raw_data<mesh_header_v0>(data);
+        vf::static_geom_t* fvertices = mem_raw_array<vf::static_geom_t>(data, header->numVertices);
+        uint32_t*          findices  = mem_raw_array<uint32_t>(data, header->numIndices);
 
-        if (mem_file(&data, name))
+        if (!numModels)
         {
-            mesh_header_v0*    header    = mem_raw_data<mesh_header_v0>(&data);
-            vf::static_geom_t* fvertices = mem_raw_array<vf::static_geom_t>(&data, header->numVertices);
-            uint32_t*          findices  = mem_raw_array<uint32_t>(&data, header->numIndices);
-
-            if (!numModels)
-            {
-                scene_min.x = header->minx;
-                scene_min.y = header->miny;
-                scene_min.z = header->minz;
-                scene_max.x = header->maxx;
-                scene_max.y = header->maxy;
-                scene_max.z = header->maxz;
-            }
-            else
-            {
-                scene_min.x = core::min(scene_min.x, header->minx);
-                scene_min.y = core::min(scene_min.y, header->miny);
-                scene_min.z = core::min(scene_min.z, header->minz);
-                scene_max.x = core::max(scene_max.x, header->maxx);
-                scene_max.y = core::max(scene_max.y, header->maxy);
-                scene_max.z = core::max(scene_max.z, header->maxz);
-            }
-
-            GLuint verticesSize = sizeof(vf::static_geom_t) * header->numVertices;
-            GLuint indicesSize  = sizeof(uint32_t) * header->numIndices;
+            scene_min.x = header->minx;
+            scene_min.y = header->miny;
+            scene_min.z = header->minz;
+            scene_max.x = header->maxx;
+            scene_max.y = header->maxy;
+            scene_max.z = header->maxz;
+        }
+        else
+        {
+            scene_min.x = core::min(scene_min.x, header->minx);
+            scene_min.y = core::min(scene_min.y, header->miny);
+            scene_min.z = core::min(scene_min.z, header->minz);
+            scene_max.x = core::max(scene_max.x, header->maxx);
+            scene_max.y = core::max(scene_max.y, header->maxy);
+            scene_max.z = core::max(scene_max.z, header->maxz);
+        }
 
-            GLuint totalSize;
+        GLuint verticesSize = sizeof(vf::static_geom_t) * header->numVertices;
+        GLuint indicesSize  = sizeof(uint32_t) * header->numIndices;
 
-            uint32_t vertexOffset;
-            uint32_t indexOffset;
+        GLuint totalSize;
 
-            gfx_alloc_geom(
-                &staticAlloc,
-                sizeof(vf::static_geom_t), header->numVertices,
-                sizeof(uint32_t), header->numIndices,
-                &vertexOffset, &indexOffset, &totalSize
-            );
+        uint32_t vertexOffset;
+        uint32_t indexOffset;
 
-            assert(vertexOffset % sizeof(vf::static_geom_t) == 0);
-            assert(indexOffset % sizeof(uint32_t) == 0);
+        gfx_alloc_geom(
+            &staticAlloc,
+            sizeof(vf::static_geom_t), header->numVertices,
+            sizeof(uint32_t), header->numIndices,
+            &vertexOffset, &indexOffset, &totalSize
+        );
 
-            uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
-            mem_copy(ptr, fvertices, verticesSize);
-            mem_copy(ptr+(indexOffset-vertexOffset),  findices,  indicesSize);
-            glUnmapNamedBuffer(staticBuffer);
+        assert(vertexOffset % sizeof(vf::static_geom_t) == 0);
+        assert(indexOffset % sizeof(uint32_t) == 0);
 
-            models[numModels].numSubmeshes = header->numSubsets;
+        uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
+        mem_copy_stream(ptr, fvertices, verticesSize);
+        mem_copy_stream(ptr+(indexOffset-vertexOffset),  findices,  indicesSize);
+        glUnmapNamedBuffer(staticBuffer);
 
-            for (size_t i = 0; i < header->numSubsets; ++i)
-            {
-                meshes[numMeshes].firstVertex = vertexOffset / sizeof(vf::static_geom_t);
-                meshes[numMeshes].idxFormat   = GL_UNSIGNED_INT;
-                meshes[numMeshes].idxOffset   = indexOffset + header->meshSubsets[i*2]*sizeof(uint32_t);
-                meshes[numMeshes].numIndices  = header->meshSubsets[i*2+1];
+        models[numModels].numSubmeshes = header->numSubsets;
 
-                ++numMeshes;
-            }
+        for (size_t i = 0; i < header->numSubsets; ++i)
+        {
+            meshes[numMeshes].firstVertex = vertexOffset / sizeof(vf::static_geom_t);
+            meshes[numMeshes].idxFormat   = GL_UNSIGNED_INT;
+            meshes[numMeshes].idxOffset   = indexOffset + header->meshSubsets[i*2]*sizeof(uint32_t);
+            meshes[numMeshes].numIndices  = header->meshSubsets[i*2+1];
 
-            ++numModels;
-            mem_free(&data);
+            ++numMeshes;
         }
+
+        ++numModels;
     }
 
     void convertOBJ()
@@ -1053,182 +1080,306 @@ namespace app
 
 #define BACKWARD_STORE_LIGHT_INDICES
 
-    static void assignLightsToClustersCpu(v128 modelView[4], v128 proj[4])
+    struct light_grid_build_t
     {
-        PROFILER_CPU_TIMESLICE("LightGridBuild");
-
-        numViewLights = 0;
-        for (size_t i=0; i < numLights; ++i)
-        {
-            light_t& l = lightsView[i];
-
-            l = lights[i];
-
-            v128 vlp = ml::mul_mat4_vec4(modelView, vi_set(l.pos.x, l.pos.y, l.pos.z, 1.0f));
-            vi_store_v3(&l.pos, vlp);
-            ++numViewLights;
-        }
-
-        lightOffset = 0;
-        lightSize   = sizeof(light_t)* core::max(4U, numViewLights);
-
-        light_t* data = (light_t*)gfx::dynbufAllocMem(lightSize, gfx::caps.tboAlignment, &lightOffset);
-        memcpy(data, lightsView, numViewLights*sizeof(light_t));
-        glTextureBufferRange(texLightData, GL_RGBA32F, gfx::dynBuffer, lightOffset, lightSize);
-
-        assert(lightSize % (sizeof(float)*8) == 0);
-
-        gridDimX = (gfx::width  + LIGHT_GRID_TILE_DIM_X - 1) / LIGHT_GRID_TILE_DIM_X;
-        gridDimY = (gfx::height + LIGHT_GRID_TILE_DIM_Y - 1) / LIGHT_GRID_TILE_DIM_Y;
-        gridDimZ = 64;//32;//128;
+        v128          matMV[4];
+        v128          matP[4];
+
+        ScreenRect3D* rects;
+        uint32_t      numRects;
+        int32_t*      offsets;
+        int32_t*      counts;
+        int32_t*      blockSums;
+        int32_t       totalus;
+
+        GLuint        clusterDataOffset;
+        GLuint        clusterDataSize;
+    };
 
-        numClusters = gridDimX * gridDimY * gridDimZ;
+    static light_grid_build_t lightGrid;
+    static mt::task_graph_t*  lightGridGraph;
 
-        float b = 4.0f;
-        float q = 1.03805f;//1.116;//1.0098;
-        zLogScale = 1.0f / logf(q);
-        zscale  = -(q-1)/b;
-        zoffset = 1.0f;
+    static void lightGridBuildRects(void*)
+    {
+        buildRects3D(lightGrid.matMV, lightGrid.matP, MAX_LIGHTS, lightGrid.numRects, lightGrid.rects);
+    }
 
-        uint32_t numRects;
-        ScreenRect3D* rects = mem::alloc_array<ScreenRect3D>(appArena, MAX_LIGHTS);
-        int32_t* offsets = mem::alloc_array<int32_t>(appArena, numClusters);
-        int32_t* counts  = mem::alloc_array<int32_t>(appArena, numClusters);
+    static void lightGridClear(void*)
+    {
+        memset(lightGrid.counts, 0,  sizeof(int32_t)*numClusters);
+        memset(lightGrid.offsets, 0, sizeof(int32_t)*numClusters);
+    }
 
-        buildRects3D(modelView, proj, MAX_LIGHTS, numRects, rects);
+    static void lightGridCount(void*)
+    {
+        PROFILER_CPU_TIMESLICE("Pass1");
 
-        memset(counts, 0,  sizeof(int32_t)*numClusters);
-        memset(offsets, 0, sizeof(int32_t)*numClusters);
+        ScreenRect3D* rects  = lightGrid.rects;
+        int32_t*      counts = lightGrid.counts;
 
         int32_t totalus = 0;
-        {  
-            PROFILER_CPU_TIMESLICE("Pass1");
-            for (size_t i = 0; i < numRects; ++i)
-            {
-                ScreenRect3D r = rects[i];
+        for (size_t i = 0; i < lightGrid.numRects; ++i)
+        {
+            ScreenRect3D r = rects[i];
 
-                uint32_t lx = core::max(0, core::min<int>(gridDimX, r.minx));
-                uint32_t ly = core::max(0, core::min<int>(gridDimY, r.miny));
-                uint32_t lz = core::max(0, core::min<int>(gridDimZ, r.minz));
+            uint32_t lx = core::max(0, core::min<int>(gridDimX, r.minx));
+            uint32_t ly = core::max(0, core::min<int>(gridDimY, r.miny));
+            uint32_t lz = core::max(0, core::min<int>(gridDimZ, r.minz));
 
-                uint32_t ux = core::max(0, core::min<int>(gridDimX, r.maxx));
-                uint32_t uy = core::max(0, core::min<int>(gridDimY, r.maxy));
-                uint32_t uz = core::max(0, core::min<int>(gridDimZ, r.maxz));
+            uint32_t ux = core::max(0, core::min<int>(gridDimX, r.maxx));
+            uint32_t uy = core::max(0, core::min<int>(gridDimY, r.maxy));
+            uint32_t uz = core::max(0, core::min<int>(gridDimZ, r.maxz));
 
-                for (uint32_t z = lz; z < uz; ++z)
+            for (uint32_t z = lz; z < uz; ++z)
+            {
+                for (uint32_t y = ly; y < uy; ++y)
                 {
-                    for (uint32_t y = ly; y < uy; ++y)
+                    for (uint32_t x = lx; x < ux; ++x)
                     {
-                        for (uint32_t x = lx; x < ux; ++x)
-                        {
-                            uint32_t idx = (z * gridDimY + y) * gridDimX + x;
-                            ++counts[idx];
-                            ++totalus;
-                        }
+                        uint32_t idx = (z * gridDimY + y) * gridDimX + x;
+                        ++counts[idx];
+                        ++totalus;
                     }
                 }
             }
         }
 
-        uint32_t offset = 0;
-        {  
-            PROFILER_CPU_TIMESLICE("BuildOffsets");
-            for (int32_t idx = 0; idx < numClusters; ++idx)
+        lightGrid.totalus = totalus;
+    }
+
+    static const int32_t OFFSETS_BLOCK_SIZE = 4096;
+
+    static void lightGridBuildOffsets(void*)
+    {
+        PROFILER_CPU_TIMESLICE("BuildOffsets");
+
+        int32_t* offsets   = lightGrid.offsets;
+        int32_t* counts    = lightGrid.counts;
+        int32_t* blockSums = lightGrid.blockSums;
+
+        int32_t numBlocks = (numClusters + OFFSETS_BLOCK_SIZE - 1) / OFFSETS_BLOCK_SIZE;
+
+        // Prefix sum in blocks, then add sum of all previous blocks
+        mt::parallel_for(0, numBlocks, 1, [=](size_t beginBlock, size_t endBlock)
+        {
+            for (size_t block = beginBlock; block < endBlock; ++block)
             {
+                int32_t begin = int32_t(block) * OFFSETS_BLOCK_SIZE;
+                int32_t end   = core::min(begin + OFFSETS_BLOCK_SIZE, numClusters);
+
+                int32_t offset = 0;
+                for (int32_t idx = begin; idx < end; ++idx)
+                {
 #ifdef BACKWARD_STORE_LIGHT_INDICES
-                offset += counts[idx];
-                offsets[idx] = offset;
+                    offset += counts[idx];
+                    offsets[idx] = offset;
 #else
-                offsets[idx] = offset;
-                offset += counts[idx];
+                    offsets[idx] = offset;
+                    offset += counts[idx];
 #endif
+                }
+                blockSums[block] = offset;
             }
+        });
+
+        int32_t offset = 0;
+        for (int32_t block = 0; block < numBlocks; ++block)
+        {
+            int32_t sum = blockSums[block];
+            blockSums[block] = offset;
+            offset += sum;
         }
 
+        mt::parallel_for(1, numBlocks, 1, [=](size_t beginBlock, size_t endBlock)
+        {
+            for (size_t block = beginBlock; block < endBlock; ++block)
+            {
+                int32_t begin = int32_t(block) * OFFSETS_BLOCK_SIZE;
+                int32_t end   = core::min(begin + OFFSETS_BLOCK_SIZE, numClusters);
+                int32_t base  = blockSums[block];
+
+                for (int32_t idx = begin; idx < end; ++idx)
+                {
+                    offsets[idx] += base;
+                }
+            }
+        });
+
 #ifndef BACKWARD_STORE_LIGHT_INDICES
         memset(counts, 0,  sizeof(uint32_t)*numClusters);
 #endif
+    }
 
-        {
-            PROFILER_CPU_TIMESLICE("Pass2");
+    // Tasks below touch dynamic buffer, they are chained and main thread waits for the graph,
+    // so there is no concurrent dynbufAllocMem.
+    static void lightGridFillLightList(void*)
+    {
+        PROFILER_CPU_TIMESLICE("Pass2");
 
-            lightListOffset = 0;
-            lightListSize   = core::max(4, totalus) * sizeof(uint16_t);
+        ScreenRect3D* rects   = lightGrid.rects;
+        int32_t*      offsets = lightGrid.offsets;
+        int32_t*      counts  = lightGrid.counts;
 
-            int16_t* data = (int16_t*)gfx::dynbufAllocMem(lightListSize, gfx::caps.tboAlignment, &lightListOffset);
+        lightListOffset = 0;
+        lightListSize   = core::max(4, lightGrid.totalus) * sizeof(uint16_t);
 
-            for (size_t i = 0; i < numRects; ++i)
-            {
-                ScreenRect3D r = rects[i];
+        int16_t* data = (int16_t*)gfx::dynbufAllocMem(lightListSize, gfx::caps.tboAlignment, &lightListOffset);
+
+        for (size_t i = 0; i < lightGrid.numRects; ++i)
+        {
+            ScreenRect3D r = rects[i];
 
-                uint32_t lx = core::max(0, core::min<int>(gridDimX, r.minx));
-                uint32_t ly = core::max(0, core::min<int>(gridDimY, r.miny));
-                uint32_t lz = core::max(0, core::min<int>(gridDimZ, r.minz));
+            uint32_t lx = core::max(0, core::min<int>(gridDimX, r.minx));
+            uint32_t ly = core::max(0, core::min<int>(gridDimY, r.miny));
+            uint32_t lz = core::max(0, core::min<int>(gridDimZ, r.minz));
 
-                uint32_t ux = core::max(0, core::min<int>(gridDimX, r.maxx));
-                uint32_t uy = core::max(0, core::min<int>(gridDimY, r.maxy));
-                uint32_t uz = core::max(0, core::min<int>(gridDimZ, r.maxz));
+            uint32_t ux = core::max(0, core::min<int>(gridDimX, r.maxx));
+            uint32_t uy = core::max(0, core::min<int>(gridDimY, r.maxy));
+            uint32_t uz = core::max(0, core::min<int>(gridDimZ, r.maxz));
 
-                assert(r.index<numViewLights);
+            assert(r.index<numViewLights);
 
-                for (uint32_t z = lz; z < uz; ++z)
+            for (uint32_t z = lz; z < uz; ++z)
+            {
+                for (uint32_t y = ly; y < uy; ++y)
                 {
-                    for (uint32_t y = ly; y < uy; ++y)
+                    for (uint32_t x = lx; x < ux; ++x)
                     {
-                        for (uint32_t x = lx; x < ux; ++x)
-                        {
-                            uint32_t idx = (z * gridDimY + y) * gridDimX + x;
+                        uint32_t idx = (z * gridDimY + y) * gridDimX + x;
 
 #ifdef BACKWARD_STORE_LIGHT_INDICES
-                            int32_t offset = --offsets[idx];
+                        int32_t offset = --offsets[idx];
 #else
-                            int32_t count = counts[idx];
-                            ++counts[idx];
-                            int32_t offset = offsets[idx] + count;
+                        int32_t count = counts[idx];
+                        ++counts[idx];
+                        int32_t offset = offsets[idx] + count;
 #endif
 
-                            data[offset] = r.index;
-                        }
+                        data[offset] = r.index;
                     }
                 }
             }
-            glTextureBufferRange(texLightListData, GL_R16I, gfx::dynBuffer, lightListOffset, lightListSize);
         }
-        {
-            PROFILER_CPU_TIMESLICE("copyGridFromHost");
+    }
+
+    static void lightGridFillClusters(void*)
+    {
+        PROFILER_CPU_TIMESLICE("copyGridFromHost");
 
-            clusterListOffset = 0;
-            clusterListSize   = sizeof(gpu_clustered_lighting_t);
+        int32_t* offsets = lightGrid.offsets;
+        int32_t* counts  = lightGrid.counts;
 
-            gpu_clustered_lighting_t* data = (gpu_clustered_lighting_t*)gfx::dynbufAllocMem(clusterListSize, gfx::caps.uboAlignment, &clusterListOffset);
+        clusterListOffset = 0;
+        clusterListSize   = sizeof(gpu_clustered_lighting_t);
 
-            data->uAmbientGlobal = { 0.02f, 0.02f, 0.02f };
-            data->uGridTileX = LIGHT_GRID_TILE_DIM_X;
-            data->uGridTileY = LIGHT_GRID_TILE_DIM_Y;
-            data->uGridDimX  = gridDimX;
-            data->uGridDimY  = gridDimY;
-            data->uZScale    = zscale;
-            data->uZOffset   = zoffset;
-            data->uLogScale  = zLogScale;
+        gpu_clustered_lighting_t* data = (gpu_clustered_lighting_t*)gfx::dynbufAllocMem(clusterListSize, gfx::caps.uboAlignment, &clusterListOffset);
+
+        data->uAmbientGlobal = { 0.02f, 0.02f, 0.02f };
+        data->uGridTileX = LIGHT_GRID_TILE_DIM_X;
+        data->uGridTileY = LIGHT_GRID_TILE_DIM_Y;
+        data->uGridDimX  = gridDimX;
+        data->uGridDimY  = gridDimY;
+        data->uZScale    = zscale;
+        data->uZOffset   = zoffset;
+        data->uLogScale  = zLogScale;
 #ifdef DEBUG_SHADER
-            data->uDebugMaxClusters  = numClusters;
-            data->uDebugMaxLightList = totalus;
-            data->uDebugMaxLights    = numViewLights;
+        data->uDebugMaxClusters  = numClusters;
+        data->uDebugMaxLightList = lightGrid.totalus;
+        data->uDebugMaxLights    = numViewLights;
 #endif
 
-            uint32_t clusterDataSize   = 2*sizeof(uint32_t)*numClusters;
-            uint32_t clusterDataOffset = 0;
-            int32_t* clusterData = (int32_t*)gfx::dynbufAllocMem(clusterDataSize, gfx::caps.tboAlignment, &clusterDataOffset);
-            for (int32_t i = 0; i < numClusters; ++i)
-            {
-                clusterData[2*i]   = offsets[i];
-                clusterData[2*i+1] = counts [i];
-                assert(offsets[i]+counts [i]<=totalus);
-            }
-            glTextureBufferRange(texClusterData, GL_RG32I, gfx::dynBuffer, clusterDataOffset, clusterDataSize);
+        lightGrid.clusterDataSize   = 2*sizeof(uint32_t)*numClusters;
+        lightGrid.clusterDataOffset = 0;
+        int32_t* clusterData = (int32_t*)gfx::dynbufAllocMem(lightGrid.clusterDataSize, gfx::caps.tboAlignment, &lightGrid.clusterDataOffset);
+        for (int32_t i = 0; i < numClusters; ++i)
+        {
+            clusterData[2*i]   = offsets[i];
+            clusterData[2*i+1] = counts [i];
+            assert(offsets[i]+counts [i]<=lightGrid.totalus);
+        }
+    }
+
+    static void createLightGridGraph()
+    {
+        lightGridGraph = mt::createTaskGraph(8, 8);
+
+        mt::task_id_t rects   = mt::taskGraphAdd(lightGridGraph, lightGridBuildRects, 0, 0, 0);
+        mt::task_id_t clear   = mt::taskGraphAdd(lightGridGraph, lightGridClear, 0, 0, 0);
+
+        mt::task_id_t countDeps[2] = {rects, clear};
+        mt::task_id_t count   = mt::taskGraphAdd(lightGridGraph, lightGridCount, 0, countDeps, 2);
+        mt::task_id_t offsets = mt::taskGraphAdd(lightGridGraph, lightGridBuildOffsets, 0, &count, 1);
+        mt::task_id_t list    = mt::taskGraphAdd(lightGridGraph, lightGridFillLightList, 0, &offsets, 1);
+        mt::taskGraphAdd(lightGridGraph, lightGridFillClusters, 0, &list, 1);
+    }
+
+    static void destroyLightGridGraph()
+    {
+        mt::destroyTaskGraph(lightGridGraph);
+        lightGridGraph = 0;
+    }
+
+    // Main thread has little work before models are rendered, so overlap is small
+    // and the graph mostly shows the API: submit early in the frame, wait where results are used.
+    // Dynamic buffer is not touched by main thread between submit and wait.
+    static void submitLightGridBuild(v128 modelView[4], v128 proj[4])
+    {
+        PROFILER_CPU_TIMESLICE("LightGridSubmit");
+
+        numViewLights = 0;
+        for (size_t i=0; i < numLights; ++i)
+        {
+            light_t& l = lightsView[i];
+
+            l = lights[i];
+
+            v128 vlp = ml::mul_mat4_vec4(modelView, vi_set(l.pos.x, l.pos.y, l.pos.z, 1.0f));
+            vi_store_v3(&l.pos, vlp);
+            ++numViewLights;
         }
-        mem::free(appArena, offsets);
-        mem::free(appArena, counts);
-        mem::free(appArena, rects);
+
+        lightOffset = 0;
+        lightSize   = sizeof(light_t)* core::max(4U, numViewLights);
+
+        light_t* data = (light_t*)gfx::dynbufAllocMem(lightSize, gfx::caps.tboAlignment, &lightOffset);
+        memcpy(data, lightsView, numViewLights*sizeof(light_t));
+
+        assert(lightSize % (sizeof(float)*8) == 0);
+
+        gridDimX = (gfx::width  + LIGHT_GRID_TILE_DIM_X - 1) / LIGHT_GRID_TILE_DIM_X;
+        gridDimY = (gfx::height + LIGHT_GRID_TILE_DIM_Y - 1) / LIGHT_GRID_TILE_DIM_Y;
+        gridDimZ = 64;//32;//128;
+
+        numClusters = gridDimX * gridDimY * gridDimZ;
+
+        float b = 4.0f;
+        float q = 1.03805f;//1.116;//1.0098;
+        zLogScale = 1.0f / logf(q);
+        zscale  = -(q-1)/b;
+        zoffset = 1.0f;
+
+        mem_copy(lightGrid.matMV, modelView, sizeof(lightGrid.matMV));
+        mem_copy(lightGrid.matP,  proj,      sizeof(lightGrid.matP));
+
+        lightGrid.rects     = core::frame_alloc_array<ScreenRect3D>(MAX_LIGHTS);
+        lightGrid.offsets   = core::frame_alloc_array<int32_t>(numClusters);
+        lightGrid.counts    = core::frame_alloc_array<int32_t>(numClusters);
+        lightGrid.blockSums = core::frame_alloc_array<int32_t>((numClusters + OFFSETS_BLOCK_SIZE - 1) / OFFSETS_BLOCK_SIZE);
+        lightGrid.numRects  = 0;
+        lightGrid.totalus   = 0;
+
+        mt::taskGraphSubmit(lightGridGraph);
+
+        glTextureBufferRange(texLightData, GL_RGBA32F, gfx::dynBuffer, lightOffset, lightSize);
+    }
+
+    static void waitLightGridBuild()
+    {
+        PROFILER_CPU_TIMESLICE("LightGridWait");
+
+        mt::taskGraphWait(lightGridGraph);
+
+        glTextureBufferRange(texLightListData, GL_R16I, gfx::dynBuffer, lightListOffset, lightListSize);
+        glTextureBufferRange(texClusterData, GL_RG32I, gfx::dynBuffer, lightGrid.clusterDataOffset, lightGrid.clusterDataSize);
     }
 }
@@ -620,16 +620,12 @@ namespace app
         numModels = 0;
         numMeshes = 0;
 
-        memory_t        inText = {0, 0, 0};
         memory_t        bjson  = {0, 0, 0};
         mjson_element_t root = 0;
 
-        if (mem_file(&inText, "models/sponza/sponza.models"))
+        if (mem_mjson(&bjson, "models/sponza/sponza.models", &root))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
-
-            assert(result && mjson_get_type(root) == MJSON_ID_ARRAY32);
+            assert(mjson_get_type(root) == MJSON_ID_ARRAY32);
 
             mjson_element_t modelDesc, key, value;
             mjson_element_t matList, mat;
@@ -675,7 +671,6 @@ namespace app
                 modelDesc = mjson_get_element_next(root, modelDesc);
             }
 
-            mem_free(&inText);
             mem_free(&bjson);
         }
     }
@@ -694,16 +689,12 @@ namespace app
     {
         numMaterials = 0;
 
-        memory_t        inText = {0, 0, 0};
         memory_t        bjson  = {0, 0, 0};
         mjson_element_t root = 0;
 
-        if (mem_file(&inText, "models/sponza/sponza.mtllib"))
+        if (mem_mjson(&bjson, "models/sponza/sponza.mtllib", &root))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
-
-            assert(result && mjson_get_type(root) == MJSON_ID_DICT32);
+            assert(mjson_get_type(root) == MJSON_ID_DICT32);
 
             mjson_element_t material, dict, key, value;
 
@@ -828,7 +819,6 @@ namespace app
 
             assert(matOffset<=matBufferSize);
 
-            mem_free(&inText);
             mem_free(&bjson);
         }
     }
@@ -983,7 +973,7 @@ namespace app
     {
         memory_t  data = { 0, 0, 0 };
 
-        if (mem_file(&data, name))
+        if (mem_map(&data, name, MEM_MAP_SEQUENTIAL|MEM_MAP_WILLNEED))
         {
             if (data.size < sizeof(ssz_mesh_header_t))
             {
@@ -1138,7 +1128,7 @@ namespace app
         memory_t  data = {0, 0, 0};
 
 
-        if (mem_file(&data, name))
+        if (mem_map(&data, name, MEM_MAP_SEQUENTIAL|MEM_MAP_WILLNEED))
         {
             mesh_header_v0*    header    = mem_raw_data<mesh_header_v0>(&data);
             vf::static_geom_t* fvertices = mem_raw_array<vf::static_geom_t>(&data, header->numVertices);
@@ -1182,8 +1172,8 @@ namespace app
             assert(indexOffset % sizeof(uint32_t) == 0);
 
             uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
-            mem_copy(ptr, fvertices, verticesSize);
-            mem_copy(ptr+(indexOffset-vertexOffset),  findices,  indicesSize);
+            mem_copy_stream(ptr, fvertices, verticesSize);
+            mem_copy_stream(ptr+(indexOffset-vertexOffset),  findices,  indicesSize);
             glUnmapNamedBuffer(staticBuffer);
 
             models[numModels].numSubmeshes = header->numSubsets;
@@ -1392,9 +1382,9 @@ namespace app
         zoffset = 1.0f;
 
         uint32_t numRects;
-        ScreenRect3D* rects = mem::alloc_array<ScreenRect3D>(appArena, MAX_LIGHTS);
-        int32_t* offsets = mem::alloc_array<int32_t>(appArena, numClusters);
-        int32_t* counts  = mem::alloc_array<int32_t>(appArena, numClusters);
+        ScreenRect3D* rects = core::frame_alloc_array<ScreenRect3D>(MAX_LIGHTS);
+        int32_t* offsets = core::frame_alloc_array<int32_t>(numClusters);
+        int32_t* counts  = core::frame_alloc_array<int32_t>(numClusters);
 
         buildRects3D(modelView, proj, MAX_LIGHTS, numRects, rects);
 
@@ -1528,8 +1518,5 @@ namespace app
             }
             glTextureBufferRange(texClusterData, GL_RG32I, gfx::dynBuffer, clusterDataOffset, clusterDataSize);
         }
-        mem::free(appArena, offsets);
-        mem::free(appArena, counts);
-        mem::free(appArena, rects);
     }
 }
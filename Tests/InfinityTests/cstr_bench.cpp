@@ -0,0 +1,120 @@
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum cstr_bench_private
+{
+    BENCH_NUMBERS = 1 << 20,
+    BENCH_RUNS    = 5,
+};
+
+enum cstr_bench_func
+{
+    BENCH_TOFLOAT,
+    BENCH_TODOUBLE,
+    BENCH_SCANF,
+    BENCH_STRTOD,
+    BENCH_FUNC_COUNT
+};
+
+static const char* funcNames[] = {"cstr_tofloat", "cstr_todouble", "cstr_scanf %f", "strtod"};
+
+static uint32_t benchSeed = 1;
+
+static uint32_t benchRandom(uint32_t range)
+{
+    benchSeed = benchSeed * 1664525u + 1013904223u;
+    return (benchSeed >> 8) % range;
+}
+
+// Numbers separated by spaces, every number is NUL terminated for strtod
+static size_t generateNumbers(char* text, bool longDigits)
+{
+    size_t len = 0;
+
+    for (int i = 0; i < BENCH_NUMBERS; ++i)
+    {
+        if (longDigits)
+        {
+            double value = (double(benchRandom(1 << 24)) / double(1 << 24) - 0.5) * 1000.0;
+            len += sprintf(text + len, "%.17g", value) + 1;
+        }
+        else
+        {
+            // Mesh and animation data: few digits before the point, six after
+            len += sprintf(text + len, "%s%u.%06u", benchRandom(2) ? "-" : "", benchRandom(100), benchRandom(1000000)) + 1;
+        }
+    }
+
+    return len;
+}
+
+// Best of several runs, million numbers per second
+static double benchParse(cstr_bench_func func, const char* text, size_t len, double* sum)
+{
+    double best = 0.0;
+
+    for (int run = 0; run < BENCH_RUNS; ++run)
+    {
+        const char* s   = text;
+        const char* end = text + len;
+
+        uint64_t start = SDL_GetPerformanceCounter();
+
+        while (s < end)
+        {
+            const char* next = s;
+            double      d    = 0.0;
+            float       f    = 0.0f;
+
+            switch (func)
+            {
+            case BENCH_TOFLOAT:  cstr_tofloat(s, end - s, &next, &f); d = f; break;
+            case BENCH_TODOUBLE: cstr_todouble(s, end - s, &next, &d);       break;
+            case BENCH_SCANF:    cstr_scanf(s, end - s, "%f", &f); d = f; next = s + strlen(s); break;
+            case BENCH_STRTOD:   d = strtod(s, (char**)&next);               break;
+            default: break;
+            }
+
+            *sum += d;
+            s     = next + 1;
+        }
+
+        double seconds = double(SDL_GetPerformanceCounter() - start) / double(SDL_GetPerformanceFrequency());
+
+        best = core::max(best, double(BENCH_NUMBERS) * 1e-6 / seconds);
+    }
+
+    return best;
+}
+
+// Float parsing throughput on short mesh-like numbers and 17 digit round trip numbers
+int run_cstr_bench()
+{
+    char* text = (char*)malloc(BENCH_NUMBERS * 32);
+
+    printf("\ncstr float parsing, %d numbers\n", BENCH_NUMBERS);
+    printf("%-16s %-8s %12s %10s\n", "function", "digits", "Mnumbers/s", "MB/s");
+
+    for (int longDigits = 0; longDigits < 2; ++longDigits)
+    {
+        benchSeed = 1;
+
+        size_t len = generateNumbers(text, longDigits != 0);
+
+        for (int func = 0; func < BENCH_FUNC_COUNT; ++func)
+        {
+            double sum  = 0.0;
+            double rate = benchParse((cstr_bench_func)func, text, len, &sum);
+
+            printf("%-16s %-8s %12.2f %10.1f\n", funcNames[func], longDigits ? "17" : "short", rate,
+                   rate * double(len) / double(BENCH_NUMBERS));
+        }
+    }
+
+    free(text);
+
+    return 0;
+}
@@ -3,6 +3,9 @@
 #include <core/core.h>
 #include <etlsf.h>
 
+#include <math.h>
+#include <stdlib.h>
+
 static const char test_str1[] = "0";
 static const char test_str2[] = "0x00";
 static const char test_str3[] = "0xfF";
@@ -25,11 +28,11 @@ static const char test_str17[] = "  +.4E-5";
 void test_cstr_todouble()
 {
 #define NUM_FLOAT_TESTS 17
-    static const char* finput0 = "11.\0\11";
-    static const char* finput1 = ".\0\11";
-    static const char* finput2 = "11\0\11";
-    static const char* finput3 = "1111";
-    static const char* finput4 = "e1111";
+    static const char finput0[] = "11.\0\11";
+    static const char finput1[] = ".\0\11";
+    static const char finput2[] = "11\0\11";
+    static const char finput3[] = "1111";
+    static const char finput4[] = "e1111";
     {
         struct test_data_t{
             const char* str;
@@ -73,6 +76,115 @@ void test_cstr_todouble()
     }
 }
 
+static uint32_t floatSeed = 1;
+
+static uint32_t floatRandom(uint32_t range)
+{
+    floatSeed = floatSeed * 1664525u + 1013904223u;
+    return (floatSeed >> 8) % range;
+}
+
+static bool sameDouble(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static bool sameFloat(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Result and end of number match strtod and strtof
+static bool matchesStrtod(const char* str)
+{
+    double      res,  ref;
+    float       resf, reff;
+    const char  *end, *endf;
+    char        *refEnd, *refEndf;
+    size_t      len = strlen(str);
+
+    cstr_todouble(str, len, &end, &res);
+    cstr_tofloat(str, len, &endf, &resf);
+
+    ref  = strtod(str, &refEnd);
+    reff = strtof(str, &refEndf);
+
+    return sameDouble(res, ref) && end == refEnd && sameFloat(resf, reff) && endf == refEndf;
+}
+
+void test_cstr_todouble_rounding()
+{
+    static const char* const hardCases[] = {
+        "0.1", "0.3", "1e23", "8.41e21", "9007199254740993", "9007199254740993.0000000001",
+        "2.2250738585072011e-308", "2.2250738585072012e-308", "4.9e-324", "2.4703282292062327e-324",
+        "2.4703282292062328e-324", "1.7976931348623157e308", "1.7976931348623158e308", "7.3177701707893310e+15",
+        "3.4028234664e38", "3.4028235677973366e38", "1.17549435e-38", "1.4012984643e-45", "7.006492321624085e-46",
+        "16777217", "33554435", "1.000000059604644776", "1.000000059604644775", "9.536750553706952e-07", "9.53674714310182e-07", "1.00000005960464477539062500", "1.000000059604644775390625000000000001",
+        "123456789012345678901234567890e-10", "0.000000000000000000000000000000000000000000001234567890123456789012345",
+        "100000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000e-96",
+        "-0", "-0.0e10", "0e999999", "1e-99999", "5e-324", "1e", "1e+", "2E-x", ".5e3", "-.5E-3", "+7.",
+    };
+
+    uint32_t failed = 0;
+
+    for (size_t i = 0; i < sizeof(hardCases) / sizeof(hardCases[0]); ++i)
+    {
+        failed += matchesStrtod(hardCases[i]) ? 0 : 1;
+    }
+
+    sput_fail_unless(failed == 0, "Hard cases match strtod");
+
+    // Shortest round trip and longer representations of random doubles
+    char str[128];
+
+    failed = 0;
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        uint64_t bits = (uint64_t(floatRandom(1 << 24)) << 40) ^ (uint64_t(floatRandom(1 << 24)) << 20) ^ floatRandom(1 << 24);
+        double   value;
+
+        memcpy(&value, &bits, sizeof(double));
+        if (value != value || value - value != 0.0) continue;  // NaN and infinity
+
+        sprintf(str, "%.*g", 1 + floatRandom(25), value);
+        failed += matchesStrtod(str) ? 0 : 1;
+    }
+
+    sput_fail_unless(failed == 0, "Random doubles match strtod");
+
+    // Random digits, long mantissas and exponents near the ends of range
+    failed = 0;
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        int len    = 0;
+        int digits = 1 + floatRandom(floatRandom(4) ? 20 : 120);
+        int point  = floatRandom(digits + 1);
+
+        for (int d = 0; d < digits; ++d)
+        {
+            if (d == point) str[len++] = '.';
+            str[len++] = char('0' + floatRandom(10));
+        }
+
+        sprintf(str + len, "e%d", int(floatRandom(700)) - 360 - digits / 2);
+        failed += matchesStrtod(str) ? 0 : 1;
+    }
+
+    sput_fail_unless(failed == 0, "Random digit strings match strtod");
+
+    double  res;
+    errno_t err;
+
+    err = cstr_todouble("1e400", 5, 0, &res);
+    sput_fail_unless(err == ERANGE && res == HUGE_VAL, "Overflow is reported");
+    err = cstr_todouble("1e-400", 6, 0, &res);
+    sput_fail_unless(err == ERANGE && res == 0.0, "Underflow is reported");
+    err = cstr_todouble("0e-400", 6, 0, &res);
+    sput_fail_unless(err == EOK && res == 0.0, "Zero is not underflow");
+}
+
 void test_cstr_toimax()
 {
 #define NUM_IMAX_TESTS 9
@@ -228,6 +340,8 @@ int run_cstr_tests()
 
     sput_enter_suite("CSTR: test cstr_todouble");
     sput_run_test(test_cstr_todouble);
+    sput_enter_suite("CSTR: test cstr_todouble rounding");
+    sput_run_test(test_cstr_todouble_rounding);
     sput_enter_suite("CSTR: test cstr_toimax");
     sput_run_test(test_cstr_toimax);
     sput_enter_suite("CSTR: test cstr_toumax");
@@ -0,0 +1,112 @@
+#include <SDL2/SDL.h>
+#include <core/core.h>
+#include <etlsf.h>
+
+#include <stdio.h>
+
+enum etlsf_bench_private
+{
+    BENCH_OPERATIONS = 1 << 22,
+    BENCH_LIVE_SLOTS = 1 << 14,
+};
+
+struct bench_config_t
+{
+    const char* name;
+    uint32_t    size;
+    uint32_t    maxAllocs;
+    uint32_t    granularity;
+};
+
+// Baseline has granularity and limits of old 16-bit handles (256b, 65535
+// allocs), other rows are reported relative to it. Timings depend on machine.
+static const bench_config_t benchConfigs[] = {
+    {"baseline: 256b, 64k, 64Mb", 64 << 20, 0xFFFF,           256},
+    {"64b, 64k allocs, 64Mb",   64 << 20,   0xFFFF,           64},
+    {"16b, 1M allocs, 64Mb",    64 << 20,   ETLSF_MAX_ALLOCS, 16},
+    {"256b, 1M allocs, 3Gb",    0xC0000000, ETLSF_MAX_ALLOCS, 256},
+};
+
+static etlsf_alloc_t benchSlots[BENCH_LIVE_SLOTS];
+
+// Mostly small requests like uniforms and short paths, some large
+static uint32_t benchRequestSize(uint32_t seed)
+{
+    return (seed >> 24) % 8 ? 1 + (seed >> 8) % 512 : 1 + (seed >> 8) % (64*1024);
+}
+
+// Returns ns per operation
+static double benchConfig(const bench_config_t& config, double baselineNs)
+{
+    etlsf_t arena = etlsf_create_ex(config.size, config.maxAllocs, config.granularity, 0);
+
+    for (size_t i = 0; i < BENCH_LIVE_SLOTS; ++i)
+    {
+        benchSlots[i].value = 0;
+    }
+
+    uint32_t seed      = 1;
+    uint64_t requested = 0;
+    uint64_t allocated = 0;
+    uint32_t failures  = 0;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+
+    for (size_t i = 0; i < BENCH_OPERATIONS; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+
+        etlsf_alloc_t& id = benchSlots[(seed >> 4) % BENCH_LIVE_SLOTS];
+
+        if (id.value)
+        {
+            etlsf_free_range(arena, id);
+            id.value = 0;
+        }
+        else
+        {
+            uint32_t size = benchRequestSize(seed);
+
+            id = etlsf_alloc_range(arena, size);
+
+            if (id.value)
+            {
+                requested += size;
+                allocated += etlsf_alloc_size(arena, id);
+            }
+            else
+            {
+                ++failures;
+            }
+        }
+    }
+
+    uint64_t ticks = SDL_GetPerformanceCounter() - start;
+    double   ns    = double(ticks) * 1e9 / double(SDL_GetPerformanceFrequency()) / BENCH_OPERATIONS;
+
+    printf("%-26s %10.1f %10.2f %10.1f %10u %12.1f\n", config.name, ns, baselineNs > 0.0 ? ns / baselineNs : 1.0,
+           requested ? 100.0 * double(allocated - requested) / double(allocated) : 0.0,
+           failures, double(etlsf_metadata_size(config.maxAllocs, 0)) / 1024.0);
+
+    etlsf_destroy(arena);
+
+    return ns;
+}
+
+// Alloc/free mix with different granularity, handle capacity and space size
+int run_etlsf_bench()
+{
+    printf("\netlsf, %d operations, %d live slots\n", BENCH_OPERATIONS, BENCH_LIVE_SLOTS);
+    printf("%-26s %10s %10s %10s %10s %12s\n", "config", "ns/op", "x baseline", "waste, %", "failures", "metadata, Kb");
+
+    double baselineNs = 0.0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(benchConfigs); ++i)
+    {
+        double ns = benchConfig(benchConfigs[i], baselineNs);
+
+        if (i == 0) baselineNs = ns;
+    }
+
+    return 0;
+}
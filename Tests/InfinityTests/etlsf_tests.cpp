@@ -1,5 +1,6 @@
 #include <sput.h>
 
+#include <SDL2/SDL.h>
 #include <core/core.h>
 #include <etlsf.h>
 
@@ -214,6 +215,463 @@ void test_max_allocs()
     etlsf_destroy(arena);
 }
 
+void test_deferred_free()
+{
+    etlsf_t arena = etlsf_create(4096, 128);
+
+    etlsf_alloc_t id0 = etlsf_alloc_range(arena, 1024);
+    etlsf_alloc_t id1 = etlsf_alloc_range(arena, 1024);
+
+    etlsf_free_range_deferred(arena, id0);
+    etlsf_free_range_deferred(arena, id1);
+
+    etlsf_free_stats_t stats;
+    etlsf_free_stats(arena, &stats);
+
+    sput_fail_unless(!etlsf_alloc_is_valid(arena, id0) && !etlsf_alloc_is_valid(arena, id1), "Deferred ranges are not valid");
+    sput_fail_unless(stats.free_size == 2048, "Deferred ranges are not free before flush");
+
+    etlsf_flush_deferred(arena);
+    etlsf_free_stats(arena, &stats);
+
+    sput_fail_unless(stats.free_size == 4096 && stats.num_free_ranges == 1, "Deferred ranges are freed and merged by flush");
+
+    etlsf_destroy(arena);
+}
+
+void test_deferred_free_frames()
+{
+    etlsf_t arena = etlsf_create(4096, 128);
+
+    etlsf_alloc_t id0 = etlsf_alloc_range(arena, 1024);
+    etlsf_alloc_t id1 = etlsf_alloc_range(arena, 1024);
+
+    etlsf_free_stats_t stats;
+
+    // Range freed during frame 0 is reused after 2 more frames
+    etlsf_free_range_deferred(arena, id0);
+    etlsf_flush_deferred_frames(arena, 2);
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size == 2048, "Range is kept at end of its frame");
+
+    etlsf_free_range_deferred(arena, id1);
+    etlsf_flush_deferred_frames(arena, 2);
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size == 2048, "Range is kept while frame is in flight");
+
+    etlsf_flush_deferred_frames(arena, 2);
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size == 3072, "Range is freed after frames delay");
+
+    etlsf_flush_deferred_frames(arena, 2);
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size == 4096, "Ranges of later frames are freed in order");
+
+    // Full flush does not wait for frames
+    etlsf_alloc_t id2 = etlsf_alloc_range(arena, 1024);
+    etlsf_free_range_deferred(arena, id2);
+    etlsf_flush_deferred_frames(arena, 2);
+    etlsf_flush_deferred(arena);
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size == 4096 && stats.num_free_ranges == 1, "Delayed ranges are freed by full flush");
+
+    etlsf_destroy(arena);
+}
+
+void test_stale_handles()
+{
+    etlsf_t arena = etlsf_create(4096, 16);
+
+    etlsf_alloc_t id0 = etlsf_alloc_range(arena, 1024);
+    etlsf_free_range(arena, id0);
+
+    etlsf_alloc_t id1 = etlsf_alloc_range(arena, 1024);
+
+    sput_fail_unless((id0.value & ETLSF_MAX_ALLOCS) == (id1.value & ETLSF_MAX_ALLOCS), "Range data is reused");
+    sput_fail_unless(id0.value != id1.value, "Handle of reused range has new generation");
+    sput_fail_unless(!etlsf_alloc_is_valid(arena, id0) && etlsf_alloc_is_valid(arena, id1), "Stale handle is not valid");
+    sput_fail_unless(etlsf_alloc_size(arena, id0) == 0 && etlsf_alloc_offset(arena, id0) == 0, "Stale handle has no size and offset");
+
+    etlsf_alloc_t garbage = { ETLSF_MAX_ALLOCS };
+    sput_fail_unless(!etlsf_alloc_is_valid(arena, garbage), "Handle out of range data is not valid");
+
+    etlsf_destroy(arena);
+}
+
+void test_granularity()
+{
+    const uint32_t granularities[] = { 16, 64, 256 };
+
+    for (size_t g = 0; g < ARRAY_SIZE(granularities); ++g)
+    {
+        const uint32_t granularity = granularities[g];
+        const uint32_t size        = granularity * 1024;
+
+        etlsf_t arena = etlsf_create_ex(size, 1024, granularity, 0);
+
+        etlsf_alloc_t id0 = etlsf_alloc_range(arena, 1);
+        etlsf_alloc_t id1 = etlsf_alloc_range(arena, granularity + 1);
+        etlsf_alloc_t id2 = etlsf_alloc_range(arena, granularity * 100 + 3);
+
+        sput_fail_unless(etlsf_alloc_size(arena, id0) == granularity, "Size is rounded up to granularity");
+        sput_fail_unless(etlsf_alloc_size(arena, id1) == granularity * 2, "Size is rounded up to granularity");
+        sput_fail_unless(etlsf_alloc_size(arena, id2) == granularity * 101, "Size is rounded up to granularity");
+        sput_fail_unless(etlsf_alloc_offset(arena, id1) == granularity && etlsf_alloc_offset(arena, id2) == granularity * 3, "Offsets are packed");
+
+        // Fill whole arena with smallest ranges
+        etlsf_free_range(arena, id0);
+        etlsf_free_range(arena, id1);
+        etlsf_free_range(arena, id2);
+
+        bool tests_passed = true;
+        for (uint32_t i = 0; i < 1024; ++i)
+        {
+            etlsf_alloc_t id = etlsf_alloc_range(arena, granularity);
+            tests_passed &= etlsf_alloc_offset(arena, id) == i * granularity;
+        }
+        tests_passed &= !etlsf_alloc_range(arena, 1).value;
+
+        sput_fail_unless(tests_passed, "Arena is filled by ranges of granularity size");
+
+        etlsf_destroy(arena);
+    }
+}
+
+void test_large_space()
+{
+    // Arena manages offsets only, no memory is reserved
+    const uint32_t SIZE = 0xFFFFFF00;
+
+    etlsf_t arena = etlsf_create(SIZE, 16);
+
+    etlsf_alloc_t id0 = etlsf_alloc_range(arena, 0x80000000);
+    etlsf_alloc_t id1 = etlsf_alloc_range(arena, 0x40000000);
+    etlsf_alloc_t id2 = etlsf_alloc_range(arena, 0x3FFFFF00);
+
+    sput_fail_unless(id0.value && id1.value && id2.value, "Ranges larger than 1Gb are allocated");
+    sput_fail_unless(etlsf_alloc_offset(arena, id1) == 0x80000000 && etlsf_alloc_offset(arena, id2) == 0xC0000000, "Offsets above 2Gb are correct");
+    sput_fail_unless(!etlsf_alloc_range(arena, 256).value, "Arena is full");
+
+    etlsf_free_range(arena, id1);
+    etlsf_free_range(arena, id0);
+    etlsf_free_range(arena, id2);
+
+    etlsf_alloc_t id = etlsf_alloc_range(arena, SIZE);
+    sput_fail_unless(etlsf_alloc_offset(arena, id) == 0 && etlsf_alloc_size(arena, id) == SIZE, "Whole space is allocated after merge");
+
+    etlsf_destroy(arena);
+}
+
+void test_compaction()
+{
+    const uint32_t COUNT = 16;
+    const uint32_t SIZE  = 256;
+
+    etlsf_t arena = etlsf_create(COUNT * SIZE, 64);
+
+    // Memory is simulated: every range is filled with its number
+    uint8_t       memory[COUNT * SIZE];
+    etlsf_alloc_t ids[COUNT];
+
+    for (uint32_t i = 0; i < COUNT; ++i)
+    {
+        ids[i] = etlsf_alloc_range(arena, SIZE);
+        memset(memory + etlsf_alloc_offset(arena, ids[i]), i, SIZE);
+    }
+
+    // Every second range is freed, so no two free ranges are adjacent
+    for (uint32_t i = 0; i < COUNT; i += 2)
+    {
+        etlsf_free_range(arena, ids[i]);
+        ids[i].value = 0;
+    }
+
+    etlsf_free_stats_t stats;
+    etlsf_free_stats(arena, &stats);
+
+    sput_fail_unless(stats.num_free_ranges == COUNT / 2 && stats.largest_free_size == SIZE, "Free space is fragmented");
+    sput_fail_unless(stats.fragmentation == 1.0f - 2.0f / COUNT, "Fragmentation is reported");
+    sput_fail_unless(!etlsf_alloc_range(arena, SIZE * 2).value, "Range larger than free ranges fails");
+
+    etlsf_move_t moves[COUNT];
+    uint32_t     numMoves = etlsf_compact_plan(arena, SIZE * 4, moves, COUNT);
+
+    bool movesValid = numMoves == 4;
+    for (uint32_t i = 0; i < numMoves; ++i)
+    {
+        movesValid &= moves[i].size == SIZE && moves[i].dst_offset < moves[i].src_offset;
+        movesValid &= moves[i].src_offset == (COUNT - 1 - i * 2) * SIZE;
+        movesValid &= etlsf_alloc_offset(arena, moves[i].id) == moves[i].src_offset;
+    }
+    sput_fail_unless(movesValid, "Moves of last ranges to lower offsets are planned within budget");
+
+    // Rounds of copies and commits until nothing can be moved
+    uint32_t totalMoves = 0;
+    for (uint32_t round = 0; round < COUNT && numMoves; ++round)
+    {
+        for (uint32_t i = 0; i < numMoves; ++i)
+        {
+            memcpy(memory + moves[i].dst_offset, memory + moves[i].src_offset, moves[i].size);
+
+            etlsf_alloc_t id = moves[i].id;
+            etlsf_compact_commit(arena, &moves[i]);
+
+            movesValid &= etlsf_alloc_is_valid(arena, id) && etlsf_alloc_offset(arena, id) == moves[i].dst_offset;
+        }
+
+        totalMoves += numMoves;
+
+        etlsf_flush_deferred(arena);
+        numMoves = etlsf_compact_plan(arena, SIZE * 4, moves, COUNT);
+    }
+
+    sput_fail_unless(movesValid && totalMoves > 0, "Committed handles keep values and get new offsets");
+
+    bool contentValid = true;
+    for (uint32_t i = 1; i < COUNT; i += 2)
+    {
+        uint32_t offset = etlsf_alloc_offset(arena, ids[i]);
+
+        contentValid &= offset < COUNT / 2 * SIZE;
+        contentValid &= memory[offset] == i && memory[offset + SIZE - 1] == i;
+    }
+    sput_fail_unless(contentValid, "Allocations are packed at the start and keep contents");
+
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.num_free_ranges == 1 && stats.fragmentation == 0.0f, "Free space is contiguous after compaction");
+
+    etlsf_alloc_t large = etlsf_alloc_range(arena, SIZE * COUNT / 2);
+    sput_fail_unless(large.value, "Range that failed before compaction is allocated");
+
+    etlsf_free_range(arena, large);
+
+    // Allocation freed after planning and cancelled move
+    for (uint32_t i = 1; i < COUNT; i += 2)
+    {
+        etlsf_free_range(arena, ids[i]);
+    }
+
+    ids[0] = etlsf_alloc_range(arena, SIZE);
+    ids[1] = etlsf_alloc_range(arena, SIZE);
+    ids[2] = etlsf_alloc_range(arena, SIZE);
+    ids[3] = etlsf_alloc_range(arena, SIZE);
+
+    etlsf_free_range(arena, ids[0]);
+    etlsf_free_range(arena, ids[1]);
+
+    numMoves = etlsf_compact_plan(arena, SIZE * COUNT, moves, 1);
+    sput_fail_unless(numMoves == 1 && moves[0].id.value == ids[3].value, "Only last range is moved");
+
+    etlsf_free_range(arena, ids[3]);
+    sput_fail_unless(!etlsf_compact_commit(arena, &moves[0]), "Move of freed allocation is dropped");
+
+    numMoves = etlsf_compact_plan(arena, SIZE * COUNT, moves, 1);
+    sput_fail_unless(numMoves == 1 && moves[0].id.value == ids[2].value, "Range above free range is moved");
+
+    etlsf_compact_cancel(arena, &moves[0]);
+    etlsf_free_range(arena, ids[2]);
+
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size == COUNT * SIZE && stats.num_free_ranges == 1, "Dropped and cancelled moves release reserved ranges");
+
+    etlsf_destroy(arena);
+}
+
+void test_many_allocs()
+{
+    const uint32_t MAX_ALLOCS = 200000;
+
+    static etlsf_alloc_t allocs[MAX_ALLOCS];
+
+    etlsf_t arena = etlsf_create_ex(MAX_ALLOCS * 16, MAX_ALLOCS, 16, 0);
+
+    bool tests_passed = true;
+    for (uint32_t i = 0; i < MAX_ALLOCS; ++i)
+    {
+        allocs[i] = etlsf_alloc_range(arena, 16);
+        tests_passed &= etlsf_alloc_offset(arena, allocs[i]) == i * 16;
+    }
+    sput_fail_unless(tests_passed, "More than 65535 allocations succeeded");
+
+    for (uint32_t i = 0; i < MAX_ALLOCS; i += 2)
+    {
+        etlsf_free_range(arena, allocs[i]);
+    }
+    for (uint32_t i = 1; i < MAX_ALLOCS; i += 2)
+    {
+        etlsf_free_range(arena, allocs[i]);
+    }
+
+    etlsf_free_stats_t stats;
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size == MAX_ALLOCS * 16 && stats.num_free_ranges == 1, "All ranges are merged");
+
+    etlsf_destroy(arena);
+}
+
+enum concurrent_test_private
+{
+    STRESS_ARENA_SIZE  = 16*1024*1024,
+    STRESS_UNIT        = 256,
+    STRESS_TASKS       = 64,
+    STRESS_ITERATIONS  = 2000,
+    STRESS_LIVE_ALLOCS = 16,
+};
+
+struct stress_test_t
+{
+    etlsf_t        arena;
+    SDL_atomic_t*  owners;      //Task owning every 256 bytes unit of arena
+    SDL_atomic_t   overlaps;
+    SDL_atomic_t   failures;
+};
+
+static void stressMark(stress_test_t* test, etlsf_alloc_t id, int owner, int new_owner)
+{
+    uint32_t offset = etlsf_alloc_offset(test->arena, id) / STRESS_UNIT;
+    uint32_t count  = etlsf_alloc_size(test->arena, id) / STRESS_UNIT;
+
+    if (offset + count > STRESS_ARENA_SIZE / STRESS_UNIT)
+    {
+        SDL_AtomicIncRef(&test->failures);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!SDL_AtomicCAS(&test->owners[offset + i], owner, new_owner))
+        {
+            SDL_AtomicIncRef(&test->overlaps);
+        }
+    }
+}
+
+static void stressTask(stress_test_t* test, size_t task)
+{
+    etlsf_alloc_t live[STRESS_LIVE_ALLOCS] = {};
+    uint32_t      seed = (uint32_t)task * 7919 + 1;
+
+    for (uint32_t i = 0; i < STRESS_ITERATIONS; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+
+        etlsf_alloc_t& id = live[(seed >> 8) % STRESS_LIVE_ALLOCS];
+
+        if (id.value)
+        {
+            // Unmarked before release, other tasks can get range right after free
+            stressMark(test, id, (int)task + 1, 0);
+
+            if (seed & 0x10000) etlsf_free_range_deferred(test->arena, id);
+            else                etlsf_free_range(test->arena, id);
+
+            id.value = 0;
+        }
+        else
+        {
+            // Mostly small sizes that go through thread caches
+            uint32_t size = (seed >> 20) % 8 ? 1 + (seed >> 16) % 4096 : 4097 + (seed >> 12) % (64*1024);
+
+            id = etlsf_alloc_range(test->arena, size);
+
+            if (id.value)
+            {
+                if (etlsf_alloc_size(test->arena, id) < size) SDL_AtomicIncRef(&test->failures);
+                stressMark(test, id, 0, (int)task + 1);
+            }
+        }
+
+        // Frame boundaries on different threads
+        if ((i + task) % 64 == 0)
+        {
+            etlsf_flush_deferred(test->arena);
+        }
+    }
+
+    for (uint32_t i = 0; i < STRESS_LIVE_ALLOCS; ++i)
+    {
+        if (live[i].value)
+        {
+            stressMark(test, live[i], (int)task + 1, 0);
+            etlsf_free_range(test->arena, live[i]);
+        }
+    }
+}
+
+void test_concurrent_stress()
+{
+    stress_test_t test;
+
+    test.arena  = etlsf_create_concurrent(STRESS_ARENA_SIZE, 0xFFFF);
+    test.owners = (SDL_atomic_t*)malloc(sizeof(SDL_atomic_t) * STRESS_ARENA_SIZE / STRESS_UNIT);
+    memset(test.owners, 0, sizeof(SDL_atomic_t) * STRESS_ARENA_SIZE / STRESS_UNIT);
+    SDL_AtomicSet(&test.overlaps, 0);
+    SDL_AtomicSet(&test.failures, 0);
+
+    mt::parallel_for(0, STRESS_TASKS, 1, [&test](size_t begin, size_t end)
+    {
+        for (size_t task = begin; task < end; ++task)
+        {
+            stressTask(&test, task);
+        }
+    });
+
+    sput_fail_unless(SDL_AtomicGet(&test.overlaps) == 0, "Ranges allocated by different threads do not overlap");
+    sput_fail_unless(SDL_AtomicGet(&test.failures) == 0, "Ranges are inside arena and not smaller than requested");
+
+    etlsf_free_stats_t stats;
+
+    etlsf_trim(test.arena);
+    etlsf_free_stats(test.arena, &stats);
+    sput_fail_unless(stats.free_size == STRESS_ARENA_SIZE && stats.num_free_ranges == 1, "All ranges are returned and merged after trim");
+
+    free(test.owners);
+    etlsf_destroy(test.arena);
+}
+
+void test_concurrent_cached_frees()
+{
+    etlsf_t arena = etlsf_create_concurrent(1024*1024, 4096);
+
+    etlsf_alloc_t large[4];
+    for (size_t i = 0; i < 4; ++i)
+    {
+        large[i] = etlsf_alloc_range(arena, 256*1024);
+    }
+    sput_fail_unless(etlsf_alloc_is_valid(arena, large[3]), "Arena is filled with large ranges");
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        etlsf_free_range(arena, large[i]);
+    }
+
+    etlsf_alloc_t id = etlsf_alloc_range(arena, 512*1024);
+    sput_fail_unless(etlsf_alloc_is_valid(arena, id), "Large ranges are freed to arena without flush");
+    etlsf_free_range(arena, id);
+
+    static etlsf_alloc_t small[1024];
+    for (size_t i = 0; i < 1024; ++i)
+    {
+        small[i] = etlsf_alloc_range(arena, 1024);
+    }
+    sput_fail_unless(etlsf_alloc_is_valid(arena, small[1023]), "Arena is filled with small ranges");
+
+    for (size_t i = 0; i < 1024; ++i)
+    {
+        etlsf_free_range(arena, small[i]);
+    }
+
+    etlsf_free_stats_t stats;
+    etlsf_free_stats(arena, &stats);
+    sput_fail_unless(stats.free_size >= 1024*1024 - 1024*1024/64, "Thread cache keeps limited part of arena");
+
+    id = etlsf_alloc_range(arena, 1024*1024);
+    sput_fail_unless(etlsf_alloc_is_valid(arena, id), "Failed allocation returns cached ranges and retries");
+    etlsf_free_range(arena, id);
+
+    etlsf_destroy(arena);
+}
+
 int run_etlsf_tests()
 {
     core::init();
@@ -228,6 +686,24 @@ int run_etlsf_tests()
     sput_run_test(test_merge_next);
     sput_enter_suite("ETLSF: max allocs");
     sput_run_test(test_max_allocs);
+    sput_enter_suite("ETLSF: stale handles");
+    sput_run_test(test_stale_handles);
+    sput_enter_suite("ETLSF: granularity");
+    sput_run_test(test_granularity);
+    sput_enter_suite("ETLSF: spaces over 1Gb");
+    sput_run_test(test_large_space);
+    sput_enter_suite("ETLSF: more than 65535 allocs");
+    sput_run_test(test_many_allocs);
+    sput_enter_suite("ETLSF: compaction");
+    sput_run_test(test_compaction);
+    sput_enter_suite("ETLSF: deferred free");
+    sput_run_test(test_deferred_free);
+    sput_enter_suite("ETLSF: deferred free with frames delay");
+    sput_run_test(test_deferred_free_frames);
+    sput_enter_suite("ETLSF: concurrent stress");
+    sput_run_test(test_concurrent_stress);
+    sput_enter_suite("ETLSF: concurrent cached frees");
+    sput_run_test(test_concurrent_cached_frees);
 
     sput_finish_testing();
 
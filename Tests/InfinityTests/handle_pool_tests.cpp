@@ -0,0 +1,194 @@
+#include <sput.h>
+
+#include <core/core.h>
+
+struct test_object_t
+{
+    uint32_t value;
+};
+
+typedef core::handle_t<test_object_t>         test_handle_t;
+typedef core::handle_pool_t<test_object_t, 8> test_pool_t;
+
+static test_pool_t testPool;
+
+static bool liveValuesSum(test_pool_t& pool, uint32_t expected)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < core::handle_pool_count(pool); ++i)
+    {
+        test_handle_t handle = core::handle_pool_handle_at(pool, i);
+
+        if (core::handle_pool_get(pool, handle) != core::handle_pool_at(pool, i)) return false;
+
+        sum += core::handle_pool_at(pool, i)->value;
+    }
+
+    return sum == expected;
+}
+
+void test_handle_alloc_free()
+{
+    test_handle_t null = {0};
+
+    sput_fail_unless(core::handle_is_null(null),                    "Zero handle is null");
+    sput_fail_unless(!core::handle_pool_is_valid(testPool, null),   "Null handle is not valid");
+    sput_fail_unless(core::handle_pool_get(testPool, null) == 0,    "Null handle has no object");
+
+    test_handle_t a = core::handle_pool_alloc(testPool);
+    test_handle_t b = core::handle_pool_alloc(testPool);
+
+    sput_fail_unless(!core::handle_is_null(a) && !core::handle_is_null(b), "Allocated handles are not null");
+    sput_fail_unless(a.value != b.value,                                   "Allocated handles differ");
+    sput_fail_unless(core::handle_pool_count(testPool) == 2,               "Pool counts live objects");
+
+    test_object_t* objA = core::handle_pool_get(testPool, a);
+    objA->value = 1;
+
+    sput_fail_unless(core::handle_pool_free(testPool, a),                   "Live handle is freed");
+    sput_fail_unless(!core::handle_pool_free(testPool, a),                  "Freed handle is not freed twice");
+    sput_fail_unless(core::handle_pool_get(testPool, a) == 0,               "Freed handle has no object");
+    sput_fail_unless(core::handle_pool_is_valid(testPool, b),               "Other handle stays valid");
+
+    test_handle_t c = core::handle_pool_alloc(testPool);
+
+    sput_fail_unless(core::handle_pool_get(testPool, c) == objA,            "Freed slot is reused");
+    sput_fail_unless(c.value != a.value,                                    "Reused slot gets new generation");
+    sput_fail_unless(!core::handle_pool_is_valid(testPool, a),              "Stale handle does not match reused slot");
+
+    core::handle_pool_reset(testPool);
+}
+
+void test_handle_live_iteration()
+{
+    test_handle_t handles[8];
+
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        handles[i] = core::handle_pool_alloc(testPool);
+        core::handle_pool_get(testPool, handles[i])->value = 1 << i;
+    }
+
+    sput_fail_unless(liveValuesSum(testPool, 0xFF), "All live objects are iterated");
+
+    test_handle_t full = core::handle_pool_alloc(testPool);
+    sput_fail_unless(core::handle_is_null(full), "Full pool returns null handle");
+
+    core::handle_pool_free(testPool, handles[0]);
+    core::handle_pool_free(testPool, handles[5]);
+
+    sput_fail_unless(core::handle_pool_count(testPool) == 6,    "Freed objects are not counted");
+    sput_fail_unless(liveValuesSum(testPool, 0xFF & ~0x21),     "Freed objects are not iterated");
+
+    core::handle_pool_free(testPool, handles[7]);
+    sput_fail_unless(liveValuesSum(testPool, 0x7F & ~0x21),     "Freeing last live object keeps iteration valid");
+
+    core::handle_pool_reset(testPool);
+
+    sput_fail_unless(core::handle_pool_count(testPool) == 0,        "Reset pool is empty");
+    sput_fail_unless(!core::handle_pool_is_valid(testPool, handles[1]), "Handles issued before reset are stale");
+
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        handles[i] = core::handle_pool_alloc(testPool);
+    }
+
+    sput_fail_unless(!core::handle_is_null(handles[7]), "Reset pool reuses all slots");
+
+    core::handle_pool_reset(testPool);
+}
+
+void test_handle_generation_wrap()
+{
+    test_handle_t first = core::handle_pool_alloc(testPool);
+    test_handle_t last  = first;
+
+    bool neverNull = true;
+
+    // Generation wraps past zero, live handles stay non-null
+    for (uint32_t i = 0; i < 2*core::HANDLE_GEN_MASK; ++i)
+    {
+        core::handle_pool_free(testPool, last);
+        last = core::handle_pool_alloc(testPool);
+
+        neverNull = neverNull && !core::handle_is_null(last) && core::handle_pool_is_valid(testPool, last);
+    }
+
+    sput_fail_unless(neverNull, "Live handles stay valid after generation wraps");
+
+    core::handle_pool_reset(testPool);
+}
+
+void test_handle_dynpool_growth()
+{
+    typedef core::handle_dynpool_t<test_object_t, 16> test_dynpool_t;
+
+    static test_handle_t handles[1000];
+
+    test_dynpool_t pool = {};
+
+    handles[0] = core::handle_pool_alloc(pool);
+
+    test_object_t* first = core::handle_pool_get(pool, handles[0]);
+    first->value = 0;
+
+    for (uint32_t i = 1; i < 1000; ++i)
+    {
+        handles[i] = core::handle_pool_alloc(pool);
+        if (core::handle_is_null(handles[i])) break;
+
+        core::handle_pool_get(pool, handles[i])->value = i;
+    }
+
+    sput_fail_unless(!core::handle_is_null(handles[999]) && core::handle_pool_count(pool) == 1000, "Pool grows past first page");
+
+    bool stable = true;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        stable = stable && core::handle_pool_get(pool, handles[i])->value == i;
+    }
+    sput_fail_unless(stable, "Objects keep data when pool grows");
+
+    core::handle_pool_free(pool, handles[1]);
+
+    sput_fail_unless(!core::handle_pool_is_valid(pool, handles[1]) && core::handle_pool_get(pool, handles[1]) == 0, "Freed handle is stale");
+
+    test_handle_t reused = core::handle_pool_alloc(pool);
+    core::handle_pool_get(pool, reused)->value = 1;
+
+    sput_fail_unless(core::handle_pool_get(pool, handles[0]) == first, "Objects do not move");
+    sput_fail_unless((reused.value & core::HANDLE_INDEX_MASK) == (handles[1].value & core::HANDLE_INDEX_MASK), "Freed slot is reused");
+
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < core::handle_pool_count(pool); ++i)
+    {
+        sum += core::handle_pool_at(pool, i)->value;
+    }
+    sput_fail_unless(sum == 999*1000/2, "All live objects are iterated");
+
+    core::handle_pool_fini(pool);
+
+    sput_fail_unless(core::handle_pool_count(pool) == 0 && !core::handle_pool_is_valid(pool, handles[0]), "Finished pool is empty");
+    sput_fail_unless(!core::handle_is_null(core::handle_pool_alloc(pool)), "Finished pool can be used again");
+
+    core::handle_pool_fini(pool);
+}
+
+int run_handle_pool_tests()
+{
+    sput_start_testing();
+
+    sput_enter_suite("CORE handle pool: alloc and free");
+    sput_run_test(test_handle_alloc_free);
+    sput_enter_suite("CORE handle pool: live iteration");
+    sput_run_test(test_handle_live_iteration);
+    sput_enter_suite("CORE handle pool: generation wrap");
+    sput_run_test(test_handle_generation_wrap);
+    sput_enter_suite("CORE handle pool: growable pool");
+    sput_run_test(test_handle_dynpool_growth);
+
+    sput_finish_testing();
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,331 @@
+#include <sput.h>
+
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+enum io_test_private
+{
+    TEST_FILE_SIZE  = 4096,
+    TEST_MAX_READS  = 16,
+    TEST_MAX_JOBS   = 4096,
+};
+
+static const char* testSmallFile = "io_test_small.bin";
+static const char* testLargeFile = "io_test_large.bin";
+
+struct test_read_t
+{
+    io::request_t request;
+    int           status;
+    int           order;
+    size_t        size;
+    size_t        bytesInFlight;
+    bool          mapped;
+    bool          valid;
+    int           worker;
+};
+
+static test_read_t  testReads[TEST_MAX_READS];
+static SDL_atomic_t testCompleted;
+
+// Completion that blocks I/O thread, so requests can be queued while it is busy
+static SDL_sem*     testEntered;
+static SDL_sem*     testRelease;
+
+static mt::job_t*       heldJobs[TEST_MAX_JOBS];
+static mt::job_handle_t heldHandles[TEST_MAX_JOBS];
+static size_t           numHeldJobs;
+
+static bool writeTestFile(const char* name, size_t size)
+{
+    PHYSFS_File* file = PHYSFS_openWrite(name);
+    if (!file) return false;
+
+    bool ok = true;
+
+    for (size_t i = 0; i < size && ok; ++i)
+    {
+        uint8_t value = (uint8_t)i;
+        ok = PHYSFS_write(file, &value, 1, 1) == 1;
+    }
+
+    PHYSFS_close(file);
+
+    return ok;
+}
+
+static void testComplete(void* arg, int status, memory_t* data)
+{
+    test_read_t* read = (test_read_t*)arg;
+
+    read->status        = status;
+    read->size          = data->size;
+    read->mapped        = data->mapped;
+    read->bytesInFlight = io::getBytesInFlight();
+    read->worker        = mt::getWorkerIndex();
+    read->valid         = true;
+
+    for (size_t i = 0; i < data->size; ++i)
+    {
+        read->valid = read->valid && data->buffer[i] == (uint8_t)i;
+    }
+
+    read->order = SDL_AtomicAdd(&testCompleted, 1);
+
+    mem_free(data);
+}
+
+static void testCompleteBlocking(void* arg, int status, memory_t* data)
+{
+    testComplete(arg, status, data);
+
+    SDL_SemPost(testEntered);
+    SDL_SemWait(testRelease);
+}
+
+static void testNop(void*)
+{
+}
+
+static int SDLCALL holdJobRingThread(void*)
+{
+    numHeldJobs = 0;
+
+    while (numHeldJobs < TEST_MAX_JOBS)
+    {
+        mt::job_t* job = mt::createJob(testNop, 0);
+        if (!job) break;
+
+        heldHandles[numHeldJobs] = mt::getJobHandle(job);
+        heldJobs[numHeldJobs++]  = job;
+    }
+
+    return 0;
+}
+
+// Takes all slots of job ring shared by non worker threads, completions of I/O threads
+// can not be scheduled as jobs and are run by I/O threads
+static void holdJobRing()
+{
+    SDL_WaitThread(SDL_CreateThread(holdJobRingThread, "IOTestJobs", 0), 0);
+}
+
+static void releaseJobRing()
+{
+    for (size_t i = 0; i < numHeldJobs; ++i)
+    {
+        mt::runJob(heldJobs[i]);
+    }
+
+    for (size_t i = 0; i < numHeldJobs; ++i)
+    {
+        mt::waitJob(heldHandles[i]);
+    }
+
+    numHeldJobs = 0;
+}
+
+static void resetReads()
+{
+    memset(testReads, 0, sizeof(testReads));
+    SDL_AtomicSet(&testCompleted, 0);
+}
+
+static void waitReads(int count)
+{
+    while (SDL_AtomicGet(&testCompleted) < count)
+    {
+        if (!mt::runPendingJob()) SDL_Delay(1);
+    }
+}
+
+void test_io_read()
+{
+    io::init(2, 64 * TEST_FILE_SIZE);
+    resetReads();
+
+    testReads[0].request = io::read(testSmallFile,   io::PRIORITY_NORMAL, testComplete, &testReads[0]);
+    testReads[1].request = io::read("io_missing.bin", io::PRIORITY_NORMAL, testComplete, &testReads[1]);
+
+    io::wait(testReads[0].request);
+    io::wait(testReads[1].request);
+
+    sput_fail_unless(testReads[0].status == io::STATUS_COMPLETE,              "File is read");
+    sput_fail_unless(testReads[0].size == TEST_FILE_SIZE && testReads[0].valid, "Data of file is complete");
+    sput_fail_unless(testReads[0].mapped,                                     "File in directory is mapped");
+    sput_fail_unless(testReads[1].status == io::STATUS_FAILED && testReads[1].size == 0, "Missing file fails without data");
+    sput_fail_unless(io::isComplete(testReads[0].request),                    "Request is complete after wait");
+    sput_fail_unless(io::getBytesInFlight() == 0,                             "Completed reads are not in flight");
+    sput_fail_unless(core::handle_is_null(io::read(0, io::PRIORITY_NORMAL, testComplete, &testReads[2])), "Null name is rejected");
+
+    io::fini();
+}
+
+void test_io_priorities()
+{
+    io::init(1, 64 * TEST_FILE_SIZE);
+    resetReads();
+    holdJobRing();
+
+    test_read_t* blocker = &testReads[0];
+    test_read_t* low     = &testReads[1];
+    test_read_t* normal  = &testReads[2];
+    test_read_t* high    = &testReads[3];
+
+    blocker->request = io::read(testSmallFile, io::PRIORITY_LOW, testCompleteBlocking, blocker);
+    SDL_SemWait(testEntered);
+
+    // Only I/O thread is busy in completion of blocker
+    low->request    = io::read(testSmallFile, io::PRIORITY_LOW,    testComplete, low);
+    normal->request = io::read(testSmallFile, io::PRIORITY_NORMAL, testComplete, normal);
+    high->request   = io::read(testSmallFile, io::PRIORITY_HIGH,   testComplete, high);
+
+    SDL_SemPost(testRelease);
+    waitReads(4);
+
+    sput_fail_unless(high->order < normal->order && normal->order < low->order, "Requests of higher priority are read first");
+    sput_fail_unless(low->status == io::STATUS_COMPLETE && low->valid,          "Requests of low priority are read");
+
+    releaseJobRing();
+    io::fini();
+}
+
+void test_io_cancellation()
+{
+    io::init(1, 64 * TEST_FILE_SIZE);
+    resetReads();
+    holdJobRing();
+
+    test_read_t* blocker   = &testReads[0];
+    test_read_t* cancelled = &testReads[1];
+    test_read_t* kept      = &testReads[2];
+
+    blocker->request = io::read(testSmallFile, io::PRIORITY_NORMAL, testCompleteBlocking, blocker);
+    SDL_SemWait(testEntered);
+
+    cancelled->request = io::read(testSmallFile, io::PRIORITY_NORMAL, testComplete, cancelled);
+    kept->request      = io::read(testSmallFile, io::PRIORITY_NORMAL, testComplete, kept);
+
+    sput_fail_unless(io::cancel(cancelled->request),                "Queued request is cancelled");
+
+    io::wait(cancelled->request);
+
+    sput_fail_unless(cancelled->status == io::STATUS_CANCELLED && cancelled->size == 0, "Cancelled request is completed without data");
+    sput_fail_unless(!io::cancel(cancelled->request),               "Completed request is not cancelled again");
+    sput_fail_unless(!io::cancel(io::request_t()),                  "Null request is not cancelled");
+
+    SDL_SemPost(testRelease);
+    waitReads(3);
+
+    sput_fail_unless(kept->status == io::STATUS_COMPLETE && kept->valid, "Other requests are read");
+
+    releaseJobRing();
+    io::fini();
+}
+
+void test_io_bytes_in_flight()
+{
+    const size_t maxBytes = 2 * TEST_FILE_SIZE;
+
+    io::init(1, maxBytes);
+    resetReads();
+    holdJobRing();
+
+    for (int i = 0; i < 8; ++i)
+    {
+        testReads[i].request = io::read(testSmallFile, io::PRIORITY_NORMAL, testComplete, &testReads[i]);
+    }
+    testReads[8].request = io::read(testLargeFile, io::PRIORITY_LOW, testComplete, &testReads[8]);
+
+    waitReads(9);
+
+    size_t maxObserved = 0;
+    bool   allRead     = true;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        maxObserved = core::max(maxObserved, testReads[i].bytesInFlight);
+        allRead     = allRead && testReads[i].status == io::STATUS_COMPLETE && testReads[i].valid;
+    }
+
+    sput_fail_unless(allRead,                                  "All files are read");
+    sput_fail_unless(maxObserved <= maxBytes,                  "Bytes in flight do not exceed limit");
+    sput_fail_unless(testReads[8].status == io::STATUS_COMPLETE && testReads[8].size == 3 * TEST_FILE_SIZE, "File bigger than limit is read");
+    sput_fail_unless(testReads[8].bytesInFlight == 3 * TEST_FILE_SIZE, "File bigger than limit is read alone");
+    sput_fail_unless(io::getBytesInFlight() == 0,              "Completed reads release bytes in flight");
+
+    releaseJobRing();
+    io::fini();
+}
+
+void test_io_completion_fallback()
+{
+    io::init(1, 64 * TEST_FILE_SIZE);
+    resetReads();
+    holdJobRing();
+
+    testReads[0].request = io::read(testSmallFile, io::PRIORITY_NORMAL, testComplete, &testReads[0]);
+
+    io::wait(testReads[0].request);
+
+    sput_fail_unless(testReads[0].status == io::STATUS_COMPLETE && testReads[0].valid, "Read is completed without free job slots");
+    sput_fail_unless(testReads[0].worker == -1,                                         "Completion is run by I/O thread");
+
+    releaseJobRing();
+    io::fini();
+}
+
+int run_io_tests()
+{
+    core::init();
+
+    // Tests use own configurations of I/O service
+    io::fini();
+
+    bool ownPhysFS = !PHYSFS_isInit();
+    if (ownPhysFS) PHYSFS_init(0);
+
+    const char* dir = PHYSFS_getBaseDir();
+
+    PHYSFS_setWriteDir(dir);
+    PHYSFS_mount(dir, 0, 1);
+
+    testEntered = SDL_CreateSemaphore(0);
+    testRelease = SDL_CreateSemaphore(0);
+
+    sput_start_testing();
+
+    if (writeTestFile(testSmallFile, TEST_FILE_SIZE) && writeTestFile(testLargeFile, 3 * TEST_FILE_SIZE))
+    {
+        sput_enter_suite("CORE io: read");
+        sput_run_test(test_io_read);
+        sput_enter_suite("CORE io: priorities");
+        sput_run_test(test_io_priorities);
+        sput_enter_suite("CORE io: cancellation");
+        sput_run_test(test_io_cancellation);
+        sput_enter_suite("CORE io: bytes in flight");
+        sput_run_test(test_io_bytes_in_flight);
+        sput_enter_suite("CORE io: completion without job slots");
+        sput_run_test(test_io_completion_fallback);
+    }
+    else
+    {
+        sput_enter_suite("CORE io: test files");
+        sput_fail_unless(false, "Test files are written");
+    }
+
+    sput_finish_testing();
+
+    PHYSFS_delete(testSmallFile);
+    PHYSFS_delete(testLargeFile);
+    PHYSFS_removeFromSearchPath(dir);
+
+    if (ownPhysFS) PHYSFS_deinit();
+
+    SDL_DestroySemaphore(testRelease);
+    SDL_DestroySemaphore(testEntered);
+
+    core::fini();
+
+    return sput_get_return_value();
+}
@@ -6,6 +6,18 @@ int run_etlsf_tests();
 int run_math_tests();
 int run_bit_tests();
 int run_cstr_tests();
+int run_mt_tests();
+int run_profiler_tests();
+int run_mem_tests();
+int run_handle_pool_tests();
+int run_mjson_tests();
+int run_io_tests();
+
+int run_cstr_bench();
+int run_mt_bench();
+int run_mem_bench();
+int run_etlsf_bench();
+int run_mjson_bench();
 
 extern "C" int assert_handler(const char* cond, const char* file, int line) { return true; }
 
@@ -18,6 +30,25 @@ int main(int argc, char **argv)
     res |= run_math_tests();
     res |= run_vg_tests();
     res |= run_cstr_tests();
+    res |= run_mt_tests();
+    res |= run_profiler_tests();
+    res |= run_mem_tests();
+    res |= run_handle_pool_tests();
+    res |= run_mjson_tests();
+    res |= run_io_tests();
+
+    // Benchmarks are slow, run them only on request
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-bench") == 0)
+        {
+            run_cstr_bench();
+            run_mt_bench();
+            run_mem_bench();
+            run_etlsf_bench();
+            run_mjson_bench();
+        }
+    }
 
     return res;
 }
\ No newline at end of file
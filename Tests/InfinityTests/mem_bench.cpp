@@ -0,0 +1,267 @@
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+#include <stdio.h>
+#include <string.h>
+
+enum mem_bench_private
+{
+    BENCH_BYTES    = 256 << 20,     //Bytes processed per measurement
+    BENCH_MAX_SIZE = 16 << 20,
+    BENCH_ALIGN    = 64,
+};
+
+static const size_t benchSizes[] = {
+    8, 16, 24, 48, 64, 100, 256, 1024, 4096, 16384, 65536, 256*1024, 1 << 20, 4 << 20, BENCH_MAX_SIZE
+};
+
+// Source and destination offsets from cache line
+static const size_t benchOffsets[][2] = {
+    {0, 0}, {1, 0}, {0, 3}, {7, 13}
+};
+
+enum mem_cache_bench_private
+{
+    BENCH_CACHE_OPERATIONS = 1 << 21,   //Per thread
+    BENCH_CACHE_SLOTS      = 1024,      //Live blocks per thread
+    BENCH_CACHE_SHARED     = 4096,      //Slots shared by threads, blocks are freed by other threads
+    BENCH_CACHE_MAX_SIZE   = 512,
+};
+
+enum mem_bench_op
+{
+    BENCH_OP_COPY,
+    BENCH_OP_STREAM,
+    BENCH_OP_SET,
+};
+
+static const char* isaNames[] = {"scalar", "sse2", "avx2"};
+
+// Returns throughput in GB/s
+static double benchRun(mem_bench_op op, bool libc, uint8_t* dst, const uint8_t* src, size_t size)
+{
+    size_t iterations = core::max<size_t>(BENCH_BYTES / size, 1);
+
+    uint64_t start = SDL_GetPerformanceCounter();
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        switch (op)
+        {
+        case BENCH_OP_COPY:
+        case BENCH_OP_STREAM:
+            if (libc)                       memcpy(dst, src, size);
+            else if (op == BENCH_OP_COPY)   mem_copy(dst, src, size);
+            else                            mem_copy_stream(dst, src, size);
+            break;
+        case BENCH_OP_SET:
+            if (libc)   memset(dst, (int)i, size);
+            else        mem_set(dst, size, (uint8_t)i);
+            break;
+        }
+    }
+
+    uint64_t ticks   = SDL_GetPerformanceCounter() - start;
+    double   seconds = double(ticks ? ticks : 1) / double(SDL_GetPerformanceFrequency());
+
+    return double(iterations) * double(size) / seconds / 1e9;
+}
+
+static void benchOp(mem_bench_op op, const char* name, uint8_t* dst, const uint8_t* src)
+{
+    int supported = mem_utils_select_isa(-1);
+
+    printf("\n%s, GB/s\n", name);
+    printf("%10s %8s %8s", "size", "offsets", "libc");
+    for (int isa = MEM_ISA_SCALAR; isa <= supported; ++isa)
+    {
+        printf(" %8s", isaNames[isa]);
+    }
+    printf("\n");
+
+    for (size_t s = 0; s < ARRAY_SIZE(benchSizes); ++s)
+    {
+        for (size_t o = 0; o < ARRAY_SIZE(benchOffsets); ++o)
+        {
+            size_t         size = benchSizes[s];
+            uint8_t*       d    = dst + benchOffsets[o][1];
+            const uint8_t* sp   = src + benchOffsets[o][0];
+
+            printf("%10llu %4llu/%-3llu %8.2f", (unsigned long long)size,
+                   (unsigned long long)benchOffsets[o][0], (unsigned long long)benchOffsets[o][1],
+                   benchRun(op, true, d, sp, size));
+
+            for (int isa = MEM_ISA_SCALAR; isa <= supported; ++isa)
+            {
+                mem_utils_select_isa(isa);
+                printf(" %8.2f", benchRun(op, false, d, sp, size));
+            }
+
+            printf("\n");
+        }
+    }
+
+    mem_utils_select_isa(-1);
+}
+
+struct cache_bench_t
+{
+    mspace_t     mspace;
+    mem_cache_t  cache;     //Locked mspace path if 0
+    SDL_atomic_t ready;
+    SDL_atomic_t go;
+    void*        shared[BENCH_CACHE_SHARED];
+};
+
+struct cache_bench_thread_t
+{
+    cache_bench_t* bench;
+    uint32_t       seed;
+    void*          slots[BENCH_CACHE_SLOTS];
+};
+
+// Block size is stored in block, so other threads can free it
+static void* cacheBenchAlloc(cache_bench_t* bench, uint32_t size)
+{
+    uint32_t* block = (uint32_t*)(bench->cache ? mem_cache_alloc(bench->cache, size) : mem_alloc(bench->mspace, size, 0));
+    *block = size;
+    return block;
+}
+
+static void cacheBenchFree(cache_bench_t* bench, void* block)
+{
+    if (!block) return;
+
+    if (bench->cache)   mem_cache_free(bench->cache, block, *(uint32_t*)block);
+    else                mem_free(bench->mspace, block);
+}
+
+static int cacheBenchThread(void* arg)
+{
+    cache_bench_thread_t* thread = (cache_bench_thread_t*)arg;
+    cache_bench_t*        bench  = thread->bench;
+    uint32_t              seed   = thread->seed;
+
+    SDL_AtomicAdd(&bench->ready, 1);
+    while (!SDL_AtomicGet(&bench->go));
+
+    for (size_t i = 0; i < BENCH_CACHE_OPERATIONS; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+
+        void*  block = (seed >> 28) & 1 ? cacheBenchAlloc(bench, 4 + (seed >> 8) % BENCH_CACHE_MAX_SIZE) : 0;
+        void** slot  = (seed >> 29) == 0 ? &bench->shared[(seed >> 4) % BENCH_CACHE_SHARED]
+                                         : &thread->slots[(seed >> 4) % BENCH_CACHE_SLOTS];
+
+        cacheBenchFree(bench, SDL_AtomicSetPtr(slot, block));
+    }
+
+    for (size_t i = 0; i < BENCH_CACHE_SLOTS; ++i)
+    {
+        cacheBenchFree(bench, thread->slots[i]);
+        thread->slots[i] = 0;
+    }
+
+    if (bench->cache)
+    {
+        mem_cache_flush(bench->cache);
+    }
+
+    return 0;
+}
+
+// Returns millions of operations per second of all threads
+static double benchCacheRun(cache_bench_t* bench, cache_bench_thread_t* threads, int numThreads)
+{
+    SDL_Thread* handles[MEM_CACHE_MAX_THREADS];
+
+    SDL_AtomicSet(&bench->ready, 0);
+    SDL_AtomicSet(&bench->go, 0);
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        threads[i].bench = bench;
+        threads[i].seed  = i + 1;
+        handles[i] = SDL_CreateThread(cacheBenchThread, "mem cache bench", &threads[i]);
+    }
+
+    while (SDL_AtomicGet(&bench->ready) != numThreads);
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&bench->go, 1);
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        SDL_WaitThread(handles[i], 0);
+    }
+
+    uint64_t ticks   = SDL_GetPerformanceCounter() - start;
+    double   seconds = double(ticks ? ticks : 1) / double(SDL_GetPerformanceFrequency());
+
+    for (size_t i = 0; i < BENCH_CACHE_SHARED; ++i)
+    {
+        cacheBenchFree(bench, bench->shared[i]);
+        bench->shared[i] = 0;
+    }
+
+    return double(numThreads) * BENCH_CACHE_OPERATIONS / seconds / 1e6;
+}
+
+// Mixed alloc/free of 1 to number of CPU cores threads, 1/8 of blocks are freed by other threads
+static void benchCache()
+{
+    int maxThreads = core::min(SDL_GetCPUCount(), MEM_CACHE_MAX_THREADS);
+
+    cache_bench_t*        bench   = (cache_bench_t*)calloc(1, sizeof(cache_bench_t));
+    cache_bench_thread_t* threads = (cache_bench_thread_t*)calloc(maxThreads, sizeof(cache_bench_thread_t));
+
+    printf("\nmem_cache vs locked mspace, %d operations per thread, Mops/s\n", BENCH_CACHE_OPERATIONS);
+    printf("%8s %10s %10s %8s\n", "threads", "locked", "cache", "speedup");
+
+    for (int numThreads = 1; numThreads <= maxThreads; ++numThreads)
+    {
+        bench->mspace = mem_create_space(0);
+        bench->cache  = 0;
+
+        double locked = benchCacheRun(bench, threads, numThreads);
+
+        bench->cache = mem_create_cache(bench->mspace, MEM_TAG_UNTAGGED);
+
+        double cached = benchCacheRun(bench, threads, numThreads);
+
+        mem_destroy_cache(bench->cache);
+        mem_destroy_space(bench->mspace);
+
+        printf("%8d %10.2f %10.2f %8.2f\n", numThreads, locked, cached, cached / locked);
+    }
+
+    free(threads);
+    free(bench);
+}
+
+// mem_copy, mem_copy_stream and mem_set of every supported instruction set against libc,
+// thread cache of mspace against locked mspace
+int run_mem_bench()
+{
+    uint8_t* src = (uint8_t*)malloc(BENCH_MAX_SIZE + BENCH_ALIGN*2);
+    uint8_t* dst = (uint8_t*)malloc(BENCH_MAX_SIZE + BENCH_ALIGN*2);
+
+    uint8_t* alignedSrc = (uint8_t*)(((uintptr_t)src + BENCH_ALIGN - 1) & ~(uintptr_t)(BENCH_ALIGN - 1));
+    uint8_t* alignedDst = (uint8_t*)(((uintptr_t)dst + BENCH_ALIGN - 1) & ~(uintptr_t)(BENCH_ALIGN - 1));
+
+    memset(src, 0x5A, BENCH_MAX_SIZE + BENCH_ALIGN*2);
+    memset(dst, 0, BENCH_MAX_SIZE + BENCH_ALIGN*2);
+
+    printf("\nmem_* vs libc, %d MB per measurement\n", BENCH_BYTES >> 20);
+
+    benchOp(BENCH_OP_COPY,   "mem_copy",        alignedDst, alignedSrc);
+    benchOp(BENCH_OP_STREAM, "mem_copy_stream", alignedDst, alignedSrc);
+    benchOp(BENCH_OP_SET,    "mem_set",         alignedDst, alignedSrc);
+
+    benchCache();
+
+    free(dst);
+    free(src);
+
+    return 0;
+}
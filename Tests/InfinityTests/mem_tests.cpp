@@ -0,0 +1,431 @@
+#include <sput.h>
+
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+#include <string.h>
+
+enum mem_tests_private
+{
+    TEST_MAX_SIZE   = 40000,    //Above stream threshold
+    TEST_MAX_OFFSET = 33,
+    TEST_BUF_SIZE   = TEST_MAX_SIZE + 2*TEST_MAX_OFFSET + 64,
+};
+
+static const size_t testSizes[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+    100, 127, 128, 129, 255, 256, 257, 1000, 4095, 4096, 16383, 16384, 16385, TEST_MAX_SIZE
+};
+
+// Bytes around tested region that have to stay intact
+static size_t testSpan(size_t size)
+{
+    return size + 2*TEST_MAX_OFFSET + 64;
+}
+
+static uint8_t* testSrc;
+static uint8_t* testDst;
+static uint8_t* testRef;
+
+static void fillPattern(uint8_t* buf, size_t size, uint32_t seed)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+static bool checkCopy(void (*copy)(void*, const void*, size_t))
+{
+    for (size_t s = 0; s < ARRAY_SIZE(testSizes); ++s)
+    {
+        size_t size = testSizes[s];
+        size_t span = testSpan(size);
+
+        for (size_t srcOffset = 0; srcOffset < TEST_MAX_OFFSET; srcOffset += size > 1000 ? 7 : 1)
+        {
+            for (size_t dstOffset = 0; dstOffset < TEST_MAX_OFFSET; dstOffset += size > 1000 ? 5 : 1)
+            {
+                fillPattern(testSrc, span, (uint32_t)(size + srcOffset));
+                fillPattern(testDst, span, (uint32_t)dstOffset);
+                memcpy(testRef, testDst, span);
+                memcpy(testRef + dstOffset, testSrc + srcOffset, size);
+
+                copy(testDst + dstOffset, testSrc + srcOffset, size);
+
+                if (memcmp(testDst, testRef, span) != 0) return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool checkOverlappingMove()
+{
+    for (size_t s = 0; s < ARRAY_SIZE(testSizes); ++s)
+    {
+        size_t size = testSizes[s];
+        size_t span = testSpan(size);
+
+        for (int shift = -TEST_MAX_OFFSET; shift <= TEST_MAX_OFFSET; ++shift)
+        {
+            uint8_t* src = testDst + TEST_MAX_OFFSET;
+
+            fillPattern(testDst, span, (uint32_t)(size + shift));
+            memcpy(testRef, testDst, span);
+            memmove(testRef + TEST_MAX_OFFSET + shift, testRef + TEST_MAX_OFFSET, size);
+
+            mem_move(src + shift, src, size);
+
+            if (memcmp(testDst, testRef, span) != 0) return false;
+        }
+    }
+
+    return true;
+}
+
+static bool checkSet()
+{
+    for (size_t s = 0; s < ARRAY_SIZE(testSizes); ++s)
+    {
+        size_t size = testSizes[s];
+        size_t span = testSpan(size);
+
+        for (size_t offset = 0; offset < TEST_MAX_OFFSET; offset += size > 1000 ? 3 : 1)
+        {
+            fillPattern(testDst, span, (uint32_t)size);
+            memcpy(testRef, testDst, span);
+            memset(testRef + offset, 0xA5, size);
+
+            mem_set(testDst + offset, size, 0xA5);
+
+            if (memcmp(testDst, testRef, span) != 0) return false;
+        }
+    }
+
+    return true;
+}
+
+static bool checkSetElements()
+{
+    for (size_t s = 0; s < ARRAY_SIZE(testSizes); ++s)
+    {
+        size_t count = testSizes[s] / 4;
+
+        for (size_t offset = 0; offset < TEST_MAX_OFFSET; offset += 4)
+        {
+            uint16_t* dst16 = (uint16_t*)(testDst + offset);
+            uint32_t* dst32 = (uint32_t*)(testDst + offset);
+
+            fillPattern(testDst, testSpan(count*4), (uint32_t)count);
+            uint16_t guard16 = dst16[count];
+            mem_set16(dst16, count, 0x1234);
+            if (dst16[count] != guard16) return false;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (dst16[i] != 0x1234) return false;
+            }
+
+            fillPattern(testDst, testSpan(count*4), (uint32_t)count);
+            uint32_t guard32 = dst32[count];
+            mem_set32(dst32, count, 0x89ABCDEF);
+            if (dst32[count] != guard32) return false;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (dst32[i] != 0x89ABCDEF) return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void copyStream(void* dest, const void* src, size_t len)
+{
+    mem_copy_stream(dest, src, len);
+}
+
+void test_mem_functions()
+{
+    int supported = mem_utils_select_isa(-1);
+
+    for (int isa = MEM_ISA_SCALAR; isa <= supported; ++isa)
+    {
+        sput_fail_unless(mem_utils_select_isa(isa) == isa, "Instruction set is selected");
+
+        sput_fail_unless(checkCopy(mem_copy),       "mem_copy matches memcpy for sizes and alignments");
+        sput_fail_unless(checkCopy(copyStream),     "mem_copy_stream matches memcpy for sizes and alignments");
+        sput_fail_unless(checkOverlappingMove(),    "mem_move matches memmove for overlapping regions");
+        sput_fail_unless(checkSet(),                "mem_set matches memset for sizes and alignments");
+        sput_fail_unless(checkSetElements(),        "mem_set16/mem_set32 fill elements");
+    }
+
+    mem_utils_select_isa(-1);
+}
+
+void test_mem_elements()
+{
+    uint16_t src16[37], dst16[37];
+    uint32_t src32[37], dst32[37];
+
+    for (uint16_t i = 0; i < 37; ++i)
+    {
+        src16[i] = i + 1;
+        src32[i] = i + 0x10000;
+        dst16[i] = 0;
+        dst32[i] = 0;
+    }
+
+    mem_copy16(dst16, src16, 37);
+    mem_copy32(dst32, src32, 37);
+
+    sput_fail_unless(memcmp(dst16, src16, sizeof(src16)) == 0, "mem_copy16 copies from source");
+    sput_fail_unless(memcmp(dst32, src32, sizeof(src32)) == 0, "mem_copy32 copies whole elements");
+
+    mem_move16(src16 + 1, src16, 36);
+    sput_fail_unless(src16[0] == 1 && src16[1] == 1 && src16[36] == 36, "mem_move16 handles overlap");
+}
+
+enum mem_cache_tests_private
+{
+    TEST_CACHE_BLOCKS = 100,
+};
+
+static mem_cache_t testCache;
+static void*       testCacheBlocks[TEST_CACHE_BLOCKS];
+
+static int freeCacheBlocks(void*)
+{
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        mem_cache_free(testCache, testCacheBlocks[i], 64);
+    }
+
+    mem_cache_flush(testCache);
+
+    return 0;
+}
+
+static int allocCacheBlocks(void*)
+{
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        testCacheBlocks[i] = mem_cache_alloc(testCache, 64);
+    }
+
+    mem_cache_flush(testCache);
+
+    return 0;
+}
+
+void test_mem_cache()
+{
+    mspace_t space = mem_create_space(1 << 20);
+    testCache = mem_create_cache(space, MEM_TAG_UNTAGGED);
+
+    void* blocks[MEM_CACHE_MAX_SIZE + 2];
+    bool  aligned = true;
+    bool  intact  = true;
+
+    // Every size of small classes and one large block
+    for (size_t size = 0; size <= MEM_CACHE_MAX_SIZE + 1; ++size)
+    {
+        size_t blockSize = size > MEM_CACHE_MAX_SIZE ? 5000 : size;
+
+        blocks[size] = mem_cache_alloc(testCache, blockSize);
+        aligned = aligned && ((uintptr_t)blocks[size] & 15) == 0;
+        memset(blocks[size], (int)size, blockSize);
+    }
+
+    for (size_t size = 0; size <= MEM_CACHE_MAX_SIZE + 1; ++size)
+    {
+        size_t   blockSize = size > MEM_CACHE_MAX_SIZE ? 5000 : size;
+        uint8_t* block     = (uint8_t*)blocks[size];
+
+        for (size_t i = 0; i < blockSize; ++i)
+        {
+            intact = intact && block[i] == (uint8_t)size;
+        }
+
+        mem_cache_free(testCache, block, blockSize);
+    }
+
+    sput_fail_unless(aligned,   "Blocks are 16 bytes aligned");
+    sput_fail_unless(intact,    "Blocks do not overlap");
+
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        testCacheBlocks[i] = mem_cache_alloc(testCache, 64);
+    }
+
+    SDL_Thread* thread = SDL_CreateThread(freeCacheBlocks, "mem cache test", 0);
+    SDL_WaitThread(thread, 0);
+
+    size_t reused = 0;
+
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        void* block = mem_cache_alloc(testCache, 64);
+
+        for (size_t j = 0; j < TEST_CACHE_BLOCKS; ++j)
+        {
+            reused += block == testCacheBlocks[j];
+        }
+
+        blocks[i] = block;
+    }
+
+    sput_fail_unless(reused >= TEST_CACHE_BLOCKS/2, "Blocks freed by other thread are reused by owner");
+
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        mem_cache_free(testCache, blocks[i], 64);
+    }
+
+    mem_cache_flush(testCache);
+    mem_destroy_cache(testCache);
+
+    // Spans are carved by other thread, it flushes before its blocks are freed here
+    testCache = mem_create_cache(space, MEM_TAG_UNTAGGED);
+
+    void* first = mem_cache_alloc(testCache, 16);
+
+    thread = SDL_CreateThread(allocCacheBlocks, "mem cache test", 0);
+    SDL_WaitThread(thread, 0);
+
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        mem_cache_free(testCache, testCacheBlocks[i], 64);
+    }
+
+    reused = 0;
+
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        void* block = mem_cache_alloc(testCache, 64);
+
+        for (size_t j = 0; j < TEST_CACHE_BLOCKS; ++j)
+        {
+            reused += block == testCacheBlocks[j];
+        }
+
+        blocks[i] = block;
+    }
+
+    sput_fail_unless(reused == TEST_CACHE_BLOCKS, "Blocks freed after owner flushed are reused");
+
+    for (size_t i = 0; i < TEST_CACHE_BLOCKS; ++i)
+    {
+        mem_cache_free(testCache, blocks[i], 64);
+    }
+
+    mem_cache_free(testCache, first, 16);
+    mem_cache_flush(testCache);
+    mem_destroy_cache(testCache);
+
+    mem_destroy_space(space);
+}
+
+#ifdef CORE_ENABLE_MEM_TAGS
+void test_mem_tags()
+{
+    mspace_t        spaceA = mem_create_space(1 << 20);
+    mspace_t        spaceB = mem_create_space(1 << 20);
+    mem_tag_t       tag    = mem_register_tag("test");
+    mem_tag_stats_t stats[MEM_MAX_TAGS];
+
+    sput_fail_unless(tag != MEM_TAG_UNTAGGED,           "Tag is registered");
+    sput_fail_unless(mem_register_tag("test") == tag,   "Same name returns same tag");
+
+    mem_tags_frame_begin();
+
+    sput_fail_unless(mem_tags_snapshot(stats, MEM_MAX_TAGS) > tag, "Snapshot includes registered tag");
+
+    int64_t live = stats[tag].liveBytes;
+
+    void* a = mem_alloc_tagged(spaceA, 100, 0, tag);
+    void* b = mem_alloc_tagged(spaceB, 1000, 64, tag);
+    void* c = mem_alloc(spaceA, 500, 0);
+
+    sput_fail_unless(((uintptr_t)b & 63) == 0, "Tagged block keeps alignment");
+
+    mem_tags_snapshot(stats, MEM_MAX_TAGS);
+    sput_fail_unless(stats[tag].liveBytes == live + 1100,   "Live bytes are summed across mspaces");
+    sput_fail_unless(stats[tag].liveCount == 2,             "Live blocks are counted");
+
+    a = mem_realloc(spaceA, a, 300, 0);
+    mem_free(spaceB, b);
+
+    mem_tags_snapshot(stats, MEM_MAX_TAGS);
+    sput_fail_unless(stats[tag].liveBytes == live + 300,    "Realloc and free update live bytes");
+    sput_fail_unless(stats[tag].peakBytes >= live + 1200,   "Peak keeps maximum of live bytes");
+    sput_fail_unless(stats[tag].frameBytes == 0,            "Frame values are taken on frame begin");
+
+    mem_tags_frame_begin();
+
+    mem_tags_snapshot(stats, MEM_MAX_TAGS);
+    sput_fail_unless(stats[tag].frameAllocs == 3,           "Allocations of last frame are counted");
+    sput_fail_unless(stats[tag].frameBytes == 1400,         "Bytes of last frame are counted");
+
+    sput_fail_unless(mem_tags_report_leaks() >= 2,          "Live blocks are reported as leaks");
+
+    mem_free(spaceA, a);
+    mem_free(spaceA, c);
+
+    mem_tags_snapshot(stats, MEM_MAX_TAGS);
+    sput_fail_unless(stats[tag].liveCount == 0 && stats[tag].liveBytes == live, "Freed blocks are not live");
+
+    mem_destroy_space(spaceB);
+    mem_destroy_space(spaceA);
+}
+
+void test_mem_tags_destroyed_space()
+{
+    mspace_t        space = mem_create_space(1 << 20);
+    mem_tag_t       tag   = mem_register_tag("test destroyed space");
+    mem_tag_stats_t stats[MEM_MAX_TAGS];
+
+    mem_alloc_tagged(space, 100, 0, tag);
+    mem_alloc_tagged(space, 200, 64, tag);
+
+    mem_tags_snapshot(stats, MEM_MAX_TAGS);
+    sput_fail_unless(stats[tag].liveCount == 2 && stats[tag].liveBytes == 300, "Blocks of mspace are live");
+
+    mem_destroy_space(space);
+
+    mem_tags_snapshot(stats, MEM_MAX_TAGS);
+    sput_fail_unless(stats[tag].liveCount == 0 && stats[tag].liveBytes == 0, "Blocks released with mspace are not live");
+    sput_fail_unless(stats[tag].peakBytes == 300, "Peak is kept after mspace is destroyed");
+}
+#endif
+
+int run_mem_tests()
+{
+    testSrc = (uint8_t*)malloc(TEST_BUF_SIZE);
+    testDst = (uint8_t*)malloc(TEST_BUF_SIZE);
+    testRef = (uint8_t*)malloc(TEST_BUF_SIZE);
+
+    sput_start_testing();
+
+    sput_enter_suite("CORE mem: copy, move and set against libc");
+    sput_run_test(test_mem_functions);
+    sput_enter_suite("CORE mem: element functions");
+    sput_run_test(test_mem_elements);
+    sput_enter_suite("CORE mem: thread cache");
+    sput_run_test(test_mem_cache);
+#ifdef CORE_ENABLE_MEM_TAGS
+    sput_enter_suite("CORE mem: allocation tags");
+    sput_run_test(test_mem_tags);
+    sput_run_test(test_mem_tags_destroyed_space);
+#endif
+
+    sput_finish_testing();
+
+    free(testRef);
+    free(testDst);
+    free(testSrc);
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,236 @@
+#include <SDL2/SDL.h>
+#include <core/core.h>
+#include <mjson.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum mjson_bench_private
+{
+    BENCH_KEYS    = 10000,
+    BENCH_LOOKUPS = 1 << 20,
+};
+
+static char benchKeys[BENCH_KEYS][16];
+
+static const size_t BENCH_TEXT_SIZE = 16 * 1024 * 1024;
+
+static uint32_t benchSeed = 1;
+
+static uint32_t benchRandom(uint32_t range)
+{
+    benchSeed = benchSeed * 1664525u + 1013904223u;
+    return (benchSeed >> 8) % range;
+}
+
+// Mesh data: indented arrays of numbers
+static size_t generateMesh(char* text, size_t capacity)
+{
+    size_t len = 0;
+
+    len += sprintf(text + len, "// generated mesh\nmeshes = [\n");
+
+    while (len + 4096 < capacity)
+    {
+        len += sprintf(text + len, "    {\n        name = \"mesh_%u\"\n        positions = [\n", benchRandom(100000));
+
+        for (int v = 0; v < 32; ++v)
+        {
+            len += sprintf(text + len, "            %d.%03u, %d.%03u, -%d.%03u\n",
+                           1 + benchRandom(100), benchRandom(1000), 1 + benchRandom(100), benchRandom(1000), 1 + benchRandom(100), benchRandom(1000));
+        }
+
+        len += sprintf(text + len, "        ]\n        indices = [ ");
+
+        for (int i = 0; i < 48; ++i)
+        {
+            len += sprintf(text + len, "%u ", 1 + benchRandom(65535));
+        }
+
+        len += sprintf(text + len, "]\n    }\n");
+    }
+
+    len += sprintf(text + len, "]\n");
+
+    return len;
+}
+
+// Configuration data: keys, long strings and comments
+static size_t generateConfig(char* text, size_t capacity)
+{
+    static const char* const words[] = { "texture", "shader", "material", "sampler", "diffuse", "normal", "specular", "level" };
+
+    size_t len = 0;
+
+    while (len + 4096 < capacity)
+    {
+        len += sprintf(text + len, "/*\n * section %u\n * settings are generated for lexer benchmark\n */\nsection_%u = {\n",
+                       benchRandom(100000), benchRandom(100000));
+
+        for (int i = 0; i < 16; ++i)
+        {
+            len += sprintf(text + len, "    \"%s_%u\": \"data/%s/%s_%u.%s\"    // %s\n",
+                           words[benchRandom(8)], i, words[benchRandom(8)], words[benchRandom(8)], benchRandom(1000),
+                           words[benchRandom(8)], words[benchRandom(8)]);
+        }
+
+        len += sprintf(text + len, "}\n\n");
+    }
+
+    return len;
+}
+
+// Best of several runs, MB/s of source text
+static double benchLexer(const char* text, size_t len, uint8_t* storage, size_t storageSize, bool fullParse)
+{
+    double best = 0.0;
+
+    for (int run = 0; run < 5; ++run)
+    {
+        mjson_element_t root;
+
+        uint64_t start = SDL_GetPerformanceCounter();
+
+        if (fullParse)
+            mjson_parse(text, len, storage, storageSize, &root);
+        else
+            mjson_parse_size(text, len);
+
+        double seconds = double(SDL_GetPerformanceCounter() - start) / double(SDL_GetPerformanceFrequency());
+
+        best = core::max(best, double(len) / (1024.0 * 1024.0) / seconds);
+    }
+
+    return best;
+}
+
+// Lexer only (sizing pass) and full parse of generated documents with every supported lexer
+static void benchLexers()
+{
+    static const char* const lexerNames[] = { "re2c", "scalar", "SSE2", "AVX2" };
+
+    char* text = (char*)malloc(BENCH_TEXT_SIZE + 1);
+
+    printf("\nmjson lexers, %u Mb documents\n", uint32_t(BENCH_TEXT_SIZE >> 20));
+    printf("%-10s %-8s %12s %12s\n", "document", "lexer", "lex, MB/s", "parse, MB/s");
+
+    for (int doc = 0; doc < 2; ++doc)
+    {
+        benchSeed = 1;
+
+        size_t len = doc == 0 ? generateMesh(text, BENCH_TEXT_SIZE) : generateConfig(text, BENCH_TEXT_SIZE);
+        text[len] = 0;  // Numbers are read with sscanf
+
+        size_t   storageSize = mjson_parse_size(text, len);
+        uint8_t* storage     = (uint8_t*)malloc(storageSize);
+
+        mjson_element_t root;
+
+        if (!mjson_parse(text, len, storage, storageSize, &root))
+        {
+            printf("mjson: failed to parse generated document\n");
+        }
+
+        int best = mjson_select_lexer(-1);
+
+        for (int lexer = MJSON_LEXER_RE2C; lexer <= best; ++lexer)
+        {
+            mjson_select_lexer(lexer);
+
+            double lexMBs   = benchLexer(text, len, storage, storageSize, false);
+            double parseMBs = benchLexer(text, len, storage, storageSize, true);
+
+            printf("%-10s %-8s %12.1f %12.1f\n", doc == 0 ? "mesh" : "config", lexerNames[lexer], lexMBs, parseMBs);
+        }
+
+        mjson_select_lexer(-1);
+
+        free(storage);
+    }
+
+    free(text);
+}
+
+// Second word of BJSON entry is size of dictionary data
+static uint32_t dictSize(mjson_element_t dict)
+{
+    return ((const uint32_t*)dict)[1];
+}
+
+static double benchLookups(mjson_element_t dict, uint32_t numLookups, int64_t* sum)
+{
+    uint32_t seed = 1;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+
+    for (uint32_t i = 0; i < numLookups; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        *sum += mjson_get_int(mjson_get_member(dict, benchKeys[(seed >> 8) % BENCH_KEYS]), 0);
+    }
+
+    uint64_t ticks = SDL_GetPerformanceCounter() - start;
+
+    return double(ticks) * 1e9 / double(SDL_GetPerformanceFrequency()) / numLookups;
+}
+
+// Random member lookups in 10k keys dictionary, linear search against hash index,
+// lexer throughput on large generated documents
+int run_mjson_bench()
+{
+    benchLexers();
+
+    size_t textSize = BENCH_KEYS * 32;
+    char*  text     = (char*)malloc(textSize);
+    size_t len      = 0;
+
+    for (int i = 0; i < BENCH_KEYS; ++i)
+    {
+        sprintf(benchKeys[i], "member_%d", i);
+        len += sprintf(text + len, "%s = %d\n", benchKeys[i], i);
+    }
+
+    size_t   bufSize = 1 << 20;
+    uint8_t* parsed  = (uint8_t*)malloc(bufSize);
+    uint8_t* indexed = (uint8_t*)malloc(bufSize);
+
+    mjson_element_t root, top;
+
+    int result = mjson_parse(text, len, parsed, bufSize, &root);
+    result    &= mjson_build_index(root, indexed, bufSize, &top);
+
+    if (!result)
+    {
+        printf("\nmjson: failed to parse benchmark data\n");
+        return 1;
+    }
+
+    int64_t linearSum = 0, indexedSum = 0;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    mjson_build_index(root, indexed, bufSize, &top);
+    double buildMs = double(SDL_GetPerformanceCounter() - start) * 1e3 / double(SDL_GetPerformanceFrequency());
+
+    // Linear search is slow, it gets fewer lookups
+    double linearNs  = benchLookups(root, BENCH_LOOKUPS / 256, &linearSum);
+    double indexedNs = benchLookups(top,  BENCH_LOOKUPS / 256, &indexedSum);
+
+    if (linearSum != indexedSum)
+    {
+        printf("\nmjson: indexed lookups do not match linear search\n");
+    }
+
+    indexedNs = benchLookups(top, BENCH_LOOKUPS, &indexedSum);
+
+    printf("\nmjson, %d keys dictionary\n", BENCH_KEYS);
+    printf("%-26s %10s %12s\n", "lookup", "ns/op", "storage, Kb");
+    printf("%-26s %10.1f %12.1f\n", "linear", linearNs, double(dictSize(root)) / 1024.0);
+    printf("%-26s %10.1f %12.1f\n", "hash index", indexedNs, double(dictSize(top)) / 1024.0);
+    printf("index build %.2f ms\n", buildMs);
+
+    free(indexed);
+    free(parsed);
+    free(text);
+
+    return 0;
+}
@@ -0,0 +1,399 @@
+#include <sput.h>
+
+#include <core/core.h>
+#include <mjson.h>
+
+static const char test_dict[] =
+    "a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7, h = 8, ab = 9, a = 10\n"
+    "nested = { x = 1, y = 2, z = 3, w = 4, u = 5, v = 6, s = 7, t = 8 }\n"
+    "small = { only = \"value\" }\n"
+    "list = [ { p = 1, q = 2, r = 3, s = 4, t = 5, u = 6, v = 7, w = 8 }, \"tail\" ]\n";
+
+static const char test_escaped[] =
+    "[ \"tab\\tnewline\\n\", \"\\u00e9\\u4e2d\", 1, 2.5, null, { empty = \"\" } ]";
+
+static uint32_t parsed[4096];
+static uint32_t indexed[4096];
+
+static int testReallocs;
+
+static void* testRealloc(void*, void* ptr, size_t size)
+{
+    ++testReallocs;
+    return realloc(ptr, size);
+}
+
+static void* failingRealloc(void*, void*, size_t)
+{
+    return 0;
+}
+
+static bool membersMatch(mjson_element_t dict, mjson_element_t other)
+{
+    mjson_element_t keyA, keyB, valueA, valueB;
+
+    keyA = mjson_get_member_first(dict,  &valueA);
+    keyB = mjson_get_member_first(other, &valueB);
+
+    while (keyA && keyB)
+    {
+        if (strcmp(mjson_get_string(keyA, ""), mjson_get_string(keyB, "")) != 0) return false;
+        if (mjson_get_type(valueA) != mjson_get_type(valueB)) return false;
+
+        keyA = mjson_get_member_next(dict,  keyA, &valueA);
+        keyB = mjson_get_member_next(other, keyB, &valueB);
+    }
+
+    return !keyA && !keyB;
+}
+
+void test_mjson_member_lookup()
+{
+    mjson_element_t root;
+
+    int result = mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, sizeof(parsed), &root);
+    sput_fail_unless(result && mjson_get_type(root) == MJSON_ID_DICT32, "Dictionary is parsed");
+
+    sput_fail_unless(mjson_get_int(mjson_get_member(root, "h"), 0) == 8,        "Member after first is found");
+    sput_fail_unless(mjson_get_int(mjson_get_member(root, "ab"), 0) == 9,       "Key is not matched by prefix");
+    sput_fail_unless(mjson_get_int(mjson_get_member(root, "a"), 0) == 1,        "First of duplicated keys is found");
+    sput_fail_unless(mjson_get_member(root, "missing") == 0,                     "Missing member is null");
+    sput_fail_unless(mjson_get_member(root, "") == 0,                            "Empty name is not found");
+}
+
+void test_mjson_index()
+{
+    mjson_element_t root, top;
+
+    mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, sizeof(parsed), &root);
+
+    sput_fail_unless(!mjson_build_index(root, indexed, 64, &top) && top == 0,    "Small buffer is reported");
+    sput_fail_unless(mjson_build_index(root, indexed, sizeof(indexed), &top),    "Index is built");
+
+    sput_fail_unless(mjson_get_type(top) == MJSON_ID_DICT32,     "Indexed top stays dictionary");
+    sput_fail_unless(membersMatch(root, top),                    "Iteration skips index");
+
+    sput_fail_unless(mjson_get_int(mjson_get_member(top, "h"), 0) == 8,         "Indexed member is found");
+    sput_fail_unless(mjson_get_int(mjson_get_member(top, "ab"), 0) == 9,        "Indexed key is not matched by prefix");
+    sput_fail_unless(mjson_get_int(mjson_get_member(top, "a"), 0) == 1,         "First of duplicated keys is indexed");
+    sput_fail_unless(mjson_get_member(top, "missing") == 0,                      "Missing indexed member is null");
+
+    mjson_element_t nested = mjson_get_member(top, "nested");
+    sput_fail_unless(mjson_get_int(mjson_get_member(nested, "t"), 0) == 8,      "Nested dictionary is indexed");
+    sput_fail_unless(membersMatch(mjson_get_member(root, "nested"), nested),     "Nested iteration skips index");
+
+    mjson_element_t small = mjson_get_member(top, "small");
+    sput_fail_unless(strcmp(mjson_get_string(mjson_get_member(small, "only"), ""), "value") == 0, "Small dictionary is copied");
+
+    mjson_element_t item = mjson_get_element_first(mjson_get_member(top, "list"));
+    sput_fail_unless(mjson_get_int(mjson_get_member(item, "w"), 0) == 8,        "Dictionary in array is indexed");
+    sput_fail_unless(strcmp(mjson_get_string(mjson_get_element(mjson_get_member(top, "list"), 1), ""), "tail") == 0,
+                     "Array elements are copied");
+
+    // Indexing of indexed tree gives the same lookups
+    mjson_element_t again;
+    sput_fail_unless(mjson_build_index(top, parsed, sizeof(parsed), &again),    "Indexed tree is indexed again");
+    sput_fail_unless(mjson_get_int(mjson_get_member(again, "h"), 0) == 8,       "Reindexed member is found");
+    sput_fail_unless(membersMatch(top, again),                                   "Reindexed iteration matches");
+}
+
+void test_mjson_index_size()
+{
+    mjson_element_t root, top, again;
+
+    mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, sizeof(parsed), &root);
+
+    size_t size = mjson_build_index_size(root);
+
+    sput_fail_unless(size > 0 && size <= sizeof(indexed),                  "Size is computed");
+    sput_fail_unless(mjson_build_index(root, indexed, size, &top),          "Index fits computed size");
+    sput_fail_unless(!mjson_build_index(root, indexed, size - 4, &again),   "Size is exact");
+    sput_fail_unless(mjson_get_int(mjson_get_member(top, "h"), 0) == 8,     "Member is found in sized storage");
+    sput_fail_unless(mjson_build_index_size(top) == size,                   "Indexed tree has the same size");
+    sput_fail_unless(mjson_build_index_size(0) == 0,                        "Null tree has no size");
+}
+
+void test_mjson_parse_size()
+{
+    mjson_element_t root;
+
+    size_t size = mjson_parse_size(test_dict, sizeof(test_dict) - 1);
+
+    sput_fail_unless(size > 0 && size <= sizeof(parsed),                                    "Size is computed");
+    sput_fail_unless(mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, size, &root),    "Input fits computed size");
+    sput_fail_unless(!mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, size - 4, &root), "Size is exact without escapes");
+
+    size = mjson_parse_size(test_escaped, sizeof(test_escaped) - 1);
+
+    sput_fail_unless(mjson_parse(test_escaped, sizeof(test_escaped) - 1, parsed, size, &root), "Escaped input fits computed size");
+    sput_fail_unless(strcmp(mjson_get_string(mjson_get_element_first(root), ""), "tab\tnewline\n") == 0, "Escapes are decoded");
+
+    sput_fail_unless(mjson_parse_size("", 0) == 12,             "Empty input is empty dictionary");
+    sput_fail_unless(mjson_parse_size("a = #", 5) == 0,         "Invalid token is reported");
+}
+
+void test_mjson_parse_alloc()
+{
+    mjson_element_t root, fixedRoot;
+    void*           buffer = 0;
+    size_t          size   = 0;
+
+    size_t fixedSize = mjson_parse_size(test_dict, sizeof(test_dict) - 1);
+    mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, fixedSize, &fixedRoot);
+
+    testReallocs = 0;
+
+    int result = mjson_parse_alloc(test_dict, sizeof(test_dict) - 1, testRealloc, 0, &buffer, &size, &root);
+
+    sput_fail_unless(result && buffer && size >= fixedSize,        "Storage is allocated");
+    sput_fail_unless(testReallocs > 1,                             "Storage is grown");
+    sput_fail_unless(memcmp(buffer, parsed, fixedSize) == 0,       "Grown storage matches fixed storage");
+    sput_fail_unless(mjson_get_int(mjson_get_member(root, "h"), 0) == 8, "Members are found in grown storage");
+
+    // Escaped strings are written in pieces, every piece could move storage
+    buffer = realloc(buffer, 8);
+    size   = 8;
+    result = mjson_parse_alloc(test_escaped, sizeof(test_escaped) - 1, testRealloc, 0, &buffer, &size, &root);
+
+    sput_fail_unless(result, "Escaped input is parsed into grown storage");
+    sput_fail_unless(strcmp(mjson_get_string(mjson_get_element(root, 1), ""), "\xC3\xA9\xE4\xB8\xAD") == 0,
+                     "Unicode escapes are decoded into grown storage");
+
+    free(buffer);
+
+    buffer = 0;
+    size   = 0;
+    result = mjson_parse_alloc(test_dict, sizeof(test_dict) - 1, failingRealloc, 0, &buffer, &size, &root);
+
+    sput_fail_unless(!result && root == 0 && buffer == 0, "Allocation failure is reported");
+}
+
+void test_mjson_top_element()
+{
+    mjson_element_t root;
+
+    size_t size = mjson_parse_size(test_dict, sizeof(test_dict) - 1);
+    mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, size, &root);
+
+    sput_fail_unless(mjson_get_top_element(parsed, size) == root,                "Parsed storage has top element after fourcc");
+    sput_fail_unless(mjson_get_top_element((uint8_t*)parsed + 4, size - 4) == root, "Storage without fourcc is readable");
+    sput_fail_unless(mjson_get_top_element(parsed, size - 4) == 0,               "Truncated storage is rejected");
+    sput_fail_unless(mjson_get_top_element(parsed, 4) == 0,                      "Storage with only fourcc is rejected");
+}
+
+// Reads every element, members are also looked up by name
+static size_t walkElement(mjson_element_t element)
+{
+    size_t          count = 1;
+    mjson_element_t key, value;
+
+    switch (mjson_get_type(element))
+    {
+        case MJSON_ID_DICT32:
+            for (key = mjson_get_member_first(element, &value); key; key = mjson_get_member_next(element, key, &value))
+            {
+                count += walkElement(value) + (mjson_get_member(element, mjson_get_string(key, "")) != 0);
+            }
+            break;
+
+        case MJSON_ID_ARRAY32:
+            for (value = mjson_get_element_first(element); value; value = mjson_get_element_next(element, value))
+            {
+                count += walkElement(value);
+            }
+            break;
+
+        default:
+            count += strlen(mjson_get_string(element, ""));
+    }
+
+    return count;
+}
+
+void test_mjson_validate()
+{
+    static uint8_t corrupted[sizeof(indexed)];
+
+    mjson_element_t root, top;
+
+    size_t parsedSize = mjson_parse_size(test_dict, sizeof(test_dict) - 1);
+    mjson_parse(test_dict, sizeof(test_dict) - 1, parsed, parsedSize, &root);
+
+    size_t size = mjson_build_index_size(root);
+    mjson_build_index(root, indexed, size, &top);
+
+    sput_fail_unless(mjson_validate(parsed, parsedSize),     "Parsed storage is valid");
+    sput_fail_unless(mjson_validate(indexed, size),          "Indexed storage is valid");
+
+    bool truncatedRejected = true;
+    for (size_t truncated = 0; truncated < size; ++truncated)
+    {
+        truncatedRejected = truncatedRejected && !mjson_validate(indexed, truncated);
+    }
+    sput_fail_unless(truncatedRejected,                      "Truncated storage is rejected");
+
+    // Every byte is corrupted in turn, storage that passes is still safe to read
+    size_t rejected = 0;
+    for (size_t i = 4; i < size; ++i)
+    {
+        memcpy(corrupted, indexed, size);
+        corrupted[i] ^= 0xA5;
+
+        if (mjson_validate(corrupted, size))
+        {
+            walkElement(mjson_get_top_element(corrupted, size));
+        }
+        else
+        {
+            ++rejected;
+        }
+    }
+    sput_fail_unless(rejected > 0,                           "Corrupted storage is rejected");
+
+    // Key offset in index points into the middle of other key
+    memcpy(corrupted, indexed, size);
+    uint32_t* table = (uint32_t*)((uint8_t*)mjson_get_top_element(corrupted, size) + 16);
+    for (uint32_t slot = 0; slot < table[0]; ++slot)
+    {
+        if (table[1 + slot*2 + 1])
+        {
+            table[1 + slot*2 + 1] += 4;
+            break;
+        }
+    }
+    sput_fail_unless(!mjson_validate(corrupted, size),       "Index pointing outside of keys is rejected");
+}
+
+// Fragments cover every path of lexer front end and cases it leaves to state machine
+static const char* const lexerFragments[] = {
+    " ", "\t", "\r\n", "\n    ", "                                        ",
+    "// line comment\n", "// comment without newline", "/* block */", "/**/", "/***/",
+    "/* a **/ b */", "/* a */*/", "/* unterminated", "/*/ x */", "/", "*",
+    "\"\"", "\"plain\"", "\"string without escapes that is longer than two vectors of bytes\"",
+    "\"esc\\\"aped\"", "\"tab\\t\"", "\"\\u00e9\"", "\"bad\\q\"", "\"unterminated",
+    "0", "7", "42", "123456789012345678901234567890123", "-1", "+12", "-0", "-", "+", "1.", "1.5", "-2.25",
+    "3e5", "1.5e-3", "-4E+2", "7e", "12abc", "-12abc", "12_", "1.5x", "0x1F", "017", ".5",
+    "key", "true", "false", "null", "_id", "{", "}", "[", "]", ",", ":", "=", "#", "\x80", "\\",
+};
+
+static const char lexerAlphabet[] = " \t\r\n/*\"\\0123456789.eE+-_xaZ{}[],:=";
+
+static uint32_t fuzzSeed = 1;
+
+static uint32_t fuzzRandom(uint32_t range)
+{
+    fuzzSeed = fuzzSeed * 1664525u + 1013904223u;
+    return (fuzzSeed >> 8) % range;
+}
+
+static size_t fuzzDocument(char* text, size_t capacity)
+{
+    size_t len = 0;
+
+    if (fuzzRandom(4) == 0)
+    {
+        // Random bytes of characters significant for lexer
+        size_t count = fuzzRandom(256);
+        for (; len < count && len < capacity; ++len)
+        {
+            text[len] = lexerAlphabet[fuzzRandom(sizeof(lexerAlphabet) - 1)];
+        }
+    }
+    else
+    {
+        uint32_t count = 1 + fuzzRandom(64);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const char* fragment = lexerFragments[fuzzRandom(sizeof(lexerFragments) / sizeof(lexerFragments[0]))];
+            size_t      size     = strlen(fragment);
+
+            if (len + size > capacity) break;
+
+            memcpy(text + len, fragment, size);
+            len += size;
+        }
+    }
+
+    // Mutations, NUL byte ends input for state machine
+    for (uint32_t i = fuzzRandom(4); len && i < 3; ++i)
+    {
+        text[fuzzRandom((uint32_t)len)] = fuzzRandom(8) ? (char)fuzzRandom(256) : 0;
+    }
+
+    return len;
+}
+
+static uint32_t lexerOutput[2][8192];
+
+void test_mjson_lexer_fuzz()
+{
+    static char text[4096 + 1];
+
+    int best = mjson_select_lexer(-1);
+
+    for (int lexer = MJSON_LEXER_SCALAR; lexer <= best; ++lexer)
+    {
+        uint32_t mismatches = 0;
+
+        fuzzSeed = 1;
+
+        for (int i = 0; i < 20000; ++i)
+        {
+            mjson_element_t rootA = 0, rootB = 0;
+
+            size_t len = fuzzDocument(text, sizeof(text) - 1);
+            text[len] = 0;  // Numbers are read with sscanf
+
+            memset(lexerOutput, 0, sizeof(lexerOutput));
+
+            mjson_select_lexer(MJSON_LEXER_RE2C);
+            int    resultA = mjson_parse(text, len, lexerOutput[0], sizeof(lexerOutput[0]), &rootA);
+            size_t sizeA   = mjson_parse_size(text, len);
+
+            mjson_select_lexer(lexer);
+            int    resultB = mjson_parse(text, len, lexerOutput[1], sizeof(lexerOutput[1]), &rootB);
+            size_t sizeB   = mjson_parse_size(text, len);
+
+            bool match = resultA == resultB && sizeA == sizeB &&
+                         (!resultA || (uint8_t*)rootA - (uint8_t*)lexerOutput[0] == (uint8_t*)rootB - (uint8_t*)lexerOutput[1]) &&
+                         memcmp(lexerOutput[0], lexerOutput[1], sizeof(lexerOutput[0])) == 0;
+
+            mismatches += match ? 0 : 1;
+        }
+
+        static const char* const names[] = { "re2c", "Scalar", "SSE2", "AVX2" };
+
+        char message[64];
+        sprintf(message, "%s lexer output matches state machine", names[lexer]);
+
+        sput_fail_unless(mismatches == 0, message);
+    }
+
+    mjson_select_lexer(-1);
+}
+
+int run_mjson_tests()
+{
+    sput_start_testing();
+
+    sput_enter_suite("MJSON: member lookup");
+    sput_run_test(test_mjson_member_lookup);
+    sput_enter_suite("MJSON: dictionary index");
+    sput_run_test(test_mjson_index);
+    sput_enter_suite("MJSON: index size");
+    sput_run_test(test_mjson_index_size);
+    sput_enter_suite("MJSON: parse size");
+    sput_run_test(test_mjson_parse_size);
+    sput_enter_suite("MJSON: growable storage");
+    sput_run_test(test_mjson_parse_alloc);
+    sput_enter_suite("MJSON: top element");
+    sput_run_test(test_mjson_top_element);
+    sput_enter_suite("MJSON: validation");
+    sput_run_test(test_mjson_validate);
+    sput_enter_suite("MJSON: lexer fuzzing");
+    sput_run_test(test_mjson_lexer_fuzz);
+
+    sput_finish_testing();
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,79 @@
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+#include <math.h>
+#include <stdio.h>
+
+enum mt_bench_private
+{
+    BENCH_ELEMENTS   = 1 << 24,
+    BENCH_ITERATIONS = 8,
+};
+
+static double benchParallelReduce(const float* values)
+{
+    double result = 0.0;
+
+    for (int i = 0; i < BENCH_ITERATIONS; ++i)
+    {
+        result += mt::parallel_reduce<double>(0, BENCH_ELEMENTS, 0, 0.0,
+            [=](double& partial, size_t begin, size_t end)
+            {
+                double sum = 0.0;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    sum += sqrtf(values[i]) * sinf(values[i]);
+                }
+                partial += sum;
+            },
+            [](double& result, const double& partial)
+            {
+                result += partial;
+            }
+        );
+    }
+
+    return result;
+}
+
+// Scaling of parallel_reduce from 1 to number of CPU cores
+int run_mt_bench()
+{
+    float* values = (float*)malloc(sizeof(float)*BENCH_ELEMENTS);
+    for (size_t i = 0; i < BENCH_ELEMENTS; ++i)
+    {
+        values[i] = float(i % 1024);
+    }
+
+    int      maxThreads = SDL_GetCPUCount();
+    uint64_t baseTime   = 0;
+
+    printf("\nmt::parallel_reduce, %d elements x %d iterations\n", BENCH_ELEMENTS, BENCH_ITERATIONS);
+    printf("%8s %12s %8s\n", "threads", "time(us)", "speedup");
+
+    for (int threads = 1; threads <= maxThreads; ++threads)
+    {
+        cpu_timer_t timer;
+
+        mt::init(threads - 1, 4096);
+
+        cpu_timer_start(&timer);
+        volatile double result = benchParallelReduce(values);
+        cpu_timer_stop(&timer);
+        UNUSED(result);
+
+        mt::fini();
+
+        uint64_t time = cpu_timer_measured(&timer);
+        if (threads == 1)
+        {
+            baseTime = time;
+        }
+
+        printf("%8d %12llu %8.2f\n", threads, (unsigned long long)time, double(baseTime) / double(time ? time : 1));
+    }
+
+    free(values);
+
+    return 0;
+}
@@ -0,0 +1,502 @@
+#include <sput.h>
+
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+enum mt_test_private
+{
+    NUM_CHILD_JOBS  = 1000,
+    NUM_GRAPH_TASKS = 32,
+    NUM_ELEMENTS    = 1000003,
+};
+
+static SDL_atomic_t jobCounter;
+
+static void incrementCounter(void*)
+{
+    SDL_AtomicAdd(&jobCounter, 1);
+}
+
+static void emptyTask(void*)
+{
+}
+
+void test_child_jobs()
+{
+    SDL_AtomicSet(&jobCounter, 0);
+
+    mt::job_t* root = mt::createJob(emptyTask, 0);
+    sput_fail_unless(root, "Job allocated");
+
+    for (int i = 0; i < NUM_CHILD_JOBS; ++i)
+    {
+        mt::runJob(mt::createChildJob(root, incrementCounter, 0));
+    }
+
+    mt::job_handle_t handle = mt::getJobHandle(root);
+
+    mt::runJob(root);
+    mt::waitJob(handle);
+
+    sput_fail_unless(mt::isJobComplete(handle), "Parent job is complete");
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == NUM_CHILD_JOBS, "All child jobs finished before parent");
+}
+
+void test_job_slot_reuse()
+{
+    mt::job_t*       first  = mt::createJob(emptyTask, 0);
+    mt::job_handle_t handle = mt::getJobHandle(first);
+
+    mt::runJob(first);
+    mt::waitJob(handle);
+
+    // Ring wraps around to the slot of the finished job
+    mt::job_t* job = 0;
+    for (int i = 0; i < 1 << 16 && job != first; ++i)
+    {
+        job = mt::createJob(emptyTask, 0);
+        if (job && job != first)
+        {
+            mt::job_handle_t other = mt::getJobHandle(job);
+            mt::runJob(job);
+            mt::waitJob(other);
+        }
+    }
+
+    sput_fail_unless(job == first, "Slot of finished job is reused");
+
+    mt::job_handle_t reused = mt::getJobHandle(job);
+
+    sput_fail_unless(mt::isJobComplete(handle),  "Handle of finished job stays complete after slot is reused");
+    sput_fail_unless(!mt::isJobComplete(reused), "Job in reused slot is not complete before it is run");
+
+    mt::waitJob(handle);
+
+    mt::runJob(job);
+    mt::waitJob(reused);
+
+    sput_fail_unless(mt::isJobComplete(reused), "Job in reused slot is complete");
+}
+
+static int SDLCALL submitFromThread(void*)
+{
+    for (int i = 0; i < NUM_CHILD_JOBS; ++i)
+    {
+        mt::job_t* job = mt::createJob(incrementCounter, 0);
+        if (!job)
+        {
+            // Shared ring is full, run pending jobs to free slots
+            mt::runPendingJob();
+            --i;
+            continue;
+        }
+
+        mt::job_handle_t handle = mt::getJobHandle(job);
+        mt::runJob(job);
+
+        if (i % 64 == 0)
+        {
+            mt::waitJob(handle);
+        }
+    }
+
+    return 0;
+}
+
+void test_foreign_thread_jobs()
+{
+    SDL_AtomicSet(&jobCounter, 0);
+
+    SDL_Thread* threads[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        threads[i] = SDL_CreateThread(submitFromThread, "Submitter", 0);
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        SDL_WaitThread(threads[i], NULL);
+    }
+
+    while (mt::runPendingJob()) {}
+    while (SDL_AtomicGet(&jobCounter) != 2 * NUM_CHILD_JOBS)
+    {
+        SDL_Delay(1);
+    }
+
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == 2 * NUM_CHILD_JOBS, "Jobs from non worker threads are executed");
+    sput_fail_unless(mt::getWorkerIndex() == 0, "Thread that called init is worker 0");
+}
+
+void test_async_task_event()
+{
+    uint32_t handle;
+
+    SDL_AtomicSet(&jobCounter, 0);
+
+    sput_fail_unless(mt::addAsyncTask(incrementCounter, 0, &handle) == mt::noError, "Task added");
+    mt::syncAndReleaseEvent(handle);
+
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == 1, "Task finished after sync");
+}
+
+void test_async_task_events_exhausted()
+{
+    static uint32_t handles[NUM_CHILD_JOBS];
+
+    int count  = 0;
+    int result = mt::noError;
+
+    // Events are kept until released, so pool runs out
+    while (count < NUM_CHILD_JOBS && (result = mt::addAsyncTask(emptyTask, 0, &handles[count])) == mt::noError)
+    {
+        ++count;
+    }
+
+    sput_fail_unless(count < NUM_CHILD_JOBS && result == mt::queueFull, "Task is rejected when events run out");
+    sput_fail_unless(handles[count] == mt::INVALID_HANDLE,               "Rejected task has no event");
+
+    for (int i = 0; i < count; ++i)
+    {
+        mt::syncAndReleaseEvent(handles[i]);
+    }
+
+    uint32_t handle;
+    sput_fail_unless(mt::addAsyncTask(emptyTask, 0, &handle) == mt::noError, "Released events are reused");
+    mt::syncAndReleaseEvent(handle);
+}
+
+static SDL_atomic_t taskSequence;
+static int          taskOrder[NUM_GRAPH_TASKS];
+
+static void recordOrder(void* arg)
+{
+    taskOrder[(intptr_t)arg] = SDL_AtomicAdd(&taskSequence, 1);
+}
+
+void test_task_graph()
+{
+    mt::task_graph_t* graph = mt::createTaskGraph(NUM_GRAPH_TASKS, 2*NUM_GRAPH_TASKS);
+
+    // Diamond: 0 -> [1..N-2] -> N-1
+    mt::task_id_t first = mt::taskGraphAdd(graph, recordOrder, (void*)0, 0, 0);
+
+    mt::task_id_t middle[NUM_GRAPH_TASKS];
+    for (intptr_t i = 1; i < NUM_GRAPH_TASKS-1; ++i)
+    {
+        middle[i-1] = mt::taskGraphAdd(graph, recordOrder, (void*)i, &first, 1);
+    }
+
+    mt::task_id_t last = mt::taskGraphAdd(graph, recordOrder, (void*)(NUM_GRAPH_TASKS-1), middle, NUM_GRAPH_TASKS-2);
+    sput_fail_unless(last != mt::INVALID_TASK_ID, "Tasks added");
+
+    bool orderOK = true;
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        SDL_AtomicSet(&taskSequence, 0);
+
+        mt::taskGraphSubmit(graph);
+        mt::taskGraphWait(graph);
+
+        orderOK = orderOK && SDL_AtomicGet(&taskSequence) == NUM_GRAPH_TASKS;
+        orderOK = orderOK && taskOrder[0] == 0 && taskOrder[NUM_GRAPH_TASKS-1] == NUM_GRAPH_TASKS-1;
+    }
+
+    sput_fail_unless(orderOK, "Graph resubmitted, dependencies respected every time");
+
+    mt::destroyTaskGraph(graph);
+}
+
+void test_parallel_for()
+{
+    int32_t* values = (int32_t*)malloc(sizeof(int32_t)*NUM_ELEMENTS);
+
+    mt::parallel_for(0, NUM_ELEMENTS, 0, [=](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            values[i] = (int32_t)i;
+        }
+    });
+
+    bool allSet = true;
+    for (int32_t i = 0; i < NUM_ELEMENTS; ++i)
+    {
+        allSet = allSet && values[i] == i;
+    }
+
+    sput_fail_unless(allSet, "Every element visited with automatic grain");
+
+    mt::parallel_for(0, NUM_ELEMENTS, 777, [=](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            values[i] += 1;
+        }
+    });
+
+    allSet = true;
+    for (int32_t i = 0; i < NUM_ELEMENTS; ++i)
+    {
+        allSet = allSet && values[i] == i + 1;
+    }
+
+    sput_fail_unless(allSet, "Every element visited exactly once with fixed grain");
+
+    free(values);
+}
+
+void test_parallel_reduce()
+{
+    int64_t sum = mt::parallel_reduce<int64_t>(0, NUM_ELEMENTS, 0, 0,
+        [](int64_t& partial, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                partial += i;
+            }
+        },
+        [](int64_t& result, const int64_t& partial)
+        {
+            result += partial;
+        }
+    );
+
+    sput_fail_unless(sum == (int64_t)NUM_ELEMENTS * (NUM_ELEMENTS-1) / 2, "Sum of range");
+
+    int64_t small = mt::parallel_reduce<int64_t>(0, 10, 100, 5,
+        [](int64_t& partial, size_t begin, size_t end)
+        {
+            partial += end - begin;
+        },
+        [](int64_t& result, const int64_t& partial)
+        {
+            result = core::max(result, partial);
+        }
+    );
+
+    sput_fail_unless(small == 15, "Serial fallback below grain");
+}
+
+void test_thread_data_stacks()
+{
+    stack_mem_t mainStack = core::get_thread_data_stack();
+    size_t      marker    = stack_mem_marker(mainStack);
+
+    {
+        THREAD_STACK_SCOPE();
+        core::thread_stack_alloc(1000);
+        sput_fail_unless(stack_mem_marker(mainStack) == marker + 1000, "Allocated from thread stack");
+    }
+
+    sput_fail_unless(stack_mem_marker(mainStack) == marker, "Scope released allocations");
+    sput_fail_unless(core::thread_stack_peak() >= marker + 1000, "High-water mark is kept after release");
+
+    SDL_AtomicSet(&jobCounter, 0);
+
+    mt::parallel_for(0, 1024, 1, [=](size_t begin, size_t end)
+    {
+        THREAD_STACK_SCOPE();
+
+        uint8_t* scratch = (uint8_t*)core::thread_stack_alloc(4096, 16);
+        memset(scratch, (int)begin, 4096);
+
+        // Another thread must not write to our scratch
+        SDL_Delay(0);
+        for (size_t i = 0; i < 4096; ++i)
+        {
+            if (scratch[i] != (uint8_t)begin)
+            {
+                SDL_AtomicAdd(&jobCounter, 1);
+                break;
+            }
+        }
+
+        bool otherStack = mt::getWorkerIndex() == 0 || core::get_thread_data_stack() != mainStack;
+        SDL_AtomicAdd(&jobCounter, otherStack ? 0 : 1);
+    });
+
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == 0, "Workers use own thread stacks");
+    sput_fail_unless(stack_mem_marker(mainStack) == marker, "Main thread stack is balanced");
+    sput_fail_unless(core::thread_stacks_peak() >= 4096, "Peak over all thread stacks");
+}
+
+static int SDLCALL useThreadStack(void*)
+{
+    stack_mem_t stack = core::get_thread_data_stack();
+    if (!stack)
+    {
+        SDL_AtomicAdd(&jobCounter, 1);
+        return 0;
+    }
+
+    THREAD_STACK_SCOPE();
+    memset(core::thread_stack_alloc(1024), 0, 1024);
+
+    return 0;
+}
+
+void test_thread_data_stack_reuse()
+{
+    SDL_AtomicSet(&jobCounter, 0);
+
+    // More threads than stack slots, every exited thread returns its stack
+    for (int i = 0; i < 256; ++i)
+    {
+        SDL_WaitThread(SDL_CreateThread(useThreadStack, "Stack user", 0), NULL);
+    }
+
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == 0, "Stacks of exited threads are reused");
+}
+
+static SDL_sem*     stackHolderRelease;
+static SDL_atomic_t stacksMissing;
+static SDL_atomic_t stackHolders;
+
+// Keeps thread stack until released, threads without stack check that allocations fail
+static int SDLCALL holdThreadStack(void*)
+{
+    if (!core::get_thread_data_stack())
+    {
+        THREAD_STACK_SCOPE();
+
+        bool failed = core::thread_stack_alloc(16) == 0 && core::thread_stack_peak() == 0;
+        SDL_AtomicAdd(failed ? &stacksMissing : &jobCounter, 1);
+    }
+
+    SDL_AtomicAdd(&stackHolders, 1);
+    SDL_SemWait(stackHolderRelease);
+
+    return 0;
+}
+
+void test_thread_data_stacks_exhausted()
+{
+    static const int NUM_HOLDERS = 96;
+
+    SDL_Thread* threads[NUM_HOLDERS];
+
+    SDL_AtomicSet(&jobCounter, 0);
+    SDL_AtomicSet(&stacksMissing, 0);
+    SDL_AtomicSet(&stackHolders, 0);
+    stackHolderRelease = SDL_CreateSemaphore(0);
+
+    for (int i = 0; i < NUM_HOLDERS; ++i)
+    {
+        threads[i] = SDL_CreateThread(holdThreadStack, "Stack holder", 0);
+    }
+
+    // All threads take stacks before any of them returns its stack
+    while (SDL_AtomicGet(&stackHolders) < NUM_HOLDERS)
+    {
+        SDL_Delay(1);
+    }
+
+    for (int i = 0; i < NUM_HOLDERS; ++i)
+    {
+        SDL_SemPost(stackHolderRelease);
+    }
+
+    for (int i = 0; i < NUM_HOLDERS; ++i)
+    {
+        SDL_WaitThread(threads[i], NULL);
+    }
+
+    SDL_DestroySemaphore(stackHolderRelease);
+
+    sput_fail_unless(SDL_AtomicGet(&stacksMissing) > 0,  "Threads over the limit get no stack");
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == 0,    "Allocations without stack fail");
+
+    SDL_WaitThread(SDL_CreateThread(useThreadStack, "Stack user", 0), NULL);
+
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == 0,    "Stacks are available after threads exit");
+}
+
+void test_frame_memory()
+{
+    core::frame_mem_begin();
+
+    uint8_t* first = (uint8_t*)core::frame_alloc(100);
+    uint8_t* next  = (uint8_t*)core::frame_alloc(64, 64);
+
+    sput_fail_unless(first && next && next >= first + 100 && (uintptr_t)next % 64 == 0, "Frame allocations are linear and aligned");
+    sput_fail_unless(core::frame_mem_used() > 0, "Thread page is taken from frame buffer");
+
+    SDL_AtomicSet(&jobCounter, 0);
+
+    mt::parallel_for(0, 1024, 1, [=](size_t begin, size_t end)
+    {
+        uint32_t* data = core::frame_alloc_array<uint32_t>(256);
+        for (size_t i = 0; i < 256; ++i)
+        {
+            data[i] = (uint32_t)begin;
+        }
+
+        // Other threads must not write to our allocation
+        SDL_Delay(0);
+        for (size_t i = 0; i < 256; ++i)
+        {
+            if (data[i] != (uint32_t)begin)
+            {
+                SDL_AtomicAdd(&jobCounter, 1);
+                break;
+            }
+        }
+    });
+
+    sput_fail_unless(SDL_AtomicGet(&jobCounter) == 0, "Jobs allocate frame memory without overlaps");
+
+    size_t overflows = core::frame_mem_overflows();
+    memset(first, 0xA5, 100);
+
+    core::frame_mem_begin();
+
+    sput_fail_unless(core::frame_mem_used() == 0, "Frame buffer is reset");
+
+    uint8_t* other = (uint8_t*)core::frame_alloc(100);
+    sput_fail_unless(other != first && first[99] == 0xA5, "Previous frame allocations stay valid");
+
+    uint8_t* huge = (uint8_t*)core::frame_alloc(64 << 20, 16);
+    sput_fail_unless(huge && (uintptr_t)huge % 16 == 0, "Allocation larger than frame buffer falls back to heap");
+    sput_fail_unless(core::frame_mem_overflows() == overflows + 1, "Overflow is counted");
+
+    huge[(64 << 20) - 1] = 1;
+
+    core::frame_mem_begin();
+    core::frame_mem_begin();
+}
+
+int run_mt_tests()
+{
+    core::init();
+
+    sput_start_testing();
+
+    sput_enter_suite("MT: child jobs");
+    sput_run_test(test_child_jobs);
+    sput_enter_suite("MT: job slot reuse");
+    sput_run_test(test_job_slot_reuse);
+    sput_enter_suite("MT: jobs from non worker threads");
+    sput_run_test(test_foreign_thread_jobs);
+    sput_enter_suite("MT: async task event");
+    sput_run_test(test_async_task_event);
+    sput_run_test(test_async_task_events_exhausted);
+    sput_enter_suite("MT: task graph");
+    sput_run_test(test_task_graph);
+    sput_enter_suite("MT: parallel_for");
+    sput_run_test(test_parallel_for);
+    sput_enter_suite("MT: parallel_reduce");
+    sput_run_test(test_parallel_reduce);
+    sput_enter_suite("MT: thread data stacks");
+    sput_run_test(test_thread_data_stacks);
+    sput_run_test(test_thread_data_stack_reuse);
+    sput_run_test(test_thread_data_stacks_exhausted);
+    sput_enter_suite("MT: frame memory");
+    sput_run_test(test_frame_memory);
+
+    sput_finish_testing();
+
+    core::fini();
+
+    return sput_get_return_value();
+}
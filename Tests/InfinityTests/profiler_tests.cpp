@@ -0,0 +1,426 @@
+#include <sput.h>
+
+#include <SDL2/SDL.h>
+
+#include <core/core.h>
+
+enum profiler_test_private
+{
+    NUM_SCOPES = 4096,
+    NUM_FRAMES = 4,
+};
+
+static void profiledWork(size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        PROFILER_CPU_TIMESLICE("profiledWork");
+    }
+}
+
+// Counter events depend on registered samplers and job submissions
+static atomic_t countNonCounterEvents(const event_capture_t* capture)
+{
+    atomic_t count = 0;
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        uint32_t phase = capture->events[i].phase;
+        count += phase != PROF_EVENT_PHASE_COUNTER && phase != PROF_EVENT_PHASE_COUNTER_HIGH ? 1 : 0;
+    }
+    return count;
+}
+
+void test_profiler_thread_merge()
+{
+    profilerStartCapture();
+    profilerStartSyncPoint();
+
+    mt::parallel_for(0, NUM_SCOPES, 64, [](size_t begin, size_t end)
+    {
+        profiledWork(begin, end);
+    });
+
+    profilerStopCapture();
+    profilerStopSyncPoint();
+
+    event_capture_t* capture = profilerGetData();
+
+    sput_fail_unless(capture->numFrames == 1, "Frame marker recorded by sync point");
+    sput_fail_unless(countNonCounterEvents(capture) == 2*NUM_SCOPES + 1, "Events of all threads merged");
+    sput_fail_unless(capture->numDropped == 0, "No events dropped");
+
+    bool     ordered = true;
+    bool     validThreads = true;
+    int32_t  balance[MAX_PROFILER_THREADS] = {0};
+
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        const profiler_event_t& evt = capture->events[i];
+
+        ordered      = ordered && (i == 0 || capture->events[i-1].timestamp <= evt.timestamp);
+        ordered      = ordered && evt.timestamp <= capture->endTime;
+        validThreads = validThreads && evt.tid < profilerGetThreadCount();
+
+        if (evt.tid < MAX_PROFILER_THREADS && (evt.phase == PROF_EVENT_PHASE_BEGIN || evt.phase == PROF_EVENT_PHASE_END))
+        {
+            balance[evt.tid] += evt.phase == PROF_EVENT_PHASE_BEGIN ? 1 : -1;
+            ordered = ordered && balance[evt.tid] >= 0 && balance[evt.tid] <= 1;
+        }
+    }
+
+    sput_fail_unless(ordered, "Merged events are ordered by time and nested per thread");
+    sput_fail_unless(validThreads, "Events use registered thread indices");
+    sput_fail_unless(strcmp(profilerGetThreadName(0), "Main") == 0, "Main thread is registered first");
+}
+
+void test_profiler_frame_history()
+{
+    for (int i = 0; i < NUM_FRAMES; ++i)
+    {
+        profilerStartSyncPoint();
+        {
+            PROFILER_CPU_TIMESLICE("historyFrame");
+        }
+        profilerStopSyncPoint();
+    }
+
+    // Begin next frame, so previous ones are complete
+    profilerStartSyncPoint();
+
+    uint32_t numFrames = profilerSnapshotFrames(2);
+
+    event_capture_t* capture = profilerGetData();
+
+    sput_fail_unless(numFrames == 2, "Requested number of frames available");
+    sput_fail_unless(capture->numFrames == 2, "Snapshot starts at frame marker and excludes frame in progress");
+    sput_fail_unless(countNonCounterEvents(capture) == 6, "Snapshot contains events of last frames only");
+    sput_fail_unless(capture->events[0].phase == PROF_EVENT_PHASE_MARKER, "First event is frame marker");
+    sput_fail_unless(capture->events[0].timestamp == 0, "Timestamps are relative to first frame");
+
+    profilerStopSyncPoint();
+}
+
+void test_profiler_ring_wrap()
+{
+    const uint32_t numScopes = MAX_PROFILER_THREAD_EVENTS;
+
+    profilerStartCapture();
+    profilerStartSyncPoint();
+
+    profiledWork(0, numScopes);
+
+    profilerStopCapture();
+    profilerStopSyncPoint();
+
+    event_capture_t* capture = profilerGetData();
+
+    sput_fail_unless(capture->numEvents == MAX_PROFILER_THREAD_EVENTS - 1, "Ring keeps last events of thread");
+
+    bool ordered = true;
+    for (atomic_t i = 1; i < capture->numEvents; ++i)
+    {
+        ordered = ordered && capture->events[i-1].timestamp <= capture->events[i].timestamp;
+    }
+
+    sput_fail_unless(ordered, "Events are ordered after ring wrap");
+    sput_fail_unless(capture->events[capture->numEvents-1].phase == PROF_EVENT_PHASE_END, "Newest event is kept");
+}
+
+static uint16_t oldOwnerIndex;
+static uint16_t newOwnerIndex;
+
+static int SDLCALL oldSlotOwner(void*)
+{
+    oldOwnerIndex = profilerRegisterThread("Old owner");
+    {
+        PROFILER_CPU_TIMESLICE("oldOwnerWork");
+    }
+    profilerUnregisterThread();
+
+    return 0;
+}
+
+static int SDLCALL newSlotOwner(void*)
+{
+    newOwnerIndex = profilerRegisterThread("New owner");
+    {
+        PROFILER_CPU_TIMESLICE("newOwnerWork");
+    }
+    profilerUnregisterThread();
+
+    return 0;
+}
+
+void test_profiler_slot_reuse()
+{
+    profilerStartCapture();
+    profilerStartSyncPoint();
+
+    SDL_WaitThread(SDL_CreateThread(oldSlotOwner, "Old owner", 0), NULL);
+    SDL_WaitThread(SDL_CreateThread(newSlotOwner, "New owner", 0), NULL);
+
+    profilerStopCapture();
+    profilerStopSyncPoint();
+
+    event_capture_t* capture = profilerGetData();
+    const char**     names   = profilerGetNames();
+
+    bool oldUnderNewName = false;
+    bool newRecorded     = false;
+
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        const profiler_event_t& evt = capture->events[i];
+
+        if (evt.tid != newOwnerIndex || !names[evt.id]) continue;
+
+        oldUnderNewName = oldUnderNewName || strcmp(names[evt.id], "oldOwnerWork") == 0;
+        newRecorded     = newRecorded     || strcmp(names[evt.id], "newOwnerWork") == 0;
+    }
+
+    sput_fail_unless(oldOwnerIndex == newOwnerIndex, "Slot of exited thread is reused");
+    sput_fail_unless(!oldUnderNewName, "Events of previous owner are not reported under new thread");
+    sput_fail_unless(newRecorded, "Events of new owner are recorded");
+    sput_fail_unless(strcmp(profilerGetThreadName(newOwnerIndex), "New owner") == 0, "Slot is renamed");
+}
+
+static int64_t sampleTestValue(void* value)
+{
+    return *(int64_t*)value;
+}
+
+static bool findCounter(const event_capture_t* capture, const char* name, int64_t* value)
+{
+    const char** names = profilerGetNames();
+    for (atomic_t i = 0; i < capture->numEvents; ++i)
+    {
+        const profiler_event_t& evt = capture->events[i];
+        if (evt.phase == PROF_EVENT_PHASE_COUNTER && strcmp(names[evt.id], name) == 0)
+        {
+            *value = event_capture_counter_value(capture, i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void test_profiler_counters()
+{
+    int64_t  sampled   = 0;
+    uint16_t samplerId = profilerAddGaugeSampler("testSampler", sampleTestValue, &sampled);
+
+    profilerStartSyncPoint();
+
+    mt::parallel_for(0, NUM_SCOPES, 64, [](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            PROFILER_FRAME_COUNTER("testFrameCounter", 1);
+        }
+    });
+
+    PROFILER_GAUGE("testGauge", 1ll << 40);
+    sampled = -5;
+
+    profilerStopSyncPoint();
+
+    // Totals are recorded at the beginning of the next frame
+    profilerStartSyncPoint();
+    profilerSnapshotFrames(1);
+
+    event_capture_t* capture = profilerGetData();
+    int64_t          gauge   = 0;
+    int64_t          counter = 0;
+    int64_t          sample  = 0;
+
+    sput_fail_unless(findCounter(capture, "testGauge", &gauge) && gauge == 1ll << 40, "Gauge keeps 64-bit value");
+    sput_fail_unless(findCounter(capture, "testFrameCounter", &counter) && counter == NUM_SCOPES, "Frame counter accumulates increments of all threads");
+    sput_fail_unless(findCounter(capture, "testSampler", &sample) && sample == -5, "Sampler is called at the end of frame");
+    sput_fail_unless(capture->numFrames == 1, "Totals are recorded before next frame marker");
+
+    profilerStopSyncPoint();
+    profilerRemoveGaugeSampler(samplerId);
+}
+
+void test_profiler_export()
+{
+    profilerStartCapture();
+    profilerStartSyncPoint();
+
+    profiledWork(0, 16);
+
+    profilerStopCapture();
+    profilerStopSyncPoint();
+
+    event_capture_t* capture  = profilerGetData();
+    const char**     names    = profilerGetNames();
+    uint16_t         numNames = profilerGetIdCount();
+
+    sput_fail_unless(event_capture_export_json(capture, names, numNames, "profiler_test.json"), "JSON trace written");
+    sput_fail_unless(event_capture_export_binary(capture, names, numNames, "profiler_test.iprf"), "Binary trace written");
+
+    char      json[16] = {0};
+    uint8_t   header[24] = {0};
+
+    SDL_RWops* rw = SDL_RWFromFile("profiler_test.json", "rb");
+    if (rw)
+    {
+        SDL_RWread(rw, json, 1, sizeof(json)-1);
+        SDL_RWclose(rw);
+    }
+
+    rw = SDL_RWFromFile("profiler_test.iprf", "rb");
+    if (rw)
+    {
+        SDL_RWread(rw, header, 1, sizeof(header));
+        SDL_RWclose(rw);
+    }
+
+    uint32_t version;
+    uint64_t freq;
+    memcpy(&version, header + 4, sizeof(version));
+    memcpy(&freq,    header + 8, sizeof(freq));
+
+    sput_fail_unless(json[0] == '{', "JSON trace is an object");
+    sput_fail_unless(memcmp(header, PROFILER_BINARY_MAGIC, 4) == 0, "Binary trace starts with magic");
+    sput_fail_unless(version == PROFILER_BINARY_VERSION, "Binary trace version");
+    sput_fail_unless(freq == capture->freq, "Binary trace keeps timer frequency");
+
+    remove("profiler_test.json");
+    remove("profiler_test.iprf");
+}
+
+static void addEvent(event_capture_t* capture, uint16_t tid, uint16_t id, EventPhase phase, uint64_t ts)
+{
+    event_capture_add(capture, tid, id, phase, capture->startTime + ts);
+}
+
+void test_profiler_stats_tree()
+{
+    event_capture_t*  capture = (event_capture_t*)malloc(sizeof(event_capture_t));
+    profiler_stats_t* stats   = profilerStatsCreate(64);
+
+    event_capture_init(capture, 1000000);
+    capture->maxEvents = MAX_PROFILER_EVENTS;
+    event_capture_start(capture, 0);
+
+    // A[0, 100] -> B[10, 30], B[40, 60] -> C[45, 50]
+    addEvent(capture, 1, 0, PROF_EVENT_PHASE_BEGIN,   0);
+    addEvent(capture, 1, 1, PROF_EVENT_PHASE_BEGIN,  10);
+    addEvent(capture, 1, 1, PROF_EVENT_PHASE_END,    30);
+    addEvent(capture, 1, 1, PROF_EVENT_PHASE_BEGIN,  40);
+    addEvent(capture, 1, 2, PROF_EVENT_PHASE_BEGIN,  45);
+    addEvent(capture, 1, 2, PROF_EVENT_PHASE_END,    50);
+    addEvent(capture, 1, 1, PROF_EVENT_PHASE_END,    60);
+    addEvent(capture, 1, 0, PROF_EVENT_PHASE_END,   100);
+    // Not closed in capture
+    addEvent(capture, 2, 3, PROF_EVENT_PHASE_BEGIN, 110);
+    event_capture_stop(capture, 120);
+
+    profilerStatsAddCapture(stats, capture);
+
+    const profiler_scope_stats_t* a = profilerStatsGetScope(stats, 0);
+    const profiler_scope_stats_t* b = profilerStatsGetScope(stats, 1);
+
+    sput_fail_unless(a && a->count == 1 && a->totalTicks == 100 && a->selfTicks == 60, "Self time excludes children");
+    sput_fail_unless(b && b->count == 2 && b->totalTicks == 40 && b->selfTicks == 35, "Scope accumulates all intervals");
+    sput_fail_unless(b && b->minTicks == 20 && b->maxTicks == 20, "Min and max duration");
+    sput_fail_unless(profilerStatsGetScope(stats, 3) == 0, "Open interval is ignored");
+
+    uint32_t root = profilerStatsGetRoot(stats, 1);
+    sput_fail_unless(root != PROFILER_STATS_INVALID_NODE, "Thread has call tree");
+    sput_fail_unless(profilerStatsGetRoot(stats, 0) == PROFILER_STATS_INVALID_NODE, "Thread without events has no tree");
+
+    const profiler_tree_node_t* nodeA = profilerStatsGetNode(stats, root);
+    const profiler_tree_node_t* nodeB = profilerStatsGetNode(stats, nodeA->firstChild);
+    const profiler_tree_node_t* nodeC = profilerStatsGetNode(stats, nodeB->firstChild);
+
+    sput_fail_unless(nodeA->id == 0 && nodeA->nextSibling == PROFILER_STATS_INVALID_NODE, "Single root scope");
+    sput_fail_unless(nodeB->id == 1 && nodeB->count == 2 && nodeB->selfTicks == 35, "Repeated child is merged into one node");
+    sput_fail_unless(nodeC->id == 2 && nodeC->depth == 2 && nodeC->totalTicks == 5, "Grandchild node");
+
+    profilerStatsDestroy(stats);
+    free(capture);
+}
+
+void test_profiler_stats_percentiles()
+{
+    enum { NUM_CAPTURES = 100, DEPTH = PROFILER_STATS_MAX_DEPTH + 8 };
+
+    event_capture_t*  capture = (event_capture_t*)malloc(sizeof(event_capture_t));
+    profiler_stats_t* stats   = profilerStatsCreate(1024);
+
+    event_capture_init(capture, 1000000);
+    capture->maxEvents = MAX_PROFILER_EVENTS;
+
+    // Scope duration in capture i is (i+1)*1000 ticks
+    for (uint64_t i = 0; i < NUM_CAPTURES; ++i)
+    {
+        event_capture_start(capture, i * 1000000);
+        addEvent(capture, 0, 0, PROF_EVENT_PHASE_BEGIN, 0);
+        addEvent(capture, 0, 0, PROF_EVENT_PHASE_END,   (i + 1) * 1000);
+        event_capture_stop(capture, (i + 2) * 1000);
+
+        profilerStatsAddCapture(stats, capture);
+    }
+
+    uint64_t p50 = profilerStatsGetPercentile(stats, 0, 50.0f);
+    uint64_t p99 = profilerStatsGetPercentile(stats, 0, 99.0f);
+
+    sput_fail_unless(profilerStatsGetCaptureCount(stats) == NUM_CAPTURES, "All captures accumulated");
+    sput_fail_unless(p50 >= 50000 - 50000/16 && p50 <= 50000 + 50000/16, "p50 within histogram precision");
+    sput_fail_unless(p99 >= 99000 - 99000/16 && p99 <= 100000, "p99 within histogram precision");
+    sput_fail_unless(profilerStatsGetPercentile(stats, 0, 100.0f) == 100000, "p100 is clamped to max");
+
+    // Scopes deeper than stack are dropped from tree, outer scopes still match
+    profilerStatsReset(stats);
+    event_capture_start(capture, 0);
+    for (uint64_t i = 0; i < DEPTH; ++i)
+    {
+        addEvent(capture, 0, (uint16_t)i, PROF_EVENT_PHASE_BEGIN, i);
+    }
+    for (uint64_t i = 0; i < DEPTH; ++i)
+    {
+        addEvent(capture, 0, (uint16_t)(DEPTH - 1 - i), PROF_EVENT_PHASE_END, DEPTH + i);
+    }
+    profilerStatsAddCapture(stats, capture);
+
+    const profiler_scope_stats_t* outer = profilerStatsGetScope(stats, 0);
+
+    sput_fail_unless(profilerStatsGetDroppedCount(stats) == DEPTH - PROFILER_STATS_MAX_DEPTH, "Deep scopes are counted as dropped");
+    sput_fail_unless(outer && outer->totalTicks == 2 * DEPTH - 1, "Outer scope is complete");
+
+    profilerStatsDestroy(stats);
+    free(capture);
+}
+
+int run_profiler_tests()
+{
+    core::init();
+
+    sput_start_testing();
+
+    sput_enter_suite("Profiler: per-thread buffers merge");
+    sput_run_test(test_profiler_thread_merge);
+
+    sput_enter_suite("Profiler: rolling window");
+    sput_run_test(test_profiler_frame_history);
+    sput_run_test(test_profiler_ring_wrap);
+    sput_run_test(test_profiler_slot_reuse);
+
+    sput_enter_suite("Profiler: counters");
+    sput_run_test(test_profiler_counters);
+
+    sput_enter_suite("Profiler: scope statistics");
+    sput_run_test(test_profiler_stats_tree);
+    sput_run_test(test_profiler_stats_percentiles);
+
+    sput_enter_suite("Profiler: export");
+    sput_run_test(test_profiler_export);
+
+    sput_finish_testing();
+
+    core::fini();
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,222 @@
+"""Summarise exported profiler captures per scope.
+
+Usage:
+    profiler_report.py capture.(json|iprf) [--compare baseline.(json|iprf)] [--sort total|avg|p99|count|name]
+
+Reads Chrome trace JSON or binary capture written by event_capture_export_json/
+event_capture_export_binary and prints count, min, avg, p99, max and total time
+of every scope in milliseconds, counter tracks are summarised by number of
+samples, min, avg and max value. With --compare avg and p99 deltas against the
+baseline capture are printed as well.
+"""
+from __future__ import print_function
+
+import argparse
+import json
+import struct
+import sys
+
+PHASE_BEGIN   = 0
+PHASE_END     = 1
+PHASE_MARKER  = 2
+PHASE_COUNTER = 3
+
+BINARY_MAGIC   = b"IPRF"
+BINARY_VERSION = 2
+
+
+class Capture(object):
+    def __init__(self):
+        self.freq    = 1
+        self.dropped = 0
+        self.frames  = 0
+        # (timestamp in ms, name, tid, phase)
+        self.events  = []
+        # name -> list of values
+        self.counters = {}
+
+
+def read_varint(data, offset):
+    value = 0
+    shift = 0
+    while True:
+        byte = bytearray(data[offset:offset+1])[0]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, offset
+
+
+def read_string(data, offset):
+    length, = struct.unpack_from("<H", data, offset)
+    offset += 2
+    return data[offset:offset+length].decode("utf-8", "replace"), offset + length
+
+
+def load_binary(data):
+    capture = Capture()
+
+    if data[0:4] != BINARY_MAGIC:
+        raise ValueError("not a profiler capture")
+
+    version, = struct.unpack_from("<I", data, 4)
+    if version < 1 or version > BINARY_VERSION:
+        raise ValueError("unsupported capture version %d" % version)
+
+    (capture.freq, _, _, num_events, capture.dropped, capture.frames,
+     num_names, num_tracks) = struct.unpack_from("<QQQIIIHH", data, 8)
+    offset = 8 + struct.calcsize("<QQQIIIHH")
+
+    names = []
+    for _ in range(num_names):
+        name, offset = read_string(data, offset)
+        names.append(name)
+
+    for _ in range(num_tracks):
+        _, offset = read_string(data, offset)
+
+    ts = 0
+    for _ in range(num_events):
+        delta, offset = read_varint(data, offset)
+        eid, offset = read_varint(data, offset)
+        tid, phase = struct.unpack_from("<BB", data, offset)
+        offset += 2
+
+        ts += delta
+        name = names[eid] if eid < len(names) else "id %d" % eid
+
+        if phase == PHASE_COUNTER and version >= 2:
+            zigzag, offset = read_varint(data, offset)
+            capture.counters.setdefault(name, []).append((zigzag >> 1) ^ -(zigzag & 1))
+            continue
+
+        capture.events.append((ts * 1000.0 / capture.freq, name, tid, phase))
+
+    return capture
+
+
+def load_json(data):
+    capture = Capture()
+    trace = json.loads(data.decode("utf-8"))
+
+    other = trace.get("otherData", {})
+    capture.dropped = other.get("droppedEvents", 0)
+    capture.frames  = other.get("frames", 0)
+
+    phases = {"B": PHASE_BEGIN, "E": PHASE_END, "i": PHASE_MARKER}
+    for evt in trace["traceEvents"]:
+        if evt["ph"] == "C":
+            capture.counters.setdefault(evt["name"], []).append(evt["args"]["value"])
+            continue
+
+        phase = phases.get(evt["ph"])
+        if phase is None:
+            continue
+        capture.events.append((evt["ts"] / 1000.0, evt["name"], evt["tid"], phase))
+
+    return capture
+
+
+def load_capture(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if data[0:4] == BINARY_MAGIC:
+        return load_binary(data)
+
+    return load_json(data)
+
+
+def percentile(values, p):
+    """Nearest-rank percentile of sorted values."""
+    rank = int(round(p / 100.0 * len(values) + 0.5))
+    return values[min(max(rank, 1), len(values)) - 1]
+
+
+def scope_durations(capture):
+    stacks    = {}
+    durations = {}
+
+    for ts, name, tid, phase in capture.events:
+        stack = stacks.setdefault(tid, [])
+        if phase == PHASE_BEGIN:
+            stack.append((name, ts))
+        elif phase == PHASE_END:
+            # Scopes opened before capture start are ignored
+            if stack and stack[-1][0] == name:
+                _, start = stack.pop()
+                durations.setdefault(name, []).append(ts - start)
+
+    return durations
+
+
+def summarise(capture):
+    stats = {}
+    for name, values in scope_durations(capture).items():
+        values.sort()
+        stats[name] = {
+            "count": len(values),
+            "min":   values[0],
+            "avg":   sum(values) / len(values),
+            "p99":   percentile(values, 99),
+            "max":   values[-1],
+            "total": sum(values),
+        }
+    return stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-scope summary of profiler captures")
+    parser.add_argument("capture")
+    parser.add_argument("--compare", help="baseline capture to compare against")
+    parser.add_argument("--sort", default="total", choices=["total", "avg", "p99", "count", "name"])
+    args = parser.parse_args()
+
+    capture = load_capture(args.capture)
+    stats   = summarise(capture)
+
+    baseline = summarise(load_capture(args.compare)) if args.compare else None
+
+    if args.sort == "name":
+        order = sorted(stats)
+    else:
+        order = sorted(stats, key=lambda name: stats[name][args.sort], reverse=True)
+
+    width  = max([len(name) for name in order] + [5])
+    header = "%-*s %8s %10s %10s %10s %10s %12s" % (width, "scope", "count", "min", "avg", "p99", "max", "total")
+    if baseline is not None:
+        header += " %10s %10s" % ("d avg", "d p99")
+
+    print("events %d, frames %d, dropped %d" % (len(capture.events), capture.frames, capture.dropped))
+    print(header)
+    print("-" * len(header))
+
+    for name in order:
+        s    = stats[name]
+        line = "%-*s %8d %10.3f %10.3f %10.3f %10.3f %12.3f" % (
+            width, name, s["count"], s["min"], s["avg"], s["p99"], s["max"], s["total"])
+
+        if baseline is not None:
+            base = baseline.get(name)
+            if base:
+                line += " %+10.3f %+10.3f" % (s["avg"] - base["avg"], s["p99"] - base["p99"])
+            else:
+                line += " %10s %10s" % ("new", "new")
+
+        print(line)
+
+    if capture.counters:
+        width = max(len(name) for name in capture.counters)
+        print("")
+        print("%-*s %8s %14s %16s %14s" % (width, "counter", "samples", "min", "avg", "max"))
+        for name in sorted(capture.counters):
+            values = capture.counters[name]
+            print("%-*s %8d %14d %16.1f %14d" % (
+                width, name, len(values), min(values), float(sum(values)) / len(values), max(values)))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())